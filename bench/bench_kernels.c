@@ -0,0 +1,772 @@
+/*
+ *        Micro-benchmark of the inference kernels of CRFsuite.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <os.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <crfsuite.h>
+#include "crf1d.h"
+#include "option.h"
+
+/*
+ * This program times the kernels of crf1d_context.c on synthetic models
+ * and instances. A model is a set of random attribute weights (state
+ * features) and transition weights; the instances are drawn from the same
+ * pseudo-random generator, so that a seed always reproduces the same
+ * inputs (and the same checksum) on any platform.
+ */
+
+typedef struct {
+	int ftype;
+	int num_labels;
+	int num_items;
+	int num_attributes;
+	int num_vocabulary;
+	int num_features;
+	int order;
+	int segment;
+	int num_instances;
+	int warmup;
+	int repeat;
+	unsigned int seed;
+	int json;
+	int help;
+} bench_option_t;
+
+static void bench_option_init(bench_option_t* opt)
+{
+	memset(opt, 0, sizeof(*opt));
+	opt->ftype = FTYPE_CRF1D;
+	opt->num_labels = 10;
+	opt->num_items = 100;
+	opt->num_attributes = 20;
+	opt->num_vocabulary = 10000;
+	opt->num_features = 4;
+	opt->order = 1;
+	opt->segment = 4;
+	opt->num_instances = 8;
+	opt->warmup = 10;
+	opt->repeat = 100;
+	opt->seed = 1;
+}
+
+#define    ON_POSITIVE_OPTION(var, name) \
+    var = atoi(arg); \
+    if (var < 1) { \
+        fprintf(stderr, "ERROR: Invalid %s: %s\n", name, arg); \
+        return -1; \
+    }
+
+BEGIN_OPTION_MAP(parse_bench_options, bench_option_t)
+
+	ON_OPTION_WITH_ARG(LONGOPT("type"))
+		if (strcmp(arg, "tree") == 0)
+			opt->ftype = FTYPE_CRF1TREE;
+		else if (strcmp(arg, "semim") == 0)
+			opt->ftype = FTYPE_SEMIMCRF;
+		else if (strcmp(arg, "1d") == 0)
+			opt->ftype = FTYPE_CRF1D;
+		else {
+			fprintf(stderr, "ERROR: Unknown model type: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(SHORTOPT('L') || LONGOPT("labels"))
+		ON_POSITIVE_OPTION(opt->num_labels, "number of labels")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('T') || LONGOPT("items"))
+		ON_POSITIVE_OPTION(opt->num_items, "number of items")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('A') || LONGOPT("attributes"))
+		ON_POSITIVE_OPTION(opt->num_attributes, "number of attributes per item")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('V') || LONGOPT("vocabulary"))
+		ON_POSITIVE_OPTION(opt->num_vocabulary, "number of distinct attributes")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('F') || LONGOPT("features"))
+		ON_POSITIVE_OPTION(opt->num_features, "number of features per attribute")
+
+	ON_OPTION_WITH_ARG(LONGOPT("order"))
+		ON_POSITIVE_OPTION(opt->order, "order")
+
+	ON_OPTION_WITH_ARG(LONGOPT("segment"))
+		ON_POSITIVE_OPTION(opt->segment, "maximum segment length")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('n') || LONGOPT("instances"))
+		ON_POSITIVE_OPTION(opt->num_instances, "number of instances")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('w') || LONGOPT("warmup"))
+		opt->warmup = atoi(arg);
+
+	ON_OPTION_WITH_ARG(SHORTOPT('r') || LONGOPT("repeat"))
+		ON_POSITIVE_OPTION(opt->repeat, "number of repetitions")
+
+	ON_OPTION_WITH_ARG(SHORTOPT('s') || LONGOPT("seed"))
+		opt->seed = (unsigned int)strtoul(arg, NULL, 10);
+
+	ON_OPTION(SHORTOPT('j') || LONGOPT("json"))
+		opt->json = 1;
+
+	ON_OPTION(SHORTOPT('h') || LONGOPT("help"))
+		opt->help = 1;
+
+END_OPTION_MAP()
+
+static void show_usage(FILE *fp, const char *argv0)
+{
+	fprintf(fp, "USAGE: %s [OPTIONS]\n", argv0);
+	fprintf(fp, "Time the inference kernels on a synthetic model and synthetic instances.\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "OPTIONS:\n");
+	fprintf(fp, "    --type=MODEL_TYPE   Type of graphical model (`1d', `tree', or `semim'; default: 1d)\n");
+	fprintf(fp, "    -L, --labels=L      Number of labels (default: 10)\n");
+	fprintf(fp, "    -T, --items=T       Number of items in an instance (default: 100)\n");
+	fprintf(fp, "    -A, --attributes=A  Number of attributes of an item (default: 20)\n");
+	fprintf(fp, "    -V, --vocabulary=V  Number of distinct attributes in the model (default: 10000)\n");
+	fprintf(fp, "    -F, --features=F    Number of labels connected to an attribute (default: 4)\n");
+	fprintf(fp, "    --order=K           Maximum order of transitions (`semim' only; default: 1)\n");
+	fprintf(fp, "    --segment=S         Maximum length of label segments (`semim' only; default: 4)\n");
+	fprintf(fp, "    -n, --instances=N   Number of instances processed by a repetition (default: 8)\n");
+	fprintf(fp, "    -w, --warmup=W      Number of repetitions before timing (default: 10)\n");
+	fprintf(fp, "    -r, --repeat=R      Number of timed repetitions (default: 100)\n");
+	fprintf(fp, "    -s, --seed=SEED     Seed of the pseudo-random generator (default: 1)\n");
+	fprintf(fp, "    -j, --json          Output the results in JSON\n");
+	fprintf(fp, "    -h, --help          Show the usage of this command and exit\n");
+}
+
+
+
+/* Pseudo-random generator (xorshift32) that does not depend on the libc. */
+static unsigned int bench_rand_state = 1;
+
+static unsigned int bench_rand(void)
+{
+	unsigned int x = bench_rand_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return (bench_rand_state = x);
+}
+
+static int bench_rand_int(int n)
+{
+	return (int)(bench_rand() % (unsigned int)n);
+}
+
+static floatval_t bench_rand_weight(void)
+{
+	/* Uniform weights in [-1, 1). */
+	return (floatval_t)bench_rand() / 2147483648. - 1.;
+}
+
+/* Synthetic model: F state features per attribute, and transitions. */
+typedef struct {
+	int L;
+	int F;
+	int *labels;            /* [V][F] labels of the state features. */
+	floatval_t *weights;    /* [V][F] weights of the state features. */
+	crf1de_semimarkov_t *sm;
+} bench_model_t;
+
+/* Synthetic instance with its own context. */
+typedef struct {
+	int T;
+	int *aids;              /* [T][A] attributes of the items. */
+	int *path;              /* [T] labels used to build the semi-Markov model. */
+	int *viterbi;           /* [T] Viterbi labels. */
+	crfsuite_node_t *tree;  /* [T] nodes of a random tree, or NULL. */
+	crf1d_context_t *ctx;
+} bench_instance_t;
+
+typedef struct {
+	const bench_option_t *opt;
+	bench_model_t model;
+	bench_instance_t *insts;
+	floatval_t checksum;
+} bench_t;
+
+static int generate_tree(bench_instance_t *inst)
+{
+	int t;
+	const size_t T = (unsigned int)inst->T;
+
+	/* Attach every node to a random preceding node, so that the nodes
+	   are ordered topologically with the root at #0. */
+	inst->tree = (crfsuite_node_t*)calloc(T, sizeof(crfsuite_node_t));
+	if (inst->tree == NULL) {
+		return 1;
+	}
+	for (t = 0; t < inst->T; ++t) {
+		crfsuite_node_t *node = &inst->tree[t];
+		node->self_item_id = t;
+		node->prnt_item_id = node->prnt_node_id = (0 < t) ? bench_rand_int(t) : -1;
+		if (0 < t) {
+			crfsuite_node_t *parent = &inst->tree[node->prnt_node_id];
+			if (parent->cap_children <= parent->num_children) {
+				parent->cap_children = (parent->cap_children + 1) * 2;
+				parent->children = (int*)realloc(
+					parent->children, sizeof(int) * parent->cap_children);
+			}
+			parent->children[parent->num_children++] = t;
+		}
+	}
+	return 0;
+}
+
+static void generate_path(bench_instance_t *inst, const bench_option_t *opt)
+{
+	int t = 0, prev = -1;
+
+	/* Segments of random labels with random lengths in [1, S]. */
+	while (t < inst->T) {
+		int l = bench_rand_int(opt->num_labels);
+		int n = 1 + bench_rand_int(opt->segment);
+		if (1 < opt->num_labels && l == prev) {
+			l = (l + 1) % opt->num_labels;
+		}
+		for (; 0 < n && t < inst->T; --n) {
+			inst->path[t++] = l;
+		}
+		prev = l;
+	}
+}
+
+static int build_semimarkov(bench_t *bench)
+{
+	int i, t;
+	const bench_option_t *opt = bench->opt;
+	crf1de_semimarkov_t *sm = crf1de_create_semimarkov();
+
+	if (sm == NULL || sm->initialize(sm, opt->order, -1, opt->num_labels)) {
+		return 1;
+	}
+
+	/* Collect the label patterns of the instances as the encoder does. */
+	for (i = 0; i < opt->num_instances; ++i) {
+		const bench_instance_t *inst = &bench->insts[i];
+		int seg_len = 1;
+		sm->m_ring->reset(sm->m_ring);
+		for (t = 1; t < inst->T; ++t) {
+			if (inst->path[t - 1] != inst->path[t]) {
+				sm->update(sm, inst->path[t - 1], seg_len);
+				seg_len = 1;
+			}
+			else {
+				++seg_len;
+			}
+		}
+		sm->update(sm, inst->path[inst->T - 1], seg_len);
+	}
+	if (sm->finalize(sm)) {
+		return 1;
+	}
+	bench->model.sm = sm;
+	return 0;
+}
+
+/* Compute the state scores of an instance as crf1dt_state_score() does. */
+static void state_score(bench_t *bench, bench_instance_t *inst)
+{
+	int t, a, f;
+	const bench_model_t *model = &bench->model;
+	const int A = bench->opt->num_attributes;
+	const int F = model->F;
+	crf1d_context_t *ctx = inst->ctx;
+
+	memset(ctx->state, 0, sizeof(ctxval_t) * inst->T * ctx->num_labels);
+	for (t = 0; t < inst->T; ++t) {
+		ctxval_t *state = STATE_SCORE(ctx, t);
+		for (a = 0; a < A; ++a) {
+			const int aid = inst->aids[t * A + a];
+			const int *labels = &model->labels[aid * F];
+			const floatval_t *weights = &model->weights[aid * F];
+			for (f = 0; f < F; ++f) {
+				state[labels[f]] += weights[f];
+			}
+		}
+	}
+}
+
+
+
+/* Kernels timed for an instance. */
+typedef void (*kernel_func_t)(bench_t *bench, bench_instance_t *inst);
+
+typedef struct {
+	const char *name;
+	kernel_func_t func;
+} kernel_t;
+
+static void k_state(bench_t *bench, bench_instance_t *inst)
+{
+	state_score(bench, inst);
+}
+
+static void k_exp_state(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_exp_state(inst->ctx);
+}
+
+static void k_alpha(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_alpha_score(inst->ctx, NULL);
+}
+
+static void k_beta(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_beta_score(inst->ctx, NULL);
+}
+
+static void k_marginals(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_marginals(inst->ctx, NULL);
+}
+
+static void k_viterbi(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_viterbi(inst->ctx, inst->viterbi, NULL);
+}
+
+static void k_tree_alpha(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_tree_alpha_score(inst->ctx, inst->tree);
+}
+
+static void k_tree_beta(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_tree_beta_score(inst->ctx, inst->tree);
+}
+
+static void k_tree_marginals(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_tree_marginals(inst->ctx, inst->tree);
+}
+
+static void k_tree_viterbi(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_tree_viterbi(inst->ctx, inst->viterbi, inst->tree);
+}
+
+static void k_sm_alpha(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_sm_alpha_score(inst->ctx, bench->model.sm);
+}
+
+static void k_sm_beta(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_sm_beta_score(inst->ctx, bench->model.sm);
+}
+
+static void k_sm_marginals(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_sm_marginals(inst->ctx, bench->model.sm);
+}
+
+static void k_sm_viterbi(bench_t *bench, bench_instance_t *inst)
+{
+	crf1dc_sm_viterbi(inst->ctx, inst->viterbi, bench->model.sm);
+}
+
+/* The kernels in the order of the computation (each one depends on the
+   results of the preceding ones). */
+static const kernel_t kernels_crf1d[] = {
+	{"state", k_state},
+	{"exp_state", k_exp_state},
+	{"alpha", k_alpha},
+	{"beta", k_beta},
+	{"marginals", k_marginals},
+	{"viterbi", k_viterbi},
+	{NULL, NULL},
+};
+
+static const kernel_t kernels_tree[] = {
+	{"state", k_state},
+	{"exp_state", k_exp_state},
+	{"tree_alpha", k_tree_alpha},
+	{"tree_beta", k_tree_beta},
+	{"tree_marginals", k_tree_marginals},
+	{"tree_viterbi", k_tree_viterbi},
+	{NULL, NULL},
+};
+
+static const kernel_t kernels_sm[] = {
+	{"state", k_state},
+	{"exp_state", k_exp_state},
+	{"sm_alpha", k_sm_alpha},
+	{"sm_beta", k_sm_beta},
+	{"sm_marginals", k_sm_marginals},
+	{"sm_viterbi", k_sm_viterbi},
+	{NULL, NULL},
+};
+
+static const kernel_t *get_kernels(int ftype)
+{
+	switch (ftype) {
+	case FTYPE_CRF1TREE:
+		return kernels_tree;
+	case FTYPE_SEMIMCRF:
+		return kernels_sm;
+	default:
+		return kernels_crf1d;
+	}
+}
+
+
+
+static int bench_init(bench_t *bench, const bench_option_t *opt)
+{
+	int i, k, t;
+	const int L = opt->num_labels;
+	const int T = opt->num_items;
+	const int A = opt->num_attributes;
+	const int F = (opt->num_features < L) ? opt->num_features : L;
+	const kernel_t *kernel = NULL;
+	ctxval_t *trans = NULL;
+	int num_trans;
+
+	memset(bench, 0, sizeof(*bench));
+	bench->opt = opt;
+	bench_rand_state = opt->seed ? opt->seed : 1;
+
+	/* Generate the state features: F distinct labels for each attribute. */
+	bench->model.L = L;
+	bench->model.F = F;
+	bench->model.labels = (int*)malloc(sizeof(int) * opt->num_vocabulary * F);
+	bench->model.weights = (floatval_t*)malloc(sizeof(floatval_t) * opt->num_vocabulary * F);
+	if (bench->model.labels == NULL || bench->model.weights == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	for (i = 0; i < opt->num_vocabulary; ++i) {
+		const int offset = bench_rand_int(L);
+		for (k = 0; k < F; ++k) {
+			bench->model.labels[i * F + k] = (offset + k) % L;
+			bench->model.weights[i * F + k] = bench_rand_weight();
+		}
+	}
+
+	/* Generate the instances. */
+	bench->insts = (bench_instance_t*)calloc(opt->num_instances, sizeof(bench_instance_t));
+	if (bench->insts == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	for (i = 0; i < opt->num_instances; ++i) {
+		bench_instance_t *inst = &bench->insts[i];
+		inst->T = T;
+		inst->aids = (int*)malloc(sizeof(int) * T * A);
+		inst->path = (int*)malloc(sizeof(int) * T);
+		inst->viterbi = (int*)malloc(sizeof(int) * T);
+		if (inst->aids == NULL || inst->path == NULL || inst->viterbi == NULL) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		for (t = 0; t < T * A; ++t) {
+			inst->aids[t] = bench_rand_int(opt->num_vocabulary);
+		}
+		generate_path(inst, opt);
+		if (opt->ftype == FTYPE_CRF1TREE && generate_tree(inst) != 0) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+	}
+
+	/* Build the label patterns of the semi-Markov model. */
+	if (opt->ftype == FTYPE_SEMIMCRF && build_semimarkov(bench) != 0) {
+		fprintf(stderr, "ERROR: Failed to build the semi-Markov model.\n");
+		return CRFSUITEERR_INTERNAL_LOGIC;
+	}
+
+	/* Generate the transition weights shared by the instances. */
+	num_trans = (bench->model.sm ? (int)bench->model.sm->m_num_frw : L) * L;
+	trans = (ctxval_t*)malloc(sizeof(ctxval_t) * num_trans);
+	if (trans == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	for (k = 0; k < num_trans; ++k) {
+		trans[k] = (ctxval_t)bench_rand_weight();
+	}
+
+	/* Create the contexts and run all the kernels once. */
+	kernel = get_kernels(opt->ftype);
+	for (i = 0; i < opt->num_instances; ++i) {
+		bench_instance_t *inst = &bench->insts[i];
+		inst->ctx = crf1dc_new(
+			CTXF_VITERBI | CTXF_MARGINALS, opt->ftype, L, T, bench->model.sm);
+		if (inst->ctx == NULL ||
+			crf1dc_set_num_items(inst->ctx, bench->model.sm, T) != 0) {
+			free(trans);
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		memcpy(inst->ctx->trans, trans, sizeof(ctxval_t) * num_trans);
+		crf1dc_exp_transition(inst->ctx, bench->model.sm);
+		for (k = 0; kernel[k].name != NULL; ++k) {
+			kernel[k].func(bench, inst);
+		}
+
+		/* The checksum identifies the inputs (and the results). */
+		bench->checksum += crf1dc_lognorm(inst->ctx);
+		for (t = 0; t < T; ++t) {
+			bench->checksum += inst->viterbi[t];
+		}
+	}
+
+	free(trans);
+	return 0;
+}
+
+static void bench_finish(bench_t *bench)
+{
+	int i;
+	const bench_option_t *opt = bench->opt;
+
+	if (bench->insts != NULL) {
+		for (i = 0; i < opt->num_instances; ++i) {
+			bench_instance_t *inst = &bench->insts[i];
+			if (inst->tree != NULL) {
+				int t;
+				for (t = 0; t < inst->T; ++t) {
+					free(inst->tree[t].children);
+				}
+				free(inst->tree);
+			}
+			if (inst->ctx != NULL) {
+				crf1dc_delete(inst->ctx);
+			}
+			free(inst->viterbi);
+			free(inst->path);
+			free(inst->aids);
+		}
+		free(bench->insts);
+	}
+	if (bench->model.sm != NULL) {
+		bench->model.sm->clear(bench->model.sm);
+		free(bench->model.sm);
+	}
+	free(bench->model.weights);
+	free(bench->model.labels);
+}
+
+
+
+/* Statistics of the elapsed time of a kernel. */
+typedef struct {
+	double mean;
+	double stddev;
+	double min;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+} stats_t;
+
+static double bench_clock(void)
+{
+#ifdef    CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif/*CLOCK_MONOTONIC*/
+}
+
+static int compare_double(const void *x, const void *y)
+{
+	const double a = *(const double*)x;
+	const double b = *(const double*)y;
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static double percentile(const double *sorted, int n, double p)
+{
+	/* Nearest-rank method. */
+	int i = (int)ceil(p / 100. * n) - 1;
+	return sorted[i < 0 ? 0 : (n <= i ? n - 1 : i)];
+}
+
+/* Time a kernel; the samples are the nanoseconds per instance. */
+static void time_kernel(bench_t *bench, const kernel_t *kernel, double *samples, stats_t *stats)
+{
+	int i, r;
+	double sum = 0., sum2 = 0.;
+	const bench_option_t *opt = bench->opt;
+	const int N = opt->num_instances;
+	const int R = opt->repeat;
+
+	for (r = 0; r < opt->warmup; ++r) {
+		for (i = 0; i < N; ++i) {
+			kernel->func(bench, &bench->insts[i]);
+		}
+	}
+
+	for (r = 0; r < R; ++r) {
+		const double begin = bench_clock();
+		for (i = 0; i < N; ++i) {
+			kernel->func(bench, &bench->insts[i]);
+		}
+		samples[r] = (bench_clock() - begin) * 1e9 / N;
+		sum += samples[r];
+		sum2 += samples[r] * samples[r];
+	}
+
+	qsort(samples, R, sizeof(double), compare_double);
+	stats->mean = sum / R;
+	stats->stddev = sqrt(fmax(0., sum2 / R - stats->mean * stats->mean));
+	stats->min = samples[0];
+	stats->p50 = percentile(samples, R, 50.);
+	stats->p90 = percentile(samples, R, 90.);
+	stats->p99 = percentile(samples, R, 99.);
+	stats->max = samples[R - 1];
+}
+
+static const char *ftype_name(int ftype)
+{
+	switch (ftype) {
+	case FTYPE_CRF1TREE:
+		return "tree";
+	case FTYPE_SEMIMCRF:
+		return "semim";
+	default:
+		return "1d";
+	}
+}
+
+static void output_header(FILE *fp, const bench_t *bench)
+{
+	const bench_option_t *opt = bench->opt;
+
+	if (opt->json) {
+		fprintf(fp, "{\n");
+		fprintf(fp, "  \"config\": {\"type\": \"%s\", \"labels\": %d, \"items\": %d, "
+			"\"attributes\": %d, \"vocabulary\": %d, \"features\": %d, ",
+			ftype_name(opt->ftype), opt->num_labels, opt->num_items,
+			opt->num_attributes, opt->num_vocabulary, bench->model.F);
+		fprintf(fp, "\"order\": %d, \"segment\": %d, \"instances\": %d, "
+			"\"warmup\": %d, \"repeat\": %d, \"seed\": %u, \"float32\": %s, "
+			"\"checkpoint\": %d},\n",
+			opt->order, opt->segment, opt->num_instances, opt->warmup,
+			opt->repeat, opt->seed, sizeof(ctxval_t) == sizeof(float) ? "true" : "false",
+			bench->insts[0].ctx->checkpoint);
+		if (bench->model.sm != NULL) {
+			fprintf(fp, "  \"semimarkov\": {\"patterns\": %lu, \"forward\": %lu, \"backward\": %lu},\n",
+				(unsigned long)bench->model.sm->m_num_ptrns,
+				(unsigned long)bench->model.sm->m_num_frw,
+				(unsigned long)bench->model.sm->m_num_bkw);
+		}
+		fprintf(fp, "  \"checksum\": %.10g,\n", bench->checksum);
+		fprintf(fp, "  \"kernels\": [");
+	}
+	else {
+		fprintf(fp, "type: %s, L: %d, T: %d, A: %d, V: %d, F: %d",
+			ftype_name(opt->ftype), opt->num_labels, opt->num_items,
+			opt->num_attributes, opt->num_vocabulary, bench->model.F);
+		if (opt->ftype == FTYPE_SEMIMCRF) {
+			fprintf(fp, ", order: %d, segment: %d (%lu forward states)",
+				opt->order, opt->segment, (unsigned long)bench->model.sm->m_num_frw);
+		}
+		fprintf(fp, "\n");
+		fprintf(fp, "instances: %d, warmup: %d, repeat: %d, seed: %u, checksum: %.10g\n",
+			opt->num_instances, opt->warmup, opt->repeat, opt->seed, bench->checksum);
+		fprintf(fp, "%-16s %10s %10s %10s %10s %10s %10s %10s\n",
+			"kernel [us]", "mean", "stddev", "min", "p50", "p90", "p99", "max");
+	}
+}
+
+static void output_stats(FILE *fp, const bench_t *bench, const kernel_t *kernel, const stats_t *stats, int first)
+{
+	if (bench->opt->json) {
+		fprintf(fp, "%s\n    {\"name\": \"%s\", \"mean_ns\": %.1f, \"stddev_ns\": %.1f, "
+			"\"min_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, "
+			"\"max_ns\": %.1f}",
+			first ? "" : ",", kernel->name, stats->mean, stats->stddev,
+			stats->min, stats->p50, stats->p90, stats->p99, stats->max);
+	}
+	else {
+		fprintf(fp, "%-16s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+			kernel->name, stats->mean * 1e-3, stats->stddev * 1e-3,
+			stats->min * 1e-3, stats->p50 * 1e-3, stats->p90 * 1e-3,
+			stats->p99 * 1e-3, stats->max * 1e-3);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int k, ret = 0, arg_used = 0;
+	bench_t bench;
+	bench_option_t opt;
+	double *samples = NULL;
+	const kernel_t *kernel = NULL;
+	FILE *fp = stdout;
+
+	bench_option_init(&opt);
+	arg_used = option_parse(++argv, --argc, parse_bench_options, &opt);
+	if (arg_used < 0) {
+		return 1;
+	}
+	if (opt.help || arg_used < argc) {
+		show_usage(opt.help ? stdout : stderr, "bench_kernels");
+		return opt.help ? 0 : 1;
+	}
+
+	samples = (double*)malloc(sizeof(double) * opt.repeat);
+	if (samples == NULL) {
+		fprintf(stderr, "ERROR: Out of memory.\n");
+		return 1;
+	}
+	if ((ret = bench_init(&bench, &opt)) != 0) {
+		fprintf(stderr, "ERROR: Failed to generate the model and instances.\n");
+		goto force_exit;
+	}
+
+	output_header(fp, &bench);
+	kernel = get_kernels(opt.ftype);
+	for (k = 0; kernel[k].name != NULL; ++k) {
+		stats_t stats;
+		time_kernel(&bench, &kernel[k], samples, &stats);
+		output_stats(fp, &bench, &kernel[k], &stats, k == 0);
+		fflush(fp);
+	}
+	if (opt.json) {
+		fprintf(fp, "\n  ]\n}\n");
+	}
+
+force_exit:
+	bench_finish(&bench);
+	free(samples);
+	return ret ? 1 : 0;
+}
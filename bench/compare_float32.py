@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+
+"""
+Compare the tagging output of a double-precision build of crfsuite with
+that of a build configured with --enable-float32.
+
+Usage: compare_float32.py CRFSUITE_DOUBLE CRFSUITE_FLOAT32 MODEL TEST
+
+Both binaries tag TEST with MODEL (the model file format is the same for
+both builds); the script reports the label agreement, the item accuracy
+of each build, and the maximum absolute differences of the sequence
+probabilities and the marginal probabilities.
+"""
+
+import sys
+import subprocess
+
+def tag(crfsuite, model, test):
+    args = [crfsuite, 'tag', '-r', '-p', '-i', '-m', model, test]
+    out = subprocess.Popen(args, stdout=subprocess.PIPE).communicate()[0]
+    probs = []
+    items = []
+    for line in out.decode('utf-8').splitlines():
+        if line.startswith('@probability'):
+            probs.append(float(line.split('\t')[1]))
+        elif line and not line.startswith('@'):
+            ref, rest = line.split('\t', 1)
+            label, marginal = rest.rsplit(':', 1)
+            items.append((ref, label, float(marginal)))
+    return probs, items
+
+def accuracy(items):
+    m = sum(1 for ref, label, marginal in items if ref == label)
+    return m / float(len(items))
+
+if __name__ == '__main__':
+    if len(sys.argv) != 5:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+
+    crfsuite_d, crfsuite_f, model, test = sys.argv[1:]
+    probs_d, items_d = tag(crfsuite_d, model, test)
+    probs_f, items_f = tag(crfsuite_f, model, test)
+    if len(items_d) != len(items_f) or len(probs_d) != len(probs_f):
+        sys.stderr.write('The outputs of the two builds do not align\n')
+        sys.exit(1)
+
+    agree = 0
+    max_marginal = 0.
+    for d, f in zip(items_d, items_f):
+        if d[1] == f[1]:
+            agree += 1
+            max_marginal = max(max_marginal, abs(d[2] - f[2]))
+    max_prob = max([abs(d - f) for d, f in zip(probs_d, probs_f)] + [0.])
+
+    print('Items: %d' % len(items_d))
+    print('Label agreement: %f' % (agree / float(len(items_d))))
+    print('Item accuracy (double): %f' % accuracy(items_d))
+    print('Item accuracy (float32): %f' % accuracy(items_f))
+    print('Max difference of sequence probabilities: %g' % max_prob)
+    print('Max difference of marginal probabilities: %g' % max_marginal)
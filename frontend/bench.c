@@ -0,0 +1,906 @@
+/*
+ *        Bench command for CRFsuite frontend.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <os.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef    HAVE_PTHREAD_H
+#include <pthread.h>
+#endif/*HAVE_PTHREAD_H*/
+
+#ifdef    HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif/*HAVE_SYS_RESOURCE_H*/
+
+#include <crfsuite.h>
+#include "option.h"
+#include "iwa.h"
+
+#define    SAFE_RELEASE(obj)    if ((obj) != NULL) { (obj)->release(obj); (obj) = NULL; }
+
+void show_copyright(FILE *fp);
+
+typedef struct {
+	char *input;
+	char *model;
+	int ftype;
+	int concurrency;
+	int batch;
+	int repeat;
+	int warmup;
+	int cache;
+	int json;
+	int help;
+
+	FILE *fpi;
+	FILE *fpo;
+	FILE *fpe;
+} bench_option_t;
+
+static char* mystrdup(const char *src)
+{
+	char *dst = (char*)malloc(strlen(src) + 1);
+	if (dst != NULL) {
+		strcpy(dst, src);
+	}
+	return dst;
+}
+
+static void bench_option_init(bench_option_t* opt)
+{
+	memset(opt, 0, sizeof(*opt));
+	opt->fpi = stdin;
+	opt->fpo = stdout;
+	opt->fpe = stderr;
+	opt->model = mystrdup("");
+	opt->ftype = FTYPE_CRF1D;
+	opt->concurrency = 1;
+	opt->batch = 1;
+	opt->repeat = 1;
+}
+
+static void bench_option_finish(bench_option_t* opt)
+{
+	free(opt->input);
+	free(opt->model);
+}
+
+BEGIN_OPTION_MAP(parse_bench_options, bench_option_t)
+
+	ON_OPTION_WITH_ARG(SHORTOPT('m') || LONGOPT("model"))
+		free(opt->model);
+		opt->model = mystrdup(arg);
+
+	ON_OPTION_WITH_ARG(LONGOPT("type"))
+		if (strcmp(arg, "tree") == 0)
+			opt->ftype = FTYPE_CRF1TREE;
+		else if (strcmp(arg, "semim") == 0)
+			opt->ftype = FTYPE_SEMIMCRF;
+		else if (strcmp(arg, "1d") == 0)
+			opt->ftype = FTYPE_CRF1D;
+		else {
+			fprintf(stderr, "ERROR: Unknown model type: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(SHORTOPT('c') || LONGOPT("concurrency"))
+		opt->concurrency = atoi(arg);
+		if (opt->concurrency < 1) {
+			fprintf(stderr, "ERROR: Invalid number of concurrent taggers: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(SHORTOPT('b') || LONGOPT("batch"))
+		opt->batch = atoi(arg);
+		if (opt->batch < 1) {
+			fprintf(stderr, "ERROR: Invalid batch size: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(SHORTOPT('r') || LONGOPT("repeat"))
+		opt->repeat = atoi(arg);
+		if (opt->repeat < 1) {
+			fprintf(stderr, "ERROR: Invalid number of repetitions: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(SHORTOPT('w') || LONGOPT("warmup"))
+		opt->warmup = atoi(arg);
+		if (opt->warmup < 0) {
+			fprintf(stderr, "ERROR: Invalid number of warmup passes: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION_WITH_ARG(LONGOPT("cache"))
+		opt->cache = atoi(arg);
+		if (opt->cache < 0) {
+			fprintf(stderr, "ERROR: Invalid size of the attribute cache: %s\n", arg);
+			return -1;
+		}
+
+	ON_OPTION(SHORTOPT('j') || LONGOPT("json"))
+		opt->json = 1;
+
+	ON_OPTION(SHORTOPT('h') || LONGOPT("help"))
+		opt->help = 1;
+
+END_OPTION_MAP()
+
+static void show_usage(FILE *fp, const char *argv0, const char *command)
+{
+	fprintf(fp, "USAGE: %s %s [OPTIONS] [DATA]\n", argv0, command);
+	fprintf(fp, "Measure the throughput and latency of tagging the instances in the data set\n");
+	fprintf(fp, "given by a file (DATA). If the argument DATA is omitted or '-', this utility\n");
+	fprintf(fp, "reads a data from STDIN. The tagging results are not written.\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "OPTIONS:\n");
+	fprintf(fp, "    -m, --model=MODEL   Read a model from a file (MODEL)\n");
+	fprintf(fp, "    --type=MODEL_TYPE   Type of graphical model (can be either `tree' or `semim' or `1d',\n\
+                     the latter is used by default)\n");
+	fprintf(fp, "    -c, --concurrency=N Tag the data with N taggers in parallel (default: 1)\n");
+	fprintf(fp, "    -b, --batch=B       Number of instances in a request whose latency is measured\n\
+                    (default: 1)\n");
+	fprintf(fp, "    -r, --repeat=R      Number of timed passes over the data (default: 1)\n");
+	fprintf(fp, "    -w, --warmup=W      Number of passes over the data before timing (default: 0)\n");
+	fprintf(fp, "    --cache=N           Cache the identifiers of N recently used attributes\n");
+	fprintf(fp, "    -j, --json          Output the results in JSON\n");
+	fprintf(fp, "    -h, --help          Show the usage of this command and exit\n");
+}
+
+
+
+/* Stages of tagging an instance, timed separately. */
+enum {
+	STAGE_PARSE = 0,    /* Tokenize the instance and build the tree structure. */
+	STAGE_LOOKUP,       /* Look up the attribute identifiers. */
+	STAGE_SCORE,        /* Compute the state scores (tagger->set). */
+	STAGE_DECODE,       /* Find the Viterbi label sequence. */
+	NUM_STAGES,
+};
+
+static const char *stage_names[NUM_STAGES] = {
+	"parse", "lookup", "score", "decode",
+};
+
+/* An instance in the input data. */
+typedef struct {
+	const char *begin;
+	size_t size;
+} block_t;
+
+/* An item and the range of its attributes in the token array. */
+typedef struct {
+	int id;
+	int prnt;
+	int begin;
+	int end;
+} parsed_item_t;
+
+typedef struct {
+	const char *attr;
+	size_t length;
+	floatval_t value;
+} parsed_attr_t;
+
+typedef struct {
+	int index;
+	int ret;
+	const bench_option_t *opt;
+	const block_t *blocks;
+	int num_blocks;
+
+	crfsuite_model_t *model;
+	crfsuite_tagger_t *tagger;
+	crfsuite_dictionary_t *node_labels;
+	const void *sm;
+
+	parsed_item_t *items;
+	int num_items;
+	int cap_items;
+	parsed_attr_t *attrs;
+	int num_attrs;
+	int cap_attrs;
+	int *output;
+	int cap_output;
+
+	double *latencies;          /* Latencies of the requests [sec]. */
+	int num_latencies;
+	double stages[NUM_STAGES];  /* Total elapsed time of the stages [sec]. */
+	long num_tagged;
+	long num_tagged_items;
+} worker_t;
+
+static double bench_clock(void)
+{
+#ifdef    CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif/*CLOCK_MONOTONIC*/
+}
+
+/* Peak resident set size of the process in KiB (0 if unknown). */
+static long peak_rss(void)
+{
+#ifdef    HAVE_SYS_RESOURCE_H
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef    __APPLE__
+		return (long)(usage.ru_maxrss / 1024);
+#else
+		return (long)usage.ru_maxrss;
+#endif/*__APPLE__*/
+	}
+#endif/*HAVE_SYS_RESOURCE_H*/
+	return 0;
+}
+
+static const char *ftype_name(int ftype)
+{
+	switch (ftype) {
+	case FTYPE_CRF1TREE:
+		return "tree";
+	case FTYPE_SEMIMCRF:
+		return "semim";
+	default:
+		return "1d";
+	}
+}
+
+static size_t find_boundary(const char *buffer, size_t size, size_t offset)
+{
+	for (; offset < size; ++offset) {
+		if (2 <= offset && buffer[offset - 1] == '\n' && buffer[offset - 2] == '\n') {
+			break;
+		}
+	}
+	return (size < offset) ? size : offset;
+}
+
+/*
+	Split the input into the blocks of instances (separated by empty lines).
+ */
+static int split_blocks(const char *input, size_t size, block_t **ptr_blocks)
+{
+	int n = 0, cap = 0;
+	size_t offset = 0;
+	block_t *blocks = NULL;
+
+	for (;;) {
+		size_t end;
+		while (offset < size && (input[offset] == '\n' || input[offset] == '\r')) {
+			++offset;
+		}
+		if (size <= offset) {
+			break;
+		}
+		end = find_boundary(input, size, offset + 2);
+		if (cap <= n) {
+			block_t *p = NULL;
+			cap = (cap + 1) * 2;
+			p = (block_t*)realloc(blocks, sizeof(block_t) * cap);
+			if (p == NULL) {
+				free(blocks);
+				return -1;
+			}
+			blocks = p;
+		}
+		blocks[n].begin = input + offset;
+		blocks[n].size = end - offset;
+		++n;
+		offset = end;
+	}
+
+	*ptr_blocks = blocks;
+	return n;
+}
+
+/*
+	Tokenize an instance into the items and their attributes. For the tree
+	CRFs, the second and third fields of an item are the identifiers of the
+	node and its parent.
+ */
+static int parse_instance(worker_t *worker, const block_t *block)
+{
+	int ret = 0;
+	unsigned attr_cnt = 0;
+	parsed_item_t *item = NULL;
+	const iwa_token_t *token = NULL;
+	const int ftype = worker->opt->ftype;
+	iwa_t *iwa = iwa_reader_memory(block->begin, block->size);
+
+	if (iwa == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+
+	worker->num_items = 0;
+	worker->num_attrs = 0;
+	if (worker->node_labels != NULL) {
+		worker->node_labels->reset(worker->node_labels);
+	}
+
+	while (token = iwa_read(iwa), token != NULL) {
+		switch (token->type) {
+		case IWA_BOI:
+			if (worker->cap_items <= worker->num_items) {
+				parsed_item_t *p = NULL;
+				worker->cap_items = (worker->cap_items + 1) * 2;
+				p = (parsed_item_t*)realloc(worker->items, sizeof(parsed_item_t) * worker->cap_items);
+				if (p == NULL) {
+					ret = CRFSUITEERR_OUTOFMEMORY;
+					goto error_exit;
+				}
+				worker->items = p;
+			}
+			item = &worker->items[worker->num_items++];
+			item->id = item->prnt = -1;
+			item->begin = item->end = worker->num_attrs;
+			attr_cnt = 0;
+			break;
+		case IWA_EOI:
+			if (ftype == FTYPE_CRF1TREE && attr_cnt < 2) {
+				fprintf(stderr, "ERROR: Incorrect number of attributes for tree (%d instead of %d)\n",
+					attr_cnt, 2);
+				ret = CRFSUITEERR_INCOMPATIBLE;
+				goto error_exit;
+			}
+			item->end = worker->num_attrs;
+			break;
+		case IWA_ITEM:
+			/* The first field in a line presents a label (unused). */
+			if (++attr_cnt == 1) {
+				break;
+			}
+			if (ftype == FTYPE_CRF1TREE && attr_cnt == 2) {
+				item->id = worker->node_labels->get_n(
+					worker->node_labels, token->attr, token->attr_length);
+				break;
+			}
+			if (ftype == FTYPE_CRF1TREE && attr_cnt == 3) {
+				if (token->attr_length == 1 && token->attr[0] == '_')
+					item->prnt = -1;
+				else
+					item->prnt = worker->node_labels->get_n(
+						worker->node_labels, token->attr, token->attr_length);
+				break;
+			}
+			if (worker->cap_attrs <= worker->num_attrs) {
+				parsed_attr_t *p = NULL;
+				worker->cap_attrs = (worker->cap_attrs + 1) * 2;
+				p = (parsed_attr_t*)realloc(worker->attrs, sizeof(parsed_attr_t) * worker->cap_attrs);
+				if (p == NULL) {
+					ret = CRFSUITEERR_OUTOFMEMORY;
+					goto error_exit;
+				}
+				worker->attrs = p;
+			}
+			worker->attrs[worker->num_attrs].attr = token->attr;
+			worker->attrs[worker->num_attrs].length = token->attr_length;
+			worker->attrs[worker->num_attrs].value = iwa_value(token);
+			++worker->num_attrs;
+			break;
+		}
+	}
+
+error_exit:
+	iwa_delete(iwa);
+	return ret;
+}
+
+/*
+	Build an instance from the parsed items with the attribute identifiers.
+ */
+static int lookup_instance(worker_t *worker, crfsuite_instance_t *inst)
+{
+	int i, j;
+	crfsuite_item_t item;
+	crfsuite_attribute_t cont;
+	crfsuite_tagger_t *tagger = worker->tagger;
+
+	for (i = 0; i < worker->num_items; ++i) {
+		const parsed_item_t *parsed = &worker->items[i];
+		crfsuite_item_init(&item);
+		item.id = parsed->id;
+		item.prnt = parsed->prnt;
+		for (j = parsed->begin; j < parsed->end; ++j) {
+			const parsed_attr_t *attr = &worker->attrs[j];
+			int aid = tagger->to_aid(tagger, attr->attr, attr->length);
+			/* Ignore attributes 'unknown' to the model. */
+			if (0 <= aid) {
+				crfsuite_attribute_set(&cont, aid, attr->value);
+				crfsuite_item_append_attribute(&item, &cont);
+			}
+		}
+		crfsuite_instance_append(inst, &item, 0);
+		crfsuite_item_finish(&item);
+	}
+
+	if (worker->opt->ftype == FTYPE_CRF1TREE && crfsuite_tree_init(inst) != 0) {
+		fprintf(stderr, "ERROR: Could not create tree for tagging instance.\n");
+		return CRFSUITEERR_INCOMPATIBLE;
+	}
+	return 0;
+}
+
+/*
+	Tag an instance; the elapsed time of each stage is added to stages.
+ */
+static int tag_instance(worker_t *worker, const block_t *block, double *stages)
+{
+	int ret = 0;
+	floatval_t score = 0;
+	crfsuite_instance_t inst;
+	crfsuite_tagger_t *tagger = worker->tagger;
+	double t0, t1;
+
+	crfsuite_instance_init(&inst);
+
+	t0 = bench_clock();
+	if ((ret = parse_instance(worker, block))) {
+		goto error_exit;
+	}
+	t1 = bench_clock();
+	stages[STAGE_PARSE] += t1 - t0;
+
+	t0 = t1;
+	if ((ret = lookup_instance(worker, &inst))) {
+		goto error_exit;
+	}
+	t1 = bench_clock();
+	stages[STAGE_LOOKUP] += t1 - t0;
+
+	if (crfsuite_instance_empty(&inst)) {
+		goto error_exit;
+	}
+	if (worker->cap_output < inst.num_items) {
+		int *p = (int*)realloc(worker->output, sizeof(int) * inst.num_items);
+		if (p == NULL) {
+			ret = CRFSUITEERR_OUTOFMEMORY;
+			goto error_exit;
+		}
+		worker->output = p;
+		worker->cap_output = inst.num_items;
+	}
+
+	t0 = t1;
+	if ((ret = tagger->set(tagger, &inst))) {
+		goto error_exit;
+	}
+	t1 = bench_clock();
+	stages[STAGE_SCORE] += t1 - t0;
+
+	t0 = t1;
+	if ((ret = tagger->viterbi(tagger, worker->output, &score,
+		(worker->opt->ftype == FTYPE_CRF1TREE) ? (const void*)inst.tree : worker->sm))) {
+		goto error_exit;
+	}
+	t1 = bench_clock();
+	stages[STAGE_DECODE] += t1 - t0;
+
+	++worker->num_tagged;
+	worker->num_tagged_items += inst.num_items;
+
+error_exit:
+	crfsuite_instance_finish(&inst);
+	return ret;
+}
+
+/*
+	Replay the instances of the worker: the requests (batches) #index,
+	#index + C, #index + 2C, ... where C is the number of workers.
+ */
+static void* run_worker(void *arg)
+{
+	int i, k, r, s;
+	worker_t *worker = (worker_t*)arg;
+	const bench_option_t *opt = worker->opt;
+	const int B = opt->batch;
+	const int C = opt->concurrency;
+	const int num_batches = (worker->num_blocks + B - 1) / B;
+	double stages[NUM_STAGES];
+
+	for (r = 0; r < opt->warmup + opt->repeat; ++r) {
+		const int timed = (opt->warmup <= r);
+		for (k = worker->index; k < num_batches; k += C) {
+			const int end = (worker->num_blocks < (k + 1) * B) ? worker->num_blocks : (k + 1) * B;
+			memset(stages, 0, sizeof(stages));
+			for (i = k * B; i < end; ++i) {
+				if ((worker->ret = tag_instance(worker, &worker->blocks[i], stages))) {
+					return NULL;
+				}
+			}
+			if (timed) {
+				double latency = 0.;
+				for (s = 0; s < NUM_STAGES; ++s) {
+					worker->stages[s] += stages[s];
+					latency += stages[s];
+				}
+				worker->latencies[worker->num_latencies++] = latency;
+			}
+		}
+		if (!timed) {
+			worker->num_tagged = 0;
+			worker->num_tagged_items = 0;
+		}
+	}
+	return NULL;
+}
+
+static int compare_double(const void *x, const void *y)
+{
+	const double a = *(const double*)x;
+	const double b = *(const double*)y;
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static double percentile(const double *sorted, int n, double p)
+{
+	/* Nearest-rank method. */
+	int i = (int)(p / 100. * n + 0.999999) - 1;
+	return (n <= 0) ? 0. : sorted[i < 0 ? 0 : (n <= i ? n - 1 : i)];
+}
+
+static int read_input(FILE *fp, iwa_t **ptr_mapped, char **ptr_buffer, const char **ptr_input, size_t *ptr_size)
+{
+	size_t size = 0, cap = 0, n = 0;
+	char *buffer = NULL;
+	iwa_t *mapped = iwa_reader_mmap(fp);
+
+	/* Map the input into memory, or read it into a buffer. */
+	if (mapped != NULL) {
+		*ptr_mapped = mapped;
+		*ptr_input = iwa_data(mapped, ptr_size);
+		return 0;
+	}
+	for (;;) {
+		if (cap <= size) {
+			char *newbuf = NULL;
+			cap = (cap + 1) * 2 < (1 << 20) ? (1 << 20) : cap * 2;
+			newbuf = (char*)realloc(buffer, cap);
+			if (newbuf == NULL) {
+				free(buffer);
+				return CRFSUITEERR_OUTOFMEMORY;
+			}
+			buffer = newbuf;
+		}
+		n = fread(buffer + size, sizeof(char), cap - size, fp);
+		if (n == 0) {
+			break;
+		}
+		size += n;
+	}
+	*ptr_buffer = buffer;
+	*ptr_input = buffer;
+	*ptr_size = size;
+	return 0;
+}
+
+static void
+output_results(
+	const bench_option_t *opt,
+	crfsuite_model_t *model,
+	int num_blocks,
+	long num_tagged,
+	long num_tagged_items,
+	double load_time,
+	double elapsed,
+	const double *latencies,
+	int num_latencies,
+	const double *stages,
+	long rss_model,
+	long rss_peak
+)
+{
+	int s;
+	double sum = 0., total = 0.;
+	FILE *fpo = opt->fpo;
+	crfsuite_dictionary_t *labels = NULL, *attrs = NULL;
+
+	model->get_labels(model, &labels);
+	model->get_attrs(model, &attrs);
+	for (s = 0; s < num_latencies; ++s) {
+		sum += latencies[s];
+	}
+	for (s = 0; s < NUM_STAGES; ++s) {
+		total += stages[s];
+	}
+	if (elapsed <= 0.) {
+		elapsed = 1e-9;
+	}
+
+	if (opt->json) {
+		fprintf(fpo, "{\n");
+		fprintf(fpo, "  \"model\": {\"type\": \"%s\", \"labels\": %d, \"attributes\": %d, "
+			"\"load_sec\": %f},\n",
+			ftype_name(opt->ftype), labels->num(labels), attrs->num(attrs), load_time);
+		fprintf(fpo, "  \"config\": {\"instances\": %d, \"concurrency\": %d, \"batch\": %d, "
+			"\"repeat\": %d, \"warmup\": %d, \"cache\": %d},\n",
+			num_blocks, opt->concurrency, opt->batch, opt->repeat, opt->warmup, opt->cache);
+		fprintf(fpo, "  \"throughput\": {\"elapsed_sec\": %f, \"instances\": %ld, \"items\": %ld, "
+			"\"instances_per_sec\": %.1f, \"items_per_sec\": %.1f},\n",
+			elapsed, num_tagged, num_tagged_items,
+			num_tagged / elapsed, num_tagged_items / elapsed);
+		fprintf(fpo, "  \"latency_ms\": {\"requests\": %d, \"mean\": %.6f, \"p50\": %.6f, "
+			"\"p95\": %.6f, \"p99\": %.6f, \"p999\": %.6f, \"max\": %.6f},\n",
+			num_latencies, num_latencies ? sum / num_latencies * 1e3 : 0.,
+			percentile(latencies, num_latencies, 50.) * 1e3,
+			percentile(latencies, num_latencies, 95.) * 1e3,
+			percentile(latencies, num_latencies, 99.) * 1e3,
+			percentile(latencies, num_latencies, 99.9) * 1e3,
+			num_latencies ? latencies[num_latencies - 1] * 1e3 : 0.);
+		fprintf(fpo, "  \"stages\": {");
+		for (s = 0; s < NUM_STAGES; ++s) {
+			fprintf(fpo, "%s\"%s_sec\": %f", s ? ", " : "", stage_names[s], stages[s]);
+		}
+		fprintf(fpo, "},\n");
+		fprintf(fpo, "  \"rss_kb\": {\"model\": %ld, \"peak\": %ld}\n", rss_model, rss_peak);
+		fprintf(fpo, "}\n");
+	}
+	else {
+		fprintf(fpo, "Model: %s (type: %s, %d labels, %d attributes)\n",
+			opt->model, ftype_name(opt->ftype), labels->num(labels), attrs->num(attrs));
+		fprintf(fpo, "Model load time: %f [sec]\n", load_time);
+		fprintf(fpo, "Data: %d instances (concurrency: %d, batch: %d, repeat: %d, warmup: %d)\n",
+			num_blocks, opt->concurrency, opt->batch, opt->repeat, opt->warmup);
+		fprintf(fpo, "Elapsed time: %f [sec] (%.1f [instance/sec], %.1f [item/sec])\n",
+			elapsed, num_tagged / elapsed, num_tagged_items / elapsed);
+		fprintf(fpo, "Latency of %d requests [ms]: mean %.4f, p50 %.4f, p95 %.4f, p99 %.4f, p999 %.4f, max %.4f\n",
+			num_latencies, num_latencies ? sum / num_latencies * 1e3 : 0.,
+			percentile(latencies, num_latencies, 50.) * 1e3,
+			percentile(latencies, num_latencies, 95.) * 1e3,
+			percentile(latencies, num_latencies, 99.) * 1e3,
+			percentile(latencies, num_latencies, 99.9) * 1e3,
+			num_latencies ? latencies[num_latencies - 1] * 1e3 : 0.);
+		fprintf(fpo, "Breakdown [sec]:");
+		for (s = 0; s < NUM_STAGES; ++s) {
+			fprintf(fpo, " %s %f (%.1f%%)%s", stage_names[s], stages[s],
+				total > 0. ? 100. * stages[s] / total : 0., s + 1 < NUM_STAGES ? "," : "\n");
+		}
+		fprintf(fpo, "Peak RSS: %ld [KiB] (%ld [KiB] after loading the model)\n", rss_peak, rss_model);
+	}
+}
+
+static int bench(bench_option_t *opt)
+{
+	int i, s, ret = 0, num_blocks = 0, num_latencies = 0;
+	long num_tagged = 0, num_tagged_items = 0, rss_model = 0;
+	double load_time = 0., elapsed = 0., begin;
+	double stages[NUM_STAGES];
+	double *latencies = NULL;
+	size_t size = 0;
+	char *buffer = NULL;
+	const char *input = NULL;
+	iwa_t *mapped = NULL;
+	block_t *blocks = NULL;
+	worker_t *workers = NULL;
+	FILE *fp = NULL, *fpi = opt->fpi, *fpe = opt->fpe;
+	const int C = opt->concurrency;
+
+	/* Create a model (and a tagger) for each worker. */
+	workers = (worker_t*)calloc(C, sizeof(worker_t));
+	if (workers == NULL) {
+		ret = CRFSUITEERR_OUTOFMEMORY;
+		goto force_exit;
+	}
+	for (i = 0; i < C; ++i) {
+		worker_t *worker = &workers[i];
+		worker->index = i;
+		worker->opt = opt;
+
+		begin = bench_clock();
+		if ((ret = crfsuite_create_instance_from_file_ex(
+				opt->model, (void**)&worker->model, opt->ftype, CRFSUITE_TAGGER_VITERBI))) {
+			fprintf(fpe, "ERROR: Couldn't create model instance.\n");
+			goto force_exit;
+		}
+		if (i == 0) {
+			load_time = bench_clock() - begin;
+		}
+
+		if ((ret = worker->model->get_tagger(worker->model, &worker->tagger))) {
+			goto force_exit;
+		}
+		if (0 < opt->cache && (ret = worker->tagger->cache_attributes(worker->tagger, opt->cache))) {
+			fprintf(fpe, "ERROR: Failed to allocate memory for the attribute cache.\n");
+			goto force_exit;
+		}
+		if (opt->ftype == FTYPE_CRF1TREE) {
+			if (!crfsuite_create_instance("dictionary", (void**)&worker->node_labels)) {
+				fprintf(fpe, "ERROR: Failed to create a dictionary instance.\n");
+				ret = 1;
+				goto force_exit;
+			}
+		}
+		else if (opt->ftype == FTYPE_SEMIMCRF) {
+			worker->model->get_sm(worker->model, &worker->sm);
+		}
+	}
+	rss_model = peak_rss();
+
+	/* Read the input data into memory, and split it into instances. */
+	fp = (strcmp(opt->input, "-") == 0) ? fpi : fopen(opt->input, "r");
+	if (fp == NULL) {
+		fprintf(fpe, "ERROR: failed to open the stream for the input data,\n");
+		fprintf(fpe, "  %s\n", opt->input);
+		ret = 1;
+		goto force_exit;
+	}
+	if ((ret = read_input(fp, &mapped, &buffer, &input, &size)) ||
+		(num_blocks = split_blocks(input, size, &blocks)) < 0) {
+		fprintf(fpe, "ERROR: Could not allocate memory for the data.\n");
+		ret = CRFSUITEERR_OUTOFMEMORY;
+		goto force_exit;
+	}
+
+	/* Allocate the latencies of the requests of each worker. */
+	for (i = 0; i < C; ++i) {
+		const int num_batches = (num_blocks + opt->batch - 1) / opt->batch;
+		workers[i].blocks = blocks;
+		workers[i].num_blocks = num_blocks;
+		workers[i].latencies = (double*)calloc(
+			(size_t)(num_batches / C + 1) * opt->repeat, sizeof(double));
+		if (workers[i].latencies == NULL) {
+			ret = CRFSUITEERR_OUTOFMEMORY;
+			goto force_exit;
+		}
+	}
+
+	/* Replay the instances. */
+	begin = bench_clock();
+	{
+		int *started = (int*)calloc(C, sizeof(int));
+#ifdef    HAVE_PTHREAD_H
+		pthread_t *threads = (pthread_t*)calloc(C, sizeof(pthread_t));
+		if (started != NULL && threads != NULL) {
+			for (i = 1; i < C; ++i) {
+				started[i] = (pthread_create(&threads[i], NULL, run_worker, &workers[i]) == 0);
+			}
+		}
+#endif/*HAVE_PTHREAD_H*/
+		run_worker(&workers[0]);
+		for (i = 1; i < C; ++i) {
+#ifdef    HAVE_PTHREAD_H
+			if (started != NULL && started[i]) {
+				pthread_join(threads[i], NULL);
+			}
+			else
+#endif/*HAVE_PTHREAD_H*/
+			{
+				/* Run the worker in this thread if no thread was created. */
+				run_worker(&workers[i]);
+			}
+		}
+#ifdef    HAVE_PTHREAD_H
+		free(threads);
+#endif/*HAVE_PTHREAD_H*/
+		free(started);
+	}
+	elapsed = bench_clock() - begin;
+
+	/* Aggregate the statistics of the workers. */
+	memset(stages, 0, sizeof(stages));
+	for (i = 0; i < C; ++i) {
+		if (workers[i].ret) {
+			ret = workers[i].ret;
+			fprintf(fpe, "ERROR: Failed to tag the data.\n");
+			goto force_exit;
+		}
+		num_latencies += workers[i].num_latencies;
+	}
+	latencies = (double*)malloc(sizeof(double) * (num_latencies + 1));
+	if (latencies == NULL) {
+		ret = CRFSUITEERR_OUTOFMEMORY;
+		goto force_exit;
+	}
+	for (i = 0, num_latencies = 0; i < C; ++i) {
+		memcpy(latencies + num_latencies, workers[i].latencies,
+			sizeof(double) * workers[i].num_latencies);
+		num_latencies += workers[i].num_latencies;
+		for (s = 0; s < NUM_STAGES; ++s) {
+			stages[s] += workers[i].stages[s];
+		}
+		num_tagged += workers[i].num_tagged;
+		num_tagged_items += workers[i].num_tagged_items;
+	}
+	qsort(latencies, num_latencies, sizeof(double), compare_double);
+
+	output_results(opt, workers[0].model, num_blocks, num_tagged, num_tagged_items,
+		load_time, elapsed, latencies, num_latencies, stages, rss_model, peak_rss());
+
+force_exit:
+	if (workers != NULL) {
+		for (i = 0; i < C; ++i) {
+			free(workers[i].latencies);
+			free(workers[i].output);
+			free(workers[i].attrs);
+			free(workers[i].items);
+			SAFE_RELEASE(workers[i].node_labels);
+			SAFE_RELEASE(workers[i].model);
+		}
+		free(workers);
+	}
+	free(latencies);
+	free(blocks);
+	free(buffer);
+	iwa_delete(mapped);
+	if (fp != NULL && fp != fpi) {
+		fclose(fp);
+	}
+	return ret;
+}
+
+int main_bench(int argc, char *argv[], const char *argv0)
+{
+	int ret = 0, arg_used = 0;
+	bench_option_t opt;
+	const char *command = argv[0];
+	FILE *fpo = stdout;
+
+	/* Parse the command-line option. */
+	bench_option_init(&opt);
+	arg_used = option_parse(++argv, --argc, parse_bench_options, &opt);
+	if (arg_used < 0) {
+		ret = 1;
+		goto force_exit;
+	}
+
+	/* Show the help message for this command if specified. */
+	if (opt.help) {
+		show_copyright(fpo);
+		show_usage(fpo, argv0, command);
+		goto force_exit;
+	}
+
+	/* Set an input file. */
+	if (arg_used < argc) {
+		opt.input = mystrdup(argv[arg_used]);
+	}
+	else {
+		opt.input = mystrdup("-");    /* STDIN. */
+	}
+
+	ret = bench(&opt);
+
+force_exit:
+	bench_option_finish(&opt);
+	return ret;
+}
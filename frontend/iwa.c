@@ -30,10 +30,24 @@
 
  /* $Id$ */
 
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYS_STAT_H)
+#define    USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef    __SSE2__
+#include <emmintrin.h>
+#endif/*__SSE2__*/
+
 #include "iwa.h"
 
 typedef struct {
@@ -48,10 +62,15 @@ struct tag_iwa {
 	iwa_string_t value;
 
 	FILE *fp;
+	long fp_begin;
 
 	char *buffer;
 	char *offset;
 	char *end;
+
+	const char *data;       /* Memory block for a reader without a stream. */
+	void *map_addr;         /* Address of the mapped file, if any. */
+	size_t map_size;        /* Size of the mapped file. */
 };
 
 #define    DEFAULT_SIZE    4096
@@ -72,13 +91,14 @@ static void string_finish(iwa_string_t* str)
 
 static void string_clear(iwa_string_t* str)
 {
-	memset(str->value, 0, str->size);
+	/* Characters after the offset are always zero. */
+	memset(str->value, 0, str->offset);
 	str->offset = 0;
 }
 
 static void string_append(iwa_string_t* str, int c)
 {
-	if (str->size <= str->offset) {
+	if (str->size <= str->offset + 1) {
 		str->size *= 2;
 		str->value = (char*)realloc(str->value, str->size);
 		memset(&str->value[str->offset], 0, str->size - str->offset);
@@ -86,6 +106,65 @@ static void string_append(iwa_string_t* str, int c)
 	str->value[str->offset++] = c;
 }
 
+iwa_t* iwa_reader_memory(const char *data, size_t size)
+{
+	iwa_t* iwa = (iwa_t*)malloc(sizeof(iwa_t));
+
+	if (iwa == NULL)
+		goto error_exit;
+
+	/* The memory block is used as the buffer without a stream. */
+	memset(iwa, 0, sizeof(iwa_t));
+	iwa->fp = NULL;
+	iwa->data = data;
+	iwa->offset = (char*)data;
+	iwa->end = (char*)data + size;
+
+	string_init(&iwa->attr);
+	string_init(&iwa->value);
+
+	return iwa;
+
+error_exit:
+	iwa_delete(iwa);
+	return NULL;
+}
+
+iwa_t* iwa_reader_mmap(FILE *fp)
+{
+#ifdef    USE_MMAP
+	iwa_t* iwa = NULL;
+	void *addr = NULL;
+	struct stat st;
+	long begin = ftell(fp);
+
+	/* Map only regular files with some data after the current position. */
+	if (begin < 0 || fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) ||
+		st.st_size <= (off_t)begin) {
+		return NULL;
+	}
+
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if (addr == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef    MADV_SEQUENTIAL
+	madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif/*MADV_SEQUENTIAL*/
+
+	iwa = iwa_reader_memory((const char*)addr + begin, (size_t)st.st_size - begin);
+	if (iwa == NULL) {
+		munmap(addr, (size_t)st.st_size);
+		return NULL;
+	}
+	iwa->map_addr = addr;
+	iwa->map_size = (size_t)st.st_size;
+	return iwa;
+#else
+	return NULL;
+#endif/*USE_MMAP*/
+}
+
 iwa_t* iwa_reader(FILE *fp)
 {
 	iwa_t* iwa = (iwa_t*)malloc(sizeof(iwa_t));
@@ -95,6 +174,7 @@ iwa_t* iwa_reader(FILE *fp)
 
 	memset(iwa, 0, sizeof(iwa_t));
 	iwa->fp = fp;
+	iwa->fp_begin = ftell(fp);
 
 	iwa->buffer = (char*)malloc(sizeof(char) * BUFFER_SIZE);
 	iwa->offset = iwa->buffer + BUFFER_SIZE;
@@ -118,15 +198,58 @@ void iwa_delete(iwa_t* iwa)
 		string_finish(&iwa->value);
 		string_finish(&iwa->attr);
 		free(iwa->buffer);
+#ifdef    USE_MMAP
+		if (iwa->map_addr != NULL) {
+			munmap(iwa->map_addr, iwa->map_size);
+		}
+#endif/*USE_MMAP*/
 	}
 	free(iwa);
 }
 
+const char *iwa_data(iwa_t* iwa, size_t *size)
+{
+	if (iwa->fp != NULL) {
+		return NULL;
+	}
+	*size = (size_t)(iwa->end - iwa->data);
+	return iwa->data;
+}
+
+long iwa_tell(iwa_t* iwa)
+{
+	if (iwa->fp != NULL) {
+		return ftell(iwa->fp) - iwa->fp_begin;
+	}
+	return (long)(iwa->offset - iwa->data);
+}
+
+double iwa_value(const iwa_token_t* token)
+{
+	char buffer[64];
+	size_t n = token->value_length;
+
+	if (token->value == NULL || n == 0) {
+		return 1.0;
+	}
+
+	/* Values in a memory block are not terminated by a NULL character. */
+	if (sizeof(buffer) <= n) {
+		n = sizeof(buffer) - 1;
+	}
+	memcpy(buffer, token->value, n);
+	buffer[n] = 0;
+	return atof(buffer);
+}
+
 static int peek_char(iwa_t* iwa)
 {
 	/* Refill the buffer if necessary. */
 	if (iwa->end <= iwa->offset) {
-		size_t count = fread(iwa->buffer, sizeof(char), BUFFER_SIZE, iwa->fp);
+		size_t count;
+		if (iwa->fp == NULL)
+			return EOF;
+		count = fread(iwa->buffer, sizeof(char), BUFFER_SIZE, iwa->fp);
 		iwa->offset = iwa->buffer;
 		iwa->end = iwa->buffer + count;
 		if (count == 0)
@@ -161,7 +284,7 @@ static void read_field_unescaped(iwa_t* iwa, iwa_string_t* str)
 {
 	int c, d;
 	/* Read until a colon, space, tab, or break-line character. */
-	while (c = peek_char(iwa), c != ':' && c != '\t' && c != '\n' && c != EOF) {
+	while (c = peek_char(iwa), c != ':' && c != '\t' && c != '\r' && c != '\n' && c != EOF) {
 		get_char(iwa);
 		if (c == '\\') {
 			/* Possibly a escape sequence. */
@@ -180,11 +303,106 @@ static void read_field_unescaped(iwa_t* iwa, iwa_string_t* str)
 	/* The input stream points to the character just after the field is terminated. */
 }
 
+/*
+	Find the first colon, tab, carriage-return, break-line, or backslash
+	character in the memory block; 16 characters are tested at a time with
+	SSE2.
+ */
+static const char *scan_field(const char *p, const char *end)
+{
+#ifdef    __SSE2__
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i bs = _mm_set1_epi8('\\');
+
+	while (p + 16 <= end) {
+		const __m128i x = _mm_loadu_si128((const __m128i*)p);
+		const __m128i m = _mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(x, colon), _mm_cmpeq_epi8(x, tab)),
+				_mm_or_si128(_mm_cmpeq_epi8(x, lf), _mm_cmpeq_epi8(x, bs))
+				),
+			_mm_cmpeq_epi8(x, cr)
+			);
+		int mask = _mm_movemask_epi8(m);
+		if (mask != 0) {
+			while (!(mask & 1)) {
+				mask >>= 1;
+				++p;
+			}
+			return p;
+		}
+		p += 16;
+	}
+#endif/*__SSE2__*/
+
+	for (; p < end; ++p) {
+		if (*p == ':' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '\\') {
+			break;
+		}
+	}
+	return p;
+}
+
+/*
+	Read a field in the memory block. The field is returned as a slice of
+	the block unless it has escape sequences, which are resolved in str.
+ */
+static const char *read_field_memory(iwa_t* iwa, iwa_string_t* str, size_t *length)
+{
+	const char *begin = iwa->offset;
+	const char *p = scan_field(begin, iwa->end);
+
+	if (p == iwa->end || *p != '\\') {
+		/* No escape sequence in the field. */
+		iwa->offset = (char*)p;
+		*length = (size_t)(p - begin);
+		return begin;
+	}
+
+	/* Copy the field with the escape sequences resolved. */
+	string_clear(str);
+	for (;;) {
+		for (; begin < p; ++begin) {
+			string_append(str, *begin);
+		}
+		if (p == iwa->end || *p != '\\') {
+			break;
+		}
+		/* Possibly a escape sequence. */
+		++p;
+		if (p < iwa->end && (*p == ':' || *p == '\\')) {
+			string_append(str, *p++);
+		}
+		else {
+			string_append(str, '\\');
+		}
+		begin = p;
+		p = scan_field(p, iwa->end);
+	}
+	iwa->offset = (char*)p;
+	*length = str->offset;
+	return str->value;
+}
+
 static int read_item(iwa_t* iwa)
 {
 	int c;
+	iwa_token_t* token = &iwa->token;
 
-	read_field_unescaped(iwa, &iwa->attr);
+	if (iwa->fp == NULL) {
+		token->attr = read_field_memory(iwa, &iwa->attr, &token->attr_length);
+	}
+	else {
+		string_clear(&iwa->attr);
+		string_clear(&iwa->value);
+		read_field_unescaped(iwa, &iwa->attr);
+		token->attr = iwa->attr.value;
+		token->attr_length = iwa->attr.offset;
+		token->value = iwa->value.value;
+	}
 
 	/* Check the character just after the attribute field is terminated. */
 	c = peek_char(iwa);
@@ -192,7 +410,14 @@ static int read_item(iwa_t* iwa)
 		/* Discard the colon. */
 		get_char(iwa);
 
-		read_field_unescaped(iwa, &iwa->value);
+		if (iwa->fp == NULL) {
+			token->value = read_field_memory(iwa, &iwa->value, &token->value_length);
+		}
+		else {
+			read_field_unescaped(iwa, &iwa->value);
+			token->value = iwa->value.value;
+			token->value_length = iwa->value.offset;
+		}
 
 		c = peek_char(iwa);
 		if (c == ':')
@@ -208,8 +433,8 @@ const iwa_token_t* iwa_read(iwa_t* iwa)
 	/* Initialization. */
 	token->attr = NULL;
 	token->value = NULL;
-	string_clear(&iwa->attr);
-	string_clear(&iwa->value);
+	token->attr_length = 0;
+	token->value_length = 0;
 
 	/* Return NULL if the stream hits EOF. */
 	if (peek_char(iwa) == EOF) {
@@ -230,7 +455,14 @@ const iwa_token_t* iwa_read(iwa_t* iwa)
 	switch (token->type) {
 	case IWA_NONE:
 	case IWA_EOI:
-		if (peek_char(iwa) == '\n') {
+		/* Skip carriage-return characters of CR-LF line breaks. */
+		while (peek_char(iwa) == '\r') {
+			get_char(iwa);
+		}
+		if (peek_char(iwa) == EOF) {
+			token->type = IWA_EOF;
+		}
+		else if (peek_char(iwa) == '\n') {
 			/* An empty line. */
 			get_char(iwa);
 			token->type = IWA_NONE;
@@ -245,24 +477,24 @@ const iwa_token_t* iwa_read(iwa_t* iwa)
 		for (;;) {
 			int c = peek_char(iwa);
 
-			if (c == '\t') {
-				/* Skip white spaces. */
+			if (c == '\t' || c == '\r') {
+				/* Skip white spaces (and carriage-returns of CR-LF). */
 				get_char(iwa);
 			}
-			else if (c == '\n') {
+			else if (c == '\n' || c == EOF) {
 				get_char(iwa);
 				token->type = IWA_EOI;
 				break;
 			}
 			else {
 				if (read_item(iwa)) {
-					fprintf(stderr, "Unknown attribute format: '%s:%s:'\n", iwa->attr.value, iwa->value.value);
+					fprintf(stderr, "Unknown attribute format: '%.*s:%.*s:'\n",
+						(int)token->attr_length, token->attr,
+						(int)token->value_length, token->value);
 					iwa_delete(iwa);
 					exit(6);
 				}
 				token->type = IWA_ITEM;
-				token->attr = iwa->attr.value;
-				token->value = iwa->value.value;
 				break;
 			}
 		}
@@ -47,16 +47,28 @@ extern "C" {
 		IWA_ITEM,
 	};
 
+	/*
+		Attributes and values of a reader on a memory block (or a mapped
+		file) point into the block and are not terminated by a NULL
+		character; use the lengths.
+	 */
 	struct tag_iwa_token {
 		int type;
 		const char *attr;
 		const char *value;
+		size_t attr_length;
+		size_t value_length;
 	};
 	typedef struct tag_iwa_token iwa_token_t;
 
 	iwa_t* iwa_reader(FILE *fp);
+	iwa_t* iwa_reader_memory(const char *data, size_t size);
+	iwa_t* iwa_reader_mmap(FILE *fp);
 	const iwa_token_t* iwa_read(iwa_t* iwa);
 	void iwa_delete(iwa_t* iwa);
+	const char *iwa_data(iwa_t* iwa, size_t *size);
+	long iwa_tell(iwa_t* iwa);
+	double iwa_value(const iwa_token_t* token);
 
 #ifdef    __cplusplus
 }
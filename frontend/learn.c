@@ -55,6 +55,9 @@ typedef struct {
 	int cross_validation;
 	int holdout;
 	int logfile;
+	int num_threads;
+	int num_folds;
+	int max_memory;
 
 	int help;
 	int help_params;
@@ -85,6 +88,8 @@ static void learn_option_init(learn_option_t* opt)
 	memset(opt, 0, sizeof(*opt));
 	opt->num_params = 0;
 	opt->holdout = -1;
+	opt->num_threads = 1;
+	opt->num_folds = 1;
 	opt->type = mystrdup("1d");
 	opt->algorithm = mystrdup("lbfgs");
 	opt->model = mystrdup("");
@@ -166,6 +171,27 @@ opt->cross_validation = 1;
 ON_OPTION_WITH_ARG(SHORTOPT('e') || LONGOPT("holdout"))
 opt->holdout = atoi(arg) - 1;
 
+ON_OPTION_WITH_ARG(SHORTOPT('T') || LONGOPT("threads"))
+opt->num_threads = atoi(arg);
+if (opt->num_threads < 1) {
+	fprintf(stderr, "ERROR: Invalid number of threads: %s\n", arg);
+	return 1;
+}
+
+ON_OPTION_WITH_ARG(SHORTOPT('P') || LONGOPT("parallel"))
+opt->num_folds = atoi(arg);
+if (opt->num_folds < 1) {
+	fprintf(stderr, "ERROR: Invalid number of folds: %s\n", arg);
+	return 1;
+}
+
+ON_OPTION_WITH_ARG(SHORTOPT('M') || LONGOPT("max-memory"))
+opt->max_memory = atoi(arg);
+if (opt->max_memory < 0) {
+	fprintf(stderr, "ERROR: Invalid memory size: %s\n", arg);
+	return 1;
+}
+
 ON_OPTION_WITH_ARG(SHORTOPT('L') || LONGOPT("logbase"))
 free(opt->logbase);
 opt->logbase = mystrdup(arg);
@@ -217,9 +243,19 @@ static void show_usage(FILE *fp, const char *argv0, const char *command)
 	fprintf(fp, "                        for training\n");
 	fprintf(fp, "  -x, --cross-validate  repeat holdout evaluations for #i in {1, ..., N} groups\n");
 	fprintf(fp, "                        (N-fold cross validation)\n");
+	fprintf(fp, "  -P, --parallel=N      train N folds of the cross validation concurrently\n");
+	fprintf(fp, "                        (DEFAULT=1); the folds share the data set and the\n");
+	fprintf(fp, "                        feature counts; each fold shuffles its instances with\n");
+	fprintf(fp, "                        its own random sequence, so the results do not depend\n");
+	fprintf(fp, "                        on N\n");
+	fprintf(fp, "  -M, --max-memory=MB   start a fold only if the estimated memory of the\n");
+	fprintf(fp, "                        running folds stays within MB megabytes (DEFAULT=0,\n");
+	fprintf(fp, "                        no limit)\n");
 	fprintf(fp, "  -l, --log-to-file     write the training log to a file instead of to STDOUT;\n");
 	fprintf(fp, "                        The filename is determined automatically by the training\n");
 	fprintf(fp, "                        algorithm, parameters, and source files\n");
+	fprintf(fp, "  -T, --threads=N       parse each data set with N threads (DEFAULT=1); the\n");
+	fprintf(fp, "                        attribute and label IDs do not depend on N\n");
 	fprintf(fp, "  -L, --logbase=BASE    set the base name for a log file (used with -l option)\n");
 	fprintf(fp, "  -h, --help            show the usage of this command and exit\n");
 	fprintf(fp, "  -H, --help-params     show the help message of algorithm-specific parameters;\n");
@@ -296,14 +332,21 @@ int main_learn(int argc, char *argv[], const char *argv0)
 	}
 
 	/* Create dictionaries for attributes and labels.  Dictionary for node
-	   attributes will be created later if needed. */
-	ret = crfsuite_create_instance("dictionary", (void**)&data.attrs);
+	   attributes will be created later if needed. The hash-based
+	   dictionaries assign the same IDs as "dictionary" but intern the
+	   strings faster; the concurrent ones are shared by the threads
+	   parsing a data set. */
+	ret = crfsuite_create_instance(
+		1 < opt.num_threads ? "dictionary/concurrent" : "dictionary/hash",
+		(void**)&data.attrs);
 	if (!ret) {
 		fprintf(fpe, "ERROR: Failed to create a dictionary instance.\n");
 		ret = 1;
 		goto force_exit;
 	}
-	ret = crfsuite_create_instance("dictionary", (void**)&data.labels);
+	ret = crfsuite_create_instance(
+		1 < opt.num_threads ? "dictionary/concurrent" : "dictionary/hash",
+		(void**)&data.labels);
 	if (!ret) {
 		fprintf(fpe, "ERROR: Failed to create a dictionary instance.\n");
 		ret = 1;
@@ -409,7 +452,7 @@ int main_learn(int argc, char *argv[], const char *argv0)
 		}
 		fprintf(fpo, "[%d] %s\n", i - arg_used + 1, argv[i]);
 		clk_begin = clock();
-		n = read_data(fp, fpo, &data, i - arg_used, trainer);
+		n = read_data(fp, fpo, &data, i - arg_used, trainer, opt.num_threads);
 		if (n < 0) {
 			fprintf(fpo, "An error occurred while reading data.\n");
 			goto force_exit;
@@ -452,19 +495,21 @@ int main_learn(int argc, char *argv[], const char *argv0)
 
 	/* Start training. */
 	if (opt.cross_validation) {
-		for (i = 0; i < groups; ++i) {
-			fprintf(fpo, "===== Cross validation (%d/%d) =====\n", i + 1, groups);
-			if ((ret = trainer->train(trainer, &data, "", i))) {
-				goto force_exit;
-			}
-			fprintf(fpo, "\n");
+		/* The trainer reports the folds in order through the callback. */
+		fflush(fpo);
+		if ((ret = trainer->cross_validate(trainer, &data, groups,
+				opt.num_folds, (size_t)opt.max_memory << 20))) {
+			goto force_exit;
 		}
-
 	}
 	else {
 		// model is written to file on successful training
-		if ((ret = trainer->train(trainer, &data, opt.model, opt.holdout)))
+		if ((ret = trainer->train(trainer, &data, opt.model, opt.holdout))) {
+			/* The status codes do not fit into the exit status. */
+			fprintf(fpe, "ERROR: Failed to train a model (0x%X)\n", (unsigned int)ret);
+			ret = 1;
 			goto force_exit;
+		}
 	}
 
 	/* Log the end time. */
@@ -43,6 +43,7 @@
 int main_learn(int argc, char *argv[], const char *argv0);
 int main_tag(int argc, char *argv[], const char *argv0);
 int main_dump(int argc, char *argv[], const char *argv0);
+int main_bench(int argc, char *argv[], const char *argv0);
 
 typedef struct {
 	int help;            /**< Show help message and exit. */
@@ -88,6 +89,7 @@ static void show_usage(FILE *fp, const char *argv0)
 	fprintf(fp, "    learn       Obtain a model from a training set of instances\n");
 	fprintf(fp, "    tag         Assign suitable labels to given instances by using a model\n");
 	fprintf(fp, "    dump        Output a model in a plain-text format\n");
+	fprintf(fp, "    bench       Measure the throughput and latency of tagging by using a model\n");
 	fprintf(fp, "\n");
 	fprintf(fp, "For the usage of each command, specify -h option in the command argument.\n");
 }
@@ -138,6 +140,9 @@ int main(int argc, char *argv[])
 	else if (strcmp(command, "dump") == 0) {
 		return main_dump(argc - arg_used, argv + arg_used, argv0);
 	}
+	else if (strcmp(command, "bench") == 0) {
+		return main_bench(argc - arg_used, argv + arg_used, argv0);
+	}
 	else {
 		fprintf(fpe, "ERROR: Unrecognized command (%s) specified.\n", command);
 		return 1;
@@ -34,6 +34,6 @@
 #define    __READDATA_H__
 
 int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
-	crfsuite_trainer_t *trainer);
+	crfsuite_trainer_t *trainer, int num_threads);
 
 #endif/*__READDATA_H__*/
@@ -30,12 +30,20 @@
 
  /* $Id$ */
 
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
 #include <os.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef    HAVE_PTHREAD_H
+#include <pthread.h>
+#endif/*HAVE_PTHREAD_H*/
+
 #include <crfsuite.h>
 #include "iwa.h"
 
@@ -58,19 +66,19 @@ static int progress(FILE *fpo, int prev, int current)
 }
 
 /**
- * Function for reading training data.
+ * Read instances from a token stream into a data set.
  *
- * @param fpi - input file
- * @param fpo - output file
- * @param data - pointer to data instance
- * @param group - pointer to data instance
- * @param ftype - type of trained model (affects the way in which input data
- * are interpreted)
+ * @param iwa - token stream
+ * @param data - data set receiving the instances (with dictionaries)
+ * @param group - group number of the instances
+ * @param ftype - type of trained model
+ * @param filesize - size of the input for the progress report (0 for no report)
+ * @param fpo - output file for the progress report
  *
  * @return number of instances read
  */
-int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
-	crfsuite_trainer_t *trainer)
+static int read_instances(iwa_t* iwa, crfsuite_data_t* data, int group, int ftype, \
+	long filesize, FILE *fpo)
 {
 	crfsuite_dictionary_t *attrs = data->attrs;
 	crfsuite_dictionary_t *labels = data->labels;
@@ -78,37 +86,23 @@ int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
 
 	int n = 0;
 	int lid = -1;
-	int ftype = trainer->ftype;
 	unsigned attr_cnt = 0;
 	crfsuite_instance_t inst;
 	crfsuite_item_t item;
 	crfsuite_attribute_t cont;
-	iwa_t* iwa = NULL;
 	const iwa_token_t *token = NULL;
-	long filesize = 0, begin = 0, offset = 0;
 	int prev = 0, current = 0, ret = 0;
 
 	/* Initialize instance.*/
 	crfsuite_instance_init(&inst);
 	inst.group = group;
 
-	/* Obtain file size. */
-	begin = ftell(fpi);
-	fseek(fpi, 0, SEEK_END);
-	filesize = ftell(fpi) - begin;
-	fseek(fpi, begin, SEEK_SET);
-
-	/* */
-	fprintf(fpo, "0");
-	fflush(fpo);
-	prev = 0;
-
-	iwa = iwa_reader(fpi);
 	while ((token = iwa_read(iwa))) {
-		/* Progress report. */
-		offset = ftell(fpi);
-		current = (int)((offset - begin) * 100.0 / (double)filesize);
-		prev = progress(fpo, prev, current);
+		/* Progress report at the beginning of each item. */
+		if (0 < filesize && token->type == IWA_BOI) {
+			current = (int)(iwa_tell(iwa) * 100.0 / (double)filesize);
+			prev = progress(fpo, prev, current);
+		}
 
 		switch (token->type) {
 		case IWA_BOI:
@@ -136,40 +130,39 @@ int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
 		case IWA_ITEM:
 			++attr_cnt;
 			if (lid == -1) {
-				lid = labels->get(labels, token->attr);
+				lid = labels->get_n(labels, token->attr, token->attr_length);
 			}
 			else {
 				if (ftype == FTYPE_CRF1TREE) {
 					if (attr_cnt == 2) {
 						// check that same id is not used twice for different nodes within
 						// an instance
-						item.id = node_labels->get(node_labels, token->attr);
+						item.id = node_labels->get_n(node_labels, token->attr, token->attr_length);
 						// remember string label of this node
-						item.node_label = (char *)malloc(sizeof(char) * (strlen(token->attr) + 1));
+						item.node_label = (char *)malloc(sizeof(char) * (token->attr_length + 1));
 						if (item.node_label) {
 							// be sure to delete node_label at the end
-							strcpy(item.node_label, token->attr);
+							memcpy(item.node_label, token->attr, token->attr_length);
+							item.node_label[token->attr_length] = 0;
 						}
 						else {
-							fprintf(stderr, "ERROR: Could not allocate memory for storing node label '%s'.\n", token->attr);
+							fprintf(stderr, "ERROR: Could not allocate memory for storing node label '%.*s'.\n",
+								(int)token->attr_length, token->attr);
 							goto clear_exit;
 						}
 						break;
 					}
 					else if (attr_cnt == 3) {
-						if (strcmp(token->attr, "_") == 0)
+						if (token->attr_length == 1 && token->attr[0] == '_')
 							item.prnt = -1;
 						else
-							item.prnt = node_labels->get(node_labels, token->attr);
+							item.prnt = node_labels->get_n(node_labels, token->attr, token->attr_length);
 						break;
 					}
 				}
 				crfsuite_attribute_init(&cont);
-				cont.aid = attrs->get(attrs, token->attr);
-				if (token->value && *token->value)
-					cont.value = atof(token->value);
-				else
-					cont.value = 1.0;
+				cont.aid = attrs->get_n(attrs, token->attr, token->attr_length);
+				cont.value = iwa_value(token);
 				crfsuite_item_append_attribute(&item, &cont);
 			}
 			break;
@@ -197,8 +190,9 @@ int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
 			break;
 		}
 	}
-	progress(fpo, prev, 100);
-	fprintf(fpo, "\n");
+	if (0 < filesize) {
+		progress(fpo, prev, 100);
+	}
 
 clear_exit:
 	if (ftype == FTYPE_CRF1TREE)
@@ -206,3 +200,309 @@ clear_exit:
 
 	return n;
 }
+
+/**
+ * Chunk of the input parsed by a worker thread.
+ */
+typedef struct {
+	const char *begin;
+	size_t size;
+	int group;
+	int ftype;
+	crfsuite_data_t data;       /**< Instances read from the chunk. */
+	int n;                      /**< Return value of read_instances(). */
+} chunk_t;
+
+static void* read_chunk(void *arg)
+{
+	chunk_t *chunk = (chunk_t*)arg;
+	iwa_t *iwa = iwa_reader_memory(chunk->begin, chunk->size);
+	if (iwa == NULL) {
+		chunk->n = -1;
+		return NULL;
+	}
+	chunk->n = read_instances(iwa, &chunk->data, chunk->group, chunk->ftype, 0, NULL);
+	iwa_delete(iwa);
+	return NULL;
+}
+
+/*
+	Find the beginning of an instance at or after the offset, i.e., the
+	position just after an empty line. A line holding only carriage-return
+	characters (of CR-LF line breaks) is empty as in iwa_read().
+ */
+static size_t find_boundary(const char *buffer, size_t size, size_t offset)
+{
+	for (; offset < size; ++offset) {
+		if (2 <= offset && buffer[offset - 1] == '\n') {
+			size_t i = offset - 2;
+			while (0 < i && buffer[i] == '\r') {
+				--i;
+			}
+			if (buffer[i] == '\n') {
+				break;
+			}
+		}
+	}
+	return (size < offset) ? size : offset;
+}
+
+/*
+	Renumber the identifiers that a dictionary assigned while reading the
+	instances from #first in the order of their first occurrences, so that
+	the identifiers agree with those assigned by a single thread. The
+	identifiers below num_before were assigned by the previous data sets.
+ */
+static int renumber_dictionary(crfsuite_dictionary_t* dic, int num_before, \
+	crfsuite_data_t* data, int first, int is_label)
+{
+	int i, j, t, next = num_before, ret = 0;
+	const int num = dic->num(dic);
+	int *map = (int*)malloc(sizeof(int) * (num + 1));
+
+	if (map == NULL) {
+		return -1;
+	}
+	for (i = 0; i < num; ++i) {
+		map[i] = (i < num_before) ? i : -1;
+	}
+
+	/* Assign the identifiers in the order of first occurrences. */
+	for (i = first; i < data->num_instances; ++i) {
+		crfsuite_instance_t *inst = &data->instances[i];
+		for (t = 0; t < inst->num_items; ++t) {
+			if (is_label) {
+				if (map[inst->labels[t]] < 0) {
+					map[inst->labels[t]] = next++;
+				}
+			}
+			else {
+				crfsuite_item_t *item = &inst->items[t];
+				for (j = 0; j < item->num_contents; ++j) {
+					if (map[item->contents[j].aid] < 0) {
+						map[item->contents[j].aid] = next++;
+					}
+				}
+			}
+		}
+	}
+
+	/* Strings only in the instances dropped (without items). */
+	for (i = 0; i < num; ++i) {
+		if (map[i] < 0) {
+			map[i] = next++;
+		}
+	}
+
+	if ((ret = dic->renumber(dic, map)) == 0) {
+		for (i = first; i < data->num_instances; ++i) {
+			crfsuite_instance_t *inst = &data->instances[i];
+			for (t = 0; t < inst->num_items; ++t) {
+				if (is_label) {
+					inst->labels[t] = map[inst->labels[t]];
+				}
+				else {
+					crfsuite_item_t *item = &inst->items[t];
+					for (j = 0; j < item->num_contents; ++j) {
+						item->contents[j].aid = map[item->contents[j].aid];
+					}
+				}
+			}
+		}
+	}
+
+	free(map);
+	return ret;
+}
+
+/*
+	Read the whole input into memory, split it into chunks at instance
+	boundaries, parse the chunks in worker threads, and append the
+	instances to the data set in the original order.
+ */
+static int read_data_parallel(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
+	int ftype, int num_threads)
+{
+	int i, j, n = 0, prev = 0;
+	size_t size = 0, cap = 0, offset = 0;
+	char *buffer = NULL;
+	const char *input = NULL;
+	iwa_t *mapped = NULL;
+	chunk_t *chunks = NULL;
+	const int first = data->num_instances;
+	const int num_attrs = data->attrs->num(data->attrs);
+	const int num_labels = data->labels->num(data->labels);
+
+	/* Map the input into memory, or read it into a buffer. */
+	mapped = iwa_reader_mmap(fpi);
+	if (mapped != NULL) {
+		input = iwa_data(mapped, &size);
+	}
+	while (mapped == NULL) {
+		if (cap <= size) {
+			char *newbuf = NULL;
+			cap = (cap + 1) * 2 < (1 << 20) ? (1 << 20) : cap * 2;
+			newbuf = (char*)realloc(buffer, cap);
+			if (newbuf == NULL) {
+				free(buffer);
+				fprintf(stderr, "ERROR: Could not allocate memory for the data.\n");
+				return -1;
+			}
+			buffer = newbuf;
+		}
+		offset = fread(buffer + size, sizeof(char), cap - size, fpi);
+		if (offset == 0) {
+			break;
+		}
+		size += offset;
+	}
+	if (mapped == NULL) {
+		input = buffer;
+	}
+
+	fprintf(fpo, "0");
+	fflush(fpo);
+
+	/* Split the input into chunks of the similar sizes. */
+	chunks = (chunk_t*)calloc(num_threads, sizeof(chunk_t));
+	if (chunks == NULL) {
+		iwa_delete(mapped);
+		free(buffer);
+		return -1;
+	}
+	for (i = 0, offset = 0; i < num_threads; ++i) {
+		size_t end = find_boundary(input, size, size / num_threads * (i + 1));
+		if (i == num_threads - 1) {
+			end = size;
+		}
+		chunks[i].begin = input + offset;
+		chunks[i].size = end - offset;
+		chunks[i].group = group;
+		chunks[i].ftype = ftype;
+		crfsuite_data_init(&chunks[i].data);
+		chunks[i].data.attrs = data->attrs;
+		chunks[i].data.labels = data->labels;
+		offset = end;
+	}
+
+	/* Parse the chunks. */
+	{
+		int *started = (int*)calloc(num_threads, sizeof(int));
+#ifdef    HAVE_PTHREAD_H
+		pthread_t *threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+		if (started != NULL && threads != NULL) {
+			for (i = 1; i < num_threads; ++i) {
+				started[i] = (pthread_create(&threads[i], NULL, read_chunk, &chunks[i]) == 0);
+			}
+		}
+#endif/*HAVE_PTHREAD_H*/
+		read_chunk(&chunks[0]);
+		prev = progress(fpo, prev, 100 / num_threads);
+		for (i = 1; i < num_threads; ++i) {
+#ifdef    HAVE_PTHREAD_H
+			if (started != NULL && started[i]) {
+				pthread_join(threads[i], NULL);
+			}
+			else
+#endif/*HAVE_PTHREAD_H*/
+			{
+				/* Parse the chunk in this thread if no thread was created. */
+				read_chunk(&chunks[i]);
+			}
+			prev = progress(fpo, prev, 100 * (i + 1) / num_threads);
+		}
+#ifdef    HAVE_PTHREAD_H
+		free(threads);
+#endif/*HAVE_PTHREAD_H*/
+		free(started);
+	}
+
+	/* Move the instances to the data set in the original order. */
+	for (i = 0; i < num_threads; ++i) {
+		crfsuite_data_t *src = &chunks[i].data;
+		if (chunks[i].n < 0) {
+			n = -1;
+		}
+		if (0 <= n) {
+			for (j = 0; j < src->num_instances; ++j) {
+				if (data->cap_instances <= data->num_instances) {
+					data->cap_instances = (data->cap_instances + 1) * 2;
+					data->instances = (crfsuite_instance_t*)realloc(
+						data->instances, sizeof(crfsuite_instance_t) * data->cap_instances);
+				}
+				data->instances[data->num_instances++] = src->instances[j];
+			}
+			n += src->num_instances;
+			src->num_instances = 0;
+		}
+		src->attrs = NULL;
+		src->labels = NULL;
+		crfsuite_data_finish(src);
+	}
+	free(chunks);
+	iwa_delete(mapped);
+	free(buffer);
+
+	/* Assign the identifiers independently of the scheduling of threads. */
+	if (0 <= n) {
+		if (renumber_dictionary(data->attrs, num_attrs, data, first, 0) != 0 ||
+			renumber_dictionary(data->labels, num_labels, data, first, 1) != 0) {
+			fprintf(stderr, "ERROR: Could not renumber the attributes and labels.\n");
+			n = -1;
+		}
+	}
+
+	progress(fpo, prev, 100);
+	fprintf(fpo, "\n");
+	return n;
+}
+
+/**
+ * Function for reading training data.
+ *
+ * @param fpi - input file
+ * @param fpo - output file
+ * @param data - pointer to data instance
+ * @param group - pointer to data instance
+ * @param ftype - type of trained model (affects the way in which input data
+ * are interpreted)
+ * @param num_threads - number of threads parsing the input; the
+ * dictionaries of the data must be concurrent if it is more than one
+ *
+ * @return number of instances read
+ */
+int read_data(FILE *fpi, FILE *fpo, crfsuite_data_t* data, int group, \
+	crfsuite_trainer_t *trainer, int num_threads)
+{
+	int n = 0;
+	long filesize = 0;
+	iwa_t* iwa = NULL;
+
+	/* Tree CRFs number the nodes of each instance with a shared dictionary. */
+	if (1 < num_threads && trainer->ftype != FTYPE_CRF1TREE) {
+		return read_data_parallel(fpi, fpo, data, group, trainer->ftype, num_threads);
+	}
+
+	fprintf(fpo, "0");
+	fflush(fpo);
+
+	/* Map the file into memory if possible; fall back to stream reading. */
+	iwa = iwa_reader_mmap(fpi);
+	if (iwa != NULL) {
+		size_t size = 0;
+		iwa_data(iwa, &size);
+		filesize = (long)size;
+	} else {
+		long begin = ftell(fpi);
+		if (0 <= begin && fseek(fpi, 0, SEEK_END) == 0) {
+			filesize = ftell(fpi) - begin;
+			fseek(fpi, begin, SEEK_SET);
+		}
+		iwa = iwa_reader(fpi);
+	}
+	n = read_instances(iwa, data, group, trainer->ftype, filesize, fpo);
+	iwa_delete(iwa);
+
+	fprintf(fpo, "\n");
+	return n;
+}
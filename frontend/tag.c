@@ -33,6 +33,7 @@
 #include <os.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -56,6 +57,9 @@ typedef struct {
 	int probability;
 	int marginal;
     int marginal_all;
+	int nbest;
+	int cache;
+	int binary;
 	int quiet;
 	int reference;
 	int help;
@@ -128,6 +132,23 @@ opt->marginal = 1;
 ON_OPTION(SHORTOPT('l') || LONGOPT("marginal-all"))
 opt->marginal_all = 1;
 
+ON_OPTION_WITH_ARG(LONGOPT("nbest"))
+opt->nbest = atoi(arg);
+if (opt->nbest < 1) {
+	fprintf(stderr, "ERROR: Invalid number of label sequences: %s\n", arg);
+	return 1;
+}
+
+ON_OPTION_WITH_ARG(LONGOPT("cache"))
+opt->cache = atoi(arg);
+if (opt->cache < 0) {
+	fprintf(stderr, "ERROR: Invalid size of the attribute cache: %s\n", arg);
+	return 1;
+}
+
+ON_OPTION(LONGOPT("binary"))
+opt->binary = 1;
+
 ON_OPTION(SHORTOPT('q') || LONGOPT("quiet"))
 opt->quiet = 1;
 
@@ -159,63 +180,317 @@ static void show_usage(FILE *fp, const char *argv0, const char *command)
 	fprintf(fp, "    -i, --marginal      Output the marginal probabilities of items (only for\n\
                     `1d' and `tree')\n");
     fprintf(fp, "    -i, --marginal      Output the marginal probabilitiy of items for their predicted label\n");
+	fprintf(fp, "    --nbest=N           Output the N-best label sequences of each instance, each of\n\
+                    which is preceded by a line `@nbest RANK SCORE'\n");
+	fprintf(fp, "    --cache=N           Cache the identifiers of N recently used attributes (the\n\
+                    hit rate is reported with -t)\n");
+	fprintf(fp, "    --binary            Output the tagging results in the binary format (label ids and\n\
+                    float32 probabilities in the native byte order)\n");
 	fprintf(fp, "    -q, --quiet         Suppress tagging results (useful for test mode)\n");
 	fprintf(fp, "    -h, --help          Show the usage of this command and exit\n");
 }
 
 
 
+#define    OUTPUT_BUFFER_SIZE  65536
+
+/* Buffered writer for the tagging results. */
+typedef struct {
+	FILE *fp;
+	size_t pos;
+	char buffer[OUTPUT_BUFFER_SIZE];
+} output_t;
+
+/* Label strings of the model with their lengths. */
+typedef struct {
+	int num;
+	char **strs;
+	size_t *lens;
+} label_table_t;
+
+static void output_flush(output_t *out)
+{
+	if (0 < out->pos) {
+		fwrite(out->buffer, sizeof(char), out->pos, out->fp);
+		out->pos = 0;
+	}
+}
+
+static void output_bytes(output_t *out, const void *data, size_t size)
+{
+	if (OUTPUT_BUFFER_SIZE < out->pos + size) {
+		output_flush(out);
+		if (OUTPUT_BUFFER_SIZE < size) {
+			fwrite(data, sizeof(char), size, out->fp);
+			return;
+		}
+	}
+	memcpy(out->buffer + out->pos, data, size);
+	out->pos += size;
+}
+
+static void output_char(output_t *out, char c)
+{
+	if (OUTPUT_BUFFER_SIZE <= out->pos) {
+		output_flush(out);
+	}
+	out->buffer[out->pos++] = c;
+}
+
+static void output_int32(output_t *out, int value)
+{
+	int32_t v = (int32_t)value;
+	output_bytes(out, &v, sizeof(v));
+}
+
+static void output_float32(output_t *out, floatval_t value)
+{
+	float v = (float)value;
+	output_bytes(out, &v, sizeof(v));
+}
+
+/**
+ * Write a value in the same way as printf("%f").
+ *  Values whose absolute values are less than 10^6 are converted by the
+ *  integer arithmetic on the value multiplied by 10^6; the error of the
+ *  multiplication is far below 10^-3, so it cannot change the rounding
+ *  unless the seventh digit is close to a tie. The other values (and the
+ *  ties) are formatted by snprintf().
+ */
+static void output_float(output_t *out, floatval_t value)
+{
+	char buffer[32];
+	char *p = buffer + sizeof(buffer);
+	double x = fabs((double)value);
+	double y = x * 1000000.;
+	double f = y - floor(y);
+
+	if (x < 1000000. && 0.001 < fabs(f - 0.5)) {
+		uint64_t n = (uint64_t)floor(y + 0.5);
+		uint64_t i = n / 1000000;
+		int d;
+
+		/* Fractional part. */
+		n %= 1000000;
+		for (d = 0; d < 6; ++d) {
+			*--p = (char)('0' + n % 10);
+			n /= 10;
+		}
+		*--p = '.';
+
+		/* Integer part. */
+		do {
+			*--p = (char)('0' + i % 10);
+			i /= 10;
+		} while (i != 0);
+		if (signbit(value)) {
+			*--p = '-';
+		}
+		output_bytes(out, p, buffer + sizeof(buffer) - p);
+	} else {
+		char str[512];
+		int n = snprintf(str, sizeof(str), "%f", (double)value);
+		if (0 < n) {
+			output_bytes(out, str, (size_t)n < sizeof(str) ? (size_t)n : sizeof(str) - 1);
+		}
+	}
+}
+
+static int label_table_init(label_table_t *table, crfsuite_dictionary_t *labels)
+{
+	int l;
+
+	table->num = labels->num(labels);
+	table->strs = (char**)calloc(table->num, sizeof(char*));
+	table->lens = (size_t*)calloc(table->num, sizeof(size_t));
+	if (table->strs == NULL || table->lens == NULL) {
+		return 1;
+	}
+
+	for (l = 0; l < table->num; ++l) {
+		const char *label = NULL;
+		labels->to_string(labels, l, &label);
+		if (label != NULL) {
+			table->strs[l] = mystrdup(label);
+			table->lens[l] = strlen(label);
+			labels->free(labels, label);
+		}
+		if (table->strs[l] == NULL) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void label_table_finish(label_table_t *table)
+{
+	int l;
+
+	if (table->strs != NULL) {
+		for (l = 0; l < table->num; ++l) {
+			free(table->strs[l]);
+		}
+	}
+	free(table->strs);
+	free(table->lens);
+	memset(table, 0, sizeof(*table));
+}
+
+static void output_label(output_t *out, const label_table_t *table, int l)
+{
+	if (0 <= l && l < table->num) {
+		output_bytes(out, table->strs[l], table->lens[l]);
+	} else {
+		/* Labels unknown to the model (printf used to write a null string). */
+		output_bytes(out, "(null)", 6);
+	}
+}
+
 static void
 output_result(
-	FILE *fpo,
+	output_t *out,
 	crfsuite_tagger_t *tagger,
 	const crfsuite_instance_t *inst,
 	int *output,
-	crfsuite_dictionary_t *labels,
+	const label_table_t *table,
 	floatval_t score,
 	const tagger_option_t* opt,
 	const void *aux
 )
 {
-	int i;
+	int i, l;
+	floatval_t prob;
 
 	if (opt->probability) {
 		floatval_t lognorm = 0;
 		tagger->lognorm(tagger, &lognorm, aux);
-        fprintf(fpo, "@score\t%f\t%f\n", score, lognorm);
-		fprintf(fpo, "@probability\t%f\n", exp(score - lognorm));
+		output_bytes(out, "@score\t", 7);
+		output_float(out, score);
+		output_char(out, '\t');
+		output_float(out, lognorm);
+		output_bytes(out, "\n@probability\t", 14);
+		output_float(out, exp(score - lognorm));
+		output_char(out, '\n');
 	}
 
 	for (i = 0; i < inst->num_items; ++i) {
-		const char *label = NULL;
-		floatval_t prob;
 		if (opt->reference) {
-			labels->to_string(labels, inst->labels[i], &label);
-			fprintf(fpo, "%s\t", label);
-			labels->free(labels, label);
+			output_label(out, table, inst->labels[i]);
+			output_char(out, '\t');
 		}
 
-		labels->to_string(labels, output[i], &label);
-		fprintf(fpo, "%s", label);
-		labels->free(labels, label);
+		output_label(out, table, output[i]);
 
 		if (opt->marginal) {
 			tagger->marginal_point(tagger, output[i], i, &prob, aux);
-			fprintf(fpo, ":%f", prob);
+			output_char(out, ':');
+			output_float(out, prob);
 		}
 
-        if (opt->marginal_all) {
-            for (int l = 0; l < labels->num(labels); ++l) {
-                tagger->marginal_point(tagger, l, i, &prob, aux);
-                labels->to_string(labels, l, &label);
-                fprintf(fpo, "\t%s:%f", label, prob);
-                labels->free(labels, label);
-            }
-        }
+		if (opt->marginal_all) {
+			for (l = 0; l < table->num; ++l) {
+				tagger->marginal_point(tagger, l, i, &prob, aux);
+				output_char(out, '\t');
+				output_label(out, table, l);
+				output_char(out, ':');
+				output_float(out, prob);
+			}
+		}
 
-		fprintf(fpo, "\n");
+		output_char(out, '\n');
+	}
+	output_char(out, '\n');
+}
+
+/*
+ * The binary format of the tagging results. All integers are 32-bit
+ * signed integers and all real values are 32-bit floats, both in the
+ * native byte order.
+ *
+ *  The header:
+ *      "CRFB" (4 bytes), version (1), flags, number of labels L,
+ *      L label strings, each of which is its length followed by its bytes.
+ *  The flags:
+ *      0x01 (-p), 0x02 (-r), 0x04 (-i), 0x08 (-l).
+ *  Each instance:
+ *      number of items T,
+ *      the probability of the label sequence (if -p),
+ *      T reference label ids (if -r; the label L is unknown to the model),
+ *      T predicted label ids,
+ *      T marginal probabilities of the predicted labels (if -i),
+ *      T x L marginal probabilities of all labels (if -l).
+ */
+static void output_binary_header(
+	output_t *out,
+	const label_table_t *table,
+	const tagger_option_t* opt
+)
+{
+	int l, flags = 0;
+
+	if (opt->probability) flags |= 0x01;
+	if (opt->reference) flags |= 0x02;
+	if (opt->marginal) flags |= 0x04;
+	if (opt->marginal_all) flags |= 0x08;
+
+	output_bytes(out, "CRFB", 4);
+	output_int32(out, 1);
+	output_int32(out, flags);
+	output_int32(out, table->num);
+	for (l = 0; l < table->num; ++l) {
+		output_int32(out, (int)table->lens[l]);
+		output_bytes(out, table->strs[l], table->lens[l]);
+	}
+}
+
+static void
+output_result_binary(
+	output_t *out,
+	crfsuite_tagger_t *tagger,
+	const crfsuite_instance_t *inst,
+	int *output,
+	const label_table_t *table,
+	floatval_t score,
+	const tagger_option_t* opt,
+	const void *aux
+)
+{
+	int i, l;
+	floatval_t prob;
+
+	output_int32(out, inst->num_items);
+
+	if (opt->probability) {
+		floatval_t lognorm = 0;
+		tagger->lognorm(tagger, &lognorm, aux);
+		output_float32(out, exp(score - lognorm));
+	}
+
+	if (opt->reference) {
+		for (i = 0; i < inst->num_items; ++i) {
+			output_int32(out, inst->labels[i]);
+		}
+	}
+
+	for (i = 0; i < inst->num_items; ++i) {
+		output_int32(out, output[i]);
+	}
+
+	if (opt->marginal) {
+		for (i = 0; i < inst->num_items; ++i) {
+			tagger->marginal_point(tagger, output[i], i, &prob, aux);
+			output_float32(out, prob);
+		}
+	}
+
+	if (opt->marginal_all) {
+		for (i = 0; i < inst->num_items; ++i) {
+			for (l = 0; l < table->num; ++l) {
+				tagger->marginal_point(tagger, l, i, &prob, aux);
+				output_float32(out, prob);
+			}
+		}
 	}
-	fprintf(fpo, "\n");
 }
 
 static void output_instance(
@@ -254,12 +529,16 @@ static int message_callback(void *instance, const char *format, va_list args)
 
 static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 {
-	int N = 0, L = 0, ret = 0, lid = -1;
+	int N = 0, L = 0, ret = 0, lid = -1, k, num_paths = 0, cap_paths = 0;
+	int *paths = NULL;
+	floatval_t *scores = NULL;
 	clock_t clk0, clk1;
 	crfsuite_instance_t inst;
 	crfsuite_item_t item;
 	crfsuite_attribute_t cont;
 	crfsuite_evaluation_t eval;
+	output_t *out = NULL;
+	label_table_t table;
 	char *comment = NULL;
 	iwa_t* iwa = NULL;
 	const void *aux = NULL;
@@ -268,6 +547,8 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 	crfsuite_dictionary_t *attrs = NULL, *labels = NULL, *node_labels = NULL;
 	FILE *fp = NULL, *fpi = opt->fpi, *fpo = opt->fpo, *fpe = opt->fpe;
 
+	memset(&table, 0, sizeof(table));
+
 	/* Obtain the dictionary interface representing the labels in the model. */
 	if ((ret = model->get_labels(model, &labels))) {
 		goto force_exit;
@@ -283,6 +564,12 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 		goto force_exit;
 	}
 
+	/* Enable the attribute cache of the tagger. */
+	if (0 < opt->cache && (ret = tagger->cache_attributes(tagger, opt->cache))) {
+		fprintf(fpe, "ERROR: Failed to allocate memory for the attribute cache.\n");
+		goto force_exit;
+	}
+
 	/* Create a dictionary interface for mapping node labels to ids
 	   for CRFs with tree structures. */
 	if (ftype == FTYPE_CRF1TREE) {
@@ -301,6 +588,27 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 	crfsuite_instance_init(&inst);
 	crfsuite_evaluation_init(&eval, L);
 
+	/* Prepare the writer and the label strings for the output. */
+	out = (output_t*)malloc(sizeof(output_t));
+	if (out == NULL || label_table_init(&table, labels) != 0) {
+		fprintf(fpe, "ERROR: Failed to allocate memory for the output.\n");
+		ret = 1;
+		goto force_exit;
+	}
+	out->fp = fpo;
+	out->pos = 0;
+	if (0 < opt->nbest) {
+		scores = (floatval_t*)calloc(opt->nbest, sizeof(floatval_t));
+		if (scores == NULL) {
+			fprintf(fpe, "ERROR: Failed to allocate memory for the output.\n");
+			ret = 1;
+			goto force_exit;
+		}
+	}
+	if (opt->binary && !opt->quiet) {
+		output_binary_header(out, &table, opt);
+	}
+
 	/* Open the stream for the input data. */
 	fp = (strcmp(opt->input, "-") == 0) ? fpi : fopen(opt->input, "r");
 	if (fp == NULL) {
@@ -310,8 +618,11 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 		goto force_exit;
 	}
 
-	/* Open a IWA reader. */
-	iwa = iwa_reader(fp);
+	/* Open a IWA reader; map the input into memory if possible. */
+	iwa = iwa_reader_mmap(fp);
+	if (iwa == NULL) {
+		iwa = iwa_reader(fp);
+	}
 	if (iwa == NULL) {
 		fprintf(fpe, "ERROR: Failed to initialize the parser for the input data.\n");
 		ret = 1;
@@ -347,7 +658,7 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 			++attr_cnt;
 			if (lid == -1) {
 				/* The first field in a line presents a label. */
-				lid = labels->to_id(labels, token->attr);
+				lid = labels->to_id_n(labels, token->attr, token->attr_length);
 				if (lid < 0) lid = L;    /* #L stands for a unknown label. */
 			}
 			else {
@@ -355,7 +666,7 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 					if (attr_cnt == 2) {
 						// check that same id is not used twice for different
 						// nodes within an instance
-						item.id = node_labels->get(node_labels, token->attr);
+						item.id = node_labels->get_n(node_labels, token->attr, token->attr_length);
 						// remember string label of this node
 						/* item.node_label = (char *) malloc(sizeof(char) * (strlen(token->attr) + 1)); */
 						/* if (item.node_label) { */
@@ -368,24 +679,19 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 						break;
 					}
 					else if (attr_cnt == 3) {
-						if (strcmp(token->attr, "_") == 0)
+						if (token->attr_length == 1 && token->attr[0] == '_')
 							item.prnt = -1;
 						else
-							item.prnt = node_labels->get(node_labels, token->attr);
+							item.prnt = node_labels->get_n(node_labels, token->attr, token->attr_length);
 						break;
 					}
 				}
 				/* Fields after the first field present attributes. */
-				int aid = attrs->to_id(attrs, token->attr);
+				int aid = tagger->to_aid(tagger, token->attr, token->attr_length);
 				/* Ignore attributes 'unknown' to the model. */
 				if (0 <= aid) {
 					/* Associate the attribute with the current item. */
-					if (token->value && *token->value) {
-						crfsuite_attribute_set(&cont, aid, atof(token->value));
-					}
-					else {
-						crfsuite_attribute_set(&cont, aid, 1.0);
-					}
+					crfsuite_attribute_set(&cont, aid, iwa_value(token));
 					crfsuite_item_append_attribute(&item, &cont);
 				}
 			}
@@ -414,7 +720,26 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 				}
 
 				/* Obtain the viterbi label sequence. */
-				if ((ret = tagger->viterbi(tagger, output, &score, aux)))
+				if (0 < opt->nbest) {
+					/* Reuse the buffer of the N-best label sequences. */
+					if (cap_paths < opt->nbest * inst.num_items) {
+						int *p = (int*)realloc(paths, sizeof(int) * opt->nbest * inst.num_items);
+						if (p == NULL) {
+							fprintf(fpe, "ERROR: Failed to allocate memory for the output.\n");
+							ret = 1;
+							goto force_exit;
+						}
+						paths = p;
+						cap_paths = opt->nbest * inst.num_items;
+					}
+					if ((ret = tagger->nbest(tagger, opt->nbest, paths, scores, &num_paths, aux))) {
+						fprintf(fpe, "ERROR: Failed to find the N-best label sequences.\n");
+						goto force_exit;
+					}
+					memcpy(output, paths, sizeof(int) * inst.num_items);
+					score = scores[0];
+				}
+				else if ((ret = tagger->viterbi(tagger, output, &score, aux)))
 					goto force_exit;
 
 				++N;
@@ -424,8 +749,24 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 					crfsuite_evaluation_accumulate(&eval, inst.labels, output, inst.num_items);
 				}
 
-				if (!opt->quiet) {
-					output_result(fpo, tagger, &inst, output, labels, score, opt, aux);
+				if (opt->quiet) {
+					/* Nothing to output. */
+				}
+				else if (0 < opt->nbest) {
+					for (k = 0; k < num_paths; ++k) {
+						char rank[32];
+						int n = snprintf(rank, sizeof(rank), "@nbest\t%d\t", k + 1);
+						output_bytes(out, rank, (size_t)n);
+						output_float(out, scores[k]);
+						output_char(out, '\n');
+						output_result(out, tagger, &inst, &paths[inst.num_items * k], &table, scores[k], opt, aux);
+					}
+				}
+				else if (opt->binary) {
+					output_result_binary(out, tagger, &inst, output, &table, score, opt, aux);
+				}
+				else {
+					output_result(out, tagger, &inst, output, &table, score, opt, aux);
 				}
 
 				free(output);
@@ -440,6 +781,7 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 		}
 	}
 	clk1 = clock();
+	output_flush(out);
 
 	/* Compute the performance if specified. */
 	if (opt->evaluate) {
@@ -447,9 +789,26 @@ static int tag(tagger_option_t* opt, crfsuite_model_t* model, const int ftype)
 		crfsuite_evaluation_finalize(&eval);
 		crfsuite_evaluation_output(&eval, labels, message_callback, stdout);
 		fprintf(fpo, "Elapsed time: %f [sec] (%.1f [instance/sec])\n", sec, N / sec);
+		if (0 < opt->cache) {
+			crfsuite_cache_stats_t stats;
+			tagger->cache_stats(tagger, &stats);
+			fprintf(fpo, "Attribute cache: %lu hits of %lu lookups (%.4f) with %d entries\n",
+				(unsigned long)stats.hits, (unsigned long)stats.lookups,
+				stats.lookups ? (double)stats.hits / stats.lookups : 0., stats.size);
+		}
 	}
 
 force_exit:
+	/* Write the remaining output. */
+	if (out != NULL) {
+		output_flush(out);
+		free(out);
+		out = NULL;
+	}
+	label_table_finish(&table);
+	free(scores);
+	free(paths);
+
 	/* Close the IWA parser. */
 	iwa_delete(iwa);
 	iwa = NULL;
@@ -501,6 +860,12 @@ int main_tag(int argc, char *argv[], const char *argv0)
 			goto force_exit;
 	}
 
+	if (opt.nbest && opt.binary) {
+		fprintf(opt.fpe, "ERROR: The option `--nbest' cannot be used with `--binary'.\n");
+		ret = 4;
+		goto force_exit;
+	}
+
 	/* Show the help message for this command if specified. */
 	if (opt.help) {
 		show_copyright(fpo);
@@ -518,8 +883,12 @@ int main_tag(int argc, char *argv[], const char *argv0)
 
 	/* Read the model. */
 	if (opt.model != NULL) {
+		/* Marginal probabilities are unnecessary without -p, -i, and -l. */
+		const int flag = (opt.probability || opt.marginal || opt.marginal_all) ?
+			CRFSUITE_TAGGER_DEFAULT : CRFSUITE_TAGGER_VITERBI;
+
 		/* Create a model instance corresponding to the model file. */
-		if ((ret = crfsuite_create_instance_from_file(opt.model, (void**)&model, opt.ftype))) {
+		if ((ret = crfsuite_create_instance_from_file_ex(opt.model, (void**)&model, opt.ftype, flag))) {
 			fprintf(stderr, "ERROR: Couldn't create model instance.\n");
 			goto force_exit;
 		}
@@ -105,6 +105,17 @@ extern "C" {
 		FTYPE_SEMIMCRF,		/**< semi-Markov CRF (possibly of different orders) */
 	};
 
+	/**
+	 * Flags for the tagger of a model object.
+	 */
+	enum {
+		/** Viterbi decoding, scores, and marginal probabilities. */
+		CRFSUITE_TAGGER_DEFAULT = 0x00,
+		/** Viterbi decoding and scores only; marginal probabilities and the
+		    partition factor are unsupported, but the tagger uses less memory. */
+		CRFSUITE_TAGGER_VITERBI = 0x01,
+	};
+
 	/**
 	 * \addtogroup crfsuite_object Object interfaces and utilities.
 	 * @{
@@ -289,6 +300,18 @@ extern "C" {
 		floatval_t  macro_fmeasure;
 	} crfsuite_evaluation_t;
 
+	/**
+	 * Statistics of the attribute cache of a tagger.
+	 */
+	typedef struct {
+		/** Number of entries (0 if the cache is disabled). */
+		int         size;
+		/** Number of lookups through the cache. */
+		size_t      lookups;
+		/** Number of lookups answered by the cache. */
+		size_t      hits;
+	} crfsuite_cache_stats_t;
+
 	/**@}*/
 
 
@@ -445,6 +468,25 @@ extern "C" {
 		 */
 		int(*train)(crfsuite_trainer_t* trainer, const crfsuite_data_t *data, \
 			const char *filename, int holdout);
+
+		/**
+		 * Run a cross validation over the groups of a data set.
+		 *  The fold #i trains a model on the groups other than #i and
+		 *  evaluates it on the group #i. The folds share the data set and
+		 *  the features counted once for all groups, and up to num_workers
+		 *  folds are trained concurrently; the log of each fold is sent to
+		 *  the message callback in the order of the groups.
+		 *  @param  trainer     The pointer to this trainer instance.
+		 *  @param  data        The pointer to the data set.
+		 *  @param  num_groups  The number of groups.
+		 *  @param  num_workers The maximum number of folds trained concurrently.
+		 *  @param  max_memory  The budget in bytes for the estimated memory of
+		 *                      the concurrent folds (0 for no limit); a fold
+		 *                      starts regardless when no other fold is running.
+		 *  @return int         The status code.
+		 */
+		int(*cross_validate)(crfsuite_trainer_t* trainer, const crfsuite_data_t *data, \
+			int num_groups, int num_workers, size_t max_memory);
 	};
 
 	/**
@@ -558,6 +600,112 @@ extern "C" {
 		 */
 		int(*marginal_path)(crfsuite_tagger_t *tagger, const int *path, int begin, int end, \
 			floatval_t *ptr_prob, const void *aux);
+
+		/**
+		 * Start tagging a stream of items.
+		 *  The labels of the items pushed by push() are decided as soon as
+		 *  all the surviving Viterbi paths agree on them, or when more than
+		 *  the lookahead items are pending; the decided labels are obtained
+		 *  by pop(). Labels decided by the lookahead may differ from those
+		 *  of viterbi(). This function discards the current stream, if any.
+		 *  The stream is supported only by 1st-order linear-chain models.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  lookahead   The maximum number of items whose labels may
+		 *                      be pending (0 for the default, 64). The
+		 *                      labels must be popped at least every
+		 *                      lookahead items.
+		 *  @return int         The status code.
+		 */
+		int(*stream)(crfsuite_tagger_t* tagger, int lookahead);
+
+		/**
+		 * Push an item to the stream.
+		 *  This function starts a stream with the default lookahead if
+		 *  stream() has not been called.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  item        The item.
+		 *  @return int         The status code; CRFSUITEERR_OVERFLOW if
+		 *                      too many labels have not been popped.
+		 */
+		int(*push)(crfsuite_tagger_t* tagger, const crfsuite_item_t *item);
+
+		/**
+		 * Pop the decided labels of the items in the stream.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  labels      The label array that receives the labels.
+		 *  @param  size        The number of elements in the array.
+		 *  @param  end         Nonzero to end the current item sequence; the
+		 *                      pending items are tagged with the best path,
+		 *                      and the next item pushed starts a new
+		 *                      sequence.
+		 *  @param  ptr_num     The pointer to an integer that receives the
+		 *                      number of labels stored in the array.
+		 *  @return int         The status code.
+		 */
+		int(*pop)(crfsuite_tagger_t* tagger, int *labels, int size, int end, int *ptr_num);
+
+		/**
+		 * Find the N-best label sequences for the item sequence.
+		 *  The label sequences are found in the descending order of their
+		 *  scores. The search needs the lattice of all items, which is
+		 *  allocated even for an item sequence whose lattice would be
+		 *  checkpointed (see the parameter "context.checkpoint").
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  n           The maximum number of label sequences.
+		 *  @param  paths       The label array that receives the label
+		 *                      sequences; the array must have n * T
+		 *                      elements, and the sequence #k is stored at
+		 *                      paths[k * T], ..., paths[k * T + T - 1].
+		 *  @param  scores      The pointer to an array of n elements that
+		 *                      receives the scores of the label sequences
+		 *                      (without the normalization factor), or
+		 *                      \c NULL.
+		 *  @param  ptr_num     The pointer to an integer that receives the
+		 *                      number of the label sequences found, which
+		 *                      is less than n if the lattice has fewer paths.
+		 *  @param  aux         Auxiliary data (the tree of the instance for
+		 *                      tree-structured models, or the semi-Markov
+		 *                      data for semi-Markov models).
+		 *  @return int         The status code.
+		 */
+		int(*nbest)(crfsuite_tagger_t* tagger, int n, int *paths, floatval_t *scores, \
+			int *ptr_num, const void *aux);
+
+		/**
+		 * Enable the attribute cache of this tagger.
+		 *  The cache keeps the identifiers of the recently looked-up
+		 *  attribute names (including the names unknown to the model) so
+		 *  that frequent attributes skip the hash table of the model. The
+		 *  cache belongs to the tagger and shares its thread-safety: a
+		 *  tagger must not be used by multiple threads concurrently.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  size        The number of entries, which is rounded up to
+		 *                      a power of two; 0 disables the cache.
+		 *  @return int         The status code.
+		 */
+		int(*cache_attributes)(crfsuite_tagger_t* tagger, int size);
+
+		/**
+		 * Obtain the identifier of an attribute through the cache.
+		 *  This function is equivalent to crfsuite_dictionary_t::to_id_n()
+		 *  of the attribute dictionary of the model when the cache is
+		 *  disabled.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  str         The pointer to the first character of the name.
+		 *  @param  length      The number of characters of the name.
+		 *  @return int         The attribute identifier, or a negative
+		 *                      value if the model does not have the attribute.
+		 */
+		int(*to_aid)(crfsuite_tagger_t* tagger, const char *str, size_t length);
+
+		/**
+		 * Obtain the statistics of the attribute cache.
+		 *  @param  tagger      The pointer to this tagger instance.
+		 *  @param  stats       The pointer to the structure that receives
+		 *                      the statistics since the cache was enabled.
+		 *  @return int         The status code.
+		 */
+		int(*cache_stats)(crfsuite_tagger_t* tagger, crfsuite_cache_stats_t *stats);
 	};
 
 	/**
@@ -637,6 +785,44 @@ extern "C" {
 		 *                      freed.
 		 */
 		void(*free)(crfsuite_dictionary_t* dic, const char *str);
+
+		/**
+		 * Obtain the integer ID for the string of the given length.
+		 *  The string does not have to be terminated by a NULL character,
+		 *  so that a slice of a larger buffer can be looked up in place.
+		 *  @param  dic         The pointer to this dictionary instance.
+		 *  @param  str         The pointer to the first character.
+		 *  @param  length      The number of characters of the string.
+		 *  @return int         The ID associated with the string if any,
+		 *                      a negative value otherwise.
+		 */
+		int(*to_id_n)(crfsuite_dictionary_t* dic, const char *str, size_t length);
+
+		/**
+		 * Reassign the integer IDs of the strings.
+		 *  The string associated with the ID \c i is associated with the ID
+		 *  \c map[i] after this call. Use this function to make the IDs
+		 *  assigned by concurrent get() calls independent of the scheduling
+		 *  of the threads, e.g., in the order of the first occurrences of the
+		 *  strings in the input.
+		 *  @param  dic         The pointer to this dictionary instance.
+		 *  @param  map         The permutation of the IDs, an array of num()
+		 *                      elements.
+		 *  @return int         \c 0 if successful, an error code otherwise
+		 *                      (e.g., when \c map is not a permutation).
+		 */
+		int(*renumber)(crfsuite_dictionary_t* dic, const int *map);
+
+		/**
+		 * Assign and obtain the integer ID for the string of the given length.
+		 *  The string does not have to be terminated by a NULL character.
+		 *  @param  dic         The pointer to this dictionary instance.
+		 *  @param  str         The pointer to the first character.
+		 *  @param  length      The number of characters of the string.
+		 *  @return int         The ID associated with the string if any,
+		 *                      the new ID otherwise.
+		 */
+		int(*get_n)(crfsuite_dictionary_t* dic, const char *str, size_t length);
 	};
 
 	/**
@@ -822,6 +1008,21 @@ extern "C" {
 	 */
 	int crfsuite_create_instance_from_file(const char *filename, void **ptr, const int ftype);
 
+	/**
+	 * Create an instance of a model object from a model file with tagger flags.
+	 *  @param  filename    The filename of the model.
+	 *  @param  ptr         The pointer to \c void* that points to the
+	 *                      instance of the model object if successful,
+	 *                      *ptr points to \c NULL otherwise.
+	 *  @param  ftype       Type of expected graphical model (can be either
+	 *                      FTYPE_CRF1D or FTYPE_CRF1TREE)
+	 *  @param  flag        Flags for the tagger (CRFSUITE_TAGGER_*).
+	 *  @return int         \c 0 if this function creates an object successfully,
+	 *                      \c 1 otherwise.
+	 */
+	int crfsuite_create_instance_from_file_ex(const char *filename, void **ptr, const int ftype,
+		const int flag);
+
 	/**
 	  * Create an instance of a model object from a model in memory.
 	  *  @param  data        A pointer to the model data.
@@ -837,6 +1038,24 @@ extern "C" {
 	  */
 	int crfsuite_create_instance_from_memory(const void *data, size_t size, void **ptr, const int ftype);
 
+	/**
+	  * Create an instance of a model object from a model in memory with
+	  * tagger flags.
+	  *  @param  data        A pointer to the model data.
+	  *                      Must be 16-byte aligned.
+	  *  @param  size        A size (in bytes) of the model data.
+	  *  @param  ptr         The pointer to \c void* that points to the
+	  *                      instance of the model object if successful,
+	  *                      *ptr points to \c NULL otherwise.
+	  *  @param  ftype       Type of expected graphical model (can be either
+	  *                      FTYPE_CRF1D or FTYPE_CRF1TREE)
+	  *  @param  flag        Flags for the tagger (CRFSUITE_TAGGER_*).
+	  *  @return int         \c 0 if this function creates an object successfully,
+	  *                      \c 1 otherwise
+	  */
+	int crfsuite_create_instance_from_memory_ex(const void *data, size_t size, void **ptr,
+		const int ftype, const int flag);
+
 	/**
 	 * Create instances of tagging object from a model file.
 	 *  @param  filename    The filename of the model.
@@ -341,6 +341,7 @@ namespace CRFSuite
 		this->m_labels = NULL;
 		this->m_node_labels = NULL;
 		this->m_aux = NULL;
+		crfsuite_instance_init(&this->m_inst);
 	}
 
 	Tagger::~Tagger()
@@ -348,7 +349,7 @@ namespace CRFSuite
 		this->close();
 	}
 
-	bool Tagger::open(const std::string& name, const int ftype)
+	bool Tagger::open(const std::string& name, const int ftype, const int flag)
 	{
 		m_ftype = ftype;
 		int ret;
@@ -357,7 +358,7 @@ namespace CRFSuite
 		this->close();
 
 		// Open the model file.
-		if ((ret = crfsuite_create_instance_from_file(name.c_str(), (void**)&model, m_ftype))) {
+		if ((ret = crfsuite_create_instance_from_file_ex(name.c_str(), (void**)&model, m_ftype, flag))) {
 			return false;
 		}
 
@@ -388,7 +389,7 @@ namespace CRFSuite
 		return true;
 	}
 
-	bool Tagger::open(const void* data, std::size_t size, const int ftype)
+	bool Tagger::open(const void* data, std::size_t size, const int ftype, const int flag)
 	{
 		m_ftype = ftype;
 		int ret;
@@ -397,7 +398,7 @@ namespace CRFSuite
 		this->close();
 
 		// Open the model file.
-		if ((ret = crfsuite_create_instance_from_memory(data, size, (void**)&model, m_ftype))) {
+		if ((ret = crfsuite_create_instance_from_memory_ex(data, size, (void**)&model, m_ftype, flag))) {
 			return false;
 		}
 
@@ -450,6 +451,12 @@ namespace CRFSuite
 			m_attrs->release(m_attrs);
 			m_attrs = NULL;
 		}
+
+		// Free all the items allocated for set() with attribute identifiers.
+		m_inst.num_items = m_inst.cap_items;
+		crfsuite_instance_finish(&m_inst);
+		m_path.clear();
+		m_label_names.clear();
 	}
 
 	StringList Tagger::labels()
@@ -527,7 +534,8 @@ namespace CRFSuite
 			}
 
 			for (; i < item.size(); ++i) {
-				int aid = m_attrs->to_id(m_attrs, item[i].attr.c_str());
+				const std::string& attr = item[i].attr;
+				int aid = tagger->to_aid(tagger, attr.data(), attr.size());
 				if (0 <= aid) {
 					crfsuite_attribute_t cont;
 					crfsuite_attribute_set(&cont, aid, item[i].value);
@@ -591,6 +599,193 @@ namespace CRFSuite
 		return yseq;
 	}
 
+	void Tagger::set(const int *aids, const double *values, const int *offsets, int T)
+	{
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("Tagger is not opened.");
+		}
+		if (m_ftype == FTYPE_CRF1TREE) {
+			throw std::invalid_argument("Tree-structured models need items with node identifiers.");
+		}
+
+		// Extend the storage of the items; the items beyond num_items keep
+		// their attribute arrays for reuse.
+		if (m_inst.cap_items < T) {
+			crfsuite_item_t *items = (crfsuite_item_t*)realloc(
+				m_inst.items, sizeof(crfsuite_item_t) * T);
+			if (items == NULL) {
+				throw std::runtime_error("Failed to allocate memory for items.");
+			}
+			std::memset(items + m_inst.cap_items, 0, sizeof(crfsuite_item_t) * (T - m_inst.cap_items));
+			m_inst.items = items;
+			int *labels = (int*)realloc(m_inst.labels, sizeof(int) * T);
+			if (labels == NULL) {
+				m_inst.num_items = m_inst.cap_items = T;
+				crfsuite_instance_finish(&m_inst);
+				throw std::runtime_error("Failed to allocate memory for items.");
+			}
+			m_inst.labels = labels;
+			m_inst.cap_items = T;
+		}
+
+		// Fill the items with the attributes.
+		m_inst.num_items = T;
+		for (int t = 0; t < T; ++t) {
+			crfsuite_item_t* _item = &m_inst.items[t];
+			_item->num_contents = 0;
+			for (int i = offsets[t]; i < offsets[t + 1]; ++i) {
+				if (0 <= aids[i]) {
+					crfsuite_attribute_t cont;
+					crfsuite_attribute_set(&cont, aids[i], values != NULL ? values[i] : 1.);
+					crfsuite_item_append_attribute(_item, &cont);
+				}
+			}
+		}
+
+		// Set the instance to the tagger.
+		if (tagger->set(tagger, &m_inst)) {
+			throw std::runtime_error("Failed to set the instance to the tagger.");
+		}
+	}
+
+	int Tagger::length()
+	{
+		if (model == NULL || tagger == NULL)
+			throw std::invalid_argument("The tagger is not opened");
+		return tagger->length(tagger);
+	}
+
+	int Tagger::viterbi(int *labels, double *score)
+	{
+		if (model == NULL || tagger == NULL)
+			throw std::invalid_argument("The tagger is not opened");
+
+		const int T = tagger->length(tagger);
+		if (T <= 0)
+			return 0;
+
+		floatval_t value;
+		if (tagger->viterbi(tagger, labels, &value, m_aux)) {
+			throw std::runtime_error("Failed to find the Viterbi path.");
+		}
+		if (score != NULL)
+			*score = value;
+		return T;
+	}
+
+	int Tagger::viterbi(const char **labels, double *score)
+	{
+		if (model == NULL || tagger == NULL)
+			throw std::invalid_argument("The tagger is not opened");
+
+		const int T = tagger->length(tagger);
+		if (T <= 0)
+			return 0;
+
+		if (m_path.size() < (size_t)T)
+			m_path.resize(T);
+		viterbi(&m_path[0], score);
+		for (int t = 0; t < T; ++t)
+			labels[t] = label(m_path[t]);
+		return T;
+	}
+
+	const char *Tagger::label(int l)
+	{
+		if (model == NULL || m_labels == NULL)
+			throw std::invalid_argument("The tagger is not opened");
+
+		// Convert all the label identifiers to strings at the first call.
+		if (m_label_names.empty()) {
+			const int L = m_labels->num(m_labels);
+			m_label_names.resize(L);
+			for (int i = 0; i < L; ++i) {
+				const char *str = NULL;
+				if (m_labels->to_string(m_labels, i, &str) != 0) {
+					m_label_names.clear();
+					throw std::runtime_error("Failed to convert a label identifier to string.");
+				}
+				m_label_names[i] = str;
+				m_labels->free(m_labels, str);
+			}
+		}
+
+		if (l < 0 || (int)m_label_names.size() <= l)
+			return NULL;
+		return m_label_names[l].c_str();
+	}
+
+	void Tagger::tag(const int *aids, const double *values, const int *offsets,
+		const int *lengths, int N, int *labels, double *marginals)
+	{
+		if (marginals != NULL && m_ftype == FTYPE_SEMIMCRF) {
+			throw std::invalid_argument("Semi-Markov models do not support marginal probabilities.");
+		}
+
+		int i = 0;
+		for (int n = 0; n < N; ++n) {
+			const int T = lengths[n];
+			if (T <= 0)
+				continue;
+
+			// The offsets are relative to aids, so the items of the
+			// sequence #n start at offsets + i.
+			set(aids, values, offsets + i, T);
+			viterbi(labels + i, NULL);
+
+			if (marginals != NULL) {
+				for (int t = 0; t < T; ++t) {
+					floatval_t prob;
+					if (tagger->marginal_point(tagger, labels[i + t], t, &prob, m_aux)) {
+						throw std::runtime_error("Failed to compute the marginal probabilities.");
+					}
+					marginals[i + t] = prob;
+				}
+			}
+			i += T;
+		}
+	}
+
+	std::vector<StringList> Tagger::nbest(int n, std::vector<double> *scores)
+	{
+		if (model == NULL || tagger == NULL)
+			throw std::invalid_argument("The tagger is not opened");
+
+		int num = 0;
+		std::vector<StringList> yseqs;
+		if (scores != NULL)
+			scores->clear();
+
+		// Make sure that the current instance is not empty.
+		const int T = tagger->length(tagger);
+		if (T <= 0 || n <= 0)
+			return yseqs;
+
+		// Run the N-best Viterbi algorithm.
+		std::vector<int> paths((size_t)n * T);
+		std::vector<floatval_t> values(n);
+		if (tagger->nbest(tagger, n, &paths[0], &values[0], &num, m_aux)) {
+			throw std::runtime_error("Failed to find the N-best paths.");
+		}
+
+		// Convert the paths to label sequences.
+		yseqs.resize(num);
+		for (int k = 0; k < num; ++k) {
+			yseqs[k].resize(T);
+			for (int t = 0; t < T; ++t) {
+				const char *label = NULL;
+				if (m_labels->to_string(m_labels, paths[(size_t)k * T + t], &label) != 0) {
+					throw std::runtime_error("Failed to convert a label identifier to string.");
+				}
+				yseqs[k][t] = label;
+				m_labels->free(m_labels, label);
+			}
+			if (scores != NULL)
+				scores->push_back(values[k]);
+		}
+		return yseqs;
+	}
+
 	double Tagger::probability(StringList& yseq)
 	{
 		int ret;
@@ -712,6 +907,116 @@ namespace CRFSuite
 		throw std::runtime_error(msg.str());
 	}
 
+	void Tagger::stream(int lookahead)
+	{
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("The tagger is not opened");
+		}
+		if (tagger->stream(tagger, lookahead)) {
+			throw std::runtime_error("Failed to start a stream.");
+		}
+	}
+
+	void Tagger::push(const Item& item)
+	{
+		int ret;
+		crfsuite_item_t _item;
+
+		if (model == NULL || tagger == NULL || m_attrs == NULL) {
+			throw std::invalid_argument("Tagger is not opened.");
+		}
+
+		crfsuite_item_init(&_item);
+		for (size_t i = 0; i < item.size(); ++i) {
+			const std::string& attr = item[i].attr;
+			int aid = tagger->to_aid(tagger, attr.data(), attr.size());
+			if (0 <= aid) {
+				crfsuite_attribute_t cont;
+				crfsuite_attribute_set(&cont, aid, item[i].value);
+				crfsuite_item_append_attribute(&_item, &cont);
+			}
+		}
+
+		ret = tagger->push(tagger, &_item);
+		crfsuite_item_finish(&_item);
+		if (ret == (int)CRFSUITEERR_OVERFLOW) {
+			throw std::runtime_error("Too many labels are pending in the stream.");
+		}
+		else if (ret) {
+			throw std::runtime_error("Failed to push an item to the stream.");
+		}
+	}
+
+	StringList Tagger::pop(bool end)
+	{
+		int n = 0;
+		int labels[64];
+		StringList yseq;
+
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("The tagger is not opened");
+		}
+
+		do {
+			if (tagger->pop(tagger, labels, 64, end ? 1 : 0, &n)) {
+				throw std::runtime_error("Failed to pop labels from the stream.");
+			}
+			for (int i = 0; i < n; ++i) {
+				const char *label = NULL;
+				if (m_labels->to_string(m_labels, labels[i], &label) != 0) {
+					throw std::runtime_error("Failed to convert a label identifier to string.");
+				}
+				yseq.push_back(label);
+				m_labels->free(m_labels, label);
+			}
+		} while (n == 64);
+		return yseq;
+	}
+
+	int Tagger::attribute_id(const char *str, std::size_t length)
+	{
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("Tagger is not opened.");
+		}
+		return tagger->to_aid(tagger, str, length);
+	}
+
+	void Tagger::cache_attributes(int size)
+	{
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("Tagger is not opened.");
+		}
+		if (tagger->cache_attributes(tagger, size)) {
+			throw std::runtime_error("Failed to allocate memory for the attribute cache.");
+		}
+	}
+
+	crfsuite_cache_stats_t Tagger::cache_stats()
+	{
+		crfsuite_cache_stats_t stats;
+		if (model == NULL || tagger == NULL) {
+			throw std::invalid_argument("Tagger is not opened.");
+		}
+		tagger->cache_stats(tagger, &stats);
+		return stats;
+	}
+
+	int Tagger::attribute_id(const char *str)
+	{
+		return attribute_id(str, std::strlen(str));
+	}
+
+	int Tagger::attribute_id(const std::string& name)
+	{
+		return attribute_id(name.data(), name.size());
+	}
+
+#ifdef  CRFSUITE_HAVE_STRING_VIEW
+	int Tagger::attribute_id(std::string_view name)
+	{
+		return attribute_id(name.data(), name.size());
+	}
+#endif/*CRFSUITE_HAVE_STRING_VIEW*/
 
 	std::string version()
 	{
@@ -36,6 +36,11 @@
 #include <stdexcept>
 #include <vector>
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define CRFSUITE_HAVE_STRING_VIEW
+#include <string_view>
+#endif
+
 #ifndef __CRFSUITE_H__
 
 #ifdef  __cplusplus
@@ -313,6 +318,12 @@ namespace CRFSuite
 		const void *m_aux;
 		/// Type of CRF model
 		int m_ftype;
+		/// Item sequence reused by set() with attribute identifiers
+		crfsuite_instance_t m_inst;
+		/// Label identifiers reused by viterbi() with label strings
+		std::vector<int> m_path;
+		/// Label strings indexed by label identifiers
+		std::vector<std::string> m_label_names;
 
 	public:
 		/**
@@ -329,13 +340,17 @@ namespace CRFSuite
 		 * Open a model file.
 		 *  @param  name        The file name of the model file.
 		 *  @param  ftype       Type of the model to be loaded.
+		 *  @param  flag        Flags for the tagger. With
+		 *                      CRFSUITE_TAGGER_VITERBI, the tagger supports
+		 *                      only viterbi() and uses less memory.
 		 *
 		 *  @return bool        \c true if the model file is successfully opened,
 		 *                      \c false otherwise (e.g., when the mode file is
 		 *                      not found).
 		 *  @throw  std::runtime_error      An internal error in the model.
 		 */
-		bool open(const std::string& name, const int ftype = FTYPE_CRF1D);
+		bool open(const std::string& name, const int ftype = FTYPE_CRF1D,
+			const int flag = CRFSUITE_TAGGER_DEFAULT);
 
 		/**
 		* Open a model from memory.
@@ -343,12 +358,14 @@ namespace CRFSuite
 		*                      Must be 16-byte aligned.
 		*  @param  size        A size (in bytes) of the model data.
 		*  @param  ftype       Type of the model to be loaded.
+		*  @param  flag        Flags for the tagger (CRFSUITE_TAGGER_*).
 		*  @return bool        \c true if the model file is successfully opened,
 		*                      \c false otherwise (e.g., when the mode file is
 		*                      not found).
 		*  @throw  std::runtime_error      An internal error in the model.
 		*/
-		bool open(const void* data, std::size_t size, const int ftype = FTYPE_CRF1D);
+		bool open(const void* data, std::size_t size, const int ftype = FTYPE_CRF1D,
+			const int flag = CRFSUITE_TAGGER_DEFAULT);
 
 		/**
 		 * Close the model.
@@ -392,6 +409,114 @@ namespace CRFSuite
 		 */
 		StringList viterbi();
 
+		/**
+		 * Set an item sequence given by attribute identifiers.
+		 *  This function reuses the storage of the previous item sequence
+		 *  and allocates memory only when the sequence is longer (or has
+		 *  more attributes per item) than ever. The attributes of the item
+		 *  #t are aids[offsets[t]], ..., aids[offsets[t+1]-1]; negative
+		 *  identifiers (unknown attributes) are ignored. This function does
+		 *  not support tree-structured models.
+		 *  @param  aids        The attribute identifiers obtained by
+		 *                      attribute_id().
+		 *  @param  values      The attribute values parallel to aids, or
+		 *                      \c NULL for the values of 1.
+		 *  @param  offsets     The array of T+1 offsets of the items in aids.
+		 *  @param  T           The number of items.
+		 *  @throw  std::invalid_argument   A model is not opened, or the
+		 *                                  model is tree-structured.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		void set(const int *aids, const double *values, const int *offsets, int T);
+
+		/**
+		 * Obtain the number of items in the current item sequence.
+		 *  @return int         The number of items.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		int length();
+
+		/**
+		 * Find the Viterbi label sequence into a caller-owned buffer.
+		 *  @param  labels      The array of length() elements that receives
+		 *                      the label identifiers.
+		 *  @param  score       The pointer to a variable that receives the
+		 *                      score of the label sequence, or \c NULL.
+		 *  @return int         The number of items.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		int viterbi(int *labels, double *score = NULL);
+
+		/**
+		 * Find the Viterbi label sequence into a caller-owned buffer.
+		 *  @param  labels      The array of length() elements that receives
+		 *                      the label strings, which are owned by the
+		 *                      tagger and valid until the model is closed.
+		 *  @param  score       The pointer to a variable that receives the
+		 *                      score of the label sequence, or \c NULL.
+		 *  @return int         The number of items.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		int viterbi(const char **labels, double *score = NULL);
+
+		/**
+		 * Obtain the string of a label identifier.
+		 *  @param  l           The label identifier.
+		 *  @return const char* The label string owned by the tagger, which
+		 *                      is valid until the model is closed, or
+		 *                      \c NULL if the identifier is out of range.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		const char *label(int l);
+
+		/**
+		 * Tag a batch of item sequences given by attribute identifiers.
+		 *  The items of all the sequences are concatenated into a single
+		 *  array: the attributes of the item #i in the batch are
+		 *  aids[offsets[i]], ..., aids[offsets[i+1]-1], and the sequence #n
+		 *  consists of the lengths[n] items following those of the
+		 *  sequence #n-1. The storage of the tagger is reused for all the
+		 *  sequences. This function does not support tree-structured
+		 *  models.
+		 *  @param  aids        The attribute identifiers obtained by
+		 *                      attribute_id().
+		 *  @param  values      The attribute values parallel to aids, or
+		 *                      \c NULL for the values of 1.
+		 *  @param  offsets     The array of I+1 offsets of the items in aids,
+		 *                      where I is the total number of items.
+		 *  @param  lengths     The array of the numbers of items of the
+		 *                      sequences.
+		 *  @param  N           The number of sequences.
+		 *  @param  labels      The array of I elements that receives the
+		 *                      label identifiers.
+		 *  @param  marginals   The array of I elements that receives the
+		 *                      marginal probabilities of the labels, or
+		 *                      \c NULL.
+		 *  @throw  std::invalid_argument   A model is not opened, the model
+		 *                                  is tree-structured, or marginals
+		 *                                  are requested from a semi-Markov
+		 *                                  model.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		void tag(const int *aids, const double *values, const int *offsets,
+			const int *lengths, int N, int *labels, double *marginals = NULL);
+
+		/**
+		 * Find the N-best label sequences for the item sequence.
+		 *  @param  n           The maximum number of label sequences.
+		 *  @param  scores      The pointer to a vector that receives the
+		 *                      scores of the label sequences (without the
+		 *                      normalization factor), or \c NULL.
+		 *  @return std::vector<StringList> The label sequences in the
+		 *                      descending order of their scores.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		std::vector<StringList> nbest(int n, std::vector<double> *scores = NULL);
+
 		/**
 		 * Compute the probability of the label sequence.
 		 *  @param  yseq        The label sequence.
@@ -408,6 +533,97 @@ namespace CRFSuite
 		 *  @throw  std::runtime_error      An internal error.
 		 */
 		double marginal(const std::string& y, const int t);
+
+		/**
+		 * Start tagging a stream of items.
+		 *  Items are given one by one by push(), and the labels are
+		 *  obtained by pop() as soon as they are decided. The stream is
+		 *  supported only by 1st-order linear-chain models.
+		 *  @param  lookahead   The maximum number of items whose labels may
+		 *                      be pending (0 for the default).
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      The model does not support streams.
+		 */
+		void stream(int lookahead = 0);
+
+		/**
+		 * Push an item to the stream.
+		 *  @param  item        The item.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      Too many labels have not been
+		 *                                  popped.
+		 */
+		void push(const Item& item);
+
+		/**
+		 * Pop the labels decided for the items in the stream.
+		 *  @param  end         \c true to end the item sequence; the labels
+		 *                      of all the pending items are decided.
+		 *  @return StringList  The labels decided since the previous call.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      An internal error.
+		 */
+		StringList pop(bool end = false);
+
+		/**
+		 * Obtain the identifier of an attribute in the model.
+		 *  The attribute name does not have to be terminated by a NULL
+		 *  character; a slice of a larger buffer is looked up in place.
+		 *  @param  str         The pointer to the first character of the name.
+		 *  @param  length      The number of characters of the name.
+		 *  @return int         The attribute identifier if the model has the
+		 *                      attribute, a negative value otherwise.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		int attribute_id(const char *str, std::size_t length);
+
+		/**
+		 * Obtain the identifier of an attribute in the model.
+		 *  @param  str         The attribute name.
+		 *  @return int         The attribute identifier if any, a negative
+		 *                      value otherwise.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		int attribute_id(const char *str);
+
+		/**
+		 * Obtain the identifier of an attribute in the model.
+		 *  @param  name        The attribute name.
+		 *  @return int         The attribute identifier if any, a negative
+		 *                      value otherwise.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		int attribute_id(const std::string& name);
+
+#ifdef  CRFSUITE_HAVE_STRING_VIEW
+		/**
+		 * Obtain the identifier of an attribute in the model.
+		 *  @param  name        The view of the attribute name.
+		 *  @return int         The attribute identifier if any, a negative
+		 *                      value otherwise.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		int attribute_id(std::string_view name);
+#endif/*CRFSUITE_HAVE_STRING_VIEW*/
+
+		/**
+		 * Enable the cache of attribute identifiers.
+		 *  The identifiers looked up by attribute_id(), set(), and push()
+		 *  are cached by the tagger so that frequent attributes skip the
+		 *  hash table of the model.
+		 *  @param  size        The number of entries (0 to disable).
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 *  @throw  std::runtime_error      Out of memory.
+		 */
+		void cache_attributes(int size);
+
+		/**
+		 * Obtain the statistics of the cache of attribute identifiers.
+		 *  @return crfsuite_cache_stats_t  The size, the number of lookups,
+		 *                                  and the number of hits.
+		 *  @throw  std::invalid_argument   A model is not opened.
+		 */
+		crfsuite_cache_stats_t cache_stats();
 	};
 
 	/**
@@ -46,6 +46,8 @@
 #define alloca      _alloca
 #define strdup      _strdup
 #define open        _open
+#define fseeko      _fseeki64
+#define ftello      _ftelli64
 
 #if    _MSC_VER < 1900
 /* Pre Microsoft Visual C 2015 */
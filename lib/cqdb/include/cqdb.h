@@ -55,6 +55,8 @@
 enum {
 	CQDB_NONE = 0,                        /**< No flag. */
 	CQDB_ONEWAY = 0x00000001,            /**< A reverse lookup array is omitted. */
+	CQDB_FASTHASH = 0x00000002,          /**< Write the second (word-wise hash) format. */
+	CQDB_OFFSET64 = 0x00000004,          /**< Write 64-bit offsets for chunks larger than 4GB. */
 	CQDB_ERROR_OCCURRED = 0x00010000,    /**< An error has occurred. */
 };
 
@@ -70,6 +72,7 @@ enum {
 	CQDB_ERROR_FILETELL,                /**< Error in ftell() operations. */
 	CQDB_ERROR_FILESEEK,                /**< Error in fseek() operations. */
 	CQDB_ERROR_INVALIDID,                /**< Invalid parameters. */
+	CQDB_ERROR_OVERFLOW,                /**< Offsets exceed 32 bits without ::CQDB_OFFSET64. */
 };
 
 /** @} */
@@ -91,6 +94,13 @@ enum {
  *    lookups. The data for reverse lookup is omitted with ::CQDB_ONEWAY flag
  *    specified.
  *
+ *    By default, the writer emits the first format of the database, which
+ *    every version of the reader can load. Specify ::CQDB_FASTHASH flag to
+ *    write the second format, which hashes keys with a word-wise hash
+ *    function and rounds every hash table up to a power of two; readers
+ *    that predate the second format cannot load it. cqdb_reader() reads
+ *    both.
+ *
  *    It is recommended to keep the maximum number of identifiers as smallest as
  *    possible because reverse lookup is maintained by a array with the size of
  *    sizeof(int) * (maximum number of identifiers + 1). For example, putting a
@@ -110,8 +120,11 @@ typedef struct tag_cqdb_writer cqdb_writer_t;    /**< Typedef of a CQDB writer.
  *    The stream must have the writable and binary flags. The database creation
  *    flag must be zero except when the reverse lookup array is unnecessary;
  *    specifying ::CQDB_ONEWAY flag will save the storage space for the reverse
- *    lookup array. Once calling this function, one should avoid accessing the
- *    seekable stream directly until calling cqdb_writer_close().
+ *    lookup array. ::CQDB_FASTHASH flag writes the second format of the
+ *    database. A chunk larger than 4GB requires the ::CQDB_OFFSET64 flag,
+ *    which stores the offsets in 64 bits. Once calling this function, one
+ *    should avoid accessing the seekable stream directly until calling
+ *    cqdb_writer_close().
  *
  *    @param    fp                The pointer to the writable and seekable stream.
  *    @param    flag            Database creation flag.
@@ -208,6 +221,23 @@ void cqdb_delete(cqdb_t* db);
  */
 int cqdb_to_id(cqdb_t* db, const char *str);
 
+/**
+ * Retrieve the identifier associated with a string of the given length.
+ *
+ *    This function is identical to cqdb_to_id() except that the string
+ *    does not have to be terminated by a NULL character; one can look up
+ *    a slice of a larger buffer. A database of the first format hashes a
+ *    key with its NULL character; the slice is thus copied into a temporary
+ *    buffer with the character (allocated for 256 bytes or more).
+ *
+ *    @param    db            The pointer to the ::cqdb_t instance.
+ *    @param    str            The pointer to the first character of a string.
+ *    @param    length        The number of characters in the string.
+ *    @retval    int            The non-negative identifier if successful, negative
+ *                        status code otherwise.
+ */
+int cqdb_to_id_n(cqdb_t* db, const char *str, size_t length);
+
 /**
  * Retrieve the string associated with an identifier.
  *
@@ -31,6 +31,10 @@
 
  /* $Id$ */
 
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -38,18 +42,48 @@
 
 #include <cqdb.h>
 
+#ifdef  _MSC_VER
+#define fseeko      _fseeki64
+#define ftello      _ftelli64
+#endif/*_MSC_VER*/
+
 #define CHUNKID             "CQDB"
 #define BYTEORDER_CHECK     (0x62445371)
 #define NUM_TABLES          (256)
-#define OFFSET_REFS         (0 + sizeof(header_t))
-#define OFFSET_DATA         (OFFSET_REFS + sizeof(tableref_t) * NUM_TABLES)
+
+/*
+	Sizes of the structures in a chunk. A chunk with FLAG_OFFSET64 appends
+	the 64-bit chunk size and backlink offset to the header, and stores the
+	offsets in table references, buckets, and the backlink array in 64 bits.
+ */
+#define HEADER_SIZE(w)      ((w) ? 40 : 24)
+#define TABLEREF_SIZE(w)    ((w) ? 12 : 8)
+#define BUCKET_SIZE(w)      ((w) ? 12 : 8)
+#define BACKLINK_SIZE(w)    ((w) ? 8 : 4)
+#define OFFSET_REFS(w)      (HEADER_SIZE(w))
+#define OFFSET_DATA(w)      (OFFSET_REFS(w) + TABLEREF_SIZE(w) * NUM_TABLES)
+
+/*
+	Global flags of a chunk. FLAG_FASTHASH marks the second format where
+	keys are hashed by hash_key() without the terminating NULL character,
+	the size of every hash table is a power of two, and a table reference
+	stores the number of records instead of the size of the table.
+ */
+#define FLAG_FASTHASH       (0x00000001)
+#define FLAG_OFFSET64       (0x00000002)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CQDB_LITTLE_ENDIAN
+#elif defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+#define CQDB_LITTLE_ENDIAN
+#endif
 
 /**
  * An element of a hash table.
  */
 typedef struct {
 	uint32_t    hash;       /**< Hash value of the record. */
-	uint32_t    offset;     /**< Offset address to the actual record. */
+	uint64_t    offset;     /**< Offset address to the actual record. */
 } bucket_t;
 
 /**
@@ -66,18 +100,18 @@ typedef struct {
  */
 typedef struct {
 	int8_t      chunkid[4]; /**< Chunk identifier, "CQDB". */
-	uint32_t    size;       /**< Chunk size including this header. */
+	uint64_t    size;       /**< Chunk size including this header. */
 	uint32_t    flag;       /**< Global flags. */
 	uint32_t    byteorder;  /**< Byte-order indicator. */
 	uint32_t    bwd_size;   /**< Number of elements in the backward array. */
-	uint32_t    bwd_offset; /**< Offset to the backward array. */
+	uint64_t    bwd_offset; /**< Offset to the backward array. */
 } header_t;
 
 /**
  * Reference to a hash table.
  */
 typedef struct {
-	uint32_t    offset;     /**< Offset to a hash table. */
+	uint64_t    offset;     /**< Offset to a hash table. */
 	uint32_t    num;        /**< Number of elements in the hash table. */
 } tableref_t;
 
@@ -87,33 +121,96 @@ typedef struct {
 struct tag_cqdb_writer {
 	uint32_t    flag;           /**< Operation flag. */
 	FILE*       fp;             /**< File pointer. */
-	uint32_t    begin;          /**< Offset address to the head of this database. */
-	uint32_t    cur;            /**< Offset address to a new key/data pair. */
+	uint64_t    begin;          /**< Offset address to the head of this database. */
+	uint64_t    cur;            /**< Offset address to a new key/data pair. */
 	table_t     ht[NUM_TABLES]; /**< Hash tables (string -> id). */
 
-	uint32_t*   bwd;            /**< Backlink array. */
+	uint64_t*   bwd;            /**< Backlink array. */
 	uint32_t    bwd_num;        /**< */
 	uint32_t    bwd_size;       /**< Number of elements in the backlink array. */
 };
 
 /**
  * Constant quark database (CQDB).
+ *  The reader does not copy the hash tables nor the backlink array; they
+ *  are decoded from the memory block on each look-up.
  */
 struct tag_cqdb {
-	uint8_t*    buffer;         /**< Pointer to the memory block. */
+	const uint8_t* buffer;      /**< Pointer to the memory block. */
 	size_t      size;           /**< Size of the memory block. */
 
 	header_t    header;         /**< Chunk header. */
-	table_t     ht[NUM_TABLES]; /**< Hash tables (string -> id). */
+	tableref_t  ht[NUM_TABLES]; /**< Hash tables (string -> id) in the block. */
 
-	uint32_t*   bwd;            /**< Array for backward look-up (id -> string). */
+	const uint8_t* bwd;         /**< Array for backward look-up (id -> string). */
 
 	int         num;            /**< Number of key/data pairs. */
+	int         offset64;       /**< Nonzero if the offsets are stored in 64 bits. */
 };
 
 
 uint32_t hashlittle(const void *key, size_t length, uint32_t initval);
 
+#define HASH_PRIME1     (0x9E3779B185EBCA87ULL)
+#define HASH_PRIME2     (0xC2B2AE3D27D4EB4FULL)
+#define HASH_PRIME3     (0x165667B19E3779F9ULL)
+#define HASH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t read_uint64(const uint8_t* p)
+{
+	uint64_t value;
+#ifdef  CQDB_LITTLE_ENDIAN
+	memcpy(&value, p, sizeof(value));
+#else
+	int i;
+	for (i = 7, value = 0; 0 <= i; --i) {
+		value = (value << 8) | p[i];
+	}
+#endif/*CQDB_LITTLE_ENDIAN*/
+	return value;
+}
+
+/**
+ * Hash function of the second format.
+ *  Keys are consumed in 64-bit words with multiply-rotate rounds (in the
+ *  manner of xxHash64) and the result is folded into 32 bits. The words
+ *  are read as little-endian integers so that the hash values stored in
+ *  a database do not depend on the host.
+ */
+static uint32_t hash_key(const void *key, size_t length)
+{
+	const uint8_t *p = (const uint8_t*)key;
+	uint64_t h = HASH_PRIME3 ^ ((uint64_t)length * HASH_PRIME1);
+	uint64_t k;
+
+	while (8 <= length) {
+		k = read_uint64(p) * HASH_PRIME2;
+		k = HASH_ROTL(k, 31) * HASH_PRIME1;
+		h ^= k;
+		h = HASH_ROTL(h, 27) * HASH_PRIME1 + HASH_PRIME2;
+		p += 8;
+		length -= 8;
+	}
+
+	if (0 < length) {
+		for (k = 0; 0 < length; ) {
+			k = (k << 8) | p[--length];
+		}
+		k *= HASH_PRIME2;
+		k = HASH_ROTL(k, 31) * HASH_PRIME1;
+		h ^= k;
+		h = HASH_ROTL(h, 27) * HASH_PRIME1 + HASH_PRIME2;
+	}
+
+	/* Final avalanche. */
+	h ^= h >> 33;
+	h *= HASH_PRIME2;
+	h ^= h >> 29;
+	h *= HASH_PRIME3;
+	h ^= h >> 32;
+	return (uint32_t)h;
+}
+
 
 
 
@@ -127,6 +224,15 @@ static size_t write_uint32(cqdb_writer_t* wt, uint32_t value)
 	return fwrite(buffer, sizeof(uint8_t), 4, wt->fp) / sizeof(value);
 }
 
+static size_t write_offset(cqdb_writer_t* wt, uint64_t value)
+{
+	if (wt->flag & CQDB_OFFSET64) {
+		write_uint32(wt, (uint32_t)(value & 0xFFFFFFFF));
+		return write_uint32(wt, (uint32_t)(value >> 32));
+	}
+	return write_uint32(wt, (uint32_t)value);
+}
+
 static size_t write_data(cqdb_writer_t* wt, const void *data, size_t size)
 {
 	return fwrite(data, size, 1, wt->fp);
@@ -142,8 +248,8 @@ cqdb_writer_t* cqdb_writer(FILE *fp, int flag)
 		memset(dbw, 0, sizeof(*dbw));
 		dbw->flag = flag;
 		dbw->fp = fp;
-		dbw->begin = ftell(dbw->fp);
-		dbw->cur = OFFSET_DATA;
+		dbw->begin = (uint64_t)ftello(dbw->fp);
+		dbw->cur = OFFSET_DATA(flag & CQDB_OFFSET64);
 
 		/* Initialize the hash tables.*/
 		for (i = 0; i < NUM_TABLES; ++i) {
@@ -155,7 +261,7 @@ cqdb_writer_t* cqdb_writer(FILE *fp, int flag)
 		dbw->bwd_size = 0;
 
 		/* Move the file pointer to the offset to the first key/data pair. */
-		if (fseek(dbw->fp, dbw->begin + dbw->cur, SEEK_SET) != 0) {
+		if (fseeko(dbw->fp, dbw->begin + dbw->cur, SEEK_SET) != 0) {
 			goto error_exit;    /* Seek error. */
 		}
 	}
@@ -187,7 +293,8 @@ int cqdb_writer_put(cqdb_writer_t* dbw, const char *str, int id)
 	uint32_t ksize = (uint32_t)(strlen(str) + 1);
 
 	/* Compute the hash value and choose a hash table. */
-	uint32_t hv = hashlittle(key, ksize, 0);
+	uint32_t hv = (dbw->flag & CQDB_FASTHASH) ?
+		hash_key(key, ksize - 1) : hashlittle(key, ksize, 0);
 	table_t* ht = &dbw->ht[hv % 256];
 
 	/* Check for non-negative identifier. */
@@ -196,6 +303,12 @@ int cqdb_writer_put(cqdb_writer_t* dbw, const char *str, int id)
 		goto error_exit;
 	}
 
+	/* Check that the record is addressable with 32-bit offsets. */
+	if (!(dbw->flag & CQDB_OFFSET64) && 0xFFFFFFFF < dbw->cur + 2 * sizeof(uint32_t) + ksize) {
+		ret = CQDB_ERROR_OVERFLOW;
+		goto error_exit;
+	}
+
 	/* Write out the current data. */
 	write_uint32(dbw, (uint32_t)id);
 	write_uint32(dbw, (uint32_t)ksize);
@@ -227,7 +340,7 @@ int cqdb_writer_put(cqdb_writer_t* dbw, const char *str, int id)
 			uint32_t size = dbw->bwd_size;
 
 			while (size <= (uint32_t)id) size = (size + 1) * 2;
-			dbw->bwd = (uint32_t*)realloc(dbw->bwd, sizeof(uint32_t) * size);
+			dbw->bwd = (uint64_t*)realloc(dbw->bwd, sizeof(uint64_t) * size);
 			if (dbw->bwd == NULL) {
 				ret = CQDB_ERROR_OUTOFMEMORY;
 				goto error_exit;
@@ -253,11 +366,34 @@ error_exit:
 	return ret;
 }
 
+/**
+ * Number of buckets for a hash table with n elements.
+ *  The first format doubles the number of elements; the second format
+ *  rounds it up to a power of two so that the reader can use a mask.
+ */
+static uint32_t table_size(int fasthash, uint32_t n)
+{
+	uint32_t size = 2;
+
+	if (n == 0) {
+		return 0;
+	}
+	if (!fasthash) {
+		return n * 2;
+	}
+	while (size / 2 < n && size < 0x80000000) {
+		size *= 2;
+	}
+	return size;
+}
+
 int cqdb_writer_close(cqdb_writer_t* dbw)
 {
 	uint32_t i, j;
 	int k, ret = 0;
-	long offset = 0;
+	const int fasthash = (dbw->flag & CQDB_FASTHASH) ? 1 : 0;
+	const int offset64 = (dbw->flag & CQDB_OFFSET64) ? 1 : 0;
+	int64_t offset = 0;
 	header_t header;
 
 	/* If an error have occurred, just free the memory blocks. */
@@ -268,7 +404,7 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 
 	/* Initialize the file header. */
 	strncpy((char*)header.chunkid, CHUNKID, 4);
-	header.flag = 0;
+	header.flag = (fasthash ? FLAG_FASTHASH : 0) | (offset64 ? FLAG_OFFSET64 : 0);
 	header.byteorder = BYTEORDER_CHECK;
 	header.bwd_offset = 0;
 	header.bwd_size = dbw->bwd_num;
@@ -283,10 +419,10 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 		/* Do not write empty hash tables. */
 		if (ht->bucket != NULL) {
 			/*
-				Actual bucket will have the double size; half elements
-				in the bucket are kept empty.
+				Actual bucket will have (at least) the double size; half
+				elements in the bucket are kept empty.
 			 */
-			int n = ht->num * 2;
+			int n = (int)table_size(fasthash, ht->num);
 
 			/* Allocate the bucket. */
 			bucket_t* dst = (bucket_t*)calloc(n, sizeof(bucket_t));
@@ -315,7 +451,7 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 			/* Write the bucket. */
 			for (k = 0; k < n; ++k) {
 				write_uint32(dbw, dst[k].hash);
-				write_uint32(dbw, dst[k].offset);
+				write_offset(dbw, dst[k].offset);
 			}
 
 			/* Free the bucket. */
@@ -326,10 +462,10 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 	/* Write the backlink array if specified. */
 	if (!(dbw->flag & CQDB_ONEWAY) && 0 < dbw->bwd_size) {
 		/* Store the offset to the head of this array. */
-		header.bwd_offset = ftell(dbw->fp) - dbw->begin;
+		header.bwd_offset = (uint64_t)ftello(dbw->fp) - dbw->begin;
 		/* Store the contents of the backlink array. */
 		for (i = 0; i < dbw->bwd_num; ++i) {
-			write_uint32(dbw, dbw->bwd[i]);
+			write_offset(dbw, dbw->bwd[i]);
 		}
 	}
 
@@ -340,26 +476,34 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 	}
 
 	/* Store the current position. */
-	offset = ftell(dbw->fp);
+	offset = (int64_t)ftello(dbw->fp);
 	if (offset == -1) {
 		ret = CQDB_ERROR_FILETELL;
 		goto error_exit;
 	}
-	header.size = (uint32_t)offset - dbw->begin;
+	header.size = (uint64_t)offset - dbw->begin;
+	if (!offset64 && 0xFFFFFFFF < header.size) {
+		ret = CQDB_ERROR_OVERFLOW;
+		goto error_exit;
+	}
 
 	/* Rewind the current position to the beginning. */
-	if (fseek(dbw->fp, dbw->begin, SEEK_SET) != 0) {
+	if (fseeko(dbw->fp, dbw->begin, SEEK_SET) != 0) {
 		ret = CQDB_ERROR_FILESEEK;
 		goto error_exit;
 	}
 
 	/* Write the file header. */
 	write_data(dbw, header.chunkid, 4);
-	write_uint32(dbw, header.size);
+	write_uint32(dbw, (uint32_t)header.size);
 	write_uint32(dbw, header.flag);
 	write_uint32(dbw, header.byteorder);
 	write_uint32(dbw, header.bwd_size);
-	write_uint32(dbw, header.bwd_offset);
+	write_uint32(dbw, (uint32_t)header.bwd_offset);
+	if (offset64) {
+		write_offset(dbw, header.size);
+		write_offset(dbw, header.bwd_offset);
+	}
 
 	/*
 		Write references to hash tables. At this moment, dbw->cur points
@@ -367,11 +511,11 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 	 */
 	for (i = 0; i < NUM_TABLES; ++i) {
 		/* Offset to the hash table (or zero for non-existent tables). */
-		write_uint32(dbw, dbw->ht[i].num ? dbw->cur : 0);
-		/* Bucket size is double to the number of elements. */
-		write_uint32(dbw, dbw->ht[i].num * 2);
+		write_offset(dbw, dbw->ht[i].num ? dbw->cur : 0);
+		/* Bucket size (first format) or number of elements (second format). */
+		write_uint32(dbw, fasthash ? dbw->ht[i].num : table_size(0, dbw->ht[i].num));
 		/* Advance the offset counter. */
-		dbw->cur += (dbw->ht[i].num * 2) * sizeof(bucket_t);
+		dbw->cur += table_size(fasthash, dbw->ht[i].num) * (uint64_t)BUCKET_SIZE(offset64);
 	}
 
 	/* Check an occurrence of a file-related error. */
@@ -381,7 +525,7 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 	}
 
 	/* Seek to the last position. */
-	if (fseek(dbw->fp, offset, SEEK_SET) != 0) {
+	if (fseeko(dbw->fp, offset, SEEK_SET) != 0) {
 		ret = CQDB_ERROR_FILESEEK;
 		goto error_exit;
 	}
@@ -391,7 +535,7 @@ int cqdb_writer_close(cqdb_writer_t* dbw)
 
 error_exit:
 	/* Seek to the first position. */
-	fseek(dbw->fp, dbw->begin, SEEK_SET);
+	fseeko(dbw->fp, dbw->begin, SEEK_SET);
 	cqdb_writer_delete(dbw);
 	return ret;
 }
@@ -401,44 +545,33 @@ error_exit:
 static uint32_t read_uint32(const uint8_t* p)
 {
 	uint32_t value;
+#ifdef  CQDB_LITTLE_ENDIAN
+	/* The memory image is identical to the little-endian data. */
+	memcpy(&value, p, sizeof(value));
+#else
 	value = ((uint32_t)p[0]);
 	value |= ((uint32_t)p[1] << 8);
 	value |= ((uint32_t)p[2] << 16);
 	value |= ((uint32_t)p[3] << 24);
+#endif/*CQDB_LITTLE_ENDIAN*/
 	return value;
 }
 
-static const uint8_t *read_tableref(tableref_t* ref, const uint8_t *p)
+static uint64_t read_offset(const uint8_t* p, int offset64)
 {
-	ref->offset = read_uint32(p);
-	p += sizeof(uint32_t);
-	ref->num = read_uint32(p);
-	p += sizeof(uint32_t);
-	return p;
-}
-
-static bucket_t* read_bucket(const uint8_t* p, uint32_t num)
-{
-	uint32_t i;
-	bucket_t *bucket = (bucket_t*)calloc(num, sizeof(bucket_t));
-	for (i = 0; i < num; ++i) {
-		bucket[i].hash = read_uint32(p);
-		p += sizeof(uint32_t);
-		bucket[i].offset = read_uint32(p);
-		p += sizeof(uint32_t);
+	if (offset64) {
+		return (uint64_t)read_uint32(p) | ((uint64_t)read_uint32(p + 4) << 32);
 	}
-	return bucket;
+	return read_uint32(p);
 }
 
-static uint32_t* read_backward_links(const uint8_t* p, uint32_t num)
+static const uint8_t *read_tableref(tableref_t* ref, const uint8_t *p, int offset64)
 {
-	uint32_t i;
-	uint32_t *bwd = (uint32_t*)calloc(num, sizeof(uint32_t));
-	for (i = 0; i < num; ++i) {
-		bwd[i] = read_uint32(p);
-		p += sizeof(uint32_t);
-	}
-	return bwd;
+	ref->offset = read_offset(p, offset64);
+	p += offset64 ? sizeof(uint64_t) : sizeof(uint32_t);
+	ref->num = read_uint32(p);
+	p += sizeof(uint32_t);
+	return p;
 }
 
 cqdb_t* cqdb_reader(const void *buffer, size_t size)
@@ -447,7 +580,7 @@ cqdb_t* cqdb_reader(const void *buffer, size_t size)
 	cqdb_t* db = NULL;
 
 	/* The minimum size of a valid CQDB is OFFSET_DATA. */
-	if (size < OFFSET_DATA) {
+	if (size < OFFSET_DATA(0)) {
 		return NULL;
 	}
 
@@ -461,12 +594,12 @@ cqdb_t* cqdb_reader(const void *buffer, size_t size)
 		const uint8_t* p = NULL;
 
 		/* Set memory block and size. */
-		db->buffer = buffer;
+		db->buffer = (const uint8_t*)buffer;
 		db->size = size;
 
 		/* Read the database header. */
 		p = db->buffer;
-		strncpy((char*)db->header.chunkid, (const char*)p, 4);
+		memcpy(db->header.chunkid, p, 4);
 		p += sizeof(uint32_t);
 		db->header.size = read_uint32(p);
 		p += sizeof(uint32_t);
@@ -485,36 +618,51 @@ cqdb_t* cqdb_reader(const void *buffer, size_t size)
 			return NULL;
 		}
 
+		/* Read the 64-bit size and offset. */
+		db->offset64 = (db->header.flag & FLAG_OFFSET64) ? 1 : 0;
+		if (db->offset64) {
+			if (size < OFFSET_DATA(1)) {
+				free(db);
+				return NULL;
+			}
+			db->header.size = read_offset(p, 1);
+			db->header.bwd_offset = read_offset(p + sizeof(uint64_t), 1);
+		}
+
 		/* Check the chunk size. */
 		if (size < db->header.size) {
 			free(db);
 			return NULL;
 		}
 
-		/* Set pointers to the hash tables. */
+		/* Read the references to the hash tables. */
 		db->num = 0;    /* Number of records. */
-		p = (db->buffer + OFFSET_REFS);
+		p = (db->buffer + OFFSET_REFS(db->offset64));
 		for (i = 0; i < NUM_TABLES; ++i) {
-			tableref_t ref;
-			p = read_tableref(&ref, p);
-			if (ref.offset) {
-				/* Set buckets. */
-				db->ht[i].bucket = read_bucket(db->buffer + ref.offset, ref.num);
-				db->ht[i].num = ref.num;
+			p = read_tableref(&db->ht[i], p, db->offset64);
+
+			/* The second format stores the number of records in the table. */
+			if (db->header.flag & FLAG_FASTHASH) {
+				db->num += db->ht[i].num;
+				db->ht[i].num = table_size(1, db->ht[i].num);
 			}
 			else {
-				/* An empty hash table. */
-				db->ht[i].bucket = NULL;
-				db->ht[i].num = 0;
+				/* The number of records is the half of the table size.*/
+				db->num += db->ht[i].num / 2;
 			}
 
-			/* The number of records is the half of the table size.*/
-			db->num += ref.num / 2;
+			/* Reject a hash table outside of the chunk. */
+			if (db->ht[i].offset && db->header.size < \
+				db->ht[i].offset + (uint64_t)db->ht[i].num * BUCKET_SIZE(db->offset64)) {
+				free(db);
+				return NULL;
+			}
 		}
 
 		/* Set the pointer to the backlink array if any. */
-		if (db->header.bwd_offset) {
-			db->bwd = read_backward_links(db->buffer + db->header.bwd_offset, db->num);
+		if (db->header.bwd_offset && db->header.bwd_offset + \
+			(uint64_t)db->header.bwd_size * BACKLINK_SIZE(db->offset64) <= db->header.size) {
+			db->bwd = db->buffer + db->header.bwd_offset;
 		}
 		else {
 			db->bwd = NULL;
@@ -526,53 +674,95 @@ cqdb_t* cqdb_reader(const void *buffer, size_t size)
 
 void cqdb_delete(cqdb_t* db)
 {
-	int i;
+	free(db);
+}
 
-	if (db != NULL) {
-		for (i = 0; i < NUM_TABLES; ++i) {
-			free(db->ht[i].bucket);
+/* Size of the key buffer for hashing a key of the first format. */
+#define KEY_BUFFER_SIZE     256
+
+/**
+ * Hash a key as stored in the first format, i.e., with the terminating
+ * NULL character. A key that is not terminated by a NULL character (a
+ * slice of a longer string) is copied into a buffer with the character.
+ */
+static int hash_key_version1(const char *str, size_t length, int terminated, uint32_t *hv)
+{
+	char buffer[KEY_BUFFER_SIZE];
+	char *key = buffer;
+
+	if (terminated) {
+		*hv = hashlittle(str, length + 1, 0);
+		return 0;
+	}
+	if (KEY_BUFFER_SIZE <= length) {
+		key = (char*)malloc(length + 1);
+		if (key == NULL) {
+			return CQDB_ERROR_OUTOFMEMORY;
 		}
-		free(db->bwd);
-		free(db);
 	}
+	memcpy(key, str, length);
+	key[length] = 0;
+	*hv = hashlittle(key, length + 1, 0);
+	if (key != buffer) {
+		free(key);
+	}
+	return 0;
 }
 
-int cqdb_to_id(cqdb_t* db, const char *str)
+static int to_id(cqdb_t* db, const char *str, size_t length, int terminated)
 {
-	uint32_t hv = hashlittle(str, strlen(str) + 1, 0);
-	int t = hv % 256;
-	table_t* ht = &db->ht[t];
-
-	if (ht->num && ht->bucket != NULL) {
-		int n = ht->num;
-		int k = (hv >> 8) % n;
-		bucket_t* p = NULL;
-
-		while (p = &ht->bucket[k], p->offset) {
-			if (p->hash == hv) {
-				int value;
-				uint32_t ksize;
-				const uint8_t *q = db->buffer + p->offset;
-				value = (int)read_uint32(q);
-				q += sizeof(uint32_t);
-				ksize = read_uint32(q);
-				q += sizeof(uint32_t);
-				if (strcmp(str, (const char *)q) == 0) {
-					return value;
+	uint32_t hv, k, n;
+	uint64_t offset;
+	const tableref_t* ht = NULL;
+	const uint8_t* bucket = NULL;
+	const int fasthash = (db->header.flag & FLAG_FASTHASH);
+	const size_t bsize = BUCKET_SIZE(db->offset64);
+
+	/* The first format hashes the key with the terminating NULL. */
+	if (fasthash) {
+		hv = hash_key(str, length);
+	}
+	else if (hash_key_version1(str, length, terminated, &hv) != 0) {
+		return CQDB_ERROR_OUTOFMEMORY;
+	}
+	ht = &db->ht[hv % 256];
+	if (ht->num && ht->offset) {
+		n = ht->num;
+		bucket = db->buffer + ht->offset;
+		k = fasthash ? ((hv >> 8) & (n - 1)) : ((hv >> 8) % n);
+
+		/* Read the elements (hash, offset) of the bucket in place. */
+		while ((offset = read_offset(bucket + k * bsize + sizeof(uint32_t), db->offset64)) != 0) {
+			if (read_uint32(bucket + k * bsize) == hv) {
+				/* Compare the stored key size first, then the key bytes. */
+				const uint8_t *q = db->buffer + offset;
+				if (read_uint32(q + sizeof(uint32_t)) == length + 1 &&
+					memcmp(str, q + 2 * sizeof(uint32_t), length) == 0) {
+					return (int)read_uint32(q);
 				}
 			}
-			k = (k + 1) % n;
+			k = fasthash ? ((k + 1) & (n - 1)) : ((k + 1) % n);
 		}
 	}
 
 	return CQDB_ERROR_NOTFOUND;
 }
 
+int cqdb_to_id(cqdb_t* db, const char *str)
+{
+	return to_id(db, str, strlen(str), 1);
+}
+
+int cqdb_to_id_n(cqdb_t* db, const char *str, size_t length)
+{
+	return to_id(db, str, length, 0);
+}
+
 const char* cqdb_to_string(cqdb_t* db, int id)
 {
 	/* Check if the current database supports the backward look-up. */
 	if (db->bwd != NULL && (uint32_t)id < db->header.bwd_size) {
-		uint32_t offset = db->bwd[id];
+		uint64_t offset = read_offset(db->bwd + BACKLINK_SIZE(db->offset64) * id, db->offset64);
 		if (offset) {
 			const uint8_t *p = db->buffer + offset;
 			p += sizeof(uint32_t);  /* Skip key data. */
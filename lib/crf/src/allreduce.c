@@ -0,0 +1,480 @@
+/*
+ *      Allreduce over process-to-process transports.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+ /* $Id$ */
+
+#define    _POSIX_C_SOURCE    200809L
+
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <os.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <crfsuite.h>
+#include "allreduce.h"
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_NETDB_H)
+#define    USE_SOCKETS    1
+#endif
+
+#ifdef    USE_SOCKETS
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifndef    MSG_NOSIGNAL
+#define    MSG_NOSIGNAL    0
+#endif/*MSG_NOSIGNAL*/
+
+/* Number of attempts (100ms apart) to connect to rank #0. */
+#define    CONNECT_RETRIES    600
+
+struct tag_allreduce {
+	const allreduce_transport_t *tr;
+	char *address;
+	int rank;
+	int size;
+	int *fds;           /**< Descriptors of the ranks (rank #0 only). */
+	int fd;             /**< Descriptor connected to rank #0. */
+	floatval_t *recv;   /**< Receive buffer for the reduction. */
+	int cap;
+};
+
+static void sleep_msec(long msec)
+{
+	struct timespec ts;
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (msec % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+static int write_all(int fd, const void *buffer, size_t size)
+{
+	const char *p = (const char*)buffer;
+	while (0 < size) {
+		ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		p += n;
+		size -= (size_t)n;
+	}
+	return 0;
+}
+
+static int read_all(int fd, void *buffer, size_t size)
+{
+	char *p = (char*)buffer;
+	while (0 < size) {
+		ssize_t n = recv(fd, p, size, 0);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (n == 0) {
+			return -1;    /* The peer has closed the connection. */
+		}
+		p += n;
+		size -= (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ * Unix domain socket transport; the address is a path name.
+ */
+static int unix_address(struct sockaddr_un *sa, const char *address)
+{
+	memset(sa, 0, sizeof(*sa));
+	sa->sun_family = AF_UNIX;
+	if (sizeof(sa->sun_path) <= strlen(address)) {
+		return -1;
+	}
+	strcpy(sa->sun_path, address);
+	return 0;
+}
+
+static int unix_listen(const char *address, int backlog)
+{
+	int fd;
+	struct sockaddr_un sa;
+
+	if (unix_address(&sa, address) != 0) {
+		return -1;
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -1;
+	}
+	unlink(address);
+	if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 || listen(fd, backlog) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int unix_connect(const char *address)
+{
+	int fd;
+	struct sockaddr_un sa;
+
+	if (unix_address(&sa, address) != 0) {
+		return -1;
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void unix_unlink(const char *address)
+{
+	unlink(address);
+}
+
+/*
+ * TCP transport; the address is "host:port" (an empty host listens on all
+ * the interfaces).
+ */
+static struct addrinfo* tcp_resolve(const char *address, int passive)
+{
+	char *host = NULL, *port = NULL;
+	struct addrinfo hints, *res = NULL;
+
+	host = (char*)malloc(strlen(address) + 1);
+	if (host == NULL) {
+		return NULL;
+	}
+	strcpy(host, address);
+	port = strrchr(host, ':');
+	if (port == NULL) {
+		free(host);
+		return NULL;
+	}
+	*port++ = 0;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+	if (getaddrinfo(*host ? host : NULL, port, &hints, &res) != 0) {
+		res = NULL;
+	}
+	free(host);
+	return res;
+}
+
+static int tcp_open(const char *address, int passive, int backlog)
+{
+	int fd = -1, on = 1;
+	struct addrinfo *ai = NULL, *res = tcp_resolve(address, passive);
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) {
+			continue;
+		}
+		if (passive) {
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, backlog) == 0) {
+				break;
+			}
+		}
+		else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+
+	if (res != NULL) {
+		freeaddrinfo(res);
+	}
+	return fd;
+}
+
+static int tcp_listen(const char *address, int backlog)
+{
+	return tcp_open(address, 1, backlog);
+}
+
+static int tcp_connect(const char *address)
+{
+	return tcp_open(address, 0, 0);
+}
+
+static void tcp_unlink(const char *address)
+{
+}
+
+static const allreduce_transport_t transports[] = {
+	{"unix", unix_listen, unix_connect, unix_unlink},
+	{"tcp", tcp_listen, tcp_connect, tcp_unlink},
+	{NULL, NULL, NULL, NULL},
+};
+
+static const allreduce_transport_t* find_transport(const char *address, const char **rest)
+{
+	const allreduce_transport_t *tr = NULL;
+
+	for (tr = transports; tr->scheme != NULL; ++tr) {
+		size_t n = strlen(tr->scheme);
+		if (strncmp(address, tr->scheme, n) == 0 && address[n] == ':') {
+			*rest = address + n + 1;
+			return tr;
+		}
+	}
+	return NULL;
+}
+
+static int reserve(allreduce_t *ar, int n)
+{
+	if (ar->cap < n) {
+		floatval_t *recv = (floatval_t*)realloc(ar->recv, sizeof(floatval_t) * n);
+		if (recv == NULL) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		ar->recv = recv;
+		ar->cap = n;
+	}
+	return 0;
+}
+
+int allreduce_open(allreduce_t **ptr_ar, const char *address, int rank, int size)
+{
+	int i, ret = 0, fd = -1;
+	const char *rest = NULL;
+	allreduce_t *ar = NULL;
+	const allreduce_transport_t *tr = find_transport(address, &rest);
+
+	*ptr_ar = NULL;
+	if (tr == NULL || size < 1 || rank < 0 || size <= rank) {
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
+
+	ar = (allreduce_t*)calloc(1, sizeof(allreduce_t));
+	if (ar == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	ar->tr = tr;
+	ar->rank = rank;
+	ar->size = size;
+	ar->fd = -1;
+	ar->address = (char*)malloc(strlen(rest) + 1);
+	if (ar->address == NULL) {
+		ret = CRFSUITEERR_OUTOFMEMORY;
+		goto error_exit;
+	}
+	strcpy(ar->address, rest);
+
+	if (rank == 0) {
+		/* Accept a connection from every other rank. */
+		ar->fds = (int*)malloc(sizeof(int) * size);
+		if (ar->fds == NULL) {
+			ret = CRFSUITEERR_OUTOFMEMORY;
+			goto error_exit;
+		}
+		for (i = 0; i < size; ++i) {
+			ar->fds[i] = -1;
+		}
+
+		fd = tr->listen(ar->address, size);
+		if (fd < 0) {
+			ret = CRFSUITEERR_UNKNOWN;
+			goto error_exit;
+		}
+
+		for (i = 1; i < size; ++i) {
+			int32_t peer = -1;
+			int conn = accept(fd, NULL, NULL);
+			if (conn < 0) {
+				if (errno == EINTR) {
+					--i;
+					continue;
+				}
+				ret = CRFSUITEERR_UNKNOWN;
+				goto error_exit;
+			}
+			if (read_all(conn, &peer, sizeof(peer)) != 0 || \
+				peer <= 0 || size <= peer || 0 <= ar->fds[peer]) {
+				close(conn);
+				ret = CRFSUITEERR_INCOMPATIBLE;
+				goto error_exit;
+			}
+			ar->fds[peer] = conn;
+		}
+
+		close(fd);
+		tr->unlink(ar->address);
+		fd = -1;
+	}
+	else {
+		/* Connect to rank #0, which may not be listening yet. */
+		int32_t self = (int32_t)rank;
+		for (i = 0; i < CONNECT_RETRIES; ++i) {
+			if (0 <= (ar->fd = tr->connect(ar->address))) {
+				break;
+			}
+			sleep_msec(100);
+		}
+		if (ar->fd < 0 || write_all(ar->fd, &self, sizeof(self)) != 0) {
+			ret = CRFSUITEERR_UNKNOWN;
+			goto error_exit;
+		}
+	}
+
+	*ptr_ar = ar;
+	return 0;
+
+error_exit:
+	if (0 <= fd) {
+		close(fd);
+		tr->unlink(ar->address);
+	}
+	allreduce_close(ar);
+	return ret;
+}
+
+int allreduce_sum(allreduce_t *ar, floatval_t *buffer, int n)
+{
+	int i, r;
+	const size_t size = sizeof(floatval_t) * n;
+
+	if (ar->rank != 0) {
+		/* Send the local values and receive the sum. */
+		if (write_all(ar->fd, buffer, size) != 0 || read_all(ar->fd, buffer, size) != 0) {
+			return CRFSUITEERR_UNKNOWN;
+		}
+		return 0;
+	}
+
+	if (reserve(ar, n) != 0) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+
+	/* Add the values in the order of ranks so that the sum is reproducible. */
+	for (r = 1; r < ar->size; ++r) {
+		if (read_all(ar->fds[r], ar->recv, size) != 0) {
+			return CRFSUITEERR_UNKNOWN;
+		}
+		for (i = 0; i < n; ++i) {
+			buffer[i] += ar->recv[i];
+		}
+	}
+
+	/* Send back the identical sum to all the ranks. */
+	for (r = 1; r < ar->size; ++r) {
+		if (write_all(ar->fds[r], buffer, size) != 0) {
+			return CRFSUITEERR_UNKNOWN;
+		}
+	}
+	return 0;
+}
+
+int allreduce_broadcast(allreduce_t *ar, floatval_t *buffer, int n)
+{
+	int r;
+	const size_t size = sizeof(floatval_t) * n;
+
+	if (ar->rank != 0) {
+		return read_all(ar->fd, buffer, size) != 0 ? CRFSUITEERR_UNKNOWN : 0;
+	}
+
+	for (r = 1; r < ar->size; ++r) {
+		if (write_all(ar->fds[r], buffer, size) != 0) {
+			return CRFSUITEERR_UNKNOWN;
+		}
+	}
+	return 0;
+}
+
+void allreduce_close(allreduce_t *ar)
+{
+	int i;
+
+	if (ar != NULL) {
+		if (ar->fds != NULL) {
+			for (i = 0; i < ar->size; ++i) {
+				if (0 <= ar->fds[i]) {
+					close(ar->fds[i]);
+				}
+			}
+		}
+		if (0 <= ar->fd) {
+			close(ar->fd);
+		}
+		free(ar->recv);
+		free(ar->fds);
+		free(ar->address);
+		free(ar);
+	}
+}
+
+#else
+
+int allreduce_open(allreduce_t **ptr_ar, const char *address, int rank, int size)
+{
+	*ptr_ar = NULL;
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
+int allreduce_sum(allreduce_t *ar, floatval_t *buffer, int n)
+{
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
+int allreduce_broadcast(allreduce_t *ar, floatval_t *buffer, int n)
+{
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
+void allreduce_close(allreduce_t *ar)
+{
+}
+
+#endif/*USE_SOCKETS*/
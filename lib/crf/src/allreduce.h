@@ -0,0 +1,62 @@
+/*
+ *      Allreduce over process-to-process transports.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+ /* $Id$ */
+
+#ifndef    __ALLREDUCE_H__
+#define    __ALLREDUCE_H__
+
+struct tag_allreduce;
+typedef struct tag_allreduce allreduce_t;
+
+/**
+ * Transport for exchanging buffers between the ranks of a training job.
+ *  A transport is selected by the scheme of the address string given to
+ *  allreduce_open(), e.g., "unix:/tmp/crfsuite.sock" or "tcp:host:port".
+ *  Rank #0 listens on the address and reduces the buffers sent by the other
+ *  ranks; the other ranks connect to it.
+ */
+typedef struct {
+	/** Scheme name of the transport ("unix", "tcp"). */
+	const char *scheme;
+	/** Open a listening endpoint on the address; returns a descriptor. */
+	int(*listen)(const char *address, int backlog);
+	/** Connect to the listening endpoint; returns a descriptor. */
+	int(*connect)(const char *address);
+	/** Remove the resources bound to the address (if any). */
+	void(*unlink)(const char *address);
+} allreduce_transport_t;
+
+int allreduce_open(allreduce_t **ptr_ar, const char *address, int rank, int size);
+int allreduce_sum(allreduce_t *ar, floatval_t *buffer, int n);
+int allreduce_broadcast(allreduce_t *ar, floatval_t *buffer, int n);
+void allreduce_close(allreduce_t *ar);
+
+#endif/*__ALLREDUCE_H__*/
@@ -0,0 +1,291 @@
+/*
+ *      Thread-safe quark object with sharded hash tables.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+ /* $Id$ */
+
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include "os.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef    HAVE_PTHREAD_H
+#include <pthread.h>
+typedef pthread_mutex_t mutex_t;
+#define    mutex_init(m)       pthread_mutex_init((m), NULL)
+#define    mutex_destroy(m)    pthread_mutex_destroy(m)
+#define    mutex_lock(m)       pthread_mutex_lock(m)
+#define    mutex_unlock(m)     pthread_mutex_unlock(m)
+#else
+/* Without threads, nothing can access the quark concurrently. */
+typedef int mutex_t;
+#define    mutex_init(m)
+#define    mutex_destroy(m)
+#define    mutex_lock(m)
+#define    mutex_unlock(m)
+#endif/*HAVE_PTHREAD_H*/
+
+#include "hquark.h"
+#include "cquark.h"
+
+#define    NUM_SHARDS      64
+#define    SEGMENT_BITS    16
+#define    SEGMENT_SIZE    (1 << SEGMENT_BITS)
+#define    NUM_SEGMENTS    (1 << (31 - SEGMENT_BITS))
+
+/*
+	A string is stored in the shard chosen by the upper bits of its hash
+	value. Each shard is a hashed quark, guarded by its own mutex, whose
+	local identifiers are mapped to the global ones (-1 for a string whose
+	identifier could not be allocated). The global mutex guards the
+	identifier-to-string segments; it is taken when a new string is
+	assigned an identifier, and by cquark_to_string() and cquark_num().
+	Strings are never moved, so the segments point into the arenas of the
+	shards.
+ */
+typedef struct {
+	mutex_t lock;
+	hquark_t *qrk;
+	int *gids;
+	int max;
+} shard_t;
+
+struct tag_cquark {
+	shard_t shards[NUM_SHARDS];
+
+	mutex_t lock;
+	int num;
+	const char **segments[NUM_SEGMENTS];
+};
+
+static shard_t *get_shard(cquark_t* qrk, const char *str, size_t length)
+{
+	return &qrk->shards[hquark_hash(str, length) >> 26];
+}
+
+/* Make room for the identifier of a new string; the shard must be locked. */
+static int reserve_id(shard_t* shard)
+{
+	if (shard->max <= hquark_num(shard->qrk)) {
+		int max = (shard->max + 1) * 2;
+		int *gids = (int*)realloc(shard->gids, sizeof(int) * max);
+		if (gids == NULL) {
+			return -1;
+		}
+		shard->gids = gids;
+		shard->max = max;
+	}
+	return 0;
+}
+
+/*
+	Assign a global identifier to a string; the shard must be locked. The
+	identifier stays -1 if the segment cannot be allocated, so that the
+	next cquark_get() tries again.
+ */
+static int assign_id(cquark_t* qrk, shard_t* shard, int lid)
+{
+	int gid = -1;
+	const char **segment = NULL;
+
+	mutex_lock(&qrk->lock);
+	if (qrk->num < INT_MAX) {
+		segment = qrk->segments[qrk->num >> SEGMENT_BITS];
+		if (segment == NULL) {
+			segment = (const char **)malloc(sizeof(const char *) * SEGMENT_SIZE);
+			qrk->segments[qrk->num >> SEGMENT_BITS] = segment;
+		}
+		if (segment != NULL) {
+			gid = qrk->num++;
+			segment[gid & (SEGMENT_SIZE - 1)] = hquark_to_string(shard->qrk, lid);
+		}
+	}
+	mutex_unlock(&qrk->lock);
+
+	shard->gids[lid] = gid;
+	return gid;
+}
+
+cquark_t* cquark_new()
+{
+	int i;
+	cquark_t* qrk = (cquark_t*)calloc(1, sizeof(cquark_t));
+
+	if (qrk != NULL) {
+		mutex_init(&qrk->lock);
+		for (i = 0; i < NUM_SHARDS; ++i) {
+			mutex_init(&qrk->shards[i].lock);
+		}
+		for (i = 0; i < NUM_SHARDS; ++i) {
+			qrk->shards[i].qrk = hquark_new();
+			if (qrk->shards[i].qrk == NULL) {
+				cquark_delete(qrk);
+				return NULL;
+			}
+		}
+	}
+	return qrk;
+}
+
+void cquark_delete(cquark_t* qrk)
+{
+	int i;
+
+	if (qrk != NULL) {
+		for (i = 0; i < NUM_SHARDS; ++i) {
+			hquark_delete(qrk->shards[i].qrk);
+			free(qrk->shards[i].gids);
+			mutex_destroy(&qrk->shards[i].lock);
+		}
+		for (i = 0; i < NUM_SEGMENTS; ++i) {
+			free((void*)qrk->segments[i]);
+		}
+		mutex_destroy(&qrk->lock);
+		free(qrk);
+	}
+}
+
+int cquark_get(cquark_t* qrk, const char *str)
+{
+	return cquark_get_n(qrk, str, strlen(str));
+}
+
+int cquark_get_n(cquark_t* qrk, const char *str, size_t length)
+{
+	int n, lid, gid = -1;
+	shard_t *shard = get_shard(qrk, str, length);
+
+	mutex_lock(&shard->lock);
+	if (reserve_id(shard) == 0) {
+		n = hquark_num(shard->qrk);
+		lid = hquark_get_n(shard->qrk, str, length);
+		if (lid == n || (0 <= lid && shard->gids[lid] < 0)) {
+			/* A new string, or one whose identifier was not allocated. */
+			gid = assign_id(qrk, shard, lid);
+		}
+		else if (0 <= lid) {
+			gid = shard->gids[lid];
+		}
+	}
+	mutex_unlock(&shard->lock);
+	return gid;
+}
+
+int cquark_to_id(cquark_t* qrk, const char *str)
+{
+	return cquark_to_id_n(qrk, str, strlen(str));
+}
+
+int cquark_to_id_n(cquark_t* qrk, const char *str, size_t length)
+{
+	int lid, gid = -1;
+	shard_t *shard = get_shard(qrk, str, length);
+
+	mutex_lock(&shard->lock);
+	lid = hquark_to_id_n(shard->qrk, str, length);
+	if (0 <= lid) {
+		gid = shard->gids[lid];
+	}
+	mutex_unlock(&shard->lock);
+	return gid;
+}
+
+int cquark_renumber(cquark_t* qrk, const int *map)
+{
+	int i, j, n;
+	const char **strs = NULL;
+
+	mutex_lock(&qrk->lock);
+	n = qrk->num;
+
+	/* Make sure that the map is a permutation of the identifiers. */
+	strs = (const char **)calloc(n + 1, sizeof(const char *));
+	if (strs == NULL) {
+		goto exit;
+	}
+	for (i = 0; i < n; ++i) {
+		if (map[i] < 0 || n <= map[i] || strs[map[i]] != NULL) {
+			goto exit;
+		}
+		strs[map[i]] = qrk->segments[i >> SEGMENT_BITS][i & (SEGMENT_SIZE - 1)];
+	}
+
+	/* Move the strings, then update the identifiers in the shards. */
+	for (i = 0; i < n; ++i) {
+		qrk->segments[i >> SEGMENT_BITS][i & (SEGMENT_SIZE - 1)] = strs[i];
+	}
+	mutex_unlock(&qrk->lock);
+
+	for (i = 0; i < NUM_SHARDS; ++i) {
+		shard_t *shard = &qrk->shards[i];
+		mutex_lock(&shard->lock);
+		for (j = 0; j < hquark_num(shard->qrk); ++j) {
+			if (0 <= shard->gids[j]) {
+				shard->gids[j] = map[shard->gids[j]];
+			}
+		}
+		mutex_unlock(&shard->lock);
+	}
+	free((void*)strs);
+	return 0;
+
+exit:
+	mutex_unlock(&qrk->lock);
+	free((void*)strs);
+	return -1;
+}
+
+const char *cquark_to_string(cquark_t* qrk, int qid)
+{
+	const char *str = NULL;
+
+	mutex_lock(&qrk->lock);
+	if (0 <= qid && qid < qrk->num) {
+		str = qrk->segments[qid >> SEGMENT_BITS][qid & (SEGMENT_SIZE - 1)];
+	}
+	mutex_unlock(&qrk->lock);
+	return str;
+}
+
+int cquark_num(cquark_t* qrk)
+{
+	int num;
+
+	mutex_lock(&qrk->lock);
+	num = qrk->num;
+	mutex_unlock(&qrk->lock);
+	return num;
+}
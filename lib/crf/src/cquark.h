@@ -0,0 +1,59 @@
+/*
+ *      Thread-safe quark object with sharded hash tables.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+ /* $Id$ */
+
+#ifndef    __CQUARK_H__
+#define    __CQUARK_H__
+
+/*
+	The concurrent quark may be shared by threads that intern strings at
+	the same time. It is a dictionary with striped mutexes, not a lock-free
+	one: a look-up of a string locks one of the shards, and a new
+	identifier, cquark_to_string(), and cquark_num() lock the whole quark.
+	Identifiers are dense but depend on the interleaving of the threads;
+	cquark_renumber() reassigns them in a deterministic order once the
+	threads have finished.
+ */
+struct tag_cquark;
+typedef struct tag_cquark cquark_t;
+
+cquark_t* cquark_new();
+void cquark_delete(cquark_t* qrk);
+int cquark_get(cquark_t* qrk, const char *str);
+int cquark_get_n(cquark_t* qrk, const char *str, size_t length);
+int cquark_to_id(cquark_t* qrk, const char *str);
+int cquark_to_id_n(cquark_t* qrk, const char *str, size_t length);
+int cquark_renumber(cquark_t* qrk, const int *map);
+const char *cquark_to_string(cquark_t* qrk, int qid);
+int cquark_num(cquark_t* qrk);
+
+#endif/*__CQUARK_H__*/
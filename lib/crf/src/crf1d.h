@@ -35,6 +35,7 @@
 
 #include <cqdb.h>
 #include <crfsuite.h>
+#include <float.h>
 #include <stdint.h>
 
 #include "crfsuite_internal.h"
@@ -57,6 +58,15 @@ enum {
 	CTXF_ALL = 0xFF,
 };
 
+/**
+ * Default threshold of the size (T * L) of a lattice above which a context
+ * stores the forward and Viterbi scores only at checkpoints.
+ *  @see    crf1d_context_t::checkpoint_threshold.
+ */
+#ifndef    CRF1DC_CHECKPOINT_THRESHOLD
+#define    CRF1DC_CHECKPOINT_THRESHOLD    4194304
+#endif/*CRF1DC_CHECKPOINT_THRESHOLD*/
+
 /**
  * Reset flags.
  *  @see    crf1dc_reset().
@@ -67,6 +77,32 @@ enum {
 	RF_ALL = 0xFF,     /**< Reset all. */
 };
 
+/**
+ * Type of the values stored in a context.
+ *  The scores, forward/backward scores, and marginals of a context are
+ *  computed in single precision when the library is configured with
+ *  --enable-float32 (CRFSUITE_FLOAT32); feature weights, gradients, and
+ *  the normalization factor remain in double precision.
+ */
+#ifdef    CRFSUITE_FLOAT32
+typedef float ctxval_t;
+#define    CTXVAL_MAX    FLT_MAX
+#else
+typedef floatval_t ctxval_t;
+#define    CTXVAL_MAX    FLOAT_MAX
+#endif/*CRFSUITE_FLOAT32*/
+
+/**
+ * Search node of the N-best Viterbi algorithm.
+ */
+typedef struct {
+	floatval_t score;   /**< Score of the best complete path through the node. */
+	int pos;            /**< Position (item, tree node, or segment end) labeled. */
+	int label;          /**< Label (or semi-Markov state) at the position. */
+	int step;           /**< Number of expansions from the start of the search. */
+	int prev;           /**< Index of the node expanded into this node (-1 if none). */
+} crf1dc_nbest_node_t;
+
 /**
  * Context structure.
  *  This structure maintains internal data for an instance.
@@ -97,6 +133,30 @@ typedef struct {
 	 */
 	int cap_items;
 
+	/**
+	 * The number of rows allocated for alpha_score, beta_score, and
+	 * backward_edge (and child_alpha_score and backward_end).
+	 */
+	int cap_rows;
+
+	/**
+	 * Threshold of the size (T * L) of a lattice for checkpointing.
+	 *  A context for a 1st-order chain with more than this number of cells
+	 *  stores the alpha (and Viterbi) scores only at every #checkpoint
+	 *  items and recomputes the scores of a segment on the backward pass;
+	 *  zero disables checkpointing.
+	 */
+	int checkpoint_threshold;
+
+	/**
+	 * Interval of checkpoints for the current instance (0 if disabled).
+	 *  With checkpointing, the rows [0, C) of alpha_score store the scores
+	 *  at the items #0, #K, #2K, ... (C = ceil(T / K)), the rows [C, C+K)
+	 *  are the work space for a segment of K items, backward_edge stores
+	 *  the back pointers of a segment, and beta_score stores two rows.
+	 */
+	int checkpoint;
+
 	/**
 	 * Logarithm of the normalization factor for the instance.
 	 *  This is equivalent to the total scores of all paths in the lattice.
@@ -108,49 +168,53 @@ typedef struct {
 	 *  This is a [T][L] matrix whose element [t][l] presents total score
 	 *  of state features associating label #l at #t.
 	 */
-	floatval_t *state;
+	ctxval_t *state;
 
 	/**
 	 * Transition scores.
 	 *  This is a [L][L] matrix whose element [i][j] represents the total
 	 *  score of transition features associating labels #i and #j.
 	 */
-	floatval_t *trans;
+	ctxval_t *trans;
 
 	/**
 	 * Alpha score matrix.
 	 *  This is a [T][L] matrix whose element [t][l] presents the total
 	 *  score of paths starting at BOS and arriving at (t, l).
 	 */
-	floatval_t *alpha_score;
+	ctxval_t *alpha_score;
 
 	/**
 	 * Unnormalized alpha score propagated from child to parent.
 	 *
 	 *  This is a [T][L] matrix whose element [t][l] presents the unscaled alpha
 	 *  score that child t propagates to its parent.
+	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *child_alpha_score;
+	ctxval_t *child_alpha_score;
 
 	/**
 	 * Beta score matrix.
 	 *  This is a [T][L] matrix whose element [t][l] presents the total
 	 *  score of paths starting at (t, l) and arriving at EOS.
+	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *beta_score;
+	ctxval_t *beta_score;
 
 	/**
 	 * Scale factor vector.
 	 *  This is a [T] vector whose element [t] presents the scaling
 	 *  coefficient for the alpha_score and beta_score.
+	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *scale_factor;
+	ctxval_t *scale_factor;
 
 	/**
 	 * Row vector (work space).
 	 *  This is a [L] vector used internally for a work space.
+	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *row;
+	ctxval_t *row;
 
 	/**
 	 * Backward edges.
@@ -184,7 +248,7 @@ typedef struct {
 	 *  of the total score of state features associating label #l at #t.
 	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *exp_state;
+	ctxval_t *exp_state;
 
 	/**
 	 * Exponents of transition scores.
@@ -192,7 +256,7 @@ typedef struct {
 	 *  of the total score of transition features associating labels #i and #j.
 	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *exp_trans;
+	ctxval_t *exp_trans;
 
 	/**
 	 * Model expectations of states.
@@ -200,7 +264,7 @@ typedef struct {
 	 *  expectation (marginal probability) of the state (t,l)
 	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *mexp_state;
+	ctxval_t *mexp_state;
 
 	/**
 	 * Model expectations of transitions.
@@ -208,7 +272,26 @@ typedef struct {
 	 *  expectation of the transition (i--j).
 	 *  This member is available only with CTXF_MARGINALS flag.
 	 */
-	floatval_t *mexp_trans;
+	ctxval_t *mexp_trans;
+
+	/**
+	 * Search nodes of the N-best Viterbi algorithm.
+	 *  This is a pool of #cap_nbest nodes, which is kept by the context to
+	 *  be reused by subsequent searches.
+	 */
+	crf1dc_nbest_node_t *nbest_nodes;
+
+	/**
+	 * Priority queue of the N-best Viterbi algorithm.
+	 *  This is a binary heap of #cap_nbest indices of the search nodes.
+	 */
+	int *nbest_queue;
+
+	/**
+	 * The numbers of the search nodes and queued nodes in the current
+	 * search, and the capacity of nbest_nodes and nbest_queue.
+	 */
+	int num_nbest_nodes, num_nbest_queue, cap_nbest;
 
 } crf1d_context_t;
 
@@ -283,9 +366,18 @@ floatval_t crf1dc_sm_marginal_path(crf1d_context_t *ctx, const int *path, \
 floatval_t crf1dc_lognorm(crf1d_context_t* ctx);
 
 floatval_t crf1dc_viterbi(crf1d_context_t* ctx, int *labels, const void *a_aux);
+void crf1dc_viterbi_step(crf1d_context_t* ctx, ctxval_t *cur, const ctxval_t *prev, \
+	int *back, int t);
 floatval_t crf1dc_tree_viterbi(crf1d_context_t* ctx, int *labels, const void *a_aux);
 floatval_t crf1dc_sm_viterbi(crf1d_context_t* ctx, int *labels, const void *a_aux);
 
+int crf1dc_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux);
+int crf1dc_tree_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux);
+int crf1dc_sm_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux);
+
 void crf1dc_debug_context(FILE *fp);
 void crf1dc_debug_tree_context(FILE *fp);
 void crf1dc_debug_sm_context(FILE *fp);
@@ -316,6 +408,13 @@ typedef struct {
 	int         feature_possible_transitions; /** Dense transition features. */
 	int         feature_max_seg_len; /** Maximum length of segments having same tag. */
 	int         feature_max_order; /** Maximum order of transition features. */
+	int         feature_threads; /** Number of threads for counting features. */
+	int         model_quantize; /** Bits of quantized weights in the model file (0, 8, or 16). */
+	floatval_t  model_prune_threshold; /** Threshold of absolute weights of stored features. */
+	int         model_prune_topk; /** Maximum number of state features per attribute. */
+	int         model_prune_size; /** Target size of the model file in bytes. */
+	int         model_format; /** Format of the model file (1 or 2). */
+	int         context_checkpoint; /** Lattice size (T * L) above which contexts use checkpoints. */
 } crf1de_option_t;
 
 /**
@@ -369,6 +468,37 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 	const crfsuite_logging_callback func, \
 	void *instance);
 
+/**
+ * Count the features in each group of a data set for cross validation.
+ *  @return             The feature counts, or NULL for the semi-markov
+ *                      model (whose features depend on the whole training
+ *                      set) and on an error.
+ */
+crf1df_groups_t* crf1df_count_groups(const crf1de_option_t *opt, \
+	crfsuite_data_t *data, \
+	const int num_groups, \
+	const int ftype, \
+	const int num_labels, \
+	const crfsuite_logging_callback func, \
+	void *instance);
+
+/**
+ * Obtain the number of features of the fold that holds out a group.
+ */
+int crf1df_groups_num_features(const crf1df_groups_t *groups, int holdout);
+
+/**
+ * Generate the features of the fold that holds out a group.
+ *  The features are identical to those crf1df_generate() yields for the
+ *  training set of the fold.
+ */
+crf1df_feature_t* crf1df_generate_fold(int *ptr_num_features, \
+	int *max_items, \
+	const crf1df_groups_t *groups, \
+	const int holdout);
+
+void crf1df_delete_groups(crf1df_groups_t *groups);
+
 int crf1df_init_references(feature_refs_t **ptr_attributes, \
 	feature_refs_t **ptr_trans, \
 	const crf1df_feature_t *features, \
@@ -388,25 +518,26 @@ int crf1df_init_references(feature_refs_t **ptr_attributes, \
 
 typedef struct {
 	uint8_t     magic[4];       /* File magic. */
-	uint32_t    size;           /* File size. */
+	uint64_t    size;           /* File size. */
 	uint8_t     type[4];        /* Model type */
 	uint32_t    version;        /* Version number. */
 	uint32_t    num_features;   /* Number of features. */
 	uint32_t    num_labels;     /* Number of labels. */
 	uint32_t    num_attrs;      /* Number of attributes. */
-	uint32_t    off_features;   /* Offset to features. */
-	uint32_t    off_labels;     /* Offset to label CQDB. */
-	uint32_t    off_attrs;      /* Offset to attribute CQDB. */
-	uint32_t    off_labelrefs;  /* Offset to label feature references. */
-	uint32_t    off_attrrefs;   /* Offset to attribute feature references. */
-	uint32_t    off_sm;	      /* Offset to semi-markov data. */
+	uint64_t    off_features;   /* Offset to features. */
+	uint64_t    off_labels;     /* Offset to label CQDB. */
+	uint64_t    off_attrs;      /* Offset to attribute CQDB. */
+	uint64_t    off_labelrefs;  /* Offset to label feature references. */
+	uint64_t    off_attrrefs;   /* Offset to attribute feature references. */
+	uint64_t    off_sm;	      /* Offset to semi-markov data. */
+	uint32_t    byteorder;      /* Byte-order mark (formats 2 and 3). */
 } header_t;
 
 typedef struct {
 	uint8_t     chunk[4];       /* Chunk id */
 	uint32_t    size;           /* Chunk size. */
 	uint32_t    num;            /* Number of items. */
-	uint32_t    offsets[1];     /* Offsets. */
+	uint64_t    offsets[1];     /* Offsets. */
 } featureref_header_t;
 
 typedef struct {
@@ -415,8 +546,17 @@ typedef struct {
 	uint32_t    num;            /* Number of items. */
 } feature_header_t;
 
-/* After changing size of this struct, update macro `HSM_CHUNK_SIZE` in
-   `crf1d_model.c` */
+/* A feature in the format 2, stored in the native byte order. */
+typedef struct {
+	uint32_t    type;           /* Feature type. */
+	uint32_t    src;            /* Source attribute or label. */
+	uint32_t    dst;            /* Destination label. */
+	uint32_t    reserved;       /* Padding for the alignment of the weight. */
+	double      weight;         /* Feature weight. */
+} native_feature_t;
+
+/* After changing size of this struct, update macros `HSM_CHUNK_SIZE` and
+   `HSM_CHUNK_SIZE3` in `crf1d_model.c` */
 typedef struct {
 	uint8_t     chunk[4];       /* Chunk id */
 	uint32_t    max_order;      /* Maximum order. */
@@ -425,20 +565,29 @@ typedef struct {
 	uint32_t    num_bkw_states; /* Number of transitions associated with each state. */
 	uint32_t    num_suffixes;   /* Total number of suffixes. */
 
-	uint32_t    off_max_seg_len; /* Offset of the array holding maximum segment
+	uint64_t    off_max_seg_len; /* Offset of the array holding maximum segment
 					lengths of the labels. */
-	uint32_t    off_suffixes;	/* Offset of the array with suffixes. */
-	uint32_t    off_states[1];	/* Offset of the array of states. */
+	uint64_t    off_suffixes;	/* Offset of the array with suffixes. */
+	uint64_t    off_states[1];	/* Offset of the array of states. */
 } sm_header_t;
 
 struct tag_crf1dm {
 	uint8_t*    buffer_orig;
 	uint8_t*    buffer;
-	uint32_t    size;
+	size_t      size;
 	header_t*   header;
 	cqdb_t*     labels;
 	cqdb_t*     attrs;
 	crf1de_semimarkov_t *sm;	/**< Data of semi-markov model. */
+	int         qbits;          /**< Bits of quantized weights (0 if not quantized). */
+	floatval_t* qscales;        /**< Scales of quantized weights for labels. */
+	uint64_t    off_qfeatures;  /**< Offset to quantized features. */
+	int         native;         /**< Nonzero for the formats 2 and 3. */
+	const native_feature_t* features;   /**< Features (formats 2 and 3). */
+	const uint32_t* labelrefs;  /**< Offsets to label references (format 2 only). */
+	const uint32_t* attrrefs;   /**< Offsets to attribute references (format 2 only). */
+	const uint64_t* labelrefs64;    /**< Offsets to label references (format 3 only). */
+	const uint64_t* attrrefs64;     /**< Offsets to attribute references (format 3 only). */
 };
 typedef struct tag_crf1dm crf1dm_t;
 
@@ -450,6 +599,11 @@ struct tag_crf1dmw {
 	featureref_header_t* href;
 	feature_header_t* hfeat;
 	sm_header_t* hsm;
+	int qbits;
+	floatval_t* qscales;
+	int num_qscales;
+	int native;
+	int wide;
 };
 typedef struct tag_crf1dmw crf1dmw_t;
 
@@ -460,7 +614,7 @@ typedef struct {
 	floatval_t weight;
 } crf1dm_feature_t;
 
-crf1dmw_t* crf1mmw(const char *filename, const int ftype);
+crf1dmw_t* crf1mmw(const char *filename, const int ftype, const int format);
 int crf1dmw_close(crf1dmw_t* writer);
 int crf1dmw_open_labels(crf1dmw_t* writer, int num_labels);
 int crf1dmw_close_labels(crf1dmw_t* writer);
@@ -477,6 +631,12 @@ int crf1dmw_put_attrref(crf1dmw_t* writer, int aid, const feature_refs_t* ref, i
 int crf1dmw_open_features(crf1dmw_t* writer);
 int crf1dmw_close_features(crf1dmw_t* writer);
 int crf1dmw_put_feature(crf1dmw_t* writer, int fid, const crf1dm_feature_t* f);
+int crf1dmw_set_quantization(crf1dmw_t* writer, int bits, const floatval_t *scales, int num_scales);
+int crf1dm_quantize(floatval_t weight, floatval_t scale, int bits);
+size_t crf1dm_feature_size(int format, int bits);
+size_t crf1dm_base_size(int format, int bits, int num_labels);
+size_t crf1dm_string_size(int format, size_t length);
+size_t crf1dm_sm_size(int format, const crf1de_semimarkov_t *sm);
 int crf1dmw_open_sm(crf1dmw_t* writer, const crf1de_semimarkov_t* a_sm);
 int crf1dmw_close_sm(crf1dmw_t* writer);
 int crf1dmw_put_sm_state(crf1dmw_t* writer, int sid, const crf1de_state_t *state, \
@@ -490,11 +650,14 @@ int crf1dm_get_num_labels(crf1dm_t* model);
 const char *crf1dm_to_label(crf1dm_t* model, int lid);
 int crf1dm_to_lid(crf1dm_t* model, const char *value);
 int crf1dm_to_aid(crf1dm_t* model, const char *value);
+int crf1dm_to_lid_n(crf1dm_t* model, const char *value, size_t length);
+int crf1dm_to_aid_n(crf1dm_t* model, const char *value, size_t length);
 const char *crf1dm_to_attr(crf1dm_t* model, int aid);
 int crf1dm_get_labelref(crf1dm_t* model, int lid, feature_refs_t* ref);
 int crf1dm_get_attrref(crf1dm_t* model, int aid, feature_refs_t* ref);
-int crf1dm_get_featureid(feature_refs_t* ref, int i);
+int crf1dm_get_featureid(crf1dm_t* model, feature_refs_t* ref, int i);
 int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f);
+int crf1dm_get_qfeature(crf1dm_t* model, int fid, int *dst, int *qweight);
 void crf1dm_dump(crf1dm_t* model, FILE *fp);
 
 /** @} */
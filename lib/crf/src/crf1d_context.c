@@ -47,6 +47,22 @@
 #include "crf1d.h"
 #include "vecmath.h"
 
+#ifdef    CRFSUITE_FLOAT32
+/* Use the single-precision routines for the values in contexts. */
+#define    veczero       veczerof
+#define    vecset        vecsetf
+#define    veccopy       veccopyf
+#define    vecadd        vecaddf
+#define    vecaadd       vecaaddf
+#define    vecmul        vecmulf
+#define    vecinv        vecinvf
+#define    vecscale      vecscalef
+#define    vecdot        vecdotf
+#define    vecsum        vecsumf
+#define    vecsumlog     vecsumlogf
+#define    vecexp        vecexpf
+#endif/*CRFSUITE_FLOAT32*/
+
 crf1d_context_t* crf1dc_new(int flag, const int ftype, int L, int T, const crf1de_semimarkov_t *sm)
 {
 	int ret = 0;
@@ -60,14 +76,15 @@ crf1d_context_t* crf1dc_new(int flag, const int ftype, int L, int T, const crf1d
 	ctx->ftype = ftype;
 	ctx->flag = flag;
 	ctx->num_labels = L;
+	ctx->checkpoint_threshold = CRF1DC_CHECKPOINT_THRESHOLD;
 
-	ctx->trans = (floatval_t*)calloc(n_src_tags * L, sizeof(floatval_t));
+	ctx->trans = (ctxval_t*)calloc(n_src_tags * L, sizeof(ctxval_t));
 	if (ctx->trans == NULL) goto error_exit;
 
 	if (ctx->flag & CTXF_MARGINALS) {
-		ctx->exp_trans = (floatval_t*)_aligned_malloc((n_src_tags * L + 4) * sizeof(floatval_t), 16);
+		ctx->exp_trans = (ctxval_t*)_aligned_malloc((n_src_tags * L + 4) * sizeof(ctxval_t), 16);
 		if (ctx->exp_trans == NULL) goto error_exit;
-		ctx->mexp_trans = (floatval_t*)calloc(n_src_tags * L, sizeof(floatval_t));
+		ctx->mexp_trans = (ctxval_t*)calloc(n_src_tags * L, sizeof(ctxval_t));
 		if (ctx->mexp_trans == NULL) goto error_exit;
 	}
 
@@ -86,65 +103,85 @@ error_exit:
 
 int crf1dc_set_num_items(crf1d_context_t* ctx, const crf1de_semimarkov_t *sm, const int T)
 {
+	int K = 0, rows = T;
 	const int L = ctx->num_labels;
 
 	ctx->num_items = T;
 
+	/* transition feature vectors will look differently for semimarkov model */
+	int n_alpha_states = L, n_beta_states = L;
+	if (ctx->ftype == FTYPE_SEMIMCRF) {
+		n_alpha_states = sm->m_num_frw;
+		n_beta_states = sm->m_num_bkw;
+	}
+
+	/* Store alpha scores at every K items of a long 1st-order chain. */
+	if (0 < ctx->checkpoint_threshold &&
+		ctx->ftype != FTYPE_CRF1TREE && ctx->ftype != FTYPE_SEMIMCRF &&
+		(double)ctx->checkpoint_threshold < (double)T * L) {
+		K = (int)ceil(sqrt((double)T));
+		if (K < 2) K = 2;
+		rows = (T + K - 1) / K + K;
+	}
+	ctx->checkpoint = K;
+
 	if (ctx->cap_items < T) {
-		free(ctx->backward_edge);
-		free(ctx->backward_end);
 		free(ctx->mexp_state);
 		_aligned_free(ctx->exp_state);
+		free(ctx->state);
 		free(ctx->scale_factor);
+
+		if (ctx->flag & CTXF_MARGINALS) {
+			ctx->scale_factor = (ctxval_t*)calloc(T, sizeof(ctxval_t));
+			if (ctx->scale_factor == NULL) return CRFSUITEERR_OUTOFMEMORY;
+		}
+
+		ctx->state = (ctxval_t*)calloc((size_t)T * L, sizeof(ctxval_t));
+		if (ctx->state == NULL) return CRFSUITEERR_OUTOFMEMORY;
+
+		if (ctx->flag & CTXF_MARGINALS) {
+			ctx->exp_state = (ctxval_t*)_aligned_malloc(((size_t)T * L + 4) * sizeof(ctxval_t), 16);
+			if (ctx->exp_state == NULL) return CRFSUITEERR_OUTOFMEMORY;
+			ctx->mexp_state = (ctxval_t*)calloc((size_t)T * L, sizeof(ctxval_t));
+			if (ctx->mexp_state == NULL) return CRFSUITEERR_OUTOFMEMORY;
+		}
+		ctx->cap_items = T;
+	}
+
+	if (ctx->cap_rows < rows) {
+		free(ctx->backward_edge);
+		free(ctx->backward_end);
 		free(ctx->row);
 		free(ctx->beta_score);
 		free(ctx->alpha_score);
 		free(ctx->child_alpha_score);
 
-		/* transition feature vectors will look differently for semimarkov model */
-		int n_alpha_states = L, n_beta_states = L;
-		if (ctx->ftype == FTYPE_SEMIMCRF) {
-			n_alpha_states = sm->m_num_frw;
-			n_beta_states = sm->m_num_bkw;
-		}
-
-		ctx->alpha_score = (floatval_t*)calloc(T * n_alpha_states, sizeof(floatval_t));
+		ctx->alpha_score = (ctxval_t*)calloc((size_t)rows * n_alpha_states, sizeof(ctxval_t));
 		if (ctx->alpha_score == NULL) return CRFSUITEERR_OUTOFMEMORY;
 
-		ctx->beta_score = (floatval_t*)calloc(T * n_beta_states, sizeof(floatval_t));
-		if (ctx->beta_score == NULL) return CRFSUITEERR_OUTOFMEMORY;
+		if (ctx->flag & CTXF_MARGINALS) {
+			ctx->beta_score = (ctxval_t*)calloc((size_t)rows * n_beta_states, sizeof(ctxval_t));
+			if (ctx->beta_score == NULL) return CRFSUITEERR_OUTOFMEMORY;
 
-		ctx->row = (floatval_t*)calloc(n_beta_states, sizeof(floatval_t));
-		if (ctx->row == NULL) return CRFSUITEERR_OUTOFMEMORY;
+			ctx->row = (ctxval_t*)calloc(n_beta_states, sizeof(ctxval_t));
+			if (ctx->row == NULL) return CRFSUITEERR_OUTOFMEMORY;
 
-		if (ctx->ftype == FTYPE_CRF1TREE) {
-			ctx->child_alpha_score = (floatval_t*)calloc(T * n_alpha_states, sizeof(floatval_t));
-			if (ctx->child_alpha_score == NULL) return CRFSUITEERR_OUTOFMEMORY;
+			if (ctx->ftype == FTYPE_CRF1TREE) {
+				ctx->child_alpha_score = (ctxval_t*)calloc((size_t)rows * n_alpha_states, sizeof(ctxval_t));
+				if (ctx->child_alpha_score == NULL) return CRFSUITEERR_OUTOFMEMORY;
+			}
 		}
 
 		if (ctx->flag & CTXF_VITERBI) {
-			ctx->backward_edge = (int*)calloc(T * n_alpha_states, sizeof(int));
+			ctx->backward_edge = (int*)calloc((size_t)rows * n_alpha_states, sizeof(int));
 			if (ctx->backward_edge == NULL) return CRFSUITEERR_OUTOFMEMORY;
 
 			if (ctx->ftype == FTYPE_SEMIMCRF) {
-				ctx->backward_end = (int*)calloc(T * n_alpha_states, sizeof(int));
+				ctx->backward_end = (int*)calloc((size_t)rows * n_alpha_states, sizeof(int));
 				if (ctx->backward_end == NULL) return CRFSUITEERR_OUTOFMEMORY;
 			}
 		}
-
-		ctx->scale_factor = (floatval_t*)calloc(T, sizeof(floatval_t));
-		if (ctx->scale_factor == NULL) return CRFSUITEERR_OUTOFMEMORY;
-
-		ctx->state = (floatval_t*)calloc(T * L, sizeof(floatval_t));
-		if (ctx->state == NULL) return CRFSUITEERR_OUTOFMEMORY;
-
-		if (ctx->flag & CTXF_MARGINALS) {
-			ctx->exp_state = (floatval_t*)_aligned_malloc((T * L + 4) * sizeof(floatval_t), 16);
-			if (ctx->exp_state == NULL) return CRFSUITEERR_OUTOFMEMORY;
-			ctx->mexp_state = (floatval_t*)calloc(T * L, sizeof(floatval_t));
-			if (ctx->mexp_state == NULL) return CRFSUITEERR_OUTOFMEMORY;
-		}
-		ctx->cap_items = T;
+		ctx->cap_rows = rows;
 	}
 	return 0;
 }
@@ -152,6 +189,8 @@ int crf1dc_set_num_items(crf1d_context_t* ctx, const crf1de_semimarkov_t *sm, co
 void crf1dc_delete(crf1d_context_t* ctx)
 {
 	if (ctx != NULL) {
+		free(ctx->nbest_queue);
+		free(ctx->nbest_nodes);
 		free(ctx->backward_edge);
 		free(ctx->backward_end);
 		free(ctx->mexp_state);
@@ -213,35 +252,26 @@ void crf1dc_exp_transition(crf1d_context_t* ctx, const crf1de_semimarkov_t *sm)
 	}
 }
 
-void crf1dc_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
+/*
+ * Compute the scaled alpha scores at #t (cur) from those at #t-1 (prev);
+ * prev is NULL for the first item. The scale factor at #t is also set.
+ */
+static void crf1dc_alpha_step(crf1d_context_t* a_ctx, ctxval_t *cur, const ctxval_t *prev, int t)
 {
-	int i, t;
-	floatval_t sum, *cur = NULL, *scale = &a_ctx->scale_factor[0];
-	const floatval_t *prev = NULL, *trans = NULL, *state = NULL;
-	const int T = a_ctx->num_items;
+	int i;
+	floatval_t sum;
+	ctxval_t *scale = &a_ctx->scale_factor[t];
+	const ctxval_t *trans = NULL;
+	const ctxval_t *state = EXP_STATE_SCORE(a_ctx, t);
 	const int L = a_ctx->num_labels;
-	/* Compute alpha scores on leaves (0, *).
-	   alpha[0][j] = state[0][j]
-	*/
-	cur = ALPHA_SCORE(a_ctx, 0);
-	state = EXP_STATE_SCORE(a_ctx, 0);
-	// copy L elements from state to current
-	veccopy(cur, state, L);
-	// total sum of L elements in vector
-	sum = vecsum(cur, L);
-	*scale = (sum != 0.) ? 1. / sum : 1.;
-	// multiply L elements in cur by scale factor (i.e. normalize weights)
-	vecscale(cur, *scale, L);
-	++scale;
-
-	/* Compute the alpha scores on nodes (t, *).
-	   alpha[t][j] = state[t][j] * \sum_{i} alpha[t-1][i] * trans[i][j]
-	*/
-	for (t = 1; t < T; ++t) {
-		prev = ALPHA_SCORE(a_ctx, t - 1);
-		cur = ALPHA_SCORE(a_ctx, t);
-		state = EXP_STATE_SCORE(a_ctx, t);
 
+	if (prev == NULL) {
+		/* alpha[0][j] = state[0][j] */
+		// copy L elements from state to current
+		veccopy(cur, state, L);
+	}
+	else {
+		/* alpha[t][j] = state[t][j] * \sum_{i} alpha[t-1][i] * trans[i][j] */
 		veczero(cur, L);
 		for (i = 0; i < L; ++i) {
 			trans = EXP_TRANS_SCORE(a_ctx, i);
@@ -251,11 +281,65 @@ void crf1dc_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
 		}
 		// memberwise multiplication of values in cur and values in state
 		vecmul(cur, state, L);
-		sum = vecsum(cur, L);
-		*scale = (sum != 0.) ? 1. / sum : 1.;
-		// normalize weights
-		vecscale(cur, *scale, L);
-		++scale;
+	}
+	// total sum of L elements in vector
+	sum = vecsum(cur, L);
+	*scale = (sum != 0.) ? 1. / sum : 1.;
+	// multiply L elements in cur by scale factor (i.e. normalize weights)
+	vecscale(cur, *scale, L);
+}
+
+/*
+ * Recompute the alpha scores at #cK, ..., #end-1 into the work space of a
+ * checkpointed context, starting from the checkpoint #c.
+ */
+static void crf1dc_alpha_segment(crf1d_context_t* a_ctx, int c, int end)
+{
+	int t;
+	ctxval_t *cur = NULL, *prev = NULL;
+	const int T = a_ctx->num_items;
+	const int L = a_ctx->num_labels;
+	const int K = a_ctx->checkpoint;
+	const int C = (T + K - 1) / K;
+
+	cur = ALPHA_SCORE(a_ctx, C);
+	veccopy(cur, ALPHA_SCORE(a_ctx, c), L);
+	for (t = c * K + 1; t < end; ++t) {
+		prev = cur;
+		cur = ALPHA_SCORE(a_ctx, C + t - c * K);
+		crf1dc_alpha_step(a_ctx, cur, prev, t);
+	}
+}
+
+void crf1dc_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
+{
+	int t;
+	ctxval_t *cur = NULL, *prev = NULL;
+	const int T = a_ctx->num_items;
+	const int L = a_ctx->num_labels;
+	const int K = a_ctx->checkpoint;
+
+	if (K) {
+		/* Keep the alpha scores only at the checkpoints #0, #K, #2K, ...;
+		   the other scores are recomputed from them on the backward pass. */
+		const int C = (T + K - 1) / K;
+		for (t = 0; t < T; ++t) {
+			cur = ALPHA_SCORE(a_ctx, C + t % K);
+			crf1dc_alpha_step(a_ctx, cur, prev, t);
+			if (t % K == 0) {
+				veccopy(ALPHA_SCORE(a_ctx, t / K), cur, L);
+			}
+			prev = cur;
+		}
+	}
+	else {
+		/* Compute alpha scores on leaves (0, *). */
+		crf1dc_alpha_step(a_ctx, ALPHA_SCORE(a_ctx, 0), NULL, 0);
+
+		/* Compute the alpha scores on nodes (t, *). */
+		for (t = 1; t < T; ++t) {
+			crf1dc_alpha_step(a_ctx, ALPHA_SCORE(a_ctx, t), ALPHA_SCORE(a_ctx, t - 1), t);
+		}
 	}
 
 	/* Compute the logarithm of the normalization factor here.
@@ -282,11 +366,12 @@ void crf1dc_tree_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
 
 	int i, c, t;
 	int item_id, chld_item_id;
-	floatval_t sum, *crnt_alpha, *chld_alpha, *chld_alpha_score;
-	floatval_t *scale, *row = a_ctx->row;
+	floatval_t sum;
+	ctxval_t *crnt_alpha, *chld_alpha, *chld_alpha_score;
+	ctxval_t *scale, *row = a_ctx->row;
 	const int T = a_ctx->num_items;
 	const int L = a_ctx->num_labels;
-	const floatval_t *trans, *state;
+	const ctxval_t *trans, *state;
 	const crfsuite_node_t *node, *child;
 
 	/* Since nodes in the tree are ordered topologically, we start at
@@ -373,9 +458,9 @@ void crf1dc_sm_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
 	/* Compute alpha scores on leaves (0, *).
 	   alpha[0][j] = state[0][j]
 	*/
-	const floatval_t *state_score = STATE_SCORE(a_ctx, 0);
-	floatval_t *cur = SM_ALPHA_SCORE(a_ctx, sm, 0);
-	vecset(cur, -FLOAT_MAX, sm->m_num_frw);
+	const ctxval_t *state_score = STATE_SCORE(a_ctx, 0);
+	ctxval_t *cur = SM_ALPHA_SCORE(a_ctx, sm, 0);
+	vecset(cur, -CTXVAL_MAX, sm->m_num_frw);
 
 	int j, y;
 	crf1de_state_t *frw_state = NULL;
@@ -394,14 +479,14 @@ void crf1dc_sm_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
 	   alpha[t][j] = \sum_{s = t}^{s - max_seg_len[j]} \prod_{s}^{t} state[s][j] * \
 	   \sum_{i \in j's prefixes} alpha[s-1][i] * trans[i][j]
 	*/
-	const floatval_t *prev = NULL;
+	const ctxval_t *prev = NULL;
 	floatval_t state = 0., trans = 0.;
 	const int *frw_trans1 = NULL, *frw_trans2 = NULL, *suffixes;
 	int i, k, seg_start, min_seg_start, prev_seg_end, prev_id1, prev_id2, sfx_id, pk_id;
 
 	for (int t = 1; t < T; ++t) {
 		cur = SM_ALPHA_SCORE(a_ctx, sm, t);
-		vecset(cur, -FLOAT_MAX, sm->m_num_frw);
+		vecset(cur, -CTXVAL_MAX, sm->m_num_frw);
 
 		for (j = 0; j < sm->m_num_frw; ++j) {
 			/* obtain semi-markov state, corresponding to #i-th index */
@@ -459,12 +544,17 @@ void crf1dc_sm_alpha_score(crf1d_context_t* a_ctx, const void *a_aux)
 void crf1dc_beta_score(crf1d_context_t* a_ctx, const void *a_aux)
 {
 	int i, t;
-	floatval_t *cur = NULL;
-	floatval_t *row = a_ctx->row;
-	const floatval_t *next = NULL, *state = NULL, *trans = NULL;
+	ctxval_t *cur = NULL;
+	ctxval_t *row = a_ctx->row;
+	const ctxval_t *next = NULL, *state = NULL, *trans = NULL;
 	const int T = a_ctx->num_items;
 	const int L = a_ctx->num_labels;
-	const floatval_t *scale = &a_ctx->scale_factor[T - 1];
+	const ctxval_t *scale = &a_ctx->scale_factor[T - 1];
+
+	/* A checkpointed context computes beta scores with marginals. */
+	if (a_ctx->checkpoint) {
+		return;
+	}
 
 	/* Compute the beta scores at (T-1, *). */
 	cur = BETA_SCORE(a_ctx, T - 1);
@@ -506,9 +596,9 @@ void crf1dc_tree_beta_score(crf1d_context_t* a_ctx, const void *a_aux)
 	int i, t;
 	int item_id, prnt_item_id;
 	floatval_t prnt_scale;
-	floatval_t *crnt_beta, *row = a_ctx->row;
-	const floatval_t *prnt_alpha, *prnt_beta, *prnt_state;
-	const floatval_t *chld_alpha_score, *scale, *trans;
+	ctxval_t *crnt_beta, *row = a_ctx->row;
+	const ctxval_t *prnt_alpha, *prnt_beta, *prnt_state;
+	const ctxval_t *chld_alpha_score, *scale, *trans;
 	const crfsuite_node_t *node, *prnt_node;
 	const int T = a_ctx->num_items;
 	const int L = a_ctx->num_labels;
@@ -573,18 +663,18 @@ void crf1dc_sm_beta_score(crf1d_context_t* a_ctx, const void *a_aux)
 	const int T = a_ctx->num_items;
 	const crf1de_semimarkov_t *sm = (const crf1de_semimarkov_t *)a_aux;
 
-	const floatval_t *nxt = NULL;
+	const ctxval_t *nxt = NULL;
 	floatval_t state_score = 0., trans_score = 0.;
 
 	/* Compute beta score at nodes (t, *). */
 	int j, y, pk_id, frw_id, pky_id, sfx_id, sfx_len;
 	int llabel, seg_end, max_seg_end;
 	const int *suffixes = NULL, *bkw_trans = NULL;
-	floatval_t *cur = SM_BETA_SCORE(a_ctx, sm, T - 1);
+	ctxval_t *cur = SM_BETA_SCORE(a_ctx, sm, T - 1);
 
 	for (int t = T - 1; 0 < t; --t) {
 		cur = SM_BETA_SCORE(a_ctx, sm, t);
-		vecset(cur, -FLOAT_MAX, sm->m_num_bkw);
+		vecset(cur, -CTXVAL_MAX, sm->m_num_bkw);
 
 		for (y = 0; y < sm->L; ++y) {
 			max_seg_end = t + sm->m_max_seg_len[y];
@@ -627,21 +717,109 @@ void crf1dc_sm_beta_score(crf1d_context_t* a_ctx, const void *a_aux)
 	}
 }
 
+/*
+ * Compute the beta scores and the marginal probabilities of a checkpointed
+ * context in a single backward pass. The alpha scores of each segment are
+ * recomputed from its checkpoint, and the beta scores at #t and #t+1 are
+ * kept in the rows (t % 2) and ((t+1) % 2) of beta_score.
+ */
+static void crf1dc_checkpoint_marginals(crf1d_context_t* a_ctx)
+{
+	int c, i, j, t;
+	ctxval_t *row = a_ctx->row;
+	const int T = a_ctx->num_items;
+	const int L = a_ctx->num_labels;
+	const int K = a_ctx->checkpoint;
+	const int C = (T + K - 1) / K;
+
+	for (c = C - 1; 0 <= c; --c) {
+		const int s = c * K;
+		const int e = (s + K < T) ? s + K : T;
+		crf1dc_alpha_segment(a_ctx, c, e);
+
+		for (t = e - 1; s <= t; --t) {
+			ctxval_t *fwd = ALPHA_SCORE(a_ctx, C + t - s);
+			ctxval_t *bwd = BETA_SCORE(a_ctx, t % 2);
+			ctxval_t *prob = STATE_MEXP(a_ctx, t);
+
+			if (t == T - 1) {
+				vecset(bwd, a_ctx->scale_factor[t], L);
+			}
+			else {
+				const ctxval_t *next = BETA_SCORE(a_ctx, (t + 1) % 2);
+				const ctxval_t *state = EXP_STATE_SCORE(a_ctx, t + 1);
+
+				/* row[j] = state[t+1][j] * bwd'[t+1][j] */
+				veccopy(row, next, L);
+				vecmul(row, state, L);
+
+				/* Compute bwd'[t][i] and accumulate p(t,i,t+1,j). */
+				for (i = 0; i < L; ++i) {
+					ctxval_t *edge = EXP_TRANS_SCORE(a_ctx, i);
+					ctxval_t *mexp = TRANS_MEXP(a_ctx, i);
+					bwd[i] = vecdot(edge, row, L);
+					for (j = 0; j < L; ++j) {
+						mexp[j] += fwd[i] * edge[j] * row[j];
+					}
+				}
+				vecscale(bwd, a_ctx->scale_factor[t], L);
+			}
+
+			/* p(t,i) = (1. / C[t]) * fwd'[t][i] * bwd'[t][i] */
+			veccopy(prob, fwd, L);
+			vecmul(prob, bwd, L);
+			vecscale(prob, 1. / a_ctx->scale_factor[t], L);
+		}
+	}
+}
+
+/*
+ * Recompute the beta scores at #t of a checkpointed context.
+ */
+static const ctxval_t* crf1dc_checkpoint_beta(crf1d_context_t* a_ctx, int t)
+{
+	int i, u;
+	ctxval_t *row = a_ctx->row;
+	ctxval_t *cur = NULL;
+	const ctxval_t *next = NULL;
+	const int T = a_ctx->num_items;
+	const int L = a_ctx->num_labels;
+
+	cur = BETA_SCORE(a_ctx, (T - 1) % 2);
+	vecset(cur, a_ctx->scale_factor[T - 1], L);
+	for (u = T - 2; t <= u; --u) {
+		next = cur;
+		cur = BETA_SCORE(a_ctx, u % 2);
+		veccopy(row, next, L);
+		vecmul(row, EXP_STATE_SCORE(a_ctx, u + 1), L);
+		for (i = 0; i < L; ++i) {
+			cur[i] = vecdot(EXP_TRANS_SCORE(a_ctx, i), row, L);
+		}
+		vecscale(cur, a_ctx->scale_factor[u], L);
+	}
+	return cur;
+}
+
 void crf1dc_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 {
 	int i, j, t;
 	const int T = a_ctx->num_items;
 	const int L = a_ctx->num_labels;
 
+	if (a_ctx->checkpoint) {
+		crf1dc_checkpoint_marginals(a_ctx);
+		return;
+	}
+
 	/*
 	  Compute model expectation of states.
 	  p(t,i) = fwd[t][i] * bwd[t][i] / norm
 	  = (1. / C[t]) * fwd'[t][i] * bwd'[t][i][hhh
 	*/
 	for (t = 0; t < T; ++t) {
-		floatval_t *fwd = ALPHA_SCORE(a_ctx, t);
-		floatval_t *bwd = BETA_SCORE(a_ctx, t);
-		floatval_t *prob = STATE_MEXP(a_ctx, t);
+		ctxval_t *fwd = ALPHA_SCORE(a_ctx, t);
+		ctxval_t *bwd = BETA_SCORE(a_ctx, t);
+		ctxval_t *prob = STATE_MEXP(a_ctx, t);
 		veccopy(prob, fwd, L);
 		vecmul(prob, bwd, L);
 		vecscale(prob, 1. / a_ctx->scale_factor[t], L);
@@ -656,19 +834,19 @@ void crf1dc_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 	  The model expectation of a transition (i -> j) is the sum of the marginal
 	  probabilities p(t,i,t+1,j) over t.
 	*/
-	floatval_t *row = a_ctx->row;
+	ctxval_t *row = a_ctx->row;
 	for (t = 0; t < T - 1; ++t) {
-		floatval_t *fwd = ALPHA_SCORE(a_ctx, t);
-		floatval_t *bwd = BETA_SCORE(a_ctx, t + 1);
-		floatval_t *state = EXP_STATE_SCORE(a_ctx, t + 1);
+		ctxval_t *fwd = ALPHA_SCORE(a_ctx, t);
+		ctxval_t *bwd = BETA_SCORE(a_ctx, t + 1);
+		ctxval_t *state = EXP_STATE_SCORE(a_ctx, t + 1);
 
 		/* row[j] = state[t+1][j] * bwd'[t+1][j] */
 		veccopy(row, bwd, L);
 		vecmul(row, state, L);
 
 		for (i = 0; i < L; ++i) {
-			floatval_t *edge = EXP_TRANS_SCORE(a_ctx, i);
-			floatval_t *prob = TRANS_MEXP(a_ctx, i);
+			ctxval_t *edge = EXP_TRANS_SCORE(a_ctx, i);
+			ctxval_t *prob = TRANS_MEXP(a_ctx, i);
 			for (j = 0; j < L; ++j) {
 				prob[j] += fwd[i] * edge[j] * row[j];
 			}
@@ -685,8 +863,8 @@ void crf1dc_tree_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 	const int T = a_ctx->num_items;
 	const int L = a_ctx->num_labels;
 	const crfsuite_node_t *node, *prnt_node;
-	const floatval_t *fwd = NULL, *bwd = NULL, *state = NULL, *scale = NULL;
-	floatval_t *prob = NULL;
+	const ctxval_t *fwd = NULL, *bwd = NULL, *state = NULL, *scale = NULL;
+	ctxval_t *prob = NULL;
 	/*
 	 Compute model expectations of states (this expectation is the same for all
 	 types of graphical models).
@@ -718,8 +896,8 @@ void crf1dc_tree_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 	  over t.
 	*/
 
-	floatval_t *row = a_ctx->row;
-	const floatval_t *chld_alpha = NULL, *prnt_alpha = NULL;
+	ctxval_t *row = a_ctx->row;
+	const ctxval_t *chld_alpha = NULL, *prnt_alpha = NULL;
 
 	for (t = T - 1; t > 0; --t) {
 		node = &tree[t];
@@ -753,8 +931,8 @@ void crf1dc_tree_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 		vecmul(row, bwd, L);
 
 		for (i = 0; i < L; ++i) {
-			floatval_t *edge = EXP_TRANS_SCORE(a_ctx, i);
-			floatval_t *prob = TRANS_MEXP(a_ctx, i);
+			ctxval_t *edge = EXP_TRANS_SCORE(a_ctx, i);
+			ctxval_t *prob = TRANS_MEXP(a_ctx, i);
 			for (j = 0; j < L; ++j) {
 				prob[j] += fwd[i] * edge[j] * row[j];
 			}
@@ -784,7 +962,8 @@ void crf1dc_sm_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 	const int *suffixes;
 	int y, s, seg_start, max_seg_end;
 	int afx_i, n_affixes, ptrn_id, prfx_id, sfx_i, sfx_id, suffix, frw_id;
-	floatval_t state_score, mexp, mexp_i, *alpha, *beta, *state_mexp;
+	floatval_t state_score, mexp, mexp_i;
+	ctxval_t *alpha, *beta, *state_mexp;
 
 	for (int t = 0; t < T; ++t) {
 		state_mexp = STATE_MEXP(a_ctx, t);
@@ -859,7 +1038,7 @@ void crf1dc_sm_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 	/*
 	 * Compute marginals of transitions.
 	 */
-	floatval_t *trans_mexp = NULL;
+	ctxval_t *trans_mexp = NULL;
 
 	/* iterate over each state in the sequence */
 	for (int t = 0; t < T; ++t) {
@@ -922,8 +1101,13 @@ void crf1dc_sm_marginals(crf1d_context_t* a_ctx, const void *a_aux)
 
 floatval_t crf1dc_marginal_point(crf1d_context_t *ctx, int l, int t)
 {
-	floatval_t *fwd = ALPHA_SCORE(ctx, t);
-	floatval_t *bwd = BETA_SCORE(ctx, t);
+	/* A checkpointed context stores the marginals computed by crf1dc_marginals(). */
+	if (ctx->checkpoint) {
+		return STATE_MEXP(ctx, t)[l];
+	}
+
+	ctxval_t *fwd = ALPHA_SCORE(ctx, t);
+	ctxval_t *bwd = BETA_SCORE(ctx, t);
 	return fwd[l] * bwd[l] / ctx->scale_factor[t];
 }
 
@@ -941,13 +1125,26 @@ floatval_t crf1dc_marginal_path(crf1d_context_t *ctx, const int *path, int begin
 	  = fwd[begin][a] * edge[a][b] * state[begin+1][b] * ... * edge[y][z] * state[end-1][z] * bwd[end-1][z] / norm
 	  = fwd'[begin][a] * edge[a][b] * state[begin+1][b] * ... * edge[y][z] * state[end-1][z] * bwd'[end-1][z] * (C[begin+1] * ... * C[end-2])
 	*/
-	floatval_t *fwd = ALPHA_SCORE(ctx, begin);
-	floatval_t *bwd = BETA_SCORE(ctx, end - 1);
-	floatval_t prob = fwd[path[begin]] * bwd[path[end - 1]] / ctx->scale_factor[begin];
+	const ctxval_t *fwd = NULL, *bwd = NULL;
+	floatval_t prob;
+
+	if (ctx->checkpoint) {
+		/* Recompute the alpha scores at #begin and the beta scores at #end-1. */
+		const int K = ctx->checkpoint;
+		const int C = (ctx->num_items + K - 1) / K;
+		crf1dc_alpha_segment(ctx, begin / K, begin + 1);
+		fwd = ALPHA_SCORE(ctx, C + begin % K);
+		bwd = crf1dc_checkpoint_beta(ctx, end - 1);
+	}
+	else {
+		fwd = ALPHA_SCORE(ctx, begin);
+		bwd = BETA_SCORE(ctx, end - 1);
+	}
+	prob = fwd[path[begin]] * bwd[path[end - 1]] / ctx->scale_factor[begin];
 
 	for (t = begin; t < end - 1; ++t) {
-		floatval_t *state = EXP_STATE_SCORE(ctx, t + 1);
-		floatval_t *edge = EXP_TRANS_SCORE(ctx, path[t]);
+		ctxval_t *state = EXP_STATE_SCORE(ctx, t + 1);
+		ctxval_t *edge = EXP_TRANS_SCORE(ctx, path[t]);
 		prob *= (edge[path[t + 1]] * state[path[t + 1]] * ctx->scale_factor[t]);
 	}
 
@@ -975,9 +1172,9 @@ floatval_t crf1dc_sm_marginal_path(crf1d_context_t *ctx, const int *path, int be
 void crf1dc_marginal_without_beta(crf1d_context_t* ctx)
 {
 	int i, j, t;
-	floatval_t *prob = NULL;
-	floatval_t *row = ctx->row;
-	const floatval_t *fwd = NULL;
+	ctxval_t *prob = NULL;
+	ctxval_t *row = ctx->row;
+	const ctxval_t *fwd = NULL;
 	const int T = ctx->num_items;
 	const int L = ctx->num_labels;
 
@@ -1006,8 +1203,8 @@ void crf1dc_marginal_without_beta(crf1d_context_t* ctx)
 		  row[j] = \sum_{i} adj[i][j]
 		*/
 		for (i = 0; i < L; ++i) {
-			floatval_t *adj = ADJACENCY(ctx, i);
-			floatval_t *edge = EXP_TRANS_SCORE(ctx, i);
+			ctxval_t *adj = ADJACENCY(ctx, i);
+			ctxval_t *edge = EXP_TRANS_SCORE(ctx, i);
 			vecaadd(adj, fwd[i], edge, L);
 			vecadd(row, adj, L);
 		}
@@ -1023,7 +1220,7 @@ void crf1dc_marginal_without_beta(crf1d_context_t* ctx)
 		  Apply the partition factor z (row[j]) to adj[i][j].
 		*/
 		for (i = 0; i < L; ++i) {
-			floatval_t *adj = ADJACENCY(ctx, i);
+			ctxval_t *adj = ADJACENCY(ctx, i);
 			vecmul(adj, row, L);
 		}
 
@@ -1032,8 +1229,8 @@ void crf1dc_marginal_without_beta(crf1d_context_t* ctx)
 		  accumulate model expectations of transitions.
 		*/
 		for (i = 0; i < L; ++i) {
-			floatval_t *adj = ADJACENCY(ctx, i);
-			floatval_t *prob = TRANS_MEXP(ctx, i);
+			ctxval_t *adj = ADJACENCY(ctx, i);
+			ctxval_t *prob = TRANS_MEXP(ctx, i);
 			vecadd(prob, adj, L);
 		}
 
@@ -1043,7 +1240,7 @@ void crf1dc_marginal_without_beta(crf1d_context_t* ctx)
 		*/
 		prob = STATE_MEXP(ctx, t - 1);
 		for (i = 0; i < L; ++i) {
-			floatval_t *adj = ADJACENCY(ctx, i);
+			ctxval_t *adj = ADJACENCY(ctx, i);
 			prob[i] = vecsum(adj, L);
 		}
 	}
@@ -1055,7 +1252,7 @@ floatval_t crf1dc_score(crf1d_context_t* a_ctx, const int *a_labels, \
 {
 	int i, j, t;
 	floatval_t ret = 0.;
-	const floatval_t *state = NULL, *trans = NULL;
+	const ctxval_t *state = NULL, *trans = NULL;
 	const int T = a_ctx->num_items;
 
 	/* Stay at (0, labels[0]). */
@@ -1084,7 +1281,7 @@ floatval_t crf1dc_tree_score(crf1d_context_t* a_ctx, const int *a_labels, \
 
 	int t, c;
 	floatval_t ret = 0., score = 0.;
-	const floatval_t *state = NULL, *trans = NULL;
+	const ctxval_t *state = NULL, *trans = NULL;
 	const int T = a_ctx->num_items;
 
 	const crfsuite_node_t *node;
@@ -1129,7 +1326,7 @@ floatval_t crf1dc_sm_score(crf1d_context_t* a_ctx, const int *a_labels, \
 	int label_i = a_labels[0];
 
 	/* Obtain state score for 0-th element. */
-	const floatval_t *state = STATE_SCORE(a_ctx, 0);
+	const ctxval_t *state = STATE_SCORE(a_ctx, 0);
 	ret += state[label_i];
 
 	/* Add first label to semi-markov ring. */
@@ -1181,18 +1378,135 @@ floatval_t crf1dc_lognorm(crf1d_context_t* ctx)
 	return ctx->log_norm;
 }
 
+/*
+ * Compute the Viterbi scores at #t (cur) and the back pointers to #t-1
+ * (back) from the Viterbi scores at #t-1 (prev), using the state scores
+ * in the row #t of the context.
+ */
+void crf1dc_viterbi_step(crf1d_context_t* ctx, ctxval_t *cur, const ctxval_t *prev, \
+	int *back, int t)
+{
+	int i, j;
+	floatval_t max_score, score;
+	const ctxval_t *trans = NULL;
+	const ctxval_t *state = STATE_SCORE(ctx, t);
+	const int L = ctx->num_labels;
+
+	/* Compute the score of (t, j). */
+	for (j = 0; j < L; ++j) {
+		max_score = -FLOAT_MAX;
+
+		for (i = 0; i < L; ++i) {
+			/* Transit from (t-1, i) to (t, j). */
+			trans = TRANS_SCORE(ctx, i);
+			score = prev[i] + trans[j];
+
+			/* Store this path if it has the maximum score. */
+			if (max_score < score) {
+				max_score = score;
+				/* Backward link (#t, #j) -> (#t-1, #i). */
+				back[j] = i;
+			}
+		}
+		/* Add the state score on (t, j). */
+		cur[j] = max_score + state[j];
+	}
+}
+
+/*
+ * Viterbi algorithm for a checkpointed context.
+ *  The forward pass keeps the Viterbi scores only at the checkpoints; the
+ *  backward pass recomputes the scores and back pointers of each segment
+ *  from its checkpoint, and links the segment to the label of the next one.
+ */
+static floatval_t crf1dc_checkpoint_viterbi(crf1d_context_t* ctx, int *labels)
+{
+	int c, i, j, t;
+	floatval_t max_score, score;
+	ctxval_t *cur = NULL, *prev = NULL;
+	const ctxval_t *trans = NULL;
+	const int T = ctx->num_items;
+	const int L = ctx->num_labels;
+	const int K = ctx->checkpoint;
+	const int C = (T + K - 1) / K;
+
+	/* Compute the scores at (t, *) and store them at the checkpoints. */
+	for (t = 0; t < T; ++t) {
+		cur = ALPHA_SCORE(ctx, C + t % K);
+		if (t == 0) {
+			veccopy(cur, STATE_SCORE(ctx, 0), L);
+		}
+		else {
+			crf1dc_viterbi_step(ctx, cur, prev, BACKWARD_EDGE_AT(ctx, t % K), t);
+		}
+		if (t % K == 0) {
+			veccopy(ALPHA_SCORE(ctx, t / K), cur, L);
+		}
+		prev = cur;
+	}
+
+	/* Find the node (#T, #i) that reaches EOS with the maximum score. */
+	max_score = -FLOAT_MAX;
+	for (i = 0; i < L; ++i) {
+		if (max_score < prev[i]) {
+			max_score = prev[i];
+			labels[T - 1] = i;        /* Tag the item #T. */
+		}
+	}
+
+	/* Tag labels segment by segment from the last one. */
+	for (c = C - 1; 0 <= c; --c) {
+		const int s = c * K;
+		const int e = (s + K < T) ? s + K : T;
+
+		cur = ALPHA_SCORE(ctx, C);
+		veccopy(cur, ALPHA_SCORE(ctx, c), L);
+		for (t = s + 1; t < e; ++t) {
+			prev = cur;
+			cur = ALPHA_SCORE(ctx, C + t - s);
+			crf1dc_viterbi_step(ctx, cur, prev, BACKWARD_EDGE_AT(ctx, t - s), t);
+		}
+
+		/* Tag the last item of this segment by the backward link from the
+		   first item of the next segment. */
+		if (e < T) {
+			j = labels[e];
+			score = -FLOAT_MAX;
+			for (i = 0; i < L; ++i) {
+				trans = TRANS_SCORE(ctx, i);
+				if (score < cur[i] + trans[j]) {
+					score = cur[i] + trans[j];
+					labels[e - 1] = i;
+				}
+			}
+		}
+
+		/* Tag labels by tracing the backward links in this segment. */
+		for (t = e - 2; s <= t; --t) {
+			labels[t] = BACKWARD_EDGE_AT(ctx, t + 1 - s)[labels[t + 1]];
+		}
+	}
+
+	/* Return the maximum score (without the normalization factor subtracted). */
+	return max_score;
+}
+
 floatval_t crf1dc_viterbi(crf1d_context_t* ctx, int *labels, const void *a_aux)
 {
 	int i, j, t;
 	int *back = NULL;
-	floatval_t max_score, score, *cur = NULL;
-	const floatval_t *prev = NULL, *state = NULL, *trans = NULL;
+	floatval_t max_score;
+	ctxval_t *cur = NULL;
+	const ctxval_t *prev = NULL, *state = NULL;
 	const int T = ctx->num_items;
 	const int L = ctx->num_labels;
 
 	/*
 	  This function assumes state and trans scores to be in the logarithm domain.
 	*/
+	if (ctx->checkpoint) {
+		return crf1dc_checkpoint_viterbi(ctx, labels);
+	}
 
 	/* Compute scores at (0, *). */
 	cur = ALPHA_SCORE(ctx, 0);
@@ -1205,28 +1519,8 @@ floatval_t crf1dc_viterbi(crf1d_context_t* ctx, int *labels, const void *a_aux)
 	for (t = 1; t < T; ++t) {
 		prev = ALPHA_SCORE(ctx, t - 1);
 		cur = ALPHA_SCORE(ctx, t);
-		state = STATE_SCORE(ctx, t);
 		back = BACKWARD_EDGE_AT(ctx, t);
-
-		/* Compute the score of (t, j). */
-		for (j = 0; j < L; ++j) {
-			max_score = -FLOAT_MAX;
-
-			for (i = 0; i < L; ++i) {
-				/* Transit from (t-1, i) to (t, j). */
-				trans = TRANS_SCORE(ctx, i);
-				score = prev[i] + trans[j];
-
-				/* Store this path if it has the maximum score. */
-				if (max_score < score) {
-					max_score = score;
-					/* Backward link (#t, #j) -> (#t-1, #i). */
-					back[j] = i;
-				}
-			}
-			/* Add the state score on (t, j). */
-			cur[j] = max_score + state[j];
-		}
+		crf1dc_viterbi_step(ctx, cur, prev, back, t);
 	}
 
 	/* Find the node (#T, #i) that reaches EOS with the maximum score. */
@@ -1256,8 +1550,8 @@ floatval_t crf1dc_tree_viterbi(crf1d_context_t* ctx, int *labels, const void *a_
 	int item_id = -1, chld_item_id, lbl;
 	int *back = NULL;
 	floatval_t max_score = -FLOAT_MAX, score = -FLOAT_MAX;
-	floatval_t *alpha = NULL, *chld_alpha = NULL;
-	const floatval_t *state = NULL, *trans = NULL;
+	ctxval_t *alpha = NULL, *chld_alpha = NULL;
+	const ctxval_t *state = NULL, *trans = NULL;
 	const crfsuite_node_t *node, *child;
 	const int T = ctx->num_items;
 	const int L = ctx->num_labels;
@@ -1352,8 +1646,8 @@ floatval_t crf1dc_sm_viterbi(crf1d_context_t* ctx, int *labels, const void *a_au
 	 /* Compute scores at (0, *). */
 	int i, y;
 	const crf1de_state_t *frw_state = NULL;
-	const floatval_t *state = STATE_SCORE(ctx, 0);
-	floatval_t *cur = SM_ALPHA_SCORE(ctx, sm, 0);
+	const ctxval_t *state = STATE_SCORE(ctx, 0);
+	ctxval_t *cur = SM_ALPHA_SCORE(ctx, sm, 0);
 	veczero(cur, L);
 
 	for (i = 0; i < L; ++i) {
@@ -1373,7 +1667,7 @@ floatval_t crf1dc_sm_viterbi(crf1d_context_t* ctx, int *labels, const void *a_au
 	int min_seg_start, seg_start, max_prev_seg_len, prev_seg_end, \
 		prev_id1, prev_id2;
 	floatval_t max_score, state_score, trans_score, score;
-	const floatval_t *prev;
+	const ctxval_t *prev;
 	const int *frw_trans1, *frw_trans2, *suffixes;
 	/* Compute the scores at (t, *). */
 	for (t = 1; t < T; ++t) {
@@ -1383,7 +1677,7 @@ floatval_t crf1dc_sm_viterbi(crf1d_context_t* ctx, int *labels, const void *a_au
 		veczero(cur, L);
 
 		for (j = 0; j < L; ++j) {
-			cur[j] = -FLOAT_MAX;
+			cur[j] = -CTXVAL_MAX;
 			/* obtain semi-markov state, corresponding to #i-th index */
 			frw_state = &sm->m_frw_states[j];
 			/* obtain possible transitions for that semi-markov state */
@@ -1480,6 +1774,382 @@ floatval_t crf1dc_sm_viterbi(crf1d_context_t* ctx, int *labels, const void *a_au
 	return max_score;
 }
 
+/*
+ * N-best Viterbi algorithm.
+ *  The N-best paths are found by an A* search from the end of the lattice
+ *  (or the root of a tree) toward its beginning (the leaves). The Viterbi
+ *  scores computed by the forward pass give the exact scores of the best
+ *  completions of partial paths, so that the score of a search node is the
+ *  score of the best complete path through it, and complete paths leave the
+ *  priority queue in the descending order of their scores. Ties are broken
+ *  in favor of deeper nodes so that equally scored paths are completed
+ *  one by one.
+ */
+
+static int crf1dc_nbest_before(const crf1dc_nbest_node_t *nodes, int a, int b)
+{
+	return nodes[b].score < nodes[a].score ||
+		(nodes[a].score == nodes[b].score && nodes[b].step < nodes[a].step);
+}
+
+static void crf1dc_nbest_clear(crf1d_context_t* ctx)
+{
+	ctx->num_nbest_nodes = 0;
+	ctx->num_nbest_queue = 0;
+}
+
+static int crf1dc_nbest_push(crf1d_context_t* ctx, floatval_t score, \
+	int pos, int label, int step, int prev)
+{
+	int i, j, p;
+	crf1dc_nbest_node_t *node = NULL;
+
+	/* Grow the pool of search nodes and the queue. */
+	if (ctx->cap_nbest <= ctx->num_nbest_nodes) {
+		const int cap = (0 < ctx->cap_nbest) ? 2 * ctx->cap_nbest : 1024;
+		crf1dc_nbest_node_t *nodes = (crf1dc_nbest_node_t*)realloc(
+			ctx->nbest_nodes, sizeof(crf1dc_nbest_node_t) * cap);
+		int *queue = NULL;
+		if (nodes == NULL) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		ctx->nbest_nodes = nodes;
+		queue = (int*)realloc(ctx->nbest_queue, sizeof(int) * cap);
+		if (queue == NULL) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		ctx->nbest_queue = queue;
+		ctx->cap_nbest = cap;
+	}
+
+	i = ctx->num_nbest_nodes++;
+	node = &ctx->nbest_nodes[i];
+	node->score = score;
+	node->pos = pos;
+	node->label = label;
+	node->step = step;
+	node->prev = prev;
+
+	/* Sift the node up in the queue. */
+	for (j = ctx->num_nbest_queue++; 0 < j; j = p) {
+		p = (j - 1) / 2;
+		if (!crf1dc_nbest_before(ctx->nbest_nodes, i, ctx->nbest_queue[p])) {
+			break;
+		}
+		ctx->nbest_queue[j] = ctx->nbest_queue[p];
+	}
+	ctx->nbest_queue[j] = i;
+	return 0;
+}
+
+static int crf1dc_nbest_pop(crf1d_context_t* ctx)
+{
+	int c, j, top, last;
+	int *queue = ctx->nbest_queue;
+	const crf1dc_nbest_node_t *nodes = ctx->nbest_nodes;
+
+	if (ctx->num_nbest_queue <= 0) {
+		return -1;
+	}
+	top = queue[0];
+	last = queue[--ctx->num_nbest_queue];
+
+	/* Sift the last node down from the root. */
+	for (j = 0; (c = 2 * j + 1) < ctx->num_nbest_queue; j = c) {
+		if (c + 1 < ctx->num_nbest_queue && crf1dc_nbest_before(nodes, queue[c + 1], queue[c])) {
+			++c;
+		}
+		if (!crf1dc_nbest_before(nodes, queue[c], last)) {
+			break;
+		}
+		queue[j] = queue[c];
+	}
+	queue[j] = last;
+	return top;
+}
+
+int crf1dc_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux)
+{
+	int i, j, k, t, ret = 0, num = 0;
+	floatval_t max_score, score;
+	const ctxval_t *prev = NULL, *trans = NULL;
+	const int T = ctx->num_items;
+	const int L = ctx->num_labels;
+
+	*ptr_num = 0;
+	if (ctx->checkpoint) {
+		/* The search needs the Viterbi scores of all items. */
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
+	if (T <= 0 || n <= 0) {
+		return 0;
+	}
+
+	/* Compute the Viterbi scores at (t, *). */
+	crf1dc_viterbi(ctx, paths, a_aux);
+
+	/* Start the search from the nodes (#T-1, *). */
+	crf1dc_nbest_clear(ctx);
+	prev = ALPHA_SCORE(ctx, T - 1);
+	for (j = 0; j < L; ++j) {
+		if ((ret = crf1dc_nbest_push(ctx, prev[j], T - 1, j, 0, -1))) {
+			return ret;
+		}
+	}
+
+	while (num < n && 0 <= (k = crf1dc_nbest_pop(ctx))) {
+		const crf1dc_nbest_node_t node = ctx->nbest_nodes[k];
+
+		/* A node at #0 completes a path. */
+		if (node.pos == 0) {
+			int *labels = &paths[T * num];
+			for (i = k; 0 <= i; i = ctx->nbest_nodes[i].prev) {
+				labels[ctx->nbest_nodes[i].pos] = ctx->nbest_nodes[i].label;
+			}
+			if (scores != NULL) {
+				scores[num] = node.score;
+			}
+			++num;
+			continue;
+		}
+
+		/* Expand (t, j) to (t-1, *). */
+		t = node.pos;
+		j = node.label;
+		prev = ALPHA_SCORE(ctx, t - 1);
+		max_score = -FLOAT_MAX;
+		for (i = 0; i < L; ++i) {
+			trans = TRANS_SCORE(ctx, i);
+			if (max_score < prev[i] + trans[j]) {
+				max_score = prev[i] + trans[j];
+			}
+		}
+		for (i = 0; i < L; ++i) {
+			trans = TRANS_SCORE(ctx, i);
+			score = node.score - max_score + (prev[i] + trans[j]);
+			if ((ret = crf1dc_nbest_push(ctx, score, t - 1, i, node.step + 1, k))) {
+				return ret;
+			}
+		}
+	}
+
+	*ptr_num = num;
+	return 0;
+}
+
+int crf1dc_tree_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux)
+{
+	const crfsuite_node_t *tree = (const crfsuite_node_t *)a_aux;
+	int i, j, k, m, ret = 0, num = 0;
+	floatval_t max_score, score;
+	const ctxval_t *alpha = NULL, *trans = NULL;
+	const int T = ctx->num_items;
+	const int L = ctx->num_labels;
+
+	*ptr_num = 0;
+	if (T <= 0 || n <= 0) {
+		return 0;
+	}
+
+	/* Compute the Viterbi scores of the subtrees. */
+	crf1dc_tree_viterbi(ctx, paths, a_aux);
+
+	/*
+	  A search node at the tree node #m assigns the labels to the tree
+	  nodes #0, ..., #m, which are ordered topologically; its score
+	  includes the Viterbi scores of the subtrees below the assigned nodes.
+	 */
+	crf1dc_nbest_clear(ctx);
+	alpha = ALPHA_SCORE(ctx, tree[0].self_item_id);
+	for (j = 0; j < L; ++j) {
+		if ((ret = crf1dc_nbest_push(ctx, alpha[j], 0, j, 0, -1))) {
+			return ret;
+		}
+	}
+
+	while (num < n && 0 <= (k = crf1dc_nbest_pop(ctx))) {
+		const crf1dc_nbest_node_t node = ctx->nbest_nodes[k];
+
+		/* A node at the last tree node completes a path. */
+		if (node.pos == T - 1) {
+			int *labels = &paths[T * num];
+			for (i = k; 0 <= i; i = ctx->nbest_nodes[i].prev) {
+				labels[tree[ctx->nbest_nodes[i].pos].self_item_id] = ctx->nbest_nodes[i].label;
+			}
+			if (scores != NULL) {
+				scores[num] = node.score;
+			}
+			++num;
+			continue;
+		}
+
+		/* Find the label assigned to the parent of the tree node #m. */
+		m = node.pos + 1;
+		for (i = k; ctx->nbest_nodes[i].pos != tree[m].prnt_node_id; ) {
+			i = ctx->nbest_nodes[i].prev;
+		}
+		j = ctx->nbest_nodes[i].label;
+
+		/* Replace the Viterbi score of the subtree #m by each of its labels. */
+		alpha = ALPHA_SCORE(ctx, tree[m].self_item_id);
+		max_score = -FLOAT_MAX;
+		for (i = 0; i < L; ++i) {
+			trans = TRANS_SCORE(ctx, i);
+			if (max_score < alpha[i] + trans[j]) {
+				max_score = alpha[i] + trans[j];
+			}
+		}
+		for (i = 0; i < L; ++i) {
+			trans = TRANS_SCORE(ctx, i);
+			score = node.score - max_score + (alpha[i] + trans[j]);
+			if ((ret = crf1dc_nbest_push(ctx, score, m, i, node.step + 1, k))) {
+				return ret;
+			}
+		}
+	}
+
+	*ptr_num = num;
+	return 0;
+}
+
+int crf1dc_sm_nbest(crf1d_context_t* ctx, int n, int *paths, floatval_t *scores, \
+	int *ptr_num, const void *a_aux)
+{
+	const crf1de_semimarkov_t *sm = (const crf1de_semimarkov_t *)a_aux;
+	int i, j, k, q, t, y, pass, ret = 0, num = 0;
+	int seg_start, min_seg_start, prev_seg_end, prev_id1, prev_id2, pk_id;
+	floatval_t max_score, state_score, trans_score, score;
+	const int *frw_trans1, *frw_trans2, *suffixes;
+	const crf1de_state_t *frw_state = NULL;
+	const ctxval_t *prev = NULL;
+	const int T = ctx->num_items;
+	const int L = sm->m_num_frw;
+
+	*ptr_num = 0;
+	if (T <= 0 || n <= 0) {
+		return 0;
+	}
+
+	/* Compute the Viterbi scores at (t, *). */
+	crf1dc_sm_viterbi(ctx, paths, a_aux);
+
+	/*
+	  A search node (t, j) ends a segment labeled by the semi-Markov state
+	  #j at #t; its expansions enumerate the segments and the previous
+	  states in the same manner as crf1dc_sm_viterbi(). A node at #-1
+	  completes a path.
+	 */
+	crf1dc_nbest_clear(ctx);
+	prev = SM_ALPHA_SCORE(ctx, sm, T - 1);
+	for (j = 0; j < L; ++j) {
+		if (1 <= sm->m_frw_states[j].m_len && -CTXVAL_MAX < prev[j]) {
+			if ((ret = crf1dc_nbest_push(ctx, prev[j], T - 1, j, 0, -1))) {
+				return ret;
+			}
+		}
+	}
+
+	while (num < n && 0 <= (k = crf1dc_nbest_pop(ctx))) {
+		const crf1dc_nbest_node_t node = ctx->nbest_nodes[k];
+
+		if (node.pos < 0) {
+			int *labels = &paths[T * num];
+
+			/* Label the segments from the beginning. */
+			for (i = node.prev, t = 0; 0 <= i; i = ctx->nbest_nodes[i].prev) {
+				y = sm->m_frw_llabels[ctx->nbest_nodes[i].label];
+				for (; t <= ctx->nbest_nodes[i].pos; ++t) {
+					labels[t] = y;
+				}
+			}
+
+			/* Different segmentations may yield the same label sequence. */
+			for (q = 0; q < num; ++q) {
+				if (memcmp(&paths[T * q], labels, sizeof(int) * T) == 0) {
+					break;
+				}
+			}
+			if (q == num) {
+				if (scores != NULL) {
+					scores[num] = node.score;
+				}
+				++num;
+			}
+			continue;
+		}
+
+		t = node.pos;
+		j = node.label;
+		frw_state = &sm->m_frw_states[j];
+		frw_trans1 = frw_state->m_frw_trans1;
+		frw_trans2 = frw_state->m_frw_trans2;
+		y = sm->m_frw_llabels[j];
+		min_seg_start = t - sm->m_max_seg_len[y];
+		if (min_seg_start > t)
+			min_seg_start = t - 1;
+		else if (min_seg_start < 0)
+			min_seg_start = -1;
+
+		/* Find the maximum score of the expansions, then push them. */
+		max_score = -FLOAT_MAX;
+		for (pass = 0; pass < 2; ++pass) {
+			state_score = 0.;
+			for (seg_start = t; seg_start > min_seg_start; --seg_start) {
+				prev_seg_end = seg_start - 1;
+				state_score += STATE_SCORE(ctx, seg_start)[y];
+
+				if (prev_seg_end < 0) {
+					if (frw_state->m_len != 1) {
+						continue;
+					}
+					if (pass == 0) {
+						if (max_score < state_score)
+							max_score = state_score;
+					}
+					else {
+						score = node.score - max_score + state_score;
+						if ((ret = crf1dc_nbest_push(ctx, score, -1, -1, node.step + 1, k))) {
+							return ret;
+						}
+					}
+					continue;
+				}
+
+				prev = SM_ALPHA_SCORE(ctx, sm, prev_seg_end);
+				for (i = 0; i < frw_state->m_num_affixes; ++i) {
+					prev_id1 = frw_trans1[i];
+					if (sm->m_frw_states[prev_id1].m_len > prev_seg_end + 1 ||
+						prev[prev_id1] <= -CTXVAL_MAX)
+						continue;
+
+					prev_id2 = frw_trans2[i];
+					trans_score = 0.;
+					suffixes = &SUFFIXES(sm, prev_id2, 0);
+					for (q = 0; (pk_id = suffixes[q]) >= 0; ++q) {
+						trans_score += TRANS_SCORE(ctx, pk_id)[y];
+					}
+					score = prev[prev_id1] + trans_score + state_score;
+					if (pass == 0) {
+						if (max_score < score)
+							max_score = score;
+					}
+					else {
+						score = node.score - max_score + score;
+						if ((ret = crf1dc_nbest_push(ctx, score, prev_seg_end, prev_id1, node.step + 1, k))) {
+							return ret;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	*ptr_num = num;
+	return 0;
+}
+
 static void check_values(FILE *fp, floatval_t cv, floatval_t tv)
 {
 	if (fabs(cv - tv) < 1e-9) {
@@ -1497,7 +2167,7 @@ void crf1dc_debug_context(FILE *fp)
 	const int L = 3;
 	const int T = 3;
 	crf1d_context_t *ctx = crf1dc_new(CTXF_MARGINALS, FTYPE_CRF1D, L, T, NULL);
-	floatval_t *trans = NULL, *state = NULL;
+	ctxval_t *trans = NULL, *state = NULL;
 	floatval_t scores[3][3][3];
 	int labels[3];
 
@@ -1664,7 +2334,7 @@ void crf1dc_debug_tree_context(FILE *fp)
 	const int L = 3;
 	const int T = 3;
 	crf1d_context_t *ctx = crf1dc_new(CTXF_MARGINALS, FTYPE_CRF1TREE, L, T, NULL);
-	floatval_t *trans = NULL, *state = NULL;
+	ctxval_t *trans = NULL, *state = NULL;
 	floatval_t scores[3][3][3];
 	int labels[3];
 
@@ -1820,7 +2490,8 @@ void crf1dc_debug_tree_context(FILE *fp)
 	/* Compute marginal probabilities of transitions y2 -- y1. */
 	for (y2 = 0; y2 < L; ++y2) {
 		for (y1 = 0; y1 < L; ++y1) {
-			floatval_t a, *a_c, b, s, t, t_c, p = 0.;
+			floatval_t a, b, s, t, t_c, p = 0.;
+			ctxval_t *a_c;
 			for (y3 = 0; y3 < L; ++y3) {
 				p += scores[y1][y2][y3];
 			}
@@ -1844,7 +2515,8 @@ void crf1dc_debug_tree_context(FILE *fp)
 
 	for (y3 = 0; y3 < L; ++y3) {
 		for (y1 = 0; y1 < L; ++y1) {
-			floatval_t a, *a_c, b, s, t, t_c, p = 0.;
+			floatval_t a, b, s, t, t_c, p = 0.;
+			ctxval_t *a_c;
 			for (y2 = 0; y2 < L; ++y2) {
 				p += scores[y1][y2][y3];
 			}
@@ -1875,7 +2547,7 @@ void crf1dc_debug_sm_context(FILE *fp)
 	const int L = 3;
 	const int T = 3;
 	crf1d_context_t *ctx = crf1dc_new(CTXF_MARGINALS, FTYPE_CRF1TREE, L, T, NULL);
-	floatval_t *trans = NULL, *state = NULL;
+	ctxval_t *trans = NULL, *state = NULL;
 	floatval_t scores[3][3][3];
 	int labels[3];
 
@@ -2031,7 +2703,8 @@ void crf1dc_debug_sm_context(FILE *fp)
 	/* Compute marginal probabilities of transitions y2 -- y1. */
 	for (y2 = 0; y2 < L; ++y2) {
 		for (y1 = 0; y1 < L; ++y1) {
-			floatval_t a, *a_c, b, s, t, t_c, p = 0.;
+			floatval_t a, b, s, t, t_c, p = 0.;
+			ctxval_t *a_c;
 			for (y3 = 0; y3 < L; ++y3) {
 				p += scores[y1][y2][y3];
 			}
@@ -2055,7 +2728,8 @@ void crf1dc_debug_sm_context(FILE *fp)
 
 	for (y3 = 0; y3 < L; ++y3) {
 		for (y1 = 0; y1 < L; ++y1) {
-			floatval_t a, *a_c, b, s, t, t_c, p = 0.;
+			floatval_t a, b, s, t, t_c, p = 0.;
+			ctxval_t *a_c;
 			for (y2 = 0; y2 < L; ++y2) {
 				p += scores[y1][y2][y3];
 			}
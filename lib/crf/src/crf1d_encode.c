@@ -38,6 +38,7 @@
 #include <os.h>
 
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -85,6 +86,9 @@ struct tag_crf1de {
 	crf1de_option_t opt;		/**< CRF1d options. */
 	crf1de_semimarkov_t *sm;	/**< Data, specific to semi-markov model */
 
+	const crf1df_groups_t *groups;	/**< Feature counts shared by folds (or NULL). */
+	int holdout;			/**< Holdout group for the shared feature counts. */
+
 	/**
 	 * Pointer to function for computing alpha score (the particular choice of
 	 * this function will depend on the type of graphical model).
@@ -171,7 +175,7 @@ static void crf1de_state_score(crf1de_t *crf1de,
 	/* Loop over the items in the sequence. */
 	for (t = 0; t < T; ++t) {
 		const crfsuite_item_t *item = &inst->items[t];
-		floatval_t *state = STATE_SCORE(ctx, t);
+		ctxval_t *state = STATE_SCORE(ctx, t);
 
 		/* Loop over the contents (attributes) attached to the item. */
 		for (i = 0; i < item->num_contents; ++i) {
@@ -213,7 +217,7 @@ crf1de_state_score_scaled(
 	/* Loop over the items in the sequence. */
 	for (t = 0; t < T; ++t) {
 		const crfsuite_item_t *item = &inst->items[t];
-		floatval_t *state = STATE_SCORE(ctx, t);
+		ctxval_t *state = STATE_SCORE(ctx, t);
 
 		/* Loop over the contents (attributes) attached to the item. */
 		for (i = 0; i < item->num_contents; ++i) {
@@ -237,7 +241,7 @@ static void crf1de_transition_score(crf1de_t* crf1de, const floatval_t* w, \
 	const crf1de_semimarkov_t *sm)
 {
 	int i, r;
-	floatval_t *trans = NULL;
+	ctxval_t *trans = NULL;
 	const feature_refs_t *edge = NULL;
 	crf1d_context_t* ctx = crf1de->ctx;
 	const int L = sm ? sm->m_num_frw : crf1de->num_labels;
@@ -270,7 +274,7 @@ static void crf1de_transition_score_scaled(crf1de_t* crf1de, const floatval_t* w
 
 	/* Compute transition scores between two labels. */
 	for (i = 0; i < L; ++i) {
-		floatval_t *trans = TRANS_SCORE(ctx, i);
+		ctxval_t *trans = TRANS_SCORE(ctx, i);
 		const feature_refs_t *edge = TRANSITION(crf1de, i);
 		for (r = 0; r < edge->num_features; ++r) {
 			/* Transition feature from #i to #(f->dst). */
@@ -537,7 +541,7 @@ static void crf1de_model_expectation(crf1de_t *crf1de,
 	const int L = crf1de->num_labels;
 
 	for (t = 0; t < T; ++t) {
-		floatval_t *prob = STATE_MEXP(ctx, t);
+		ctxval_t *prob = STATE_MEXP(ctx, t);
 		/* Compute expectations for state features at position #t. */
 		item = &inst->items[t];
 		for (c = 0; c < item->num_contents; ++c) {
@@ -557,7 +561,7 @@ static void crf1de_model_expectation(crf1de_t *crf1de,
 
 	/* Loop over the labels (t, i) */
 	for (i = 0; i < L; ++i) {
-		const floatval_t *prob = TRANS_MEXP(ctx, i);
+		const ctxval_t *prob = TRANS_MEXP(ctx, i);
 		trans = TRANSITION(crf1de, i);
 		for (r = 0; r < trans->num_features; ++r) {
 			/* Transition feature from #i to #(f->dst). */
@@ -581,7 +585,7 @@ static void crf1de_sm_model_expectation(crf1de_t *crf1de,
 	const int T = inst->num_items;
 
 	for (t = 0; t < T; ++t) {
-		floatval_t *prob = STATE_MEXP(ctx, t);
+		ctxval_t *prob = STATE_MEXP(ctx, t);
 		/* Compute expectations for state features at position #t. */
 		item = &inst->items[t];
 		for (c = 0; c < item->num_contents; ++c) {
@@ -600,7 +604,7 @@ static void crf1de_sm_model_expectation(crf1de_t *crf1de,
 	}
 
 	/* Loop over the labels (t, i) */
-	const floatval_t *prob = NULL;
+	const ctxval_t *prob = NULL;
 	for (i = 0; i < sm->m_num_frw; ++i) {
 		prob = TRANS_MEXP(ctx, i);
 		trans = TRANSITION(crf1de, i);
@@ -678,6 +682,20 @@ static void crf1de_finish(crf1de_t *crf1de)
 	}
 }
 
+/**
+ * Check the options used for storing the model, so that an invalid value
+ * is reported before the training.
+ */
+static int crf1de_check_options(const crf1de_option_t *opt, logging_t *lg)
+{
+	const int bits = opt->model_quantize;
+	if (bits != 0 && bits != 8 && bits != 16) {
+		logging(lg, "ERROR: model.quantize must be 0, 8, or 16 (%d)\n", bits);
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
+	return 0;
+}
+
 static int crf1de_set_data(crf1de_t *crf1de, \
 	int ftype, \
 	dataset_t *ds, \
@@ -691,6 +709,10 @@ static int crf1de_set_data(crf1de_t *crf1de, \
 	const int L = num_labels;
 	const int A = num_attributes;
 
+	if ((ret = crf1de_check_options(&crf1de->opt, lg))) {
+		return ret;
+	}
+
 	/* Initialize member variables. */
 	crf1de->num_attributes = A;
 	crf1de->num_labels = L;
@@ -719,15 +741,23 @@ static int crf1de_set_data(crf1de_t *crf1de, \
 	logging(lg, "feature.possible_transitions: %d\n", opt->feature_possible_transitions);
 	begin = clock();
 
-	crf1de->features = crf1df_generate(&crf1de->num_features,
-		crf1de->sm,
-		&T,
-		opt,
-		ds,
-		ftype,
-		L,
-		lg->func,
-		lg->instance);
+	if (crf1de->groups != NULL) {
+		/* Sum up the feature counts of the groups in the training set. */
+		crf1de->features = crf1df_generate_fold(&crf1de->num_features,
+			&T,
+			crf1de->groups,
+			crf1de->holdout);
+	} else {
+		crf1de->features = crf1df_generate(&crf1de->num_features,
+			crf1de->sm,
+			&T,
+			opt,
+			ds,
+			ftype,
+			L,
+			lg->func,
+			lg->instance);
+	}
 
 	if (crf1de->features == NULL) {
 		ret = CRFSUITEERR_OUTOFMEMORY;
@@ -751,12 +781,19 @@ static int crf1de_set_data(crf1de_t *crf1de, \
 		goto error_exit;
 	}
 
-	/* Construct CRF context. */
-	crf1de->ctx = crf1dc_new(CTXF_MARGINALS | CTXF_VITERBI, ftype, L, T, crf1de->sm);
+	/* Construct CRF context; T gives the hint for the maximum length of
+	   items after the checkpoint threshold is set. */
+	crf1de->ctx = crf1dc_new(CTXF_MARGINALS | CTXF_VITERBI, ftype, L, 0, crf1de->sm);
 	if (crf1de->ctx == NULL) {
 		ret = CRFSUITEERR_OUTOFMEMORY;
 		goto error_exit;
 	}
+	crf1de->ctx->checkpoint_threshold = opt->context_checkpoint;
+	if (crf1dc_set_num_items(crf1de->ctx, crf1de->sm, T)) {
+		ret = CRFSUITEERR_OUTOFMEMORY;
+		goto error_exit;
+	}
+	crf1de->ctx->num_items = 0;
 	return ret;
 
 error_exit:
@@ -764,6 +801,185 @@ error_exit:
 	return ret;
 }
 
+/**
+ * Bits of the quantized weights stored by the model writer.
+ *  The weights are not quantized (0) if model.quantize is 0, or if the
+ *  labels do not fit into the 16 bits of a quantized feature.
+ */
+static int crf1de_quantized_bits(const crf1de_t *crf1de)
+{
+	const int bits = crf1de->opt.model_quantize;
+	if ((bits != 8 && bits != 16) || 0xFFFF < crf1de->num_labels) {
+		return 0;
+	}
+	return bits;
+}
+
+/**
+ * Compute the scales of the quantized weights.
+ *  The weights of the features emitting the label #l are stored as
+ *  signed integers of the given bits multiplied by scales[l].
+ */
+static void
+crf1de_quantization_scales(
+	crf1de_t *crf1de,
+	const floatval_t *w,
+	const int bits,
+	floatval_t *scales
+)
+{
+	int k, l;
+	const int L = crf1de->num_labels;
+	const int K = crf1de->num_features;
+	const floatval_t qmax = (floatval_t)((1 << (bits - 1)) - 1);
+
+	for (l = 0; l < L; ++l) scales[l] = 0.;
+	for (k = 0; k < K; ++k) {
+		const crf1df_feature_t* f = &crf1de->features[k];
+		if (scales[f->dst] < fabs(w[k])) scales[f->dst] = fabs(w[k]);
+	}
+	for (l = 0; l < L; ++l) scales[l] /= qmax;
+}
+
+typedef struct {
+	int fid;
+	floatval_t score;
+} prune_item_t;
+
+static int prune_item_descending(const void *x, const void *y)
+{
+	const prune_item_t *a = (const prune_item_t*)x;
+	const prune_item_t *b = (const prune_item_t*)y;
+	return (a->score < b->score) ? 1 : ((a->score > b->score) ? -1 : 0);
+}
+
+/**
+ * Select the features to be stored in the model file.
+ *  keep[k] is set to nonzero if the feature #k is stored. Features with
+ *  zero weights are always removed; the options model.prune_* remove
+ *  features with small weights, restrict the number of state features
+ *  per attribute, and fit the model into the target size.
+ *  @return         The number of features to be stored.
+ */
+static int
+crf1de_prune(
+	crf1de_t *crf1de,
+	const floatval_t *w,
+	crfsuite_dictionary_t *attrs,
+	crfsuite_dictionary_t *labels,
+	char *keep,
+	logging_t *lg
+)
+{
+	int a, i, k, l, n = 0, J = 0;
+	prune_item_t *items = NULL;
+	int *num_attr_features = NULL;
+	const crf1de_option_t *opt = &crf1de->opt;
+	const int L = crf1de->num_labels;
+	const int A = crf1de->num_attributes;
+	const int K = crf1de->num_features;
+
+	/* Remove features with zero or small weights. */
+	for (k = 0; k < K; ++k) {
+		keep[k] = (w[k] != 0 && opt->model_prune_threshold < fabs(w[k]));
+		if (keep[k]) ++J;
+	}
+	if (0 < opt->model_prune_threshold) {
+		logging(lg, "Pruning features with |weight| <= %f\n", opt->model_prune_threshold);
+	}
+
+	items = (prune_item_t*)malloc(sizeof(prune_item_t) * K);
+	if (items == NULL) {
+		return J;
+	}
+
+	/* Keep the top-K state features of each attribute. */
+	if (0 < opt->model_prune_topk) {
+		logging(lg, "Pruning state features but the top %d of each attribute\n",
+			opt->model_prune_topk);
+		for (a = 0; a < A; ++a) {
+			const feature_refs_t *attr = ATTRIBUTE(crf1de, a);
+			for (i = 0, n = 0; i < attr->num_features; ++i) {
+				k = attr->fids[i];
+				if (keep[k]) {
+					items[n].fid = k;
+					items[n].score = fabs(w[k]);
+					++n;
+				}
+			}
+			if (opt->model_prune_topk < n) {
+				qsort(items, n, sizeof(prune_item_t), prune_item_descending);
+				for (i = opt->model_prune_topk; i < n; ++i) {
+					keep[items[i].fid] = 0;
+					--J;
+				}
+			}
+		}
+	}
+
+	/* Remove features with the smallest weights until the model fits. */
+	num_attr_features = (int*)calloc(A, sizeof(int));
+	if (0 < opt->model_prune_size && num_attr_features != NULL) {
+		size_t size = 0;
+		const char *str = NULL;
+		const int bits = crf1de_quantized_bits(crf1de);
+		const size_t fsize = crf1dm_feature_size(opt->model_format, bits) + sizeof(uint32_t);
+
+		/*
+			Estimate the size of the model: the header, empty CQDBs, the
+			semi-markov chunk, labels, and the features with their
+			attributes. The estimate does not fall below the actual size.
+		 */
+		size = crf1dm_base_size(opt->model_format, bits, L);
+		if (crf1de->sm != NULL) {
+			size += crf1dm_sm_size(opt->model_format, crf1de->sm);
+		}
+		for (l = 0; l < L; ++l) {
+			labels->to_string(labels, l, &str);
+			size += crf1dm_string_size(opt->model_format, strlen(str));
+			labels->free(labels, str);
+		}
+		for (k = 0, n = 0; k < K; ++k) {
+			if (keep[k]) {
+				const crf1df_feature_t *f = &crf1de->features[k];
+				if (f->type == FT_STATE && num_attr_features[f->src]++ == 0) {
+					attrs->to_string(attrs, f->src, &str);
+					size += crf1dm_string_size(opt->model_format, strlen(str));
+					attrs->free(attrs, str);
+				}
+				size += fsize;
+				items[n].fid = k;
+				items[n].score = fabs(w[k]);
+				++n;
+			}
+		}
+		logging(lg, "Estimated size of the model: %lu bytes\n", (unsigned long)size);
+
+		if ((size_t)opt->model_prune_size < size) {
+			logging(lg, "Pruning features to fit the model into %d bytes\n",
+				opt->model_prune_size);
+			qsort(items, n, sizeof(prune_item_t), prune_item_descending);
+			while ((size_t)opt->model_prune_size < size && 0 < n) {
+				const crf1df_feature_t *f = &crf1de->features[items[--n].fid];
+				keep[items[n].fid] = 0;
+				--J;
+				size -= fsize;
+				if (f->type == FT_STATE && --num_attr_features[f->src] == 0) {
+					attrs->to_string(attrs, f->src, &str);
+					size -= crf1dm_string_size(opt->model_format, strlen(str));
+					attrs->free(attrs, str);
+				}
+			}
+			logging(lg, "Estimated size of the pruned model: %lu bytes\n",
+				(unsigned long)size);
+		}
+	}
+
+	free(num_attr_features);
+	free(items);
+	return J;
+}
+
 static int
 crf1de_save_model(
 	crf1de_t *crf1de,
@@ -783,7 +999,14 @@ crf1de_save_model(
 	const int L = crf1de->num_labels;
 	const int A = crf1de->num_attributes;
 	const int K = crf1de->num_features;
+	const int bits = crf1de_quantized_bits(crf1de);
 	int J = 0, B = 0;
+	floatval_t *scales = NULL;
+	char *keep = NULL;
+
+	if ((ret = crf1de_check_options(&crf1de->opt, lg))) {
+		return ret;
+	}
 
 	/* Start storing the model. */
 	logging(lg, "Storing the model\n");
@@ -794,6 +1017,13 @@ crf1de_save_model(
 	if (fmap == NULL) {
 		goto error_exit;
 	}
+
+	/* Determine the features to be stored. */
+	keep = (char*)calloc(K, sizeof(char));
+	if (keep == NULL) {
+		goto error_exit;
+	}
+	crf1de_prune(crf1de, w, attrs, labels, keep, lg);
 #ifdef  CRF_TRAIN_SAVE_NO_PRUNING
 	for (k = 0; k < K; ++k) fmap[k] = k;
 	J = K;
@@ -816,10 +1046,27 @@ crf1de_save_model(
 	/*
 	 *  Open a model writer.
 	 */
-	writer = crf1mmw(filename, ftype);
+	writer = crf1mmw(filename, ftype, crf1de->opt.model_format);
 	if (writer == NULL)
 		goto error_exit;
 
+	/* Quantize the feature weights if necessary. */
+	if (bits != crf1de->opt.model_quantize) {
+		logging(lg, "Quantization to %d bits is unsupported for this model\n",
+			crf1de->opt.model_quantize);
+	}
+	if (bits != 0) {
+		scales = (floatval_t*)calloc(L, sizeof(floatval_t));
+		if (scales == NULL) {
+			ret = CRFSUITEERR_OUTOFMEMORY;
+			goto error_exit;
+		}
+		crf1de_quantization_scales(crf1de, w, bits, scales);
+		if ((ret = crf1dmw_set_quantization(writer, bits, scales, L)))
+			goto error_exit;
+		logging(lg, "Quantizing feature weights to %d bits\n", bits);
+	}
+
 	/* Open a feature chunk in the model file. */
 	if ((ret = crf1dmw_open_features(writer)))
 		goto error_exit;
@@ -830,7 +1077,7 @@ crf1de_save_model(
 	 */
 	for (k = 0; k < K; ++k) {
 		crf1df_feature_t* f = &crf1de->features[k];
-		if (w[k] != 0) {
+		if (keep[k]) {
 			int src;
 			crf1dm_feature_t feat;
 
@@ -968,10 +1215,18 @@ crf1de_save_model(
 	}
 
 	/* Close the writer. */
-	crf1dmw_close(writer);
+	logging(lg, "Size of the model: %llu bytes\n",
+		(unsigned long long)ftello(writer->fp));
+	ret = crf1dmw_close(writer);
+	writer = NULL;
+	if (ret) {
+		goto error_exit;
+	}
 	logging(lg, "Seconds required: %.3f\n", (clock() - begin) / (double)CLOCKS_PER_SEC);
 	logging(lg, "\n");
 
+	free(keep);
+	free(scales);
 	free(amap);
 	free(fmap);
 	return 0;
@@ -979,6 +1234,12 @@ crf1de_save_model(
 error_exit:
 	if (writer)
 		crf1dmw_close(writer);
+	if (ret == CRFSUITEERR_OVERFLOW) {
+		logging(lg, "ERROR: The model exceeds the limit of the format; use model.format=3\n");
+	}
+
+	free(keep);
+	free(scales);
 
 	if (amap)
 		free(amap);
@@ -1005,6 +1266,10 @@ static int crf1de_exchange_options(crfsuite_params_t* params, crf1de_option_t* o
 			"feature.possible_transitions", opt->feature_possible_transitions, 0,
 			"Force to generate possible transition features."
 		)
+		DDX_PARAM_INT(
+			"feature.threads", opt->feature_threads, 1,
+			"The number of threads for generating features (the model does not depend on the number of threads)."
+		)
 		if (ftype == FTYPE_SEMIMCRF) {
 			DDX_PARAM_INT(
 				"feature.max_seg_len", opt->feature_max_seg_len, -1,
@@ -1016,6 +1281,30 @@ static int crf1de_exchange_options(crfsuite_params_t* params, crf1de_option_t* o
 					"Maximum order of transition features."
 				)
 		}
+		DDX_PARAM_INT(
+			"model.quantize", opt->model_quantize, 0,
+			"Store the feature weights quantized to 8 or 16 bits (0 to disable). A quantized feature takes 8 or 9 bytes instead of 20 bytes; the model file shrinks less since the dictionaries and feature references are not quantized."
+		)
+		DDX_PARAM_FLOAT(
+			"model.prune_threshold", opt->model_prune_threshold, 0.0,
+			"Remove features whose absolute weights are not greater than this value."
+		)
+		DDX_PARAM_INT(
+			"model.prune_topk", opt->model_prune_topk, 0,
+			"Store at most this number of state features for each attribute (0 to disable)."
+		)
+		DDX_PARAM_INT(
+			"model.prune_size", opt->model_prune_size, 0,
+			"Remove features with small weights until the model fits into this number of bytes (0 to disable)."
+		)
+		DDX_PARAM_INT(
+			"model.format", opt->model_format, 1,
+			"Format of the model file (1: portable byte order, readable by all versions; 2: native arrays for faster loading; 3: native arrays with 64-bit offsets for models larger than 4GB). The formats 2 and 3 cannot be read by the versions predating them."
+		)
+		DDX_PARAM_INT(
+			"context.checkpoint", opt->context_checkpoint, CRF1DC_CHECKPOINT_THRESHOLD,
+			"Store the forward and Viterbi scores of a sequence only at every sqrt(T) items when the number of items times labels exceeds this value (0 to disable)."
+		)
 
 	END_PARAM_MAP()
 
@@ -1088,6 +1377,39 @@ static int encoder_exchange_options(encoder_t *self, crfsuite_params_t* params,
 	return crf1de_exchange_options(params, &crf1de->opt, mode, self->ftype);
 }
 
+static crf1df_groups_t* encoder_count_groups(encoder_t *self, crfsuite_data_t *data, \
+	int num_groups, logging_t *lg)
+{
+	clock_t begin = clock();
+	crf1df_groups_t *groups = NULL;
+	crf1de_t *crf1de = (crf1de_t*)self->internal;
+
+	if (self->ftype == FTYPE_SEMIMCRF || !data->labels || !data->attrs)
+		return NULL;
+
+	logging(lg, "Counting features in %d groups\n", num_groups);
+	groups = crf1df_count_groups(&crf1de->opt,
+		data,
+		num_groups,
+		self->ftype,
+		data->labels->num(data->labels),
+		lg->func,
+		lg->instance);
+	if (groups != NULL) {
+		logging(lg, "Seconds required: %.3f\n", (clock() - begin) / (double)CLOCKS_PER_SEC);
+		logging(lg, "\n");
+	}
+	return groups;
+}
+
+static int encoder_set_groups(encoder_t *self, const crf1df_groups_t *groups, int holdout)
+{
+	crf1de_t *crf1de = (crf1de_t*)self->internal;
+	crf1de->groups = groups;
+	crf1de->holdout = holdout;
+	return 0;
+}
+
 static int encoder_initialize(encoder_t *self, int ftype, dataset_t *ds, logging_t *lg)
 {
 	int ret = 0;
@@ -1205,6 +1527,46 @@ static int encoder_save_model(encoder_t *self, const char *filename, \
 		self->ds->data->labels, self->ftype, lg);
 }
 
+/* LEVEL_NONE -> LEVEL_NONE. */
+static int encoder_stored_weights(encoder_t *self, floatval_t *ws, \
+	const floatval_t *w)
+{
+	int k, changed = 0;
+	char *keep = NULL;
+	floatval_t *scales = NULL;
+	crf1de_t *crf1de = (crf1de_t*)self->internal;
+	const int bits = crf1de_quantized_bits(crf1de);
+	const int K = crf1de->num_features;
+
+	keep = (char*)calloc(K, sizeof(char));
+	scales = (floatval_t*)calloc(crf1de->num_labels, sizeof(floatval_t));
+	if (keep == NULL || scales == NULL) {
+		goto exit;
+	}
+
+	/* Prune and round the weights in the same manner as the model writer. */
+	crf1de_prune(crf1de, w, self->ds->data->attrs, self->ds->data->labels, keep, NULL);
+	if (bits != 0) {
+		crf1de_quantization_scales(crf1de, w, bits, scales);
+	}
+	for (k = 0; k < K; ++k) {
+		if (!keep[k]) {
+			ws[k] = 0.;
+		} else if (bits != 0) {
+			const floatval_t scale = scales[crf1de->features[k].dst];
+			ws[k] = crf1dm_quantize(w[k], scale, bits) * scale;
+		} else {
+			ws[k] = w[k];
+		}
+		if (ws[k] != w[k]) changed = 1;
+	}
+
+exit:
+	free(scales);
+	free(keep);
+	return changed;
+}
+
 /* LEVEL_NONE -> LEVEL_WEIGHT. */
 static int encoder_set_weights(encoder_t *self, const floatval_t *w, floatval_t scale)
 {
@@ -1291,8 +1653,11 @@ encoder_t *crf1d_create_encoder(int ftype)
 			self->delete = encoder_delete;
 			self->exchange_options = encoder_exchange_options;
 			self->initialize = encoder_initialize;
+			self->count_groups = encoder_count_groups;
+			self->set_groups = encoder_set_groups;
 			self->objective_and_gradients_batch = encoder_objective_and_gradients_batch;
 			self->save_model = encoder_save_model;
+			self->stored_weights = encoder_stored_weights;
 			self->features_on_path = encoder_features_on_path;
 			self->set_weights = encoder_set_weights;
 			self->set_instance = encoder_set_instance;
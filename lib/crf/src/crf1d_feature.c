@@ -46,20 +46,25 @@
 
 #include "logging.h"
 #include "crf1d.h"
-#include "rumavl.h"    /* AVL tree library necessary for feature generation. */
+
+#ifdef    HAVE_PTHREAD_H
+#include <pthread.h>
+#endif/*HAVE_PTHREAD_H*/
 
 /**
- * Feature set.
+ * Feature table.
+ *  An open-addressing hash table that accumulates the frequencies of
+ *  features; a slot with a negative type is empty.
  */
 typedef struct {
-	RUMAVL* avl;    /**< Root node of the AVL tree. */
-	int num;        /**< Number of features in the AVL tree. */
-} featureset_t;
-
+	crf1df_feature_t* slots;    /**< Slots of the hash table. */
+	size_t size;                /**< Number of slots (power of two). */
+	size_t num;                 /**< Number of features in the table. */
+} featuretable_t;
 
 #define    COMP(a, b)    ((a)>(b))-((a)<(b))
 
-static int featureset_comp(const void *x, const void *y, size_t n, void *udata)
+static int feature_comp(const void *x, const void *y)
 {
 	int ret = 0;
 	const crf1df_feature_t* f1 = (const crf1df_feature_t*)x;
@@ -75,37 +80,74 @@ static int featureset_comp(const void *x, const void *y, size_t n, void *udata)
 	return ret;
 }
 
-static featureset_t* featureset_new()
+static size_t feature_hash(const crf1df_feature_t* f)
 {
-	featureset_t* set = NULL;
-	set = (featureset_t*)calloc(1, sizeof(featureset_t));
-	if (set != NULL) {
-		set->num = 0;
-		set->avl = rumavl_new(sizeof(crf1df_feature_t), featureset_comp, NULL, NULL);
-		if (set->avl == NULL) {
-			free(set);
-			set = NULL;
-		}
+	uint64_t h = ((uint64_t)(uint32_t)f->src << 32) | (uint32_t)f->dst;
+	h ^= (uint64_t)(uint32_t)f->type * 0x9E3779B97F4A7C15ULL;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+static int featuretable_init(featuretable_t* table, size_t size)
+{
+	size_t i;
+	table->slots = (crf1df_feature_t*)malloc(sizeof(crf1df_feature_t) * size);
+	if (table->slots == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
 	}
-	return set;
+	for (i = 0; i < size; ++i) {
+		table->slots[i].type = -1;
+	}
+	table->size = size;
+	table->num = 0;
+	return 0;
+}
+
+static void featuretable_finish(featuretable_t* table)
+{
+	free(table->slots);
+	table->slots = NULL;
+	table->size = table->num = 0;
 }
 
-static void featureset_delete(featureset_t* set)
+static crf1df_feature_t* featuretable_find(crf1df_feature_t* slots, size_t size, \
+	const crf1df_feature_t* f)
 {
-	if (set != NULL) {
-		rumavl_destroy(set->avl);
-		free(set);
+	size_t i = feature_hash(f) & (size - 1);
+	while (0 <= slots[i].type && feature_comp(&slots[i], f) != 0) {
+		i = (i + 1) & (size - 1);
 	}
+	return &slots[i];
 }
 
-static int featureset_add(featureset_t* set, const crf1df_feature_t* f)
+static int featuretable_add(featuretable_t* table, const crf1df_feature_t* f)
 {
-	/* Check whether if the feature already exists. */
-	crf1df_feature_t *p = (crf1df_feature_t*)rumavl_find(set->avl, f);
-	if (p == NULL) {
-		/* Insert the feature to the feature set. */
-		rumavl_insert(set->avl, f);
-		++set->num;
+	crf1df_feature_t *p = NULL;
+
+	/* Double the number of slots to keep the load factor below 1/2. */
+	if (table->size <= table->num * 2) {
+		size_t i;
+		featuretable_t grown;
+		if (featuretable_init(&grown, table->size * 2) != 0) {
+			return CRFSUITEERR_OUTOFMEMORY;
+		}
+		for (i = 0; i < table->size; ++i) {
+			if (0 <= table->slots[i].type) {
+				*featuretable_find(grown.slots, grown.size, &table->slots[i]) = table->slots[i];
+			}
+		}
+		grown.num = table->num;
+		free(table->slots);
+		*table = grown;
+	}
+
+	p = featuretable_find(table->slots, table->size, f);
+	if (p->type < 0) {
+		/* Insert the feature to the feature table. */
+		*p = *f;
+		++table->num;
 	}
 	else {
 		/* An existing feature: add the observation expectation. */
@@ -114,14 +156,13 @@ static int featureset_add(featureset_t* set, const crf1df_feature_t* f)
 	return 0;
 }
 
-static crf1df_feature_t* featureset_generate(int *ptr_num_features, \
-	featureset_t* set, \
+static crf1df_feature_t* featuretable_generate(int *ptr_num_features, \
+	featuretable_t* table, \
 	floatval_t minfreq, \
 	crf1de_semimarkov_t *sm)
 {
-	int n = 0, k = 0;
-	RUMAVL_NODE *node = NULL;
-	crf1df_feature_t *f = NULL;
+	size_t i;
+	int n = 0, k = 0, m = 0;
 	crf1df_feature_t *features = NULL;
 
 	/* The first pass: count the number of valid features. */
@@ -133,8 +174,8 @@ static crf1df_feature_t* featureset_generate(int *ptr_num_features, \
 		}
 	}
 
-	while ((node = rumavl_node_next(set->avl, node, 1, (void**)&f)) != NULL) {
-		if (minfreq <= f->freq) {
+	for (i = 0; i < table->size; ++i) {
+		if (0 <= table->slots[i].type && minfreq <= table->slots[i].freq) {
 			++n;
 		}
 	}
@@ -159,13 +200,14 @@ static crf1df_feature_t* featureset_generate(int *ptr_num_features, \
 			}
 		}
 
-		node = NULL;
-		while ((node = rumavl_node_next(set->avl, node, 1, (void**)&f)) != NULL) {
-			if (minfreq <= f->freq) {
-				memcpy(&features[k], f, sizeof(crf1df_feature_t));
-				++k;
+		/* Feature ids follow the order of (type, src, dst). */
+		m = k;
+		for (i = 0; i < table->size; ++i) {
+			if (0 <= table->slots[i].type && minfreq <= table->slots[i].freq) {
+				memcpy(&features[k++], &table->slots[i], sizeof(crf1df_feature_t));
 			}
 		}
+		qsort(&features[m], n - m, sizeof(crf1df_feature_t), feature_comp);
 		*ptr_num_features = n;
 		return features;
 	}
@@ -175,52 +217,45 @@ static crf1df_feature_t* featureset_generate(int *ptr_num_features, \
 	}
 }
 
-crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
-	crf1de_semimarkov_t *sm, \
-	int *max_items, \
-	const crf1de_option_t *opt, \
-	const dataset_t *ds, \
-	const int ftype, \
-	const int num_labels, \
-	const crfsuite_logging_callback func, \
-	void *instance)
+/**
+ * A shard of the data set for counting features.
+ */
+typedef struct {
+	const dataset_t *ds;        /**< Data set. */
+	int begin;                  /**< Index of the first instance. */
+	int end;                    /**< Index next to the last instance. */
+	int ftype;                  /**< Type of graphical model. */
+	int num_labels;             /**< Number of labels. */
+	int connect_all_attrs;      /**< Dense state features. */
+	crf1de_semimarkov_t *sm;    /**< Semi-markov data (single shard only). */
+	logging_t *lg;              /**< Progress logger (first shard only). */
+	int max_items;              /**< Maximum length of the sequences. */
+	int ret;                    /**< Status code. */
+	featuretable_t table;       /**< Features found in the shard. */
+} featureshard_t;
+
+static void* featureshard_count(void *arg)
 {
-	int c, i, j, s, t;
+	int c, i, s, t;
 	int prev, cur, seg_len;
-
 	crf1df_feature_t f;
-	crf1df_feature_t *features = NULL;
-	featureset_t* set = NULL;
-
-	const int N = ds->num_instances;
-	const int L = num_labels;
-	const int connect_all_attrs = opt->feature_possible_states ? 1 : 0;
-	const int connect_all_edges = opt->feature_possible_transitions ? 1 : 0;
-	const int minfreq = opt->feature_minfreq;
-	const int max_order = opt->feature_max_order;
-
-	logging_t lg;
-	lg.func = func;
-	lg.instance = instance;
-	lg.percent = 0;
-
-	/* Create an instance of feature set. */
-	set = featureset_new();
-
-	/* Initialize semi-markov data storage if needed */
-	if (ftype == FTYPE_SEMIMCRF && sm->initialize(sm, max_order, opt->feature_max_seg_len, L))
-		goto final_steps;
+	featureshard_t *shard = (featureshard_t*)arg;
+	featuretable_t *table = &shard->table;
+	crf1de_semimarkov_t *sm = shard->sm;
+	const dataset_t *ds = shard->ds;
+	const int ftype = shard->ftype;
+	const int L = shard->num_labels;
+	const int connect_all_attrs = shard->connect_all_attrs;
 
 	// auxiliary variables for iteration
 	const crfsuite_item_t* item = NULL;
 	const crfsuite_node_t *node_p = NULL, *chld_node_p = NULL;
 	// iterate over training instances
-	logging_progress_start(&lg);
-	for (s = 0; s < N; ++s) {
+	for (s = shard->begin; s < shard->end; ++s) {
 		const crfsuite_instance_t* seq = dataset_get(ds, s);
 		const int T = seq->num_items;
-		if (T > *max_items)
-			*max_items = T;
+		if (T > shard->max_items)
+			shard->max_items = T;
 
 		/* reset counters */
 		prev = L; cur = 0; seg_len = 1;
@@ -247,7 +282,7 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 					f.src = seq->labels[chld_node_p->self_item_id];
 					f.dst = cur;
                     f.freq = seq->weight;
-					featureset_add(set, &f);
+					shard->ret |= featuretable_add(table, &f);
 				}
 				/* In semi-markov model, we generate all possible prefixes and affixes
 				   up to and including max order. */
@@ -268,7 +303,7 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 					f.src = prev;
 					f.dst = cur;
 					f.freq = seq->weight;
-					featureset_add(set, &f);
+					shard->ret |= featuretable_add(table, &f);
 				}
 			}
 
@@ -279,7 +314,7 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 				f.src = item->contents[c].aid;
 				f.dst = cur;
 				f.freq = seq->weight * item->contents[c].value;
-				featureset_add(set, &f);
+				shard->ret |= featuretable_add(table, &f);
 
 				/* Generate state features connecting attributes with all
 				   output labels. These features are not unobserved in the
@@ -290,7 +325,7 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 						f.src = item->contents[c].aid;
 						f.dst = i;
 						f.freq = 0;
-						featureset_add(set, &f);
+						shard->ret |= featuretable_add(table, &f);
 					}
 				}
 			}
@@ -299,9 +334,189 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 		if (ftype == FTYPE_SEMIMCRF)
 			sm->update(sm, prev, seg_len);
 
-		logging_progress(&lg, s * 100 / N);
+		if (shard->lg != NULL) {
+			logging_progress(shard->lg, \
+				(s - shard->begin) * 100 / (shard->end - shard->begin));
+		}
 	}
-	logging_progress_end(&lg);
+	return NULL;
+}
+
+/**
+ * Number of instances in a shard for counting features.
+ *  The shards do not depend on the number of threads, so that the
+ *  observation expectations are summed in the same order by any threads.
+ */
+#define    FEATURE_SHARD_SIZE    1024
+
+/**
+ * Count the features in a data set.
+ *  The data set is split into contiguous shards of FEATURE_SHARD_SIZE
+ *  instances. The threads of the option feature.threads count a round of
+ *  shards at a time, and the table receives the features merged in the
+ *  order of the shards. Therefore, the features, their ids, and their
+ *  observation expectations do not depend on the number of threads.
+ */
+static int featuretable_count(featuretable_t *table, \
+	int *max_items, \
+	crf1de_semimarkov_t *sm, \
+	const crf1de_option_t *opt, \
+	const dataset_t *ds, \
+	const int ftype, \
+	const int num_labels, \
+	logging_t *lg)
+{
+	int i, m, n, r, ret = CRFSUITEERR_OUTOFMEMORY;
+	size_t k;
+	featuretable_t merged;
+	featureshard_t *shards = NULL;
+#ifdef    HAVE_PTHREAD_H
+	pthread_t *threads = NULL;
+	char *started = NULL;
+#endif/*HAVE_PTHREAD_H*/
+	const int N = ds->num_instances;
+	const int max_order = opt->feature_max_order;
+
+	memset(&merged, 0, sizeof(merged));
+
+	/*
+	  Semi-markov data are updated in the order of instances, and must
+	  be processed in a single shard.
+	*/
+	m = (ftype == FTYPE_SEMIMCRF) ? 1 : (N + FEATURE_SHARD_SIZE - 1) / FEATURE_SHARD_SIZE;
+	if (m < 1)
+		m = 1;
+	n = (opt->feature_threads < 1) ? 1 : opt->feature_threads;
+	if (m < n)
+		n = m;
+
+	shards = (featureshard_t*)calloc(n, sizeof(featureshard_t));
+#ifdef    HAVE_PTHREAD_H
+	threads = (pthread_t*)calloc(n, sizeof(pthread_t));
+	started = (char*)calloc(n, sizeof(char));
+	if (threads == NULL || started == NULL)
+		goto final_steps;
+#endif/*HAVE_PTHREAD_H*/
+	if (shards == NULL)
+		goto final_steps;
+
+	/* Initialize semi-markov data storage if needed */
+	if (ftype == FTYPE_SEMIMCRF && sm->initialize(sm, max_order, opt->feature_max_seg_len, num_labels))
+		goto final_steps;
+
+	/* Count the features in the rounds of n shards. */
+	logging_progress_start(lg);
+	for (r = 0; r < m; r += n) {
+		const int num = (m - r < n) ? m - r : n;
+
+		for (i = 0; i < num; ++i) {
+			shards[i].ds = ds;
+			shards[i].begin = (m == 1) ? 0 : (r + i) * FEATURE_SHARD_SIZE;
+			shards[i].end = (m == 1 || N < (r + i + 1) * FEATURE_SHARD_SIZE) ?
+				N : (r + i + 1) * FEATURE_SHARD_SIZE;
+			shards[i].ftype = ftype;
+			shards[i].num_labels = num_labels;
+			shards[i].connect_all_attrs = opt->feature_possible_states ? 1 : 0;
+			shards[i].sm = (ftype == FTYPE_SEMIMCRF) ? sm : NULL;
+			shards[i].lg = (m == 1) ? lg : NULL;
+			shards[i].max_items = *max_items;
+			if ((shards[i].ret = featuretable_init(&shards[i].table, 1024)) != 0)
+				goto final_steps;
+		}
+
+#ifdef    HAVE_PTHREAD_H
+		for (i = 1; i < num; ++i) {
+			started[i] = (pthread_create(&threads[i], NULL, featureshard_count, &shards[i]) == 0);
+		}
+#endif/*HAVE_PTHREAD_H*/
+		featureshard_count(&shards[0]);
+		for (i = 1; i < num; ++i) {
+#ifdef    HAVE_PTHREAD_H
+			if (started[i]) {
+				pthread_join(threads[i], NULL);
+				started[i] = 0;
+			}
+			else
+#endif/*HAVE_PTHREAD_H*/
+			{
+				/* Count the shard in this thread if no thread was created. */
+				featureshard_count(&shards[i]);
+			}
+		}
+
+		/* Merge the shards into the table in the order of shards. */
+		for (i = 0; i < num; ++i) {
+			if (shards[i].ret != 0)
+				goto final_steps;
+			if (*max_items < shards[i].max_items)
+				*max_items = shards[i].max_items;
+			if (merged.num == 0) {
+				/* Take over the table of the first shard with features. */
+				featuretable_finish(&merged);
+				merged = shards[i].table;
+				shards[i].table.slots = NULL;
+			}
+			else {
+				for (k = 0; k < shards[i].table.size; ++k) {
+					if (0 <= shards[i].table.slots[k].type &&
+						featuretable_add(&merged, &shards[i].table.slots[k]) != 0)
+						goto final_steps;
+				}
+			}
+			featuretable_finish(&shards[i].table);
+		}
+		if (1 < m) {
+			logging_progress(lg, (r + num) * 100 / m);
+		}
+	}
+	logging_progress_end(lg);
+
+	/* Hand the merged table over to the caller. */
+	*table = merged;
+	merged.slots = NULL;
+	ret = 0;
+
+final_steps:
+	if (shards != NULL) {
+		for (i = 0; i < n; ++i) {
+			featuretable_finish(&shards[i].table);
+		}
+		free(shards);
+	}
+#ifdef    HAVE_PTHREAD_H
+	free(started);
+	free(threads);
+#endif/*HAVE_PTHREAD_H*/
+	featuretable_finish(&merged);
+	return ret;
+}
+
+crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
+	crf1de_semimarkov_t *sm, \
+	int *max_items, \
+	const crf1de_option_t *opt, \
+	const dataset_t *ds, \
+	const int ftype, \
+	const int num_labels, \
+	const crfsuite_logging_callback func, \
+	void *instance)
+{
+	int i, j;
+	crf1df_feature_t f;
+	crf1df_feature_t *features = NULL;
+	featuretable_t table;
+
+	const int L = num_labels;
+	const int connect_all_edges = opt->feature_possible_transitions ? 1 : 0;
+	const int minfreq = opt->feature_minfreq;
+
+	logging_t lg;
+	lg.func = func;
+	lg.instance = instance;
+	lg.percent = 0;
+
+	if (featuretable_count(&table, max_items, sm, opt, ds, ftype, L, &lg) != 0)
+		return NULL;
 
 	/* Generate edge features representing all pairs of labels.
 	   These features are not unobserved in the training data
@@ -317,7 +532,8 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 					f.src = i;
 					f.dst = j;
 					f.freq = 0;
-					featureset_add(set, &f);
+					if (featuretable_add(&table, &f) != 0)
+						goto final_steps;
 				}
 			}
 		}
@@ -326,15 +542,228 @@ crf1df_feature_t* crf1df_generate(int *ptr_num_features, \
 	if (ftype == FTYPE_SEMIMCRF && sm->finalize(sm))
 		goto final_steps;
 
-	/* Convert feature set to feature array. */
-	features = featureset_generate(ptr_num_features, set, minfreq, sm);
+	/* Convert feature table to feature array. */
+	features = featuretable_generate(ptr_num_features, &table, minfreq, sm);
 
-	/* Delete the feature set. */
+	/* Delete the feature table. */
 final_steps:
-	featureset_delete(set);
+	featuretable_finish(&table);
 	return features;
 }
 
+/**
+ * Features counted in each group of a data set.
+ *  A fold of cross validation trains on all groups but the holdout one;
+ *  its features are the union of the features in these groups, and their
+ *  frequencies are the sums of the group frequencies.
+ */
+struct tag_crf1df_groups {
+	int num_groups;             /**< Number of groups (G). */
+	int num_features;           /**< Number of features in all groups. */
+	int minfreq;                /**< Threshold of feature frequencies. */
+	int connect_all_edges;      /**< Nonzero to keep all transition features. */
+	crf1df_feature_t *features; /**< Features in all groups sorted in the order of ids. */
+	featuretable_t *tables;     /**< Feature frequencies in each group [G]. */
+	int *max_items;             /**< Maximum length of sequences in each group [G]. */
+	int *fold_num_features;     /**< Number of features of each fold [G]. */
+};
+
+/* Whether a feature of all groups appears in a fold (or is forced to). */
+static int crf1df_groups_fold_freq(const crf1df_groups_t *groups, \
+	const crf1df_feature_t *f, int holdout, floatval_t *freq)
+{
+	int g, present = (groups->connect_all_edges && f->type == FT_TRANS);
+	*freq = 0;
+	for (g = 0; g < groups->num_groups; ++g) {
+		const featuretable_t *table = &groups->tables[g];
+		const crf1df_feature_t *p = NULL;
+		if (g == holdout)
+			continue;
+		p = featuretable_find(table->slots, table->size, f);
+		if (0 <= p->type) {
+			*freq += p->freq;
+			present = 1;
+		}
+	}
+	return present;
+}
+
+crf1df_groups_t* crf1df_count_groups(const crf1de_option_t *opt, \
+	crfsuite_data_t *data, \
+	const int num_groups, \
+	const int ftype, \
+	const int num_labels, \
+	const crfsuite_logging_callback func, \
+	void *instance)
+{
+	int g, i, j, k;
+	size_t n;
+	crf1df_feature_t f;
+	featuretable_t all;
+	char *found = NULL;
+	floatval_t *freqs = NULL;
+	crf1df_groups_t *groups = NULL;
+	const int G = num_groups;
+	const int L = num_labels;
+
+	logging_t lg;
+	lg.func = func;
+	lg.instance = instance;
+	lg.percent = 0;
+
+	/* Semi-markov data are built from the sequences of a training set. */
+	if (ftype == FTYPE_SEMIMCRF || G <= 0)
+		return NULL;
+	if (featuretable_init(&all, 1024) != 0)
+		return NULL;
+
+	groups = (crf1df_groups_t*)calloc(1, sizeof(crf1df_groups_t));
+	if (groups == NULL)
+		goto error_exit;
+	groups->num_groups = G;
+	groups->minfreq = opt->feature_minfreq;
+	groups->connect_all_edges = opt->feature_possible_transitions ? 1 : 0;
+	groups->tables = (featuretable_t*)calloc(G, sizeof(featuretable_t));
+	groups->max_items = (int*)calloc(G, sizeof(int));
+	groups->fold_num_features = (int*)calloc(G, sizeof(int));
+	if (groups->tables == NULL || groups->max_items == NULL || groups->fold_num_features == NULL)
+		goto error_exit;
+
+	/* Count the features in each group, and collect them in one table. */
+	for (g = 0; g < G; ++g) {
+		int ret = 0;
+		dataset_t ds;
+		featuretable_t *table = &groups->tables[g];
+		dataset_init_testset(&ds, data, g);
+		ret = featuretable_count(table, &groups->max_items[g], NULL, opt, &ds, ftype, L, &lg);
+		dataset_finish(&ds);
+		if (ret != 0)
+			goto error_exit;
+		for (n = 0; n < table->size; ++n) {
+			if (0 <= table->slots[n].type && featuretable_add(&all, &table->slots[n]) != 0)
+				goto error_exit;
+		}
+	}
+	if (groups->connect_all_edges) {
+		for (i = 0; i < L; ++i) {
+			for (j = 0; j < L; ++j) {
+				f.type = FT_TRANS;
+				f.src = i;
+				f.dst = j;
+				f.freq = 0;
+				if (featuretable_add(&all, &f) != 0)
+					goto error_exit;
+			}
+		}
+	}
+
+	/* Feature ids follow the order of (type, src, dst) in every fold. */
+	groups->features = (crf1df_feature_t*)malloc(sizeof(crf1df_feature_t) * (all.num + 1));
+	if (groups->features == NULL)
+		goto error_exit;
+	for (n = 0; n < all.size; ++n) {
+		if (0 <= all.slots[n].type) {
+			groups->features[groups->num_features++] = all.slots[n];
+		}
+	}
+	qsort(groups->features, groups->num_features, sizeof(crf1df_feature_t), feature_comp);
+	featuretable_finish(&all);
+
+	/* Count the features of the folds, looking up each group only once. */
+	freqs = (floatval_t*)calloc(G, sizeof(floatval_t));
+	found = (char*)calloc(G, sizeof(char));
+	if (freqs == NULL || found == NULL)
+		goto error_exit;
+	for (i = 0; i < groups->num_features; ++i) {
+		const crf1df_feature_t *p = &groups->features[i];
+		const int forced = (groups->connect_all_edges && p->type == FT_TRANS);
+		int num_found = 0;
+		for (g = 0; g < G; ++g) {
+			const featuretable_t *table = &groups->tables[g];
+			const crf1df_feature_t *q = featuretable_find(table->slots, table->size, p);
+			found[g] = (0 <= q->type);
+			freqs[g] = found[g] ? q->freq : 0;
+			num_found += found[g];
+		}
+		for (k = 0; k < G; ++k) {
+			floatval_t freq = 0;
+			if (!forced && num_found == found[k])
+				continue;
+			for (g = 0; g < G; ++g) {
+				if (g != k)
+					freq += freqs[g];
+			}
+			if (groups->minfreq <= freq)
+				++groups->fold_num_features[k];
+		}
+	}
+	free(found);
+	free(freqs);
+	return groups;
+
+error_exit:
+	free(found);
+	free(freqs);
+	featuretable_finish(&all);
+	crf1df_delete_groups(groups);
+	return NULL;
+}
+
+int crf1df_groups_num_features(const crf1df_groups_t *groups, int holdout)
+{
+	return groups->fold_num_features[holdout];
+}
+
+crf1df_feature_t* crf1df_generate_fold(int *ptr_num_features, \
+	int *max_items, \
+	const crf1df_groups_t *groups, \
+	const int holdout)
+{
+	int g, i, k = 0;
+	crf1df_feature_t *features = NULL;
+	const int K = groups->fold_num_features[holdout];
+
+	features = (crf1df_feature_t*)calloc(K + 1, sizeof(crf1df_feature_t));
+	if (features == NULL) {
+		*ptr_num_features = 0;
+		return NULL;
+	}
+
+	for (i = 0; i < groups->num_features && k < K; ++i) {
+		floatval_t freq = 0;
+		const crf1df_feature_t *f = &groups->features[i];
+		if (crf1df_groups_fold_freq(groups, f, holdout, &freq) && groups->minfreq <= freq) {
+			features[k] = *f;
+			features[k].freq = freq;
+			++k;
+		}
+	}
+	for (g = 0; g < groups->num_groups; ++g) {
+		if (g != holdout && *max_items < groups->max_items[g])
+			*max_items = groups->max_items[g];
+	}
+
+	*ptr_num_features = k;
+	return features;
+}
+
+void crf1df_delete_groups(crf1df_groups_t *groups)
+{
+	int g;
+	if (groups != NULL) {
+		if (groups->tables != NULL) {
+			for (g = 0; g < groups->num_groups; ++g) {
+				featuretable_finish(&groups->tables[g]);
+			}
+		}
+		free(groups->fold_num_features);
+		free(groups->max_items);
+		free(groups->tables);
+		free(groups->features);
+		free(groups);
+	}
+}
+
 int crf1df_init_references(feature_refs_t **ptr_attributes,
 	feature_refs_t **ptr_trans,
 	const crf1df_feature_t *features,
@@ -30,6 +30,12 @@
 
  /* $Id$ */
 
+#ifdef    HAVE_CONFIG_H
+#include <config.h>
+#endif/*HAVE_CONFIG_H*/
+
+#include <math.h>
+#include <stdint.h>
 #include <string.h>
 #include <crfsuite.h>
 
@@ -41,16 +47,45 @@
 #define MODELTYPE_CRF1D "FOMC"
 #define MODELTYPE_SEMIM "HOSM"
 #define SM_MIN_VERSION  (101)
+#define QUANT_MIN_VERSION (102)
 #define VERSION_NUMBER  (101)
+#define VERSION_NUMBER2 (200)
+#define VERSION_NUMBER3 (300)
 #define CHUNK_LABELREF  "LFRF"
 #define CHUNK_ATTRREF   "AFRF"
 #define CHUNK_FEATURE   "FEAT"
+#define CHUNK_QFEATURE  "QFEA"
 #define CHUNK_HSMM      "HSMM"
 #define CHUNK_HSMM_SIZE 4
 #define HEADER_SIZE     52
 #define CHUNK_SIZE      12
 #define FEATURE_SIZE    20
+#define QFEATURE_SIZE(bits) (7 + (bits) / 8)
 #define HSM_CHUNK_SIZE  32
+#define HSM_CHUNK_SIZE3 40
+
+/*
+ * The format 2 (version 200) stores the features and the feature references
+ * as arrays of native types so that the reader can use them in place. Each
+ * of these chunks starts at a 64-byte boundary, and its header (encoded in
+ * the same manner as the format 1) is padded to 64 bytes. The file header
+ * is followed by a byte-order mark written in the native byte order. The
+ * CQDB chunks are written in the second CQDB format (CQDB_FASTHASH).
+ *
+ * The format 3 (version 300) is the format 2 with 64-bit sizes and offsets
+ * for models larger than 4GB: the file header appends them after the
+ * counts, the reference chunks store native uint64 offsets, the CQDB chunks
+ * are written with CQDB_OFFSET64, and the semi-markov chunk stores 64-bit
+ * offsets.
+ *
+ * The readers predating the formats 2 and 3 do not check the version and
+ * crash on these files, so that the writer uses the format 1 by default.
+ */
+#define HEADER_SIZE2    64
+#define HEADER_SIZE3    128
+#define CHUNK_SIZE2     64
+#define SECTION_ALIGN   64
+#define BYTEORDER_MARK  0x01020304
 
 enum {
 	WSTATE_NONE,
@@ -83,6 +118,21 @@ static int read_uint8(uint8_t* buffer, uint8_t* value)
 	return sizeof(*value);
 }
 
+static int write_uint16(FILE *fp, uint16_t value)
+{
+	uint8_t buffer[2];
+	buffer[0] = (uint8_t)(value & 0xFF);
+	buffer[1] = (uint8_t)(value >> 8);
+	return fwrite(buffer, sizeof(uint8_t), 2, fp) == 2 ? 0 : 1;
+}
+
+static int read_uint16(uint8_t* buffer, uint16_t* value)
+{
+	*value = ((uint16_t)buffer[0]);
+	*value |= ((uint16_t)buffer[1] << 8);
+	return sizeof(*value);
+}
+
 static int write_uint32(FILE *fp, uint32_t value)
 {
 	uint8_t buffer[4];
@@ -124,6 +174,60 @@ static int read_uint8_array(uint8_t* buffer, uint8_t *array, size_t n)
 	return ret;
 }
 
+static int write_uint64(FILE *fp, uint64_t value)
+{
+	int ret = write_uint32(fp, (uint32_t)(value & 0xFFFFFFFF));
+	return ret | write_uint32(fp, (uint32_t)(value >> 32));
+}
+
+static int read_uint64(uint8_t* buffer, uint64_t* value)
+{
+	uint32_t lo, hi;
+	read_uint32(buffer, &lo);
+	read_uint32(buffer + 4, &hi);
+	*value = ((uint64_t)hi << 32) | lo;
+	return sizeof(*value);
+}
+
+/* Write an offset in 32 or 64 bits. */
+static int write_offset(FILE *fp, uint64_t value, int wide)
+{
+	return wide ? write_uint64(fp, value) : write_uint32(fp, (uint32_t)value);
+}
+
+static int read_offset(uint8_t* buffer, uint64_t* value, int wide)
+{
+	uint32_t val;
+	if (wide) {
+		return read_uint64(buffer, value);
+	}
+	read_uint32(buffer, &val);
+	*value = val;
+	return sizeof(val);
+}
+
+static int write_native_uint32(FILE *fp, uint32_t value)
+{
+	return fwrite(&value, sizeof(value), 1, fp) == 1 ? 0 : 1;
+}
+
+/* The current position of the stream, which may exceed 4GB. */
+static uint64_t tell(FILE *fp)
+{
+	return (uint64_t)ftello(fp);
+}
+
+static uint64_t write_padding(FILE *fp, uint32_t alignment)
+{
+	uint64_t offset = tell(fp);
+	while (offset % alignment != 0) {
+		uint8_t c = 0;
+		fwrite(&c, sizeof(uint8_t), 1, fp);
+		++offset;
+	}
+	return offset;
+}
+
 static void write_float(FILE *fp, floatval_t value)
 {
 	/*
@@ -164,7 +268,19 @@ static int read_float(uint8_t* buffer, floatval_t* value)
 	return sizeof(*value);
 }
 
-crf1dmw_t* crf1mmw(const char *filename, const int ftype)
+/*
+ * The format 1 writes the CQDB chunks in the first CQDB format so that
+ * the readers predating the formats 2 and 3 can load the model.
+ */
+static int crf1dmw_cqdb_flag(const crf1dmw_t* writer)
+{
+	if (!writer->native) {
+		return CQDB_NONE;
+	}
+	return CQDB_FASTHASH | (writer->wide ? CQDB_OFFSET64 : 0);
+}
+
+crf1dmw_t* crf1mmw(const char *filename, const int ftype, const int format)
 {
 	header_t *header = NULL;
 	crf1dmw_t *writer = NULL;
@@ -190,10 +306,17 @@ crf1dmw_t* crf1mmw(const char *filename, const int ftype)
         memcpy(header->type, MODELTYPE_SEMIM, 4);
 	else
         memcpy(header->type, MODELTYPE_CRF1D, 4);
-	header->version = VERSION_NUMBER;
+	writer->native = (format != 1);
+	writer->wide = (format == 3);
+	if (writer->wide) {
+		header->version = VERSION_NUMBER3;
+	} else {
+		header->version = writer->native ? VERSION_NUMBER2 : VERSION_NUMBER;
+	}
 
 	/* Advance the file position to skip the file header. */
-	if (fseek(writer->fp, HEADER_SIZE, SEEK_CUR) != 0) {
+	if (fseek(writer->fp, writer->wide ? HEADER_SIZE3 : \
+		(writer->native ? HEADER_SIZE2 : HEADER_SIZE), SEEK_CUR) != 0) {
 		goto error_exit;
 	}
 
@@ -211,11 +334,18 @@ error_exit:
 
 int crf1dmw_close(crf1dmw_t* writer)
 {
+	int ret = 1;
 	FILE *fp = writer->fp;
 	header_t *header = &writer->header;
 
 	/* Store the file size. */
-	header->size = (uint32_t)ftell(fp);
+	header->size = tell(fp);
+
+	/* The formats 1 and 2 cannot address a file larger than 4GB. */
+	if (!writer->wide && 0xFFFFFFFF < header->size) {
+		ret = CRFSUITEERR_OVERFLOW;
+		goto error_exit;
+	}
 
 	/* Move the file position to the head. */
 	if (fseek(fp, 0, SEEK_SET) != 0) {
@@ -224,18 +354,25 @@ int crf1dmw_close(crf1dmw_t* writer)
 
 	/* Write the file header. */
 	write_uint8_array(fp, header->magic, sizeof(header->magic));
-	write_uint32(fp, header->size);
+	write_uint32(fp, writer->wide ? 0 : (uint32_t)header->size);
 	write_uint8_array(fp, header->type, sizeof(header->type));
 	write_uint32(fp, header->version);
 	write_uint32(fp, header->num_features);
 	write_uint32(fp, header->num_labels);
 	write_uint32(fp, header->num_attrs);
-	write_uint32(fp, header->off_features);
-	write_uint32(fp, header->off_labels);
-	write_uint32(fp, header->off_attrs);
-	write_uint32(fp, header->off_labelrefs);
-	write_uint32(fp, header->off_attrrefs);
-	write_uint32(fp, header->off_sm);
+	if (writer->wide) {
+		write_uint64(fp, header->size);
+	}
+	write_offset(fp, header->off_features, writer->wide);
+	write_offset(fp, header->off_labels, writer->wide);
+	write_offset(fp, header->off_attrs, writer->wide);
+	write_offset(fp, header->off_labelrefs, writer->wide);
+	write_offset(fp, header->off_attrrefs, writer->wide);
+	write_offset(fp, header->off_sm, writer->wide);
+	if (writer->native) {
+		header->byteorder = BYTEORDER_MARK;
+		write_native_uint32(fp, header->byteorder);
+	}
 
 	/* Check for any error occurrence. */
 	if (ferror(fp)) {
@@ -244,6 +381,7 @@ int crf1dmw_close(crf1dmw_t* writer)
 
 	/* Close the writer. */
 	fclose(fp);
+	free(writer->qscales);
 	free(writer);
 	return 0;
 
@@ -252,9 +390,10 @@ error_exit:
 		if (writer->fp != NULL) {
 			fclose(writer->fp);
 		}
+		free(writer->qscales);
 		free(writer);
 	}
-	return 1;
+	return ret;
 }
 
 int crf1dmw_open_labels(crf1dmw_t* writer, int num_labels)
@@ -265,10 +404,10 @@ int crf1dmw_open_labels(crf1dmw_t* writer, int num_labels)
 	}
 
 	/* Store the current offset. */
-	writer->header.off_labels = (uint32_t)ftell(writer->fp);
+	writer->header.off_labels = tell(writer->fp);
 
 	/* Open a CQDB chunk for writing. */
-	writer->dbw = cqdb_writer(writer->fp, 0);
+	writer->dbw = cqdb_writer(writer->fp, crf1dmw_cqdb_flag(writer));
 	if (writer->dbw == NULL) {
 		writer->header.off_labels = 0;
 		return 1;
@@ -287,7 +426,12 @@ int crf1dmw_close_labels(crf1dmw_t* writer)
 	}
 
 	/* Close the CQDB chunk. */
-	if (cqdb_writer_close(writer->dbw)) {
+	switch (cqdb_writer_close(writer->dbw)) {
+	case 0:
+		break;
+	case CQDB_ERROR_OVERFLOW:
+		return CRFSUITEERR_OVERFLOW;
+	default:
 		return 1;
 	}
 
@@ -304,7 +448,12 @@ int crf1dmw_put_label(crf1dmw_t* writer, int lid, const char *value)
 	}
 
 	/* Put the label. */
-	if (cqdb_writer_put(writer->dbw, value, lid)) {
+	switch (cqdb_writer_put(writer->dbw, value, lid)) {
+	case 0:
+		break;
+	case CQDB_ERROR_OVERFLOW:
+		return CRFSUITEERR_OVERFLOW;
+	default:
 		return 1;
 	}
 
@@ -319,10 +468,10 @@ int crf1dmw_open_attrs(crf1dmw_t* writer, int num_attrs)
 	}
 
 	/* Store the current offset. */
-	writer->header.off_attrs = (uint32_t)ftell(writer->fp);
+	writer->header.off_attrs = tell(writer->fp);
 
 	/* Open a CQDB chunk for writing. */
-	writer->dbw = cqdb_writer(writer->fp, 0);
+	writer->dbw = cqdb_writer(writer->fp, crf1dmw_cqdb_flag(writer));
 	if (writer->dbw == NULL) {
 		writer->header.off_attrs = 0;
 		return 1;
@@ -341,7 +490,12 @@ int crf1dmw_close_attrs(crf1dmw_t* writer)
 	}
 
 	/* Close the CQDB chunk. */
-	if (cqdb_writer_close(writer->dbw)) {
+	switch (cqdb_writer_close(writer->dbw)) {
+	case 0:
+		break;
+	case CQDB_ERROR_OVERFLOW:
+		return CRFSUITEERR_OVERFLOW;
+	default:
 		return 1;
 	}
 
@@ -358,7 +512,12 @@ int crf1dmw_put_attr(crf1dmw_t* writer, int aid, const char *value)
 	}
 
 	/* Put the attribute. */
-	if (cqdb_writer_put(writer->dbw, value, aid)) {
+	switch (cqdb_writer_put(writer->dbw, value, aid)) {
+	case 0:
+		break;
+	case CQDB_ERROR_OVERFLOW:
+		return CRFSUITEERR_OVERFLOW;
+	default:
 		return 1;
 	}
 
@@ -367,10 +526,11 @@ int crf1dmw_put_attr(crf1dmw_t* writer, int aid, const char *value)
 
 int crf1dmw_open_labelrefs(crf1dmw_t* writer, int num_labels)
 {
-	uint32_t offset;
+	uint64_t offset;
 	FILE *fp = writer->fp;
 	featureref_header_t* href = NULL;
-	size_t size = CHUNK_SIZE + sizeof(uint32_t) * num_labels;
+	size_t size = (writer->native ? CHUNK_SIZE2 : CHUNK_SIZE) + \
+		(writer->wide ? sizeof(uint64_t) : sizeof(uint32_t)) * num_labels;
 
 	/* Check if we aren't writing anything at this moment. */
 	if (writer->state != WSTATE_NONE) {
@@ -378,18 +538,14 @@ int crf1dmw_open_labelrefs(crf1dmw_t* writer, int num_labels)
 	}
 
 	/* Allocate a feature reference array. */
-	href = (featureref_header_t*)calloc(size, 1);
+	href = (featureref_header_t*)calloc(1, sizeof(featureref_header_t) + \
+		sizeof(uint64_t) * num_labels);
 	if (href == NULL) {
 		return CRFSUITEERR_OUTOFMEMORY;
 	}
 
-	/* Align the offset to a DWORD boundary. */
-	offset = (uint32_t)ftell(fp);
-	while (offset % 4 != 0) {
-		uint8_t c = 0;
-		fwrite(&c, sizeof(uint8_t), 1, fp);
-		++offset;
-	}
+	/* Align the offset to a DWORD (or section) boundary. */
+	offset = write_padding(fp, writer->native ? SECTION_ALIGN : 4);
 
 	/* Store the current offset position to the file header. */
 	writer->header.off_labelrefs = offset;
@@ -410,7 +566,7 @@ int crf1dmw_close_labelrefs(crf1dmw_t* writer)
 	uint32_t i;
 	FILE *fp = writer->fp;
 	featureref_header_t* href = writer->href;
-	uint32_t begin = writer->header.off_labelrefs, end = 0;
+	uint64_t begin = writer->header.off_labelrefs, end = 0;
 
 	/* Make sure that we are writing label feature references. */
 	if (writer->state != WSTATE_LABELREFS) {
@@ -418,22 +574,32 @@ int crf1dmw_close_labelrefs(crf1dmw_t* writer)
 	}
 
 	/* Store the current offset position. */
-	end = (uint32_t)ftell(fp);
+	end = tell(fp);
 
-	/* Compute the size of this chunk. */
-	href->size = (end - begin);
+	/* Compute the size of this chunk (which is truncated in the format 3). */
+	href->size = (uint32_t)(end - begin);
 
 	/* Write the chunk header and offset array. */
-	fseek(fp, begin, SEEK_SET);
+	fseeko(fp, begin, SEEK_SET);
 	write_uint8_array(fp, href->chunk, 4);
 	write_uint32(fp, href->size);
 	write_uint32(fp, href->num);
-	for (i = 0; i < href->num; ++i) {
-		write_uint32(fp, href->offsets[i]);
+	if (writer->wide) {
+		fseeko(fp, begin + CHUNK_SIZE2, SEEK_SET);
+		fwrite(href->offsets, sizeof(uint64_t), href->num, fp);
+	} else if (writer->native) {
+		fseeko(fp, begin + CHUNK_SIZE2, SEEK_SET);
+		for (i = 0; i < href->num; ++i) {
+			write_native_uint32(fp, (uint32_t)href->offsets[i]);
+		}
+	} else {
+		for (i = 0; i < href->num; ++i) {
+			write_uint32(fp, (uint32_t)href->offsets[i]);
+		}
 	}
 
 	/* Move the file pointer to the tail. */
-	fseek(fp, end, SEEK_SET);
+	fseeko(fp, end, SEEK_SET);
 
 	/* Uninitialize. */
 	free(href);
@@ -455,7 +621,7 @@ int crf1dmw_put_labelref(crf1dmw_t* writer, int lid, const feature_refs_t* ref,
 	}
 
 	/* Store the current offset to the offset array. */
-	href->offsets[lid] = ftell(fp);
+	href->offsets[lid] = tell(fp);
 
 	/* Count the number of references to active features. */
 	for (i = 0; i < ref->num_features; ++i) {
@@ -463,10 +629,18 @@ int crf1dmw_put_labelref(crf1dmw_t* writer, int lid, const feature_refs_t* ref,
 	}
 
 	/* Write the feature reference. */
-	write_uint32(fp, (uint32_t)n);
-	for (i = 0; i < ref->num_features; ++i) {
-		fid = map[ref->fids[i]];
-		if (0 <= fid) write_uint32(fp, (uint32_t)fid);
+	if (writer->native) {
+		write_native_uint32(fp, (uint32_t)n);
+		for (i = 0; i < ref->num_features; ++i) {
+			fid = map[ref->fids[i]];
+			if (0 <= fid) write_native_uint32(fp, (uint32_t)fid);
+		}
+	} else {
+		write_uint32(fp, (uint32_t)n);
+		for (i = 0; i < ref->num_features; ++i) {
+			fid = map[ref->fids[i]];
+			if (0 <= fid) write_uint32(fp, (uint32_t)fid);
+		}
 	}
 
 	return 0;
@@ -474,10 +648,11 @@ int crf1dmw_put_labelref(crf1dmw_t* writer, int lid, const feature_refs_t* ref,
 
 int crf1dmw_open_attrrefs(crf1dmw_t* writer, int num_attrs)
 {
-	uint32_t offset;
+	uint64_t offset;
 	FILE *fp = writer->fp;
 	featureref_header_t* href = NULL;
-	size_t size = CHUNK_SIZE + sizeof(uint32_t) * num_attrs;
+	size_t size = (writer->native ? CHUNK_SIZE2 : CHUNK_SIZE) + \
+		(writer->wide ? sizeof(uint64_t) : sizeof(uint32_t)) * num_attrs;
 
 	/* Check if we aren't writing anything at this moment. */
 	if (writer->state != WSTATE_NONE) {
@@ -485,18 +660,14 @@ int crf1dmw_open_attrrefs(crf1dmw_t* writer, int num_attrs)
 	}
 
 	/* Allocate a feature reference array. */
-	href = (featureref_header_t*)calloc(size, 1);
+	href = (featureref_header_t*)calloc(1, sizeof(featureref_header_t) + \
+		sizeof(uint64_t) * num_attrs);
 	if (href == NULL) {
 		return CRFSUITEERR_OUTOFMEMORY;
 	}
 
-	/* Align the offset to a DWORD boundary. */
-	offset = (uint32_t)ftell(fp);
-	while (offset % 4 != 0) {
-		uint8_t c = 0;
-		fwrite(&c, sizeof(uint8_t), 1, fp);
-		++offset;
-	}
+	/* Align the offset to a DWORD (or section) boundary. */
+	offset = write_padding(fp, writer->native ? SECTION_ALIGN : 4);
 
 	/* Store the current offset position to the file header. */
 	writer->header.off_attrrefs = offset;
@@ -517,7 +688,7 @@ int crf1dmw_close_attrrefs(crf1dmw_t* writer)
 	uint32_t i;
 	FILE *fp = writer->fp;
 	featureref_header_t* href = writer->href;
-	uint32_t begin = writer->header.off_attrrefs, end = 0;
+	uint64_t begin = writer->header.off_attrrefs, end = 0;
 
 	/* Make sure that we are writing attribute feature references. */
 	if (writer->state != WSTATE_ATTRREFS) {
@@ -525,22 +696,32 @@ int crf1dmw_close_attrrefs(crf1dmw_t* writer)
 	}
 
 	/* Store the current offset position. */
-	end = (uint32_t)ftell(fp);
+	end = tell(fp);
 
-	/* Compute the size of this chunk. */
-	href->size = (end - begin);
+	/* Compute the size of this chunk (which is truncated in the format 3). */
+	href->size = (uint32_t)(end - begin);
 
 	/* Write the chunk header and offset array. */
-	fseek(fp, begin, SEEK_SET);
+	fseeko(fp, begin, SEEK_SET);
 	write_uint8_array(fp, href->chunk, 4);
 	write_uint32(fp, href->size);
 	write_uint32(fp, href->num);
-	for (i = 0; i < href->num; ++i) {
-		write_uint32(fp, href->offsets[i]);
+	if (writer->wide) {
+		fseeko(fp, begin + CHUNK_SIZE2, SEEK_SET);
+		fwrite(href->offsets, sizeof(uint64_t), href->num, fp);
+	} else if (writer->native) {
+		fseeko(fp, begin + CHUNK_SIZE2, SEEK_SET);
+		for (i = 0; i < href->num; ++i) {
+			write_native_uint32(fp, (uint32_t)href->offsets[i]);
+		}
+	} else {
+		for (i = 0; i < href->num; ++i) {
+			write_uint32(fp, (uint32_t)href->offsets[i]);
+		}
 	}
 
 	/* Move the file pointer to the tail. */
-	fseek(fp, end, SEEK_SET);
+	fseeko(fp, end, SEEK_SET);
 
 	/* Uninitialize. */
 	free(href);
@@ -562,7 +743,7 @@ int crf1dmw_put_attrref(crf1dmw_t* writer, int aid, const feature_refs_t* ref, i
 	}
 
 	/* Store the current offset to the offset array. */
-	href->offsets[aid] = ftell(fp);
+	href->offsets[aid] = tell(fp);
 
 	/* Count the number of references to active features. */
 	for (i = 0; i < ref->num_features; ++i) {
@@ -570,10 +751,18 @@ int crf1dmw_put_attrref(crf1dmw_t* writer, int aid, const feature_refs_t* ref, i
 	}
 
 	/* Write the feature reference. */
-	write_uint32(fp, (uint32_t)n);
-	for (i = 0; i < ref->num_features; ++i) {
-		fid = map[ref->fids[i]];
-		if (0 <= fid) write_uint32(fp, (uint32_t)fid);
+	if (writer->native) {
+		write_native_uint32(fp, (uint32_t)n);
+		for (i = 0; i < ref->num_features; ++i) {
+			fid = map[ref->fids[i]];
+			if (0 <= fid) write_native_uint32(fp, (uint32_t)fid);
+		}
+	} else {
+		write_uint32(fp, (uint32_t)n);
+		for (i = 0; i < ref->num_features; ++i) {
+			fid = map[ref->fids[i]];
+			if (0 <= fid) write_uint32(fp, (uint32_t)fid);
+		}
 	}
 
 	return 0;
@@ -595,10 +784,26 @@ int crf1dmw_open_features(crf1dmw_t* writer)
 		return CRFSUITEERR_OUTOFMEMORY;
 	}
 
-	writer->header.off_features = (uint32_t)ftell(fp);
-	fseek(fp, CHUNK_SIZE, SEEK_CUR);
+	if (writer->native) {
+		writer->header.off_features = write_padding(fp, SECTION_ALIGN);
+		fseek(fp, CHUNK_SIZE2, SEEK_CUR);
+	} else {
+		writer->header.off_features = tell(fp);
+		fseek(fp, CHUNK_SIZE, SEEK_CUR);
+	}
 
-	memcpy(hfeat->chunk, CHUNK_FEATURE, 4);
+	if (0 < writer->qbits) {
+		/* Quantized weights are preceded by the scales of the labels. */
+		int i;
+		memcpy(hfeat->chunk, CHUNK_QFEATURE, 4);
+		write_uint32(fp, (uint32_t)writer->qbits);
+		write_uint32(fp, (uint32_t)writer->num_qscales);
+		for (i = 0; i < writer->num_qscales; ++i) {
+			write_float(fp, writer->qscales[i]);
+		}
+	} else {
+		memcpy(hfeat->chunk, CHUNK_FEATURE, 4);
+	}
 	writer->hfeat = hfeat;
 
 	writer->state = WSTATE_FEATURES;
@@ -609,7 +814,7 @@ int crf1dmw_close_features(crf1dmw_t* writer)
 {
 	FILE *fp = writer->fp;
 	feature_header_t* hfeat = writer->hfeat;
-	uint32_t begin = writer->header.off_features, end = 0;
+	uint64_t begin = writer->header.off_features, end = 0;
 
 	/* Make sure that we are writing attribute feature references. */
 	if (writer->state != WSTATE_FEATURES) {
@@ -617,19 +822,22 @@ int crf1dmw_close_features(crf1dmw_t* writer)
 	}
 
 	/* Store the current offset position. */
-	end = (uint32_t)ftell(fp);
+	end = tell(fp);
 
-	/* Compute the size of this chunk. */
-	hfeat->size = (end - begin);
+	/* Compute the size of this chunk (which is truncated in the format 3). */
+	hfeat->size = (uint32_t)(end - begin);
 
 	/* Write the chunk header and offset array. */
-	fseek(fp, begin, SEEK_SET);
+	fseeko(fp, begin, SEEK_SET);
 	write_uint8_array(fp, hfeat->chunk, 4);
 	write_uint32(fp, hfeat->size);
 	write_uint32(fp, hfeat->num);
+	if (writer->native) {
+		writer->header.num_features = hfeat->num;
+	}
 
 	/* Move the file pointer to the tail. */
-	fseek(fp, end, SEEK_SET);
+	fseeko(fp, end, SEEK_SET);
 
 	/* Uninitialize. */
 	free(hfeat);
@@ -653,35 +861,144 @@ int crf1dmw_put_feature(crf1dmw_t* writer, int fid, const crf1dm_feature_t* f)
 		return CRFSUITEERR_INTERNAL_LOGIC;
 	}
 
-	write_uint32(fp, f->type);
-	write_uint32(fp, f->src);
-	write_uint32(fp, f->dst);
-	write_float(fp, f->weight);
+	if (0 < writer->qbits) {
+		int q = crf1dm_quantize(f->weight, writer->qscales[f->dst], writer->qbits);
+		write_uint32(fp, f->src);
+		write_uint16(fp, (uint16_t)f->dst);
+		write_uint8(fp, (uint8_t)f->type);
+		if (writer->qbits == 8) {
+			write_uint8(fp, (uint8_t)(int8_t)q);
+		} else {
+			write_uint16(fp, (uint16_t)(int16_t)q);
+		}
+	} else if (writer->native) {
+		native_feature_t nf;
+		nf.type = (uint32_t)f->type;
+		nf.src = (uint32_t)f->src;
+		nf.dst = (uint32_t)f->dst;
+		nf.reserved = 0;
+		nf.weight = (double)f->weight;
+		fwrite(&nf, sizeof(nf), 1, fp);
+	} else {
+		write_uint32(fp, f->type);
+		write_uint32(fp, f->src);
+		write_uint32(fp, f->dst);
+		write_float(fp, f->weight);
+	}
 	++hfeat->num;
 	return 0;
 }
 
+int crf1dmw_set_quantization(crf1dmw_t* writer, int bits, const floatval_t *scales, int num_scales)
+{
+	/* The quantization must be set before writing the features. */
+	if (writer->state != WSTATE_NONE || writer->hfeat != NULL) {
+		return CRFSUITEERR_INTERNAL_LOGIC;
+	}
+	/* Labels are stored in 16 bits in a quantized feature chunk. */
+	if ((bits != 8 && bits != 16) || 0xFFFF < num_scales) {
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
+
+	writer->qscales = (floatval_t*)malloc(sizeof(floatval_t) * num_scales);
+	if (writer->qscales == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	memcpy(writer->qscales, scales, sizeof(floatval_t) * num_scales);
+	writer->num_qscales = num_scales;
+	writer->qbits = bits;
+	if (!writer->native) {
+		writer->header.version = QUANT_MIN_VERSION;
+	}
+	return 0;
+}
+
+size_t crf1dm_feature_size(int format, int bits)
+{
+	if (0 < bits) {
+		return QFEATURE_SIZE(bits);
+	}
+	return (format != 1) ? sizeof(native_feature_t) : FEATURE_SIZE;
+}
+
+size_t crf1dm_base_size(int format, int bits, int num_labels)
+{
+	/* The scales of the labels in a quantized feature chunk. */
+	const size_t scales = (0 < bits) ? 2 * sizeof(uint32_t) + 8 * (size_t)num_labels : 0;
+
+	/* The file header, chunk headers, and two empty CQDBs. */
+	if (format == 3) {
+		return HEADER_SIZE3 + 3 * (CHUNK_SIZE2 + SECTION_ALIGN) + CHUNK_SIZE + 2 * (40 + 12 * 256) + scales;
+	}
+	if (format != 1) {
+		return HEADER_SIZE2 + 3 * (CHUNK_SIZE2 + SECTION_ALIGN) + CHUNK_SIZE + 2 * (24 + 8 * 256) + scales;
+	}
+	/* The reference chunks are aligned to DWORD boundaries. */
+	return HEADER_SIZE + 4 * CHUNK_SIZE + 2 * (24 + 8 * 256) + 2 * 3 + scales;
+}
+
+size_t crf1dm_string_size(int format, size_t length)
+{
+	/*
+		A record (id, size, and the string), buckets, and a backlink in the
+		CQDB, and an offset and the number of features in the references.
+		The second CQDB format has up to four buckets for a string.
+	 */
+	if (format == 3) {
+		return 8 + length + 1 + 4 * 12 + 8 + 8 + 4;
+	}
+	if (format != 1) {
+		return 8 + length + 1 + 4 * 8 + 4 + 4 + 4;
+	}
+	return 8 + length + 1 + 2 * 8 + 4 + 4 + 4;
+}
+
+size_t crf1dm_sm_size(int format, const crf1de_semimarkov_t *sm)
+{
+	size_t s, size = 0;
+
+	/* The padding, the chunk header, and the offsets of the states. */
+	if (format == 3) {
+		size = 3 + HSM_CHUNK_SIZE3 + sizeof(uint64_t) * sm->m_num_frw;
+	} else {
+		size = 3 + HSM_CHUNK_SIZE + sizeof(uint32_t) * sm->m_num_frw;
+	}
+	/* The maximum segment lengths of the labels, and the suffixes. */
+	size += sizeof(uint32_t) * (sm->L + sm->m_num_suffixes);
+	/* The label sequence, prefixes, and suffixes of each state. */
+	for (s = 0; s < sm->m_num_frw; ++s) {
+		const crf1de_state_t *state = &sm->m_frw_states[s];
+		size += sizeof(uint32_t) * (2 + state->m_len + 2 * state->m_num_affixes);
+	}
+	return size;
+}
+
+int crf1dm_quantize(floatval_t weight, floatval_t scale, int bits)
+{
+	const int qmax = (1 << (bits - 1)) - 1;
+	int q = (0 < scale) ? (int)floor(weight / scale + 0.5) : 0;
+	return (q < -qmax) ? -qmax : ((qmax < q) ? qmax : q);
+}
+
 int crf1dmw_open_sm(crf1dmw_t *writer, const crf1de_semimarkov_t *a_sm)
 {
 	/* Check that we are not writing anything at this moment. */
 	if (writer->state != WSTATE_NONE) {
 		return CRFSUITEERR_INTERNAL_LOGIC;
 	}
-	size_t size = HSM_CHUNK_SIZE + sizeof(uint32_t) * a_sm->m_num_frw;
+	size_t size = writer->wide ?
+		HSM_CHUNK_SIZE3 + sizeof(uint64_t) * a_sm->m_num_frw :
+		HSM_CHUNK_SIZE + sizeof(uint32_t) * a_sm->m_num_frw;
 
-	sm_header_t* hsm = (sm_header_t *)calloc(1, size);
+	sm_header_t* hsm = (sm_header_t *)calloc(1, sizeof(sm_header_t) + \
+		sizeof(uint64_t) * a_sm->m_num_frw);
 	if (hsm == NULL) {
 		return CRFSUITEERR_OUTOFMEMORY;
 	}
 
 	/* Align the offset to a DWORD boundary. */
 	FILE *fp = writer->fp;
-	uint8_t c = 0;
-	uint32_t offset = (uint32_t)ftell(fp);
-	while (offset % 4 != 0) {
-		fwrite(&c, sizeof(uint8_t), 1, fp);
-		++offset;
-	}
+	uint64_t offset = write_padding(fp, 4);
 
 	/* Store current offset position in file header. */
 	writer->header.off_sm = offset;
@@ -703,7 +1020,7 @@ int crf1dmw_open_sm(crf1dmw_t *writer, const crf1de_semimarkov_t *a_sm)
 	writer->state = WSTATE_SM;
 
 	/* Write maximum segment length for each label. */
-	hsm->off_max_seg_len = (uint32_t)ftell(fp);
+	hsm->off_max_seg_len = tell(fp);
 	uint32_t max_seg_len = 0;
 	for (size_t i = 0; i < a_sm->L; ++i) {
 		max_seg_len = (uint32_t)a_sm->m_max_seg_len[i];
@@ -714,7 +1031,7 @@ int crf1dmw_open_sm(crf1dmw_t *writer, const crf1de_semimarkov_t *a_sm)
 	/* Write array of sufixes. */
 	int ptrn_id = 0;
 	uint32_t pk_id = 0;
-	hsm->off_suffixes = (uint32_t)ftell(fp);
+	hsm->off_suffixes = tell(fp);
 	/* fprintf(stderr, "a_sm->m_num_suffixes = %d"); */
 	for (size_t i = 0; i < a_sm->m_num_suffixes; ++i) {
 		ptrn_id = a_sm->m_suffixes[i];
@@ -739,8 +1056,8 @@ int crf1dmw_close_sm(crf1dmw_t* writer)
 	int ret = 0;
 	FILE *fp = writer->fp;
 	sm_header_t *hsm = writer->hsm;
-	uint32_t begin = writer->header.off_sm;
-	uint32_t end = (uint32_t)ftell(fp);
+	uint64_t begin = writer->header.off_sm;
+	uint64_t end = tell(fp);
 
 	/* Make sure that we are writing the semi-markov model. */
 	if (writer->state != WSTATE_SM) {
@@ -749,7 +1066,7 @@ int crf1dmw_close_sm(crf1dmw_t* writer)
 	}
 
 	/* Write the chunk header and offset array. */
-	if (fseek(fp, begin, SEEK_SET) == -1) {
+	if (fseeko(fp, begin, SEEK_SET) == -1) {
 		ret = 1;
 		goto error_exit;
 	}
@@ -759,11 +1076,10 @@ int crf1dmw_close_sm(crf1dmw_t* writer)
 	write_uint32(fp, hsm->num_states);
 	write_uint32(fp, hsm->num_bkw_states);
 	write_uint32(fp, hsm->num_suffixes);
-	write_uint32(fp, hsm->off_max_seg_len);
-	write_uint32(fp, hsm->off_suffixes);
+	write_offset(fp, hsm->off_max_seg_len, writer->wide);
+	write_offset(fp, hsm->off_suffixes, writer->wide);
 	for (uint32_t i = 0; i < hsm->num_states; ++i) {
-		/* fprintf(stderr, "crf1dmw_close_sm: hsm->off_states[%u] = %u\n", i, hsm->off_states[i]); */
-		write_uint32(fp, hsm->off_states[i]);
+		write_offset(fp, hsm->off_states[i], writer->wide);
 	}
 
 	if (ferror(fp)) {
@@ -771,7 +1087,7 @@ int crf1dmw_close_sm(crf1dmw_t* writer)
 		goto error_exit;
 	}
 	/* Move the file pointer to the end of file. */
-	fseek(fp, end, SEEK_SET);
+	fseeko(fp, end, SEEK_SET);
 
 	/* Uninitialize. */
 error_exit:
@@ -800,8 +1116,7 @@ int crf1dmw_put_sm_state(crf1dmw_t* writer, int sid, \
 	}
 
 	/* Store the current offset to the offset array. */
-	hsm->off_states[sid] = (uint32_t)ftell(fp);
-	/* fprintf(stderr, "crf1dmw_put_sm_state: hsm->off_states[%d] = %u\n", sid, hsm->off_states[sid]); */
+	hsm->off_states[sid] = tell(fp);
 
 	/* Write information about state. */
 	/* id of corresponding feature */
@@ -834,7 +1149,7 @@ int crf1dmw_put_sm_state(crf1dmw_t* writer, int sid, \
 	return 0;
 }
 
-static crf1de_semimarkov_t *crf1dm_get_sm(void *buffer, void *sm_buffer, size_t size)
+static crf1de_semimarkov_t *crf1dm_get_sm(void *buffer, void *sm_buffer, size_t size, int wide)
 {
 	/* The minimum size of a valid semi-markov model is the size of its
 	   header */
@@ -857,8 +1172,8 @@ static crf1de_semimarkov_t *crf1dm_get_sm(void *buffer, void *sm_buffer, size_t
 	p += read_uint32(p, &hsm.num_states);
 	p += read_uint32(p, &hsm.num_bkw_states);
 	p += read_uint32(p, &hsm.num_suffixes);
-	p += read_uint32(p, &hsm.off_max_seg_len);
-	p += read_uint32(p, &hsm.off_suffixes);
+	p += read_offset(p, &hsm.off_max_seg_len, wide);
+	p += read_offset(p, &hsm.off_suffixes, wide);
 	/* fprintf(stderr, "crf1dm_get_sm: hsm read\n"); */
 
 	if (hsm.max_order >= CRFSUITE_SM_MAX_PTRN_LEN) {
@@ -890,6 +1205,7 @@ static crf1de_semimarkov_t *crf1dm_get_sm(void *buffer, void *sm_buffer, size_t
 
 	/* populate forward states of semi-markov model */
 	uint32_t val;
+	uint64_t offset;
 	uint8_t *saved_state = NULL;
 	size_t i = 0, trans1_c = 0, trans2_c = 0;
 	crf1de_state_t *sm_state = NULL;
@@ -898,9 +1214,8 @@ static crf1de_semimarkov_t *crf1dm_get_sm(void *buffer, void *sm_buffer, size_t
 		/* obtain addresses of semi-markov and saved state */
 		sm_state = &sm->m_frw_states[sm->m_num_frw];
 		/* fprintf(stderr, "crf1dm_get_sm: sm_state = %p\n", sm_state); */
-		p += read_uint32(p, &val);
-		/* fprintf(stderr, "crf1dm_get_sm: val = %u\n", val); */
-		saved_state = model_buffer + val;
+		p += read_offset(p, &offset, wide);
+		saved_state = model_buffer + offset;
 		/* fprintf(stderr, "crf1dm_get_sm: saved_state = %p\n", saved_state); */
 		/* obtain feature id and value */
 		/* saved_state += read_uint32(saved_state, &val); */
@@ -973,8 +1288,26 @@ error_exit:
 	return NULL;
 }
 
-crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t size, const int ftype) 
+/**
+ * Obtain a native array in the formats 2 and 3 after checking its bounds.
+ */
+static const void* crf1dm_native_array(crf1dm_t* model, uint64_t offset, size_t elem_size)
+{
+	uint32_t num = 0;
+	if (offset == 0 || model->size < offset + CHUNK_SIZE2) {
+		return NULL;
+	}
+	read_uint32(model->buffer + offset + 8, &num);
+	if ((model->size - offset - CHUNK_SIZE2) / elem_size < num) {
+		return NULL;
+	}
+	return model->buffer + offset + CHUNK_SIZE2;
+}
+
+crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, size_t size, const int ftype) 
 {
+	int wide = 0;
+	uint32_t size32 = 0;
 	uint8_t* p = NULL;
 	crf1dm_t *model = NULL;
 	header_t *header = NULL;
@@ -1000,7 +1333,8 @@ crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t
 
 	p = model->buffer;
 	p += read_uint8_array(p, header->magic, sizeof(header->magic));
-	p += read_uint32(p, &header->size);
+	p += read_uint32(p, &size32);
+	header->size = size32;
 	p += read_uint8_array(p, header->type, sizeof(header->type));
 	const char *htype = (const char *)header->type;
 	if ((ftype == FTYPE_CRF1TREE && \
@@ -1017,15 +1351,98 @@ crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t
 	p += read_uint32(p, &header->num_features);
 	p += read_uint32(p, &header->num_labels);
 	p += read_uint32(p, &header->num_attrs);
-	p += read_uint32(p, &header->off_features);
-	p += read_uint32(p, &header->off_labels);
-	p += read_uint32(p, &header->off_attrs);
-	p += read_uint32(p, &header->off_labelrefs);
-	p += read_uint32(p, &header->off_attrrefs);
+	if (header->version >= VERSION_NUMBER3) {
+		/* The format 3 stores the file size and offsets in 64 bits. */
+		wide = 1;
+		if (model->size < HEADER_SIZE3) {
+			goto error_exit;
+		}
+		p += read_uint64(p, &header->size);
+	}
+	p += read_offset(p, &header->off_features, wide);
+	p += read_offset(p, &header->off_labels, wide);
+	p += read_offset(p, &header->off_attrs, wide);
+	p += read_offset(p, &header->off_labelrefs, wide);
+	p += read_offset(p, &header->off_attrrefs, wide);
 	if (header->version >= SM_MIN_VERSION)
-		p += read_uint32(p, &header->off_sm);
+		p += read_offset(p, &header->off_sm, wide);
 	model->header = header;
 
+	if (header->version >= VERSION_NUMBER2) {
+		/* The arrays are usable only in the byte order of this machine. */
+		memcpy(&header->byteorder, p, sizeof(header->byteorder));
+		if (header->byteorder != BYTEORDER_MARK) {
+			fprintf(stderr, "ERROR: The model was stored in a different byte order.\n");
+			goto error_exit;
+		}
+
+		/* Copy a model in the memory that is not aligned for the arrays. */
+		if ((uintptr_t)model->buffer % sizeof(double) != 0) {
+			uint8_t *aligned = NULL;
+			model->buffer_orig = (uint8_t*)malloc(model->size + SECTION_ALIGN);
+			if (model->buffer_orig == NULL) {
+				goto error_exit;
+			}
+			aligned = model->buffer_orig;
+			while ((uintptr_t)aligned % SECTION_ALIGN != 0) {
+				++aligned;
+			}
+			memcpy(aligned, model->buffer, model->size);
+			model->buffer = aligned;
+		}
+
+		model->native = 1;
+		if (model->size < header->off_features + CHUNK_SIZE2) {
+			goto error_exit;
+		}
+		if (memcmp(model->buffer + header->off_features, CHUNK_FEATURE, 4) == 0) {
+			model->features = (const native_feature_t*)crf1dm_native_array(
+				model, header->off_features, sizeof(native_feature_t));
+			if (model->features == NULL) {
+				goto error_exit;
+			}
+		}
+		if (wide) {
+			model->labelrefs64 = (const uint64_t*)crf1dm_native_array(
+				model, header->off_labelrefs, sizeof(uint64_t));
+			model->attrrefs64 = (const uint64_t*)crf1dm_native_array(
+				model, header->off_attrrefs, sizeof(uint64_t));
+			if (model->labelrefs64 == NULL || model->attrrefs64 == NULL) {
+				goto error_exit;
+			}
+		} else {
+			model->labelrefs = (const uint32_t*)crf1dm_native_array(
+				model, header->off_labelrefs, sizeof(uint32_t));
+			model->attrrefs = (const uint32_t*)crf1dm_native_array(
+				model, header->off_attrrefs, sizeof(uint32_t));
+			if (model->labelrefs == NULL || model->attrrefs == NULL) {
+				goto error_exit;
+			}
+		}
+	}
+
+	/* Read the scales of a quantized feature chunk. */
+	p = model->buffer + header->off_features;
+	if (header->version >= QUANT_MIN_VERSION && \
+		memcmp(p, CHUNK_QFEATURE, 4) == 0) {
+		uint32_t i, bits, num_scales;
+		p += model->native ? CHUNK_SIZE2 : CHUNK_SIZE;
+		p += read_uint32(p, &bits);
+		p += read_uint32(p, &num_scales);
+		if (bits != 8 && bits != 16) {
+			goto error_exit;
+		}
+		model->qscales = (floatval_t*)calloc(num_scales, sizeof(floatval_t));
+		if (model->qscales == NULL) {
+			goto error_exit;
+		}
+		for (i = 0; i < num_scales; ++i) {
+			p += read_float(p, &model->qscales[i]);
+		}
+		model->qbits = (int)bits;
+		model->off_qfeatures = (uint64_t)(p - model->buffer);
+	}
+
 	model->labels = cqdb_reader(
 		model->buffer + header->off_labels,
 		model->size - header->off_labels
@@ -1038,7 +1455,7 @@ crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t
 	if (header->off_sm) {
 		/* fprintf(stderr, "crf1dm_new: calling crf1dm_get_sm()\n"); */
 		model->sm = crf1dm_get_sm(model->buffer, model->buffer + header->off_sm, \
-			model->size - header->off_sm);
+			model->size - header->off_sm, wide);
 		/* fprintf(stderr, "crf1dm_new: crf1dm_get_sm() finished\n"); */
 	}
 	else {
@@ -1046,6 +1463,12 @@ crf1dm_t* crf1dm_new_impl(uint8_t* buffer_orig, const uint8_t* buffer, uint32_t
 	}
 	return model;
 error_exit:
+	if (model != NULL) {
+		free(model->qscales);
+		if (model->buffer_orig != buffer_orig) {
+			free(model->buffer_orig);
+		}
+	}
 	free(header);
 	free(model);
 	free(buffer_orig);
@@ -1055,7 +1478,8 @@ error_exit:
 crf1dm_t* crf1dm_new(const char *filename, const int ftype)
 {
 	FILE *fp = NULL;
-	uint32_t size = 0;
+	size_t size = 0;
+	int64_t end = 0;
 	uint8_t* buffer_orig = NULL;
 	uint8_t* buffer = NULL;
 
@@ -1063,17 +1487,23 @@ crf1dm_t* crf1dm_new(const char *filename, const int ftype)
 	if (fp == NULL)
 		goto error_exit;
 	
-	fseek(fp, 0, SEEK_END);
-	size = (uint32_t)ftell(fp);
-	fseek(fp, 0, SEEK_SET);
+	fseeko(fp, 0, SEEK_END);
+	end = (int64_t)ftello(fp);
+	fseeko(fp, 0, SEEK_SET);
+
+	/* Make sure that the model fits into the address space. */
+	if (end < 0 || (uint64_t)end > (uint64_t)(SIZE_MAX - SECTION_ALIGN)) {
+		goto error_exit;
+	}
+	size = (size_t)end;
 
-	buffer = buffer_orig = (uint8_t*)malloc(size + 16);
+	buffer = buffer_orig = (uint8_t*)malloc(size + SECTION_ALIGN);
 	if (buffer_orig == NULL) {
 		goto error_exit;
 	}
 
-	/* Align the buffer to 16 bytes. */
-	while ((uintptr_t)buffer % 16 != 0) {
+	/* Align the buffer to the boundary of the sections. */
+	while ((uintptr_t)buffer % SECTION_ALIGN != 0) {
 		++buffer;
 	}
 
@@ -1109,6 +1539,7 @@ void crf1dm_close(crf1dm_t* model)
 		free(model->header);
 		model->header = NULL;
 	}
+	free(model->qscales);
 	if (model->buffer_orig != NULL) {
 		free(model->buffer_orig);
 		model->buffer_orig = model->buffer = NULL;
@@ -1156,6 +1587,26 @@ int crf1dm_to_aid(crf1dm_t* model, const char *value)
 	}
 }
 
+int crf1dm_to_aid_n(crf1dm_t* model, const char *value, size_t length)
+{
+	if (model->attrs != NULL) {
+		return cqdb_to_id_n(model->attrs, value, length);
+	}
+	else {
+		return -1;
+	}
+}
+
+int crf1dm_to_lid_n(crf1dm_t* model, const char *value, size_t length)
+{
+	if (model->labels != NULL) {
+		return cqdb_to_id_n(model->labels, value, length);
+	}
+	else {
+		return -1;
+	}
+}
+
 const char *crf1dm_to_attr(crf1dm_t* model, int aid)
 {
 	if (model->attrs != NULL) {
@@ -1171,6 +1622,14 @@ int crf1dm_get_labelref(crf1dm_t* model, int lid, feature_refs_t* ref)
 	uint8_t *p = model->buffer;
 	uint32_t offset;
 
+	if (model->labelrefs != NULL || model->labelrefs64 != NULL) {
+		const uint32_t *q = (const uint32_t*)(model->buffer + (model->labelrefs64 != NULL ?
+			model->labelrefs64[lid] : model->labelrefs[lid]));
+		ref->num_features = (int)q[0];
+		ref->fids = (int*)&q[1];
+		return 0;
+	}
+
 	p += model->header->off_labelrefs;
 	p += CHUNK_SIZE;
 	p += sizeof(uint32_t) * lid;
@@ -1187,6 +1646,14 @@ int crf1dm_get_attrref(crf1dm_t* model, int aid, feature_refs_t* ref)
 	uint8_t *p = model->buffer;
 	uint32_t offset;
 
+	if (model->attrrefs != NULL || model->attrrefs64 != NULL) {
+		const uint32_t *q = (const uint32_t*)(model->buffer + (model->attrrefs64 != NULL ?
+			model->attrrefs64[aid] : model->attrrefs[aid]));
+		ref->num_features = (int)q[0];
+		ref->fids = (int*)&q[1];
+		return 0;
+	}
+
 	p += model->header->off_attrrefs;
 	p += CHUNK_SIZE;
 	p += sizeof(uint32_t) * aid;
@@ -1198,10 +1665,14 @@ int crf1dm_get_attrref(crf1dm_t* model, int aid, feature_refs_t* ref)
 	return 0;
 }
 
-int crf1dm_get_featureid(feature_refs_t* ref, int i)
+int crf1dm_get_featureid(crf1dm_t* model, feature_refs_t* ref, int i)
 {
 	uint32_t fid;
 	uint8_t* p = (uint8_t*)ref->fids;
+
+	if (model->native) {
+		return ref->fids[i];
+	}
 	p += sizeof(uint32_t) * i;
 	read_uint32(p, &fid);
 	return (int)fid;
@@ -1211,7 +1682,29 @@ int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f)
 {
 	uint8_t *p = NULL;
 	uint32_t val = 0;
-	uint32_t offset = model->header->off_features + CHUNK_SIZE;
+	uint64_t offset = model->header->off_features + CHUNK_SIZE;
+
+	if (model->features != NULL) {
+		const native_feature_t *nf = &model->features[fid];
+		f->type = (int)nf->type;
+		f->src = (int)nf->src;
+		f->dst = (int)nf->dst;
+		f->weight = (floatval_t)nf->weight;
+		return 0;
+	}
+
+	if (0 < model->qbits) {
+		int dst, q;
+		p = model->buffer + model->off_qfeatures + QFEATURE_SIZE(model->qbits) * fid;
+		p += read_uint32(p, &val);
+		f->src = val;
+		crf1dm_get_qfeature(model, fid, &dst, &q);
+		f->dst = dst;
+		f->type = p[2];
+		f->weight = q * model->qscales[dst];
+		return 0;
+	}
+
 	offset += FEATURE_SIZE * fid;
 	p = model->buffer + offset;
 	p += read_uint32(p, &val);
@@ -1224,6 +1717,23 @@ int crf1dm_get_feature(crf1dm_t* model, int fid, crf1dm_feature_t* f)
 	return 0;
 }
 
+int crf1dm_get_qfeature(crf1dm_t* model, int fid, int *dst, int *qweight)
+{
+	uint16_t val = 0;
+	uint8_t *p = model->buffer + model->off_qfeatures;
+	p += QFEATURE_SIZE(model->qbits) * fid + sizeof(uint32_t);
+	p += read_uint16(p, &val);
+	*dst = val;
+	++p;
+	if (model->qbits == 8) {
+		*qweight = (int8_t)*p;
+	} else {
+		read_uint16(p, &val);
+		*qweight = (int16_t)val;
+	}
+	return 0;
+}
+
 inline static void crf1dm_dump_sm_state(crf1dm_t* crf1dm, \
 	const crf1de_state_t *sm_state, \
 	FILE *fp)
@@ -1252,19 +1762,30 @@ void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
 	fprintf(fp, "FILEHEADER = {\n");
 	fprintf(fp, "  magic: %c%c%c%c\n",
 		hfile->magic[0], hfile->magic[1], hfile->magic[2], hfile->magic[3]);
-	fprintf(fp, "  size: %d\n", hfile->size);
+	fprintf(fp, "  size: %llu\n", (unsigned long long)hfile->size);
 	fprintf(fp, "  type: %c%c%c%c\n",
 		hfile->type[0], hfile->type[1], hfile->type[2], hfile->type[3]);
 	fprintf(fp, "  version: %d\n", hfile->version);
+	if (hfile->version >= VERSION_NUMBER2) {
+		const uint8_t *mark = (const uint8_t*)&hfile->byteorder;
+		fprintf(fp, "  format: %d (%s-endian)\n",
+			hfile->version >= VERSION_NUMBER3 ? 3 : 2,
+			mark[0] == 0x04 ? "little" : "big");
+	} else {
+		fprintf(fp, "  format: 1\n");
+	}
 	fprintf(fp, "  num_features: %d\n", hfile->num_features);
 	fprintf(fp, "  num_labels: %d\n", hfile->num_labels);
 	fprintf(fp, "  num_attrs: %d\n", hfile->num_attrs);
-	fprintf(fp, "  off_features: 0x%X\n", hfile->off_features);
-	fprintf(fp, "  off_labels: 0x%X\n", hfile->off_labels);
-	fprintf(fp, "  off_attrs: 0x%X\n", hfile->off_attrs);
-	fprintf(fp, "  off_labelrefs: 0x%X\n", hfile->off_labelrefs);
-	fprintf(fp, "  off_attrrefs: 0x%X\n", hfile->off_attrrefs);
-	fprintf(fp, "  off_sm: 0x%X\n", hfile->off_sm);
+	fprintf(fp, "  off_features: 0x%llX\n", (unsigned long long)hfile->off_features);
+	fprintf(fp, "  off_labels: 0x%llX\n", (unsigned long long)hfile->off_labels);
+	fprintf(fp, "  off_attrs: 0x%llX\n", (unsigned long long)hfile->off_attrs);
+	fprintf(fp, "  off_labelrefs: 0x%llX\n", (unsigned long long)hfile->off_labelrefs);
+	fprintf(fp, "  off_attrrefs: 0x%llX\n", (unsigned long long)hfile->off_attrrefs);
+	fprintf(fp, "  off_sm: 0x%llX\n", (unsigned long long)hfile->off_sm);
+	if (0 < crf1dm->qbits) {
+		fprintf(fp, "  quantization: %d bits\n", crf1dm->qbits);
+	}
 	fprintf(fp, "}\n");
 	fprintf(fp, "\n");
 
@@ -1307,7 +1828,7 @@ void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
 		crf1dm_get_labelref(crf1dm, i, &refs);
 		for (j = 0; j < refs.num_features; ++j) {
 			crf1dm_feature_t f;
-			int fid = crf1dm_get_featureid(&refs, j);
+			int fid = crf1dm_get_featureid(crf1dm, &refs, j);
 			const char *from = NULL, *to = NULL;
 
 			crf1dm_get_feature(crf1dm, fid, &f);
@@ -1345,7 +1866,7 @@ void crf1dm_dump(crf1dm_t* crf1dm, FILE *fp)
 		crf1dm_get_attrref(crf1dm, i, &refs);
 		for (j = 0; j < refs.num_features; ++j) {
 			crf1dm_feature_t f;
-			int fid = crf1dm_get_featureid(&refs, j);
+			int fid = crf1dm_get_featureid(crf1dm, &refs, j);
 			const char *attr = NULL, *to = NULL;
 
 			crf1dm_get_feature(crf1dm, fid, &f);
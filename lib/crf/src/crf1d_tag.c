@@ -65,6 +65,19 @@
     return 0;								\
   }									\
 
+#define NBEST_FUNC(a_name, a_funcname)					\
+  static int a_name(crfsuite_tagger_t* tagger, int n, int *paths,	\
+		    floatval_t *scores, int *ptr_num, const void *aux)	\
+  {									\
+    int num = 0;							\
+    crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;			\
+    int ret = a_funcname(crf1dt->ctx, n, paths, scores, &num, aux);	\
+    if (ptr_num)							\
+      *ptr_num = num;							\
+									\
+    return ret;								\
+  }									\
+
 #define SCORE_FUNC(a_name, a_funcname)					\
   static int a_name(crfsuite_tagger_t* tagger, int *path, floatval_t *ptr_score) \
   {									\
@@ -83,11 +96,19 @@
 		    int end, floatval_t *ptr_prob, const void *aux)	\
   {									\
     crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;			\
+    if (!(crf1dt->ctx->flag & CTXF_MARGINALS))				\
+      return CRFSUITEERR_NOTSUPPORTED;					\
     crf1dt_set_level(crf1dt, LEVEL_ALPHABETA, aux);			\
     *ptr_prob = a_funcname(crf1dt->ctx, path, begin, end, aux);		\
     return 0;								\
   }									\
 
+/** Default number of items whose labels a stream may leave uncommitted. */
+#define    STREAM_LOOKAHEAD    64
+
+/** Maximum length of the attribute names stored in the attribute cache. */
+#define    CACHE_STRING_SIZE    52
+
 ////////////////
 // Data Types //
 ////////////////
@@ -97,6 +118,49 @@ enum {
 	LEVEL_ALPHABETA,
 };
 
+/**
+ * Streaming Viterbi decoder.
+ *  Items are numbered from the beginning of the stream; the item #p is
+ *  stored in the row (p % R) of the ring-buffered context (R = 2W). The
+ *  labels of the items in [popped, committed) are decided but not popped,
+ *  and those in [committed, end) are pending.
+ */
+typedef struct {
+	crf1d_context_t *ctx;   /**< Ring-buffered context of R items. */
+	int lookahead;          /**< Maximum number of pending items (W). */
+	int fresh;              /**< Nonzero if the next item starts a sequence. */
+	int popped;             /**< Position next to the last popped label. */
+	int committed;          /**< Position next to the last committed label. */
+	int end;                /**< Position next to the last pushed item. */
+	int *labels;            /**< [R] labels of the items. */
+	int *cur;               /**< [L] work space for the surviving labels. */
+	int *prev;              /**< [L] work space for the surviving labels. */
+	unsigned int *mark;     /**< [L] marks for the surviving labels. */
+	unsigned int stamp;     /**< Current mark. */
+} crf1dt_stream_t;
+
+/**
+ * Entry of the attribute cache (64 bytes).
+ */
+typedef struct {
+	unsigned int hash;      /**< Hash value of the name. */
+	int aid;                /**< Attribute identifier (negative if unknown). */
+	int length;             /**< Length of the name (-1 for an empty entry). */
+	char str[CACHE_STRING_SIZE]; /**< Name (not null-terminated). */
+} crf1dt_cache_entry_t;
+
+/**
+ * Attribute cache.
+ *  This is a two-way set-associative cache; the entry #0 of a set is the
+ *  most recently used one.
+ */
+typedef struct {
+	crf1dt_cache_entry_t *entries; /**< [2 * (mask + 1)] entries. */
+	unsigned int mask;      /**< Number of sets minus one. */
+	size_t lookups;         /**< Number of lookups. */
+	size_t hits;            /**< Number of hits. */
+} crf1dt_cache_t;
+
 typedef struct {
 	crf1dm_t *model;        /**< CRF model. */
 	crf1d_context_t *ctx;   /**< CRF context. */
@@ -104,42 +168,91 @@ typedef struct {
 	int num_labels;         /**< Number of distinct output labels (L). */
 	int num_attributes;     /**< Number of distinct attributes (A). */
 	int level;
+	crf1dt_stream_t *stream; /**< Streaming decoder (NULL until used). */
+	crf1dt_cache_t cache;   /**< Attribute cache (disabled if no entries). */
 } crf1dt_t;
 
-static void crf1dt_state_score(crf1dt_t *crf1dt, const crfsuite_instance_t *inst)
+static void crf1dt_item_state_score(crf1dt_t *crf1dt, const crfsuite_item_t *item, \
+	ctxval_t *state)
 {
-	int a, i, l, t, r, fid;
+	int a, i, l, r, fid;
 	crf1dm_feature_t f;
 	feature_refs_t attr;
-	floatval_t value, *state = NULL;
+	floatval_t value;
+	crf1dm_t* model = crf1dt->model;
+	const native_feature_t *features = model->features;
+
+	/* Loop over the contents (attributes) attached to the item. */
+	for (i = 0; i < item->num_contents; ++i) {
+		/* Access the list of state features associated with the attribute. */
+		a = item->contents[i].aid;
+		crf1dm_get_attrref(model, a, &attr);
+		/* A scale usually represents the atrribute frequency in the item. */
+		value = item->contents[i].value;
+
+		/* Read the features of the format 2 in place. */
+		if (features != NULL) {
+			for (r = 0; r < attr.num_features; ++r) {
+				const native_feature_t *nf = &features[attr.fids[r]];
+				state[nf->dst] += nf->weight * value;
+			}
+			continue;
+		}
+
+		/* Loop over the state features associated with the attribute. */
+		for (r = 0; r < attr.num_features; ++r) {
+			/* The state feature #(attr->fids[r]), which is represented by
+			   the attribute #a, outputs the label #(f->dst). */
+			fid = crf1dm_get_featureid(model, &attr, r);
+			crf1dm_get_feature(model, fid, &f);
+			l = f.dst;
+			state[l] += f.weight * value;
+		}
+	}
+}
+
+static void crf1dt_item_state_score_quantized(crf1dt_t *crf1dt, const crfsuite_item_t *item, \
+	ctxval_t *state)
+{
+	int a, i, l, r, fid, dst, q;
+	feature_refs_t attr;
+	floatval_t value;
 	crf1dm_t* model = crf1dt->model;
+	const floatval_t *scales = model->qscales;
+	const int L = crf1dt->num_labels;
+
+	/* Accumulate the integer weights of the state features. */
+	for (i = 0; i < item->num_contents; ++i) {
+		a = item->contents[i].aid;
+		crf1dm_get_attrref(model, a, &attr);
+		value = item->contents[i].value;
+
+		for (r = 0; r < attr.num_features; ++r) {
+			fid = crf1dm_get_featureid(model, &attr, r);
+			crf1dm_get_qfeature(model, fid, &dst, &q);
+			state[dst] += q * value;
+		}
+	}
+
+	/* Dequantize the scores with the scales of the labels. */
+	for (l = 0; l < L; ++l) {
+		state[l] *= scales[l];
+	}
+}
+
+static void crf1dt_state_score(crf1dt_t *crf1dt, const crfsuite_instance_t *inst)
+{
+	int t;
 	crf1d_context_t* ctx = crf1dt->ctx;
-	const crfsuite_item_t* item = NULL;
 	const int T = inst->num_items;
-	const int L = crf1dt->num_labels;
 
 	/* Loop over the items in the sequence. */
 	for (t = 0; t < T; ++t) {
-		item = &inst->items[t];
-		state = STATE_SCORE(ctx, t);
-
-		/* Loop over the contents (attributes) attached to the item. */
-		for (i = 0; i < item->num_contents; ++i) {
-			/* Access the list of state features associated with the attribute. */
-			a = item->contents[i].aid;
-			crf1dm_get_attrref(model, a, &attr);
-			/* A scale usually represents the atrribute frequency in the item. */
-			value = item->contents[i].value;
-
-			/* Loop over the state features associated with the attribute. */
-			for (r = 0; r < attr.num_features; ++r) {
-				/* The state feature #(attr->fids[r]), which is represented by
-				   the attribute #a, outputs the label #(f->dst). */
-				fid = crf1dm_get_featureid(&attr, r);
-				crf1dm_get_feature(model, fid, &f);
-				l = f.dst;
-				state[l] += f.weight * value;
-			}
+		if (0 < crf1dt->model->qbits) {
+			crf1dt_item_state_score_quantized(crf1dt, &inst->items[t], STATE_SCORE(ctx, t));
+		}
+		else {
+			crf1dt_item_state_score(crf1dt, &inst->items[t], STATE_SCORE(ctx, t));
 		}
 	}
 }
@@ -155,13 +268,13 @@ static void crf1dt_transition_score(crf1dt_t* crf1dt)
 	int i, r, fid;
 	crf1dm_feature_t f;
 	feature_refs_t edge;
-	floatval_t *trans = NULL;
+	ctxval_t *trans = NULL;
 	for (i = 0; i < L; ++i) {
 		trans = TRANS_SCORE(ctx, i);
 		crf1dm_get_labelref(model, i, &edge);
 		for (r = 0; r < edge.num_features; ++r) {
 			/* Transition feature from #i to #(f->dst). */
-			fid = crf1dm_get_featureid(&edge, r);
+			fid = crf1dm_get_featureid(model, &edge, r);
 			crf1dm_get_feature(model, fid, &f);
 			trans[f.dst] = f.weight;
 		}
@@ -190,15 +303,197 @@ static void crf1dt_set_level(crf1dt_t *crf1dt, int level, const void *aux)
 		else {
 			crf1dc_alpha_score(ctx, aux);
 			crf1dc_beta_score(ctx, aux);
+			/* A checkpointed context keeps the marginals instead of the
+			   alpha and beta scores. */
+			if (ctx->checkpoint) {
+				crf1dc_marginals(ctx, aux);
+			}
 		}
 	}
 
 	crf1dt->level = level;
 }
 
+static void crf1dt_stream_delete(crf1dt_stream_t *st)
+{
+	if (st != NULL) {
+		free(st->mark);
+		free(st->prev);
+		free(st->cur);
+		free(st->labels);
+		if (st->ctx != NULL) {
+			crf1dc_delete(st->ctx);
+		}
+		free(st);
+	}
+}
+
+static crf1dt_stream_t *crf1dt_stream_new(crf1dt_t *crf1dt, int lookahead)
+{
+	crf1dt_stream_t *st = NULL;
+	const int L = crf1dt->num_labels;
+	const int R = 2 * lookahead;
+
+	st = (crf1dt_stream_t*)calloc(1, sizeof(crf1dt_stream_t));
+	if (st == NULL) {
+		return NULL;
+	}
+	st->lookahead = lookahead;
+	st->fresh = 1;
+
+	/* The ring must not be checkpointed; T gives the number of rows. */
+	st->ctx = crf1dc_new(CTXF_VITERBI, crf1dt->ftype, L, 0, NULL);
+	if (st->ctx == NULL) goto error_exit;
+	st->ctx->checkpoint_threshold = 0;
+	if (crf1dc_set_num_items(st->ctx, NULL, R)) goto error_exit;
+	memcpy(st->ctx->trans, crf1dt->ctx->trans, sizeof(ctxval_t) * L * L);
+
+	st->labels = (int*)calloc(R, sizeof(int));
+	st->cur = (int*)calloc(L, sizeof(int));
+	st->prev = (int*)calloc(L, sizeof(int));
+	st->mark = (unsigned int*)calloc(L, sizeof(unsigned int));
+	if (st->labels == NULL || st->cur == NULL || st->prev == NULL || st->mark == NULL) {
+		goto error_exit;
+	}
+	return st;
+
+error_exit:
+	crf1dt_stream_delete(st);
+	return NULL;
+}
+
+/*
+ * Decide the labels of the items #committed, ..., #u by tracing the
+ * backward links from the label of the item #u.
+ */
+static void crf1dt_stream_commit(crf1dt_stream_t *st, int u, int label)
+{
+	int v;
+	crf1d_context_t *ctx = st->ctx;
+	const int R = 2 * st->lookahead;
+
+	st->labels[u % R] = label;
+	for (v = u; st->committed < v; --v) {
+		st->labels[(v - 1) % R] = BACKWARD_EDGE_AT(ctx, v % R)[st->labels[v % R]];
+	}
+	st->committed = u + 1;
+}
+
+/*
+ * Find the label with the maximum Viterbi score at the last item.
+ */
+static int crf1dt_stream_best(crf1dt_stream_t *st)
+{
+	int i, best = 0;
+	const int R = 2 * st->lookahead;
+	const ctxval_t *score = ALPHA_SCORE(st->ctx, (st->end - 1) % R);
+
+	for (i = 1; i < st->ctx->num_labels; ++i) {
+		if (score[best] < score[i]) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+/*
+ * Subtract the maximum Viterbi score of the item #v from its scores, so
+ * that the scores of an unbounded stream do not grow and lose precision.
+ */
+static void crf1dt_stream_normalize(crf1dt_stream_t *st, int v)
+{
+	int i;
+	ctxval_t max_score;
+	ctxval_t *score = ALPHA_SCORE(st->ctx, v % (2 * st->lookahead));
+	const int L = st->ctx->num_labels;
+
+	max_score = score[0];
+	for (i = 1; i < L; ++i) {
+		if (max_score < score[i]) {
+			max_score = score[i];
+		}
+	}
+	for (i = 0; i < L; ++i) {
+		score[i] -= max_score;
+	}
+}
+
+/*
+ * Commit the pending items up to the latest one through which all the
+ * surviving Viterbi paths pass.
+ */
+static void crf1dt_stream_converge(crf1dt_stream_t *st)
+{
+	int i, l, m, n, u;
+	int *cur = st->cur, *prev = st->prev, *tmp = NULL;
+	crf1d_context_t *ctx = st->ctx;
+	const int L = ctx->num_labels;
+	const int R = 2 * st->lookahead;
+
+	/* Trace back the best paths arriving at every label of the last item. */
+	u = st->end - 1;
+	for (i = 0; i < L; ++i) {
+		cur[i] = i;
+	}
+	for (n = L; 1 < n && st->committed < u; --u) {
+		const int *back = BACKWARD_EDGE_AT(ctx, u % R);
+		if (++st->stamp == 0) {
+			memset(st->mark, 0, sizeof(unsigned int) * L);
+			st->stamp = 1;
+		}
+		for (i = 0, m = 0; i < n; ++i) {
+			l = back[cur[i]];
+			if (st->mark[l] != st->stamp) {
+				st->mark[l] = st->stamp;
+				prev[m++] = l;
+			}
+		}
+		tmp = cur; cur = prev; prev = tmp;
+		n = m;
+	}
+
+	if (n == 1) {
+		crf1dt_stream_commit(st, u, cur[0]);
+	}
+}
+
+/*
+ * Commit the first n pending items on the current best path, and restrict
+ * the Viterbi scores of the following items to the paths through them.
+ */
+static void crf1dt_stream_force(crf1dt_stream_t *st, int n)
+{
+	int j, v, y;
+	ctxval_t *score = NULL;
+	crf1d_context_t *ctx = st->ctx;
+	const int L = ctx->num_labels;
+	const int R = 2 * st->lookahead;
+	const int u = st->committed + n - 1;
+
+	/* Trace the best path back to the first pending item. */
+	crf1dt_stream_commit(st, st->end - 1, crf1dt_stream_best(st));
+	st->committed = u + 1;
+
+	/* Disallow the other labels at #u and update the scores after #u. */
+	y = st->labels[u % R];
+	score = ALPHA_SCORE(ctx, u % R);
+	for (j = 0; j < L; ++j) {
+		if (j != y) {
+			score[j] = -CTXVAL_MAX;
+		}
+	}
+	for (v = u + 1; v < st->end; ++v) {
+		crf1dc_viterbi_step(ctx, ALPHA_SCORE(ctx, v % R), ALPHA_SCORE(ctx, (v - 1) % R), \
+			BACKWARD_EDGE_AT(ctx, v % R), v % R);
+		crf1dt_stream_normalize(st, v);
+	}
+}
+
 static void crf1dt_delete(crf1dt_t* crf1dt)
 {
 	/* Note: we don't own the model object (crf1t->model). */
+	crf1dt_stream_delete(crf1dt->stream);
+	free(crf1dt->cache.entries);
 	if (crf1dt->ctx != NULL) {
 		crf1dc_delete(crf1dt->ctx);
 		crf1dt->ctx = NULL;
@@ -206,9 +501,12 @@ static void crf1dt_delete(crf1dt_t* crf1dt)
 	free(crf1dt);
 }
 
-static crf1dt_t *crf1dt_new(crf1dm_t* crf1dm, const int ftype)
+static crf1dt_t *crf1dt_new(crf1dm_t* crf1dm, const int ftype, const int flag)
 {
 	crf1dt_t* crf1dt = NULL;
+	/* A Viterbi-only tagger needs neither the exponents nor beta scores. */
+	const int ctxf = (flag & CRFSUITE_TAGGER_VITERBI) ? \
+		CTXF_VITERBI : (CTXF_VITERBI | CTXF_MARGINALS);
 
 	crf1dt = (crf1dt_t*)calloc(1, sizeof(crf1dt_t));
 	if (crf1dt != NULL) {
@@ -216,12 +514,13 @@ static crf1dt_t *crf1dt_new(crf1dm_t* crf1dm, const int ftype)
 		crf1dt->num_labels = crf1dm_get_num_labels(crf1dm);
 		crf1dt->num_attributes = crf1dm_get_num_attrs(crf1dm);
 		crf1dt->model = crf1dm;
-		crf1dt->ctx = crf1dc_new(CTXF_VITERBI | CTXF_MARGINALS, ftype, crf1dt->num_labels, 0, \
-			crf1dm->sm);
+		crf1dt->ctx = crf1dc_new(ctxf, ftype, crf1dt->num_labels, 0, crf1dm->sm);
 		if (crf1dt->ctx != NULL) {
 			crf1dc_reset(crf1dt->ctx, RF_TRANS, crf1dm->sm);
 			crf1dt_transition_score(crf1dt);
-			crf1dc_exp_transition(crf1dt->ctx, crf1dm->sm);
+			if (ctxf & CTXF_MARGINALS) {
+				crf1dc_exp_transition(crf1dt->ctx, crf1dm->sm);
+			}
 		}
 		else {
 			crf1dt_delete(crf1dt);
@@ -270,6 +569,9 @@ static int tagger_length(crfsuite_tagger_t* tagger)
 static int tagger_lognorm(crfsuite_tagger_t* tagger, floatval_t *ptr_norm, const void *aux)
 {
 	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	if (!(crf1dt->ctx->flag & CTXF_MARGINALS)) {
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
 	crf1dt_set_level(crf1dt, LEVEL_ALPHABETA, aux);
 	*ptr_norm = crf1dc_lognorm(crf1dt->ctx);
 	return 0;
@@ -279,11 +581,196 @@ static int tagger_marginal_point(crfsuite_tagger_t *tagger, int l, int t, \
 	floatval_t *ptr_prob, const void *aux)
 {
 	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	if (!(crf1dt->ctx->flag & CTXF_MARGINALS)) {
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
 	crf1dt_set_level(crf1dt, LEVEL_ALPHABETA, aux);
 	*ptr_prob = crf1dc_marginal_point(crf1dt->ctx, l, t);
 	return 0;
 }
 
+static int tagger_stream(crfsuite_tagger_t* tagger, int lookahead)
+{
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+
+	/* Streaming is implemented only for linear chains. */
+	if (crf1dt->ftype == FTYPE_CRF1TREE || crf1dt->ftype == FTYPE_SEMIMCRF) {
+		return CRFSUITEERR_NOTSUPPORTED;
+	}
+	if (lookahead <= 0) {
+		lookahead = STREAM_LOOKAHEAD;
+	}
+
+	crf1dt_stream_delete(crf1dt->stream);
+	crf1dt->stream = crf1dt_stream_new(crf1dt, lookahead);
+	return (crf1dt->stream != NULL) ? 0 : CRFSUITEERR_OUTOFMEMORY;
+}
+
+static int tagger_push(crfsuite_tagger_t* tagger, const crfsuite_item_t *item)
+{
+	int ret = 0, s;
+	ctxval_t *state = NULL;
+	crf1dt_stream_t *st = NULL;
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+
+	if (crf1dt->stream == NULL && (ret = tagger_stream(tagger, 0))) {
+		return ret;
+	}
+	st = crf1dt->stream;
+
+	/* The ring is full of labels that have not been popped. */
+	if (st->end - st->popped == 2 * st->lookahead) {
+		return CRFSUITEERR_OVERFLOW;
+	}
+
+	/* Compute the state scores of the item in its row of the ring. */
+	s = st->end % (2 * st->lookahead);
+	state = STATE_SCORE(st->ctx, s);
+	memset(state, 0, sizeof(ctxval_t) * crf1dt->num_labels);
+	if (0 < crf1dt->model->qbits) {
+		crf1dt_item_state_score_quantized(crf1dt, item, state);
+	}
+	else {
+		crf1dt_item_state_score(crf1dt, item, state);
+	}
+
+	/* Extend the Viterbi paths to the item. */
+	if (st->fresh) {
+		memcpy(ALPHA_SCORE(st->ctx, s), state, sizeof(ctxval_t) * crf1dt->num_labels);
+		st->fresh = 0;
+	}
+	else {
+		const int p = (st->end - 1) % (2 * st->lookahead);
+		crf1dc_viterbi_step(st->ctx, ALPHA_SCORE(st->ctx, s), ALPHA_SCORE(st->ctx, p), \
+			BACKWARD_EDGE_AT(st->ctx, s), s);
+	}
+	crf1dt_stream_normalize(st, st->end);
+	++st->end;
+
+	/* Commit the items on which the surviving paths agree, or the older
+	   half of the pending items if the lookahead is exhausted. */
+	crf1dt_stream_converge(st);
+	if (st->lookahead <= st->end - st->committed) {
+		crf1dt_stream_force(st, (st->lookahead + 1) / 2);
+	}
+	return 0;
+}
+
+static int tagger_pop(crfsuite_tagger_t* tagger, int *labels, int size, int end, int *ptr_num)
+{
+	int n = 0;
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	crf1dt_stream_t *st = crf1dt->stream;
+
+	if (st != NULL) {
+		const int R = 2 * st->lookahead;
+
+		/* Tag the pending items with the best path to end the sequence. */
+		if (end && !st->fresh) {
+			if (st->committed < st->end) {
+				crf1dt_stream_commit(st, st->end - 1, crf1dt_stream_best(st));
+			}
+			st->fresh = 1;
+		}
+
+		while (n < size && st->popped < st->committed) {
+			labels[n++] = st->labels[st->popped++ % R];
+		}
+
+		/* Keep the positions small for an unbounded stream. */
+		if (R <= st->popped) {
+			st->popped -= R;
+			st->committed -= R;
+			st->end -= R;
+		}
+	}
+
+	if (ptr_num) {
+		*ptr_num = n;
+	}
+	return 0;
+}
+
+static int tagger_cache_attributes(crfsuite_tagger_t* tagger, int size)
+{
+	int i;
+	unsigned int sets = 1;
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	crf1dt_cache_t *cache = &crf1dt->cache;
+
+	free(cache->entries);
+	memset(cache, 0, sizeof(*cache));
+	if (size <= 0) {
+		return 0;
+	}
+
+	/* Round up the number of sets of two entries to a power of two. */
+	while (2 * sets < (unsigned int)size) {
+		sets *= 2;
+	}
+	cache->entries = (crf1dt_cache_entry_t*)calloc(2 * sets, sizeof(crf1dt_cache_entry_t));
+	if (cache->entries == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	for (i = 0; i < 2 * (int)sets; ++i) {
+		cache->entries[i].length = -1;
+	}
+	cache->mask = sets - 1;
+	return 0;
+}
+
+static int tagger_to_aid(crfsuite_tagger_t* tagger, const char *str, size_t length)
+{
+	size_t i;
+	unsigned int hash = 2166136261u;
+	crf1dt_cache_entry_t *set = NULL, tmp;
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	crf1dt_cache_t *cache = &crf1dt->cache;
+
+	if (cache->entries == NULL || CACHE_STRING_SIZE < length) {
+		return crf1dm_to_aid_n(crf1dt->model, str, length);
+	}
+
+	/* FNV-1a hash of the name. */
+	for (i = 0; i < length; ++i) {
+		hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+	}
+
+	++cache->lookups;
+	set = &cache->entries[2 * (hash & cache->mask)];
+	for (i = 0; i < 2; ++i) {
+		if (set[i].hash == hash && set[i].length == (int)length &&
+			memcmp(set[i].str, str, length) == 0) {
+			++cache->hits;
+			if (i == 1) {
+				tmp = set[0];
+				set[0] = set[1];
+				set[1] = tmp;
+			}
+			return set[0].aid;
+		}
+	}
+
+	/* Evict the least recently used entry of the set. */
+	set[1] = set[0];
+	set[0].hash = hash;
+	set[0].length = (int)length;
+	set[0].aid = crf1dm_to_aid_n(crf1dt->model, str, length);
+	memcpy(set[0].str, str, length);
+	return set[0].aid;
+}
+
+static int tagger_cache_stats(crfsuite_tagger_t* tagger, crfsuite_cache_stats_t *stats)
+{
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	const crf1dt_cache_t *cache = &crf1dt->cache;
+
+	stats->size = (cache->entries != NULL) ? 2 * (int)(cache->mask + 1) : 0;
+	stats->lookups = cache->lookups;
+	stats->hits = cache->hits;
+	return 0;
+}
+
 /* Macros below could also have been written in other fashion, but we
    want to keep the names of the functions explicitly to ease search. */
 VITERBI_FUNC(tagger_viterbi, crf1dc_viterbi)
@@ -292,6 +779,40 @@ VITERBI_FUNC(tagger_tree_viterbi, crf1dc_tree_viterbi)
 
 VITERBI_FUNC(tagger_sm_viterbi, crf1dc_sm_viterbi)
 
+static int tagger_nbest(crfsuite_tagger_t* tagger, int n, int *paths, \
+	floatval_t *scores, int *ptr_num, const void *aux)
+{
+	int num = 0, ret = 0;
+	crf1dt_t* crf1dt = (crf1dt_t*)tagger->internal;
+	crf1d_context_t* ctx = crf1dt->ctx;
+
+	/* The search needs the Viterbi scores of all items; allocate the full
+	   lattice of a checkpointed item sequence. */
+	if (ctx->checkpoint) {
+		const int threshold = ctx->checkpoint_threshold;
+		ctx->checkpoint_threshold = 0;
+		ret = crf1dc_set_num_items(ctx, crf1dt->model->sm, ctx->num_items);
+		ctx->checkpoint_threshold = threshold;
+		if (ret) {
+			return ret;
+		}
+		/* The marginals of the checkpointed lattice are no longer valid. */
+		if (LEVEL_SET < crf1dt->level) {
+			crf1dt->level = LEVEL_SET;
+		}
+	}
+
+	ret = crf1dc_nbest(ctx, n, paths, scores, &num, aux);
+	if (ptr_num) {
+		*ptr_num = num;
+	}
+	return ret;
+}
+
+NBEST_FUNC(tagger_tree_nbest, crf1dc_tree_nbest)
+
+NBEST_FUNC(tagger_sm_nbest, crf1dc_sm_nbest)
+
 SCORE_FUNC(tagger_score, crf1dc_score)
 
 SCORE_FUNC(tagger_tree_score, crf1dc_tree_score)
@@ -327,12 +848,30 @@ static int model_attrs_get(crfsuite_dictionary_t* dic, const char *str)
 	return CRFSUITEERR_NOTSUPPORTED;
 }
 
+static int model_attrs_get_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	/* This object is ready only. */
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
 static int model_attrs_to_id(crfsuite_dictionary_t* dic, const char *str)
 {
 	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
 	return crf1dm_to_aid(crf1dm, str);
 }
 
+static int model_attrs_to_id_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
+	return crf1dm_to_aid_n(crf1dm, str, length);
+}
+
+static int model_attrs_renumber(crfsuite_dictionary_t* dic, const int *map)
+{
+	/* This object is ready only. */
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
 static int model_attrs_to_string(crfsuite_dictionary_t* dic, int id, char const **pstr)
 {
 	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
@@ -377,12 +916,30 @@ static int model_labels_get(crfsuite_dictionary_t* dic, const char *str)
 	return CRFSUITEERR_NOTSUPPORTED;
 }
 
+static int model_labels_get_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	/* This object is ready only. */
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
 static int model_labels_to_id(crfsuite_dictionary_t* dic, const char *str)
 {
 	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
 	return crf1dm_to_lid(crf1dm, str);
 }
 
+static int model_labels_to_id_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
+	return crf1dm_to_lid_n(crf1dm, str, length);
+}
+
+static int model_labels_renumber(crfsuite_dictionary_t* dic, const int *map)
+{
+	/* This object is ready only. */
+	return CRFSUITEERR_NOTSUPPORTED;
+}
+
 static int model_labels_to_string(crfsuite_dictionary_t* dic, int id, char const **pstr)
 {
 	crf1dm_t *crf1dm = (crf1dm_t*)dic->internal;
@@ -477,7 +1034,7 @@ static int model_dump(crfsuite_model_t* model, FILE *fpo)
 }
 
 static int crf1m_model_create_by_object(const crf1dm_t *crf1dm, crfsuite_model_t** ptr_model, \
-	const int ftype)
+	const int ftype, const int flag)
 {
 	int ret = 0;
 	crf1dt_t *crf1dt = NULL;
@@ -488,7 +1045,7 @@ static int crf1m_model_create_by_object(const crf1dm_t *crf1dm, crfsuite_model_t
 
 	*ptr_model = NULL;
 	/* Construct a tagger based on the model. */
-	crf1dt = crf1dt_new(crf1dm, ftype);
+	crf1dt = crf1dt_new(crf1dm, ftype, flag);
 	if (crf1dt == NULL) {
 		ret = CRFSUITEERR_OUTOFMEMORY;
 		goto error_exit;
@@ -516,6 +1073,9 @@ static int crf1m_model_create_by_object(const crf1dm_t *crf1dm, crfsuite_model_t
 	attrs->to_string = model_attrs_to_string;
 	attrs->num = model_attrs_num;
 	attrs->free = model_attrs_free;
+	attrs->to_id_n = model_attrs_to_id_n;
+	attrs->renumber = model_attrs_renumber;
+	attrs->get_n = model_attrs_get_n;
 
 	/* Create an instance of dictionary object for labels. */
 	labels = (crfsuite_dictionary_t*)calloc(1, sizeof(crfsuite_dictionary_t));
@@ -532,6 +1092,9 @@ static int crf1m_model_create_by_object(const crf1dm_t *crf1dm, crfsuite_model_t
 	labels->to_string = model_labels_to_string;
 	labels->num = model_labels_num;
 	labels->free = model_labels_free;
+	labels->to_id_n = model_labels_to_id_n;
+	labels->renumber = model_labels_renumber;
+	labels->get_n = model_labels_get_n;
 
 	/* Create an instance of tagger object. */
 	tagger = (crfsuite_tagger_t*)calloc(1, sizeof(crfsuite_tagger_t));
@@ -547,18 +1110,27 @@ static int crf1m_model_create_by_object(const crf1dm_t *crf1dm, crfsuite_model_t
 	tagger->length = tagger_length;
 	tagger->lognorm = tagger_lognorm;
 	tagger->marginal_point = tagger_marginal_point;
+	tagger->stream = tagger_stream;
+	tagger->push = tagger_push;
+	tagger->pop = tagger_pop;
+	tagger->cache_attributes = tagger_cache_attributes;
+	tagger->to_aid = tagger_to_aid;
+	tagger->cache_stats = tagger_cache_stats;
 	if (ftype == FTYPE_CRF1TREE) {
 		tagger->viterbi = tagger_tree_viterbi;
+		tagger->nbest = tagger_tree_nbest;
 		tagger->score = tagger_tree_score;
 		tagger->marginal_path = tagger_tree_marginal_path;
 	}
 	else if (ftype == FTYPE_SEMIMCRF) {
 		tagger->viterbi = tagger_sm_viterbi;
+		tagger->nbest = tagger_sm_nbest;
 		tagger->score = tagger_sm_score;
 		tagger->marginal_path = tagger_sm_marginal_path;
 	}
 	else {
 		tagger->viterbi = tagger_viterbi;
+		tagger->nbest = tagger_nbest;
 		tagger->score = tagger_score;
 		tagger->marginal_path = tagger_marginal_path;
 	}
@@ -603,7 +1175,7 @@ error_exit:
 }
 
 static int crf1m_model_create(const char *filename, crfsuite_model_t** ptr_model, \
-	const int ftype)
+	const int ftype, const int flag)
 {
 	int ret = 0;
 	crf1dm_t *crf1dm = NULL;
@@ -623,7 +1195,7 @@ static int crf1m_model_create(const char *filename, crfsuite_model_t** ptr_model
 	}
 
 	/* Construct a tagger based on the model. */
-	crf1dt = crf1dt_new(crf1dm, ftype);
+	crf1dt = crf1dt_new(crf1dm, ftype, flag);
 	if (crf1dt == NULL) {
 		ret = CRFSUITEERR_OUTOFMEMORY;
 		goto error_exit;
@@ -651,6 +1223,9 @@ static int crf1m_model_create(const char *filename, crfsuite_model_t** ptr_model
 	attrs->to_string = model_attrs_to_string;
 	attrs->num = model_attrs_num;
 	attrs->free = model_attrs_free;
+	attrs->to_id_n = model_attrs_to_id_n;
+	attrs->renumber = model_attrs_renumber;
+	attrs->get_n = model_attrs_get_n;
 
 	/* Create an instance of dictionary object for labels. */
 	labels = (crfsuite_dictionary_t*)calloc(1, sizeof(crfsuite_dictionary_t));
@@ -667,6 +1242,9 @@ static int crf1m_model_create(const char *filename, crfsuite_model_t** ptr_model
 	labels->to_string = model_labels_to_string;
 	labels->num = model_labels_num;
 	labels->free = model_labels_free;
+	labels->to_id_n = model_labels_to_id_n;
+	labels->renumber = model_labels_renumber;
+	labels->get_n = model_labels_get_n;
 
 	/* Create an instance of tagger object. */
 	tagger = (crfsuite_tagger_t*)calloc(1, sizeof(crfsuite_tagger_t));
@@ -682,18 +1260,27 @@ static int crf1m_model_create(const char *filename, crfsuite_model_t** ptr_model
 	tagger->length = tagger_length;
 	tagger->lognorm = tagger_lognorm;
 	tagger->marginal_point = tagger_marginal_point;
+	tagger->stream = tagger_stream;
+	tagger->push = tagger_push;
+	tagger->pop = tagger_pop;
+	tagger->cache_attributes = tagger_cache_attributes;
+	tagger->to_aid = tagger_to_aid;
+	tagger->cache_stats = tagger_cache_stats;
 	if (ftype == FTYPE_CRF1TREE) {
 		tagger->viterbi = tagger_tree_viterbi;
+		tagger->nbest = tagger_tree_nbest;
 		tagger->score = tagger_tree_score;
 		tagger->marginal_path = tagger_tree_marginal_path;
 	}
 	else if (ftype == FTYPE_SEMIMCRF) {
 		tagger->viterbi = tagger_sm_viterbi;
+		tagger->nbest = tagger_sm_nbest;
 		tagger->score = tagger_sm_score;
 		tagger->marginal_path = tagger_sm_marginal_path;
 	}
 	else {
 		tagger->viterbi = tagger_viterbi;
+		tagger->nbest = tagger_nbest;
 		tagger->score = tagger_score;
 		tagger->marginal_path = tagger_marginal_path;
 	}
@@ -737,12 +1324,15 @@ error_exit:
 	return ret;
 }
 
-int crf1m_create_instance_from_file(const char *filename, void **ptr, const int ftype)
+int crf1m_create_instance_from_file(const char *filename, void **ptr, const int ftype, \
+	const int flag)
 {
-	return crf1m_model_create(filename, (crfsuite_model_t**)ptr, ftype);
+	return crf1m_model_create(filename, (crfsuite_model_t**)ptr, ftype, flag);
 }
 
-int crf1m_create_instance_from_memory(const void *data, size_t size, void **ptr, const int ftype)
+int crf1m_create_instance_from_memory(const void *data, size_t size, void **ptr, \
+	const int ftype, const int flag)
 {
-	return crf1m_model_create_by_object(crf1dm_new_from_memory(data, size, ftype), ptr, ftype);
+	return crf1m_model_create_by_object(crf1dm_new_from_memory(data, size, ftype), ptr, \
+		ftype, flag);
 }
\ No newline at end of file
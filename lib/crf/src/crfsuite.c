@@ -44,8 +44,8 @@
 
 int crf1de_create_instance(const char *iid, void **ptr);
 int crfsuite_dictionary_create_instance(const char *interface, void **ptr);
-int crf1m_create_instance_from_file(const char *filename, void **ptr, const int ftype);
-int crf1m_create_instance_from_memory(const void *data, size_t size, void **ptr, const int ftype);
+int crf1m_create_instance_from_file(const char *filename, void **ptr, const int ftype, const int flag);
+int crf1m_create_instance_from_memory(const void *data, size_t size, void **ptr, const int ftype, const int flag);
 
 static void swap_vars(int *a, int *b, int *tmp)
 {
@@ -65,13 +65,27 @@ int crfsuite_create_instance(const char *iid, void **ptr)
 
 int crfsuite_create_instance_from_file(const char *filename, void **ptr, const int ftype)
 {
-	int ret = crf1m_create_instance_from_file(filename, ptr, ftype);
+	int ret = crf1m_create_instance_from_file(filename, ptr, ftype, CRFSUITE_TAGGER_DEFAULT);
+	return ret;
+}
+
+int crfsuite_create_instance_from_file_ex(const char *filename, void **ptr, const int ftype, \
+	const int flag)
+{
+	int ret = crf1m_create_instance_from_file(filename, ptr, ftype, flag);
 	return ret;
 }
 
 int crfsuite_create_instance_from_memory(const void * data, size_t size, void ** ptr, const int ftype)
 {
-	int ret = crf1m_create_instance_from_memory(data, size, ptr, ftype);
+	int ret = crf1m_create_instance_from_memory(data, size, ptr, ftype, CRFSUITE_TAGGER_DEFAULT);
+	return ret;
+}
+
+int crfsuite_create_instance_from_memory_ex(const void * data, size_t size, void ** ptr, \
+	const int ftype, const int flag)
+{
+	int ret = crf1m_create_instance_from_memory(data, size, ptr, ftype, flag);
 	return ret;
 }
 
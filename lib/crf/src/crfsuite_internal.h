@@ -34,6 +34,7 @@
 #define __CRFSUITE_INTERNAL_H__
 
 #include <crfsuite.h>
+#include <stdint.h>
 #include "logging.h"
 
 enum {
@@ -51,14 +52,19 @@ typedef struct tag_crfsuite_train_internal crfsuite_train_internal_t;
 struct tag_encoder;
 typedef struct tag_encoder encoder_t;
 
+struct tag_crf1df_groups;
+typedef struct tag_crf1df_groups crf1df_groups_t;
+
 typedef struct {
 	crfsuite_data_t *data;
 	int *perm;
 	int num_instances;
+	uint32_t seed;	/**< State of the random numbers for shuffling. */
 } dataset_t;
 
 void dataset_init_trainset(dataset_t *ds, crfsuite_data_t *data, int holdout);
 void dataset_init_testset(dataset_t *ds, crfsuite_data_t *data, int holdout);
+void dataset_init_shard(dataset_t *ds, const dataset_t *src, int rank, int size);
 void dataset_finish(dataset_t *ds);
 void dataset_shuffle(dataset_t *ds);
 crfsuite_instance_t *dataset_get(const dataset_t *ds, int i);
@@ -113,6 +119,27 @@ struct tag_encoder
 	 */
 	int(*initialize)(encoder_t *self, int ftype, dataset_t *ds, logging_t *lg);
 
+	/**
+	 * Counts the features in each group of a data set.
+	 *  The counts are shared by the encoders of cross-validation folds.
+	 *  @param  self        The encoder instance.
+	 *  @param  data        The data set.
+	 *  @param  num_groups  The number of groups.
+	 *  @param  lg          The logging interface.
+	 *  @return             The feature counts, or NULL if unavailable.
+	 */
+	crf1df_groups_t*(*count_groups)(encoder_t *self, crfsuite_data_t *data, int num_groups, \
+		logging_t *lg);
+
+	/**
+	 * Uses the feature counts of the groups in initialize().
+	 *  @param  self        The encoder instance.
+	 *  @param  groups      The feature counts (NULL to scan the training set).
+	 *  @param  holdout     The holdout group of the training set.
+	 *  @return             A status code.
+	 */
+	int(*set_groups)(encoder_t *self, const crf1df_groups_t *groups, int holdout);
+
 
 	/**
 	 * Release resources acquired by the model.
@@ -167,6 +194,10 @@ struct tag_encoder
 		const void *aux);
 
 	int(*save_model)(encoder_t *self, const char *filename, const floatval_t *w, logging_t *lg);
+
+	/* Obtain the weights as stored by save_model (pruned and quantized);
+	   returns nonzero if they differ from w. */
+	int(*stored_weights)(encoder_t *self, floatval_t *ws, const floatval_t *w);
 };
 
 /**
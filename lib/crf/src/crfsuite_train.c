@@ -36,10 +36,15 @@
 
 #include <os.h>
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef    HAVE_PTHREAD_H
+#include <pthread.h>
+#endif/*HAVE_PTHREAD_H*/
+
 #include <crfsuite.h>
 #include "crfsuite_internal.h"
 #include "params.h"
@@ -121,15 +126,21 @@ static crfsuite_params_t* crfsuite_train_params(crfsuite_trainer_t* self)
 	return params;
 }
 
-static int crfsuite_train_train(crfsuite_trainer_t* self,
+/**
+ * Train a model with an encoder.
+ *  The parameters of the trainer are only read, so that the folds of a
+ *  cross validation can run this function concurrently with their own
+ *  encoders and logging interfaces.
+ */
+static int crfsuite_train_run(crfsuite_train_internal_t *tr,
+	encoder_t *gm,
+	logging_t *lg,
+	int ftype,
 	const crfsuite_data_t *data,
 	const char *filename,
 	int holdout)
 {
-	int ret = 0;
-	crfsuite_train_internal_t *tr = (crfsuite_train_internal_t*)self->internal;
-	logging_t *lg = tr->lg;
-	encoder_t *gm = tr->gm;
+	int ret = 0, rank = 0;
 	floatval_t *w = NULL;
 	dataset_t trainset;
 	dataset_t testset;
@@ -145,19 +156,21 @@ static int crfsuite_train_train(crfsuite_trainer_t* self,
 
 	/* Set the training set to the CRF, and generate features. */
 	gm->exchange_options(gm, tr->params, -1);
-	if ((ret = gm->initialize(gm, self->ftype, &trainset, lg)))
+	if ((ret = gm->initialize(gm, ftype, &trainset, lg)))
 		goto final_steps;
 
 	/* Call the training algorithm. */
 	switch (tr->algorithm) {
 	case TRAIN_LBFGS:
-		crfsuite_train_lbfgs(
+		ret = crfsuite_train_lbfgs(
 			gm,
 			&trainset,
 			(holdout != -1 ? &testset : NULL),
 			tr->params,
 			lg,
 			&w);
+		/* Only rank #0 stores the model in distributed training. */
+		tr->params->get_int(tr->params, "distributed.rank", &rank);
 		break;
 	case TRAIN_L2SGD:
 		crfsuite_train_l2sgd(
@@ -202,14 +215,275 @@ static int crfsuite_train_train(crfsuite_trainer_t* self,
 	}
 
 	/* Store model to file. */
-	if (filename != NULL && *filename)
+	if (w != NULL && rank == 0 && filename != NULL && *filename)
 		gm->save_model(gm, filename, w, lg);
 
+	/* Report the accuracy of the stored weights on the holdout data. */
+	if (w != NULL && rank == 0 && 0 <= holdout) {
+		floatval_t *ws = (floatval_t*)malloc(sizeof(floatval_t) * gm->num_features);
+		if (ws != NULL && gm->stored_weights(gm, ws, w)) {
+			logging(lg, "Holdout evaluation with the trained weights\n");
+			holdout_evaluation(gm, &testset, w, lg);
+			logging(lg, "Holdout evaluation with the pruned or quantized weights\n");
+			holdout_evaluation(gm, &testset, ws, lg);
+			logging(lg, "\n");
+		}
+		free(ws);
+	}
+
 final_steps:
 	free(w);
 	return ret;
 }
 
+static int crfsuite_train_train(crfsuite_trainer_t* self,
+	const crfsuite_data_t *data,
+	const char *filename,
+	int holdout)
+{
+	crfsuite_train_internal_t *tr = (crfsuite_train_internal_t*)self->internal;
+	return crfsuite_train_run(tr, tr->gm, tr->lg, self->ftype, data, filename, holdout);
+}
+
+/**
+ * A fold of cross validation.
+ */
+typedef struct tag_cvfold cvfold_t;
+
+/**
+ * Folds running concurrently.
+ */
+typedef struct {
+#ifdef    HAVE_PTHREAD_H
+	pthread_mutex_t mutex;      /**< Mutex for the members below. */
+	pthread_cond_t cond;        /**< Signaled when a fold finishes. */
+#endif/*HAVE_PTHREAD_H*/
+	int running;                /**< Number of running folds. */
+	size_t memory;              /**< Estimated memory of the running folds. */
+} cvpool_t;
+
+struct tag_cvfold {
+	crfsuite_train_internal_t *tr;  /**< Trainer (read only). */
+	const crfsuite_data_t *data;    /**< Data set shared by the folds. */
+	const crf1df_groups_t *groups;  /**< Feature counts shared by the folds. */
+	cvpool_t *pool;                 /**< Pool of the running folds. */
+	int ftype;                      /**< Type of graphical model. */
+	int holdout;                    /**< Holdout group. */
+	size_t memory;                  /**< Estimated memory usage. */
+	char *log;                      /**< Training log. */
+	size_t log_size;                /**< Length of the training log. */
+	size_t log_cap;                 /**< Capacity of the training log. */
+	int ret;                        /**< Status code. */
+	int done;                       /**< Nonzero when finished. */
+#ifdef    HAVE_PTHREAD_H
+	pthread_t thread;               /**< Thread training this fold. */
+	int started;                    /**< Nonzero if the thread was created. */
+#endif/*HAVE_PTHREAD_H*/
+};
+
+/* Keep the log of a fold, which is reported after the preceding folds. */
+static int cvfold_message(void *instance, const char *format, va_list args)
+{
+	int n;
+	va_list copy;
+	cvfold_t *fold = (cvfold_t*)instance;
+
+	va_copy(copy, args);
+	n = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (n < 0) {
+		return 0;
+	}
+
+	if (fold->log_cap <= fold->log_size + n) {
+		size_t cap = fold->log_cap ? fold->log_cap : 4096;
+		char *log = NULL;
+		while (cap <= fold->log_size + n) {
+			cap *= 2;
+		}
+		log = (char*)realloc(fold->log, cap);
+		if (log == NULL) {
+			return 0;
+		}
+		fold->log = log;
+		fold->log_cap = cap;
+	}
+	vsnprintf(fold->log + fold->log_size, n + 1, format, args);
+	fold->log_size += n;
+	return 0;
+}
+
+/* Rough memory usage of a fold: features, references, and the vectors of
+   the training algorithm (L-BFGS keeps 2m + 4 of them, m = 6 by default). */
+static size_t cvfold_memory(const crf1df_groups_t *groups, int holdout)
+{
+	size_t K = (groups != NULL) ? (size_t)crf1df_groups_num_features(groups, holdout) : 0;
+	return K * (sizeof(crf1df_feature_t) + 2 * sizeof(int) + 16 * sizeof(floatval_t));
+}
+
+/* Train a fold; the log is kept in the fold unless lg is given. */
+static void cvfold_train(cvfold_t *fold, logging_t *lg)
+{
+	logging_t buffer;
+	encoder_t *gm = crf1d_create_encoder(fold->ftype);
+
+	if (lg == NULL) {
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.func = cvfold_message;
+		buffer.instance = fold;
+		lg = &buffer;
+	}
+
+	if (gm == NULL) {
+		fold->ret = CRFSUITEERR_OUTOFMEMORY;
+		return;
+	}
+	gm->set_groups(gm, fold->groups, fold->holdout);
+	fold->ret = crfsuite_train_run(
+		fold->tr, gm, lg, fold->ftype, fold->data, "", fold->holdout);
+	gm->delete(gm);
+}
+
+#ifdef    HAVE_PTHREAD_H
+static void* cvfold_thread(void *arg)
+{
+	cvfold_t *fold = (cvfold_t*)arg;
+	cvpool_t *pool = fold->pool;
+
+	cvfold_train(fold, NULL);
+
+	pthread_mutex_lock(&pool->mutex);
+	fold->done = 1;
+	--pool->running;
+	pool->memory -= fold->memory;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+static void cvfold_report(cvfold_t *fold, int num_groups, logging_t *lg)
+{
+	logging(lg, "===== Cross validation (%d/%d) =====\n", fold->holdout + 1, num_groups);
+	if (fold->log != NULL) {
+		logging(lg, "%s", fold->log);
+	}
+	logging(lg, "\n");
+	free(fold->log);
+	fold->log = NULL;
+}
+#endif/*HAVE_PTHREAD_H*/
+
+static int crfsuite_train_cross_validate(crfsuite_trainer_t* self,
+	const crfsuite_data_t *data,
+	int num_groups,
+	int num_workers,
+	size_t max_memory)
+{
+	int i, ret = 0;
+	crfsuite_train_internal_t *tr = (crfsuite_train_internal_t*)self->internal;
+	logging_t *lg = tr->lg;
+	encoder_t *gm = tr->gm;
+	crf1df_groups_t *groups = NULL;
+	cvfold_t *folds = NULL;
+	cvpool_t pool;
+
+	if (num_groups <= 0) {
+		return 0;
+	}
+	if (num_workers < 1) {
+		num_workers = 1;
+	}
+
+	folds = (cvfold_t*)calloc(num_groups, sizeof(cvfold_t));
+	if (folds == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	memset(&pool, 0, sizeof(pool));
+
+	/* Count the features of all groups once; the semi-markov model
+	   generates features for each fold instead. */
+	gm->exchange_options(gm, tr->params, -1);
+	groups = gm->count_groups(gm, (crfsuite_data_t*)data, num_groups, lg);
+
+	for (i = 0; i < num_groups; ++i) {
+		folds[i].tr = tr;
+		folds[i].data = data;
+		folds[i].groups = groups;
+		folds[i].pool = &pool;
+		folds[i].ftype = self->ftype;
+		folds[i].holdout = i;
+		folds[i].memory = cvfold_memory(groups, i);
+	}
+
+#ifdef    HAVE_PTHREAD_H
+	if (1 < num_workers && 1 < num_groups) {
+		int next = 0, reported = 0;
+		pthread_mutex_init(&pool.mutex, NULL);
+		pthread_cond_init(&pool.cond, NULL);
+
+		pthread_mutex_lock(&pool.mutex);
+		while (reported < num_groups) {
+			/* Start folds while the workers and the memory budget permit;
+			   a fold always starts if no other fold is running. */
+			while (next < num_groups && ret == 0 && pool.running < num_workers &&
+				(pool.running == 0 || max_memory == 0 ||
+				pool.memory + folds[next].memory <= max_memory)) {
+				cvfold_t *fold = &folds[next++];
+				++pool.running;
+				pool.memory += fold->memory;
+				fold->started = (pthread_create(&fold->thread, NULL, cvfold_thread, fold) == 0);
+				if (!fold->started) {
+					/* Train the fold in this thread if no thread was created. */
+					pthread_mutex_unlock(&pool.mutex);
+					cvfold_thread(fold);
+					pthread_mutex_lock(&pool.mutex);
+				}
+			}
+
+			/* Report the finished folds in the order of the groups. */
+			if (reported < next && folds[reported].done) {
+				cvfold_t *fold = &folds[reported++];
+				pthread_mutex_unlock(&pool.mutex);
+				if (fold->started) {
+					pthread_join(fold->thread, NULL);
+				}
+				cvfold_report(fold, num_groups, lg);
+				pthread_mutex_lock(&pool.mutex);
+				if (ret == 0) {
+					ret = fold->ret;
+				}
+				continue;
+			}
+
+			/* No fold is running after an error. */
+			if (reported == next) {
+				break;
+			}
+			pthread_cond_wait(&pool.cond, &pool.mutex);
+		}
+		pthread_mutex_unlock(&pool.mutex);
+
+		pthread_cond_destroy(&pool.cond);
+		pthread_mutex_destroy(&pool.mutex);
+	}
+	else
+#endif/*HAVE_PTHREAD_H*/
+	for (i = 0; i < num_groups && ret == 0; ++i) {
+		/* Show the progress of the sequential folds as they go. */
+		logging(lg, "===== Cross validation (%d/%d) =====\n", i + 1, num_groups);
+		cvfold_train(&folds[i], lg);
+		logging(lg, "\n");
+		ret = folds[i].ret;
+	}
+
+	for (i = 0; i < num_groups; ++i) {
+		free(folds[i].log);
+	}
+	free(folds);
+	crf1df_delete_groups(groups);
+	return ret;
+}
+
 int crf1de_create_instance(const char *interface, void **ptr)
 {
 	int ftype = FTYPE_NONE;
@@ -269,6 +543,7 @@ int crf1de_create_instance(const char *interface, void **ptr)
 				trainer->params = crfsuite_train_params;
 				trainer->set_message_callback = crfsuite_train_set_message_callback;
 				trainer->train = crfsuite_train_train;
+				trainer->cross_validate = crfsuite_train_cross_validate;
 
 				*ptr = trainer;
 				return 0;
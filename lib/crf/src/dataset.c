@@ -40,6 +40,13 @@
 #include <crfsuite.h>
 #include "crfsuite_internal.h"
 
+/*
+ * Every data set draws the random numbers for shuffling from its own state,
+ * so that the folds of a cross validation yield the same results whether
+ * they are trained sequentially or concurrently.
+ */
+#define    DATASET_SEED    2463534242U
+
 void dataset_init_trainset(dataset_t *ds, crfsuite_data_t *data, \
 	int holdout)
 {
@@ -53,6 +60,7 @@ void dataset_init_trainset(dataset_t *ds, crfsuite_data_t *data, \
 	ds->data = data;
 	ds->num_instances = n;
 	ds->perm = (int*)malloc(sizeof(int) * n);
+	ds->seed = DATASET_SEED;
 
 	n = 0;
 	for (i = 0; i < data->num_instances; ++i) {
@@ -74,6 +82,7 @@ void dataset_init_testset(dataset_t *ds, crfsuite_data_t *data, int holdout)
 	ds->data = data;
 	ds->num_instances = n;
 	ds->perm = (int*)malloc(sizeof(int) * n);
+	ds->seed = DATASET_SEED;
 
 	n = 0;
 	for (i = 0; i < data->num_instances; ++i) {
@@ -83,16 +92,47 @@ void dataset_init_testset(dataset_t *ds, crfsuite_data_t *data, int holdout)
 	}
 }
 
+void dataset_init_shard(dataset_t *ds, const dataset_t *src, int rank, \
+	int size)
+{
+	int i, n = 0;
+
+	for (i = rank; i < src->num_instances; i += size) {
+		++n;
+	}
+
+	ds->data = src->data;
+	ds->num_instances = n;
+	ds->perm = (int*)malloc(sizeof(int) * (n + 1));
+	ds->seed = src->seed;
+
+	n = 0;
+	for (i = rank; i < src->num_instances; i += size) {
+		ds->perm[n++] = src->perm[i];
+	}
+}
+
 void dataset_finish(dataset_t *ds)
 {
 	free(ds->perm);
 }
 
+/* Xorshift generator (Marsaglia, 2003) of 32-bit random numbers. */
+static uint32_t dataset_rand(dataset_t *ds)
+{
+	uint32_t x = ds->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	ds->seed = x;
+	return x;
+}
+
 void dataset_shuffle(dataset_t *ds)
 {
 	int i;
 	for (i = 0; i < ds->num_instances; ++i) {
-		int j = rand() % ds->num_instances;
+		int j = (int)(dataset_rand(ds) % (uint32_t)ds->num_instances);
 		int tmp = ds->perm[j];
 		ds->perm[j] = ds->perm[i];
 		ds->perm[i] = tmp;
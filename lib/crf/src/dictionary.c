@@ -32,11 +32,14 @@
 
 #include <os.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <crfsuite.h>
 #include "quark.h"
+#include "hquark.h"
+#include "cquark.h"
 
 static int dictionary_addref(crfsuite_dictionary_t* dic)
 {
@@ -67,12 +70,24 @@ static int dictionary_get(crfsuite_dictionary_t* dic, const char *str)
 	return quark_get(qrk, str);
 }
 
+static int dictionary_get_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	quark_t *qrk = (quark_t*)dic->internal;
+	return quark_get_n(qrk, str, length);
+}
+
 static int dictionary_to_id(crfsuite_dictionary_t* dic, const char *str)
 {
 	quark_t *qrk = (quark_t*)dic->internal;
 	return quark_to_id(qrk, str);
 }
 
+static int dictionary_to_id_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	quark_t *qrk = (quark_t*)dic->internal;
+	return quark_to_id_n(qrk, str, length);
+}
+
 static int dictionary_to_string(crfsuite_dictionary_t* dic, int id, char const **pstr)
 {
 	quark_t *qrk = (quark_t*)dic->internal;
@@ -99,9 +114,249 @@ static void dictionary_free(crfsuite_dictionary_t* dic, const char *str)
 	free((char*)str);
 }
 
+static int dictionary_renumber(crfsuite_dictionary_t* dic, const int *map)
+{
+	int i, n;
+	int *inv = NULL;
+	quark_t *qrk = (quark_t*)dic->internal;
+	quark_t *newqrk = NULL;
+
+	/* Make sure that the map is a permutation of the identifiers. */
+	n = quark_num(qrk);
+	inv = (int*)malloc(sizeof(int) * (n + 1));
+	if (inv == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	for (i = 0; i < n; ++i) {
+		inv[i] = -1;
+	}
+	for (i = 0; i < n; ++i) {
+		if (map[i] < 0 || n <= map[i] || 0 <= inv[map[i]]) {
+			free(inv);
+			return CRFSUITEERR_INCOMPATIBLE;
+		}
+		inv[map[i]] = i;
+	}
+
+	/* Insert the strings to a new quark in the new order. */
+	newqrk = quark_new();
+	for (i = 0; i < n; ++i) {
+		quark_get(newqrk, quark_to_string(qrk, inv[i]));
+	}
+	quark_delete(qrk);
+	dic->internal = newqrk;
+	free(inv);
+	return 0;
+}
+
+/*
+ *    Implementation of crfsuite_dictionary_t object with a hashed quark.
+ *    This object is instantiated by the interface ID "dictionary/hash".
+ */
+
+static int hdictionary_release(crfsuite_dictionary_t* dic)
+{
+	int count = crfsuite_interlocked_decrement(&dic->nref);
+	if (count == 0) {
+		hquark_t *qrk = (hquark_t*)dic->internal;
+		hquark_delete(qrk);
+		free(dic);
+	}
+	return count;
+}
+
+static void hdictionary_reset(crfsuite_dictionary_t* dic)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	hquark_delete(qrk);
+	dic->internal = hquark_new();
+}
+
+static int hdictionary_get(crfsuite_dictionary_t* dic, const char *str)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_get(qrk, str);
+}
+
+static int hdictionary_get_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_get_n(qrk, str, length);
+}
+
+static int hdictionary_to_id(crfsuite_dictionary_t* dic, const char *str)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_to_id(qrk, str);
+}
+
+static int hdictionary_to_id_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_to_id_n(qrk, str, length);
+}
+
+static int hdictionary_to_string(crfsuite_dictionary_t* dic, int id, char const **pstr)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	const char *str = hquark_to_string(qrk, id);
+	if (str != NULL) {
+		char *dst = (char*)malloc(strlen(str) + 1);
+		if (dst) {
+			strcpy(dst, str);
+			*pstr = dst;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int hdictionary_num(crfsuite_dictionary_t* dic)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_num(qrk);
+}
+
+static int hdictionary_renumber(crfsuite_dictionary_t* dic, const int *map)
+{
+	hquark_t *qrk = (hquark_t*)dic->internal;
+	return hquark_renumber(qrk, map) == 0 ? 0 : CRFSUITEERR_INCOMPATIBLE;
+}
+
+/*
+ *    Implementation of crfsuite_dictionary_t object with a concurrent quark.
+ *    This object is instantiated by the interface ID "dictionary/concurrent".
+ *    Threads can call get(), to_id() and to_id_n() at the same time.
+ */
+
+static int cdictionary_release(crfsuite_dictionary_t* dic)
+{
+	int count = crfsuite_interlocked_decrement(&dic->nref);
+	if (count == 0) {
+		cquark_t *qrk = (cquark_t*)dic->internal;
+		cquark_delete(qrk);
+		free(dic);
+	}
+	return count;
+}
+
+static void cdictionary_reset(crfsuite_dictionary_t* dic)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	cquark_delete(qrk);
+	dic->internal = cquark_new();
+}
+
+static int cdictionary_get(crfsuite_dictionary_t* dic, const char *str)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_get(qrk, str);
+}
+
+static int cdictionary_get_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_get_n(qrk, str, length);
+}
+
+static int cdictionary_to_id(crfsuite_dictionary_t* dic, const char *str)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_to_id(qrk, str);
+}
+
+static int cdictionary_to_id_n(crfsuite_dictionary_t* dic, const char *str, size_t length)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_to_id_n(qrk, str, length);
+}
+
+static int cdictionary_to_string(crfsuite_dictionary_t* dic, int id, char const **pstr)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	const char *str = cquark_to_string(qrk, id);
+	if (str != NULL) {
+		char *dst = (char*)malloc(strlen(str) + 1);
+		if (dst) {
+			strcpy(dst, str);
+			*pstr = dst;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int cdictionary_num(crfsuite_dictionary_t* dic)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_num(qrk);
+}
+
+static int cdictionary_renumber(crfsuite_dictionary_t* dic, const int *map)
+{
+	cquark_t *qrk = (cquark_t*)dic->internal;
+	return cquark_renumber(qrk, map) == 0 ? 0 : CRFSUITEERR_INCOMPATIBLE;
+}
+
 int crfsuite_dictionary_create_instance(const char *interface, void **ptr)
 {
-	if (strcmp(interface, "dictionary") == 0) {
+	if (strcmp(interface, "dictionary/concurrent") == 0) {
+		crfsuite_dictionary_t* dic = (crfsuite_dictionary_t*)calloc(1, sizeof(crfsuite_dictionary_t));
+
+		if (dic != NULL) {
+			dic->internal = cquark_new();
+			if (dic->internal == NULL) {
+				free(dic);
+				return -1;
+			}
+			dic->nref = 1;
+			dic->addref = dictionary_addref;
+			dic->release = cdictionary_release;
+			dic->reset = cdictionary_reset;
+			dic->get = cdictionary_get;
+			dic->to_id = cdictionary_to_id;
+			dic->to_string = cdictionary_to_string;
+			dic->num = cdictionary_num;
+			dic->free = dictionary_free;
+			dic->to_id_n = cdictionary_to_id_n;
+			dic->renumber = cdictionary_renumber;
+			dic->get_n = cdictionary_get_n;
+			*ptr = dic;
+			return 0;
+		}
+		else {
+			return -1;
+		}
+	}
+	else if (strcmp(interface, "dictionary/hash") == 0) {
+		crfsuite_dictionary_t* dic = (crfsuite_dictionary_t*)calloc(1, sizeof(crfsuite_dictionary_t));
+
+		if (dic != NULL) {
+			dic->internal = hquark_new();
+			if (dic->internal == NULL) {
+				free(dic);
+				return -1;
+			}
+			dic->nref = 1;
+			dic->addref = dictionary_addref;
+			dic->release = hdictionary_release;
+			dic->reset = hdictionary_reset;
+			dic->get = hdictionary_get;
+			dic->to_id = hdictionary_to_id;
+			dic->to_string = hdictionary_to_string;
+			dic->num = hdictionary_num;
+			dic->free = dictionary_free;
+			dic->to_id_n = hdictionary_to_id_n;
+			dic->renumber = hdictionary_renumber;
+			dic->get_n = hdictionary_get_n;
+			*ptr = dic;
+			return 0;
+		}
+		else {
+			return -1;
+		}
+	}
+	else if (strcmp(interface, "dictionary") == 0) {
 		crfsuite_dictionary_t* dic = (crfsuite_dictionary_t*)calloc(1, sizeof(crfsuite_dictionary_t));
 
 		if (dic != NULL) {
@@ -115,6 +370,9 @@ int crfsuite_dictionary_create_instance(const char *interface, void **ptr)
 			dic->to_string = dictionary_to_string;
 			dic->num = dictionary_num;
 			dic->free = dictionary_free;
+			dic->to_id_n = dictionary_to_id_n;
+			dic->renumber = dictionary_renumber;
+			dic->get_n = dictionary_get_n;
 			*ptr = dic;
 			return 0;
 		}
@@ -0,0 +1,299 @@
+/*
+ *      Quark object with an open-addressing hash table and a string arena.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+ /* $Id$ */
+
+#include "os.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hquark.h"
+
+/* Default size of a block in the string arena. */
+#define    ARENA_BLOCK_SIZE    (1 << 16)
+
+/* Slot of the hash table; qid is negative for an empty slot. */
+typedef struct {
+	uint32_t hash;
+	int qid;
+} slot_t;
+
+/* Block of the string arena. Strings are never moved once stored. */
+typedef struct tag_arena_block {
+	struct tag_arena_block *next;
+	size_t used;
+	size_t size;
+} arena_block_t;
+
+struct tag_hquark {
+	int num;
+	int max;
+	char **id_to_string;
+	size_t *lengths;
+
+	slot_t *table;
+	uint32_t mask;
+
+	arena_block_t *arena;
+};
+
+#define    HASH_ROTL(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint32_t hquark_hash(const char *str, size_t length)
+{
+	const uint64_t m = 0x9E3779B185EBCA87ULL;
+	uint64_t h = 0xC2B2AE3D27D4EB4FULL ^ ((uint64_t)length * m);
+	uint64_t k;
+
+	while (8 <= length) {
+		memcpy(&k, str, sizeof(k));
+		h ^= HASH_ROTL(k * m, 31) * m;
+		h = HASH_ROTL(h, 27) * m;
+		str += 8;
+		length -= 8;
+	}
+	for (k = 0; 0 < length; ) {
+		k = (k << 8) | (uint8_t)str[--length];
+	}
+	h ^= HASH_ROTL(k * m, 31) * m;
+
+	h ^= h >> 33;
+	h *= 0xC2B2AE3D27D4EB4FULL;
+	h ^= h >> 29;
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+static char *arena_store(hquark_t* qrk, const char *str, size_t length)
+{
+	char *dst = NULL;
+	arena_block_t *block = qrk->arena;
+
+	/* Allocate a new block if the current one cannot hold the string. */
+	if (block == NULL || block->size - block->used < length + 1) {
+		size_t size = (ARENA_BLOCK_SIZE < length + 1) ? length + 1 : ARENA_BLOCK_SIZE;
+		block = (arena_block_t*)malloc(sizeof(arena_block_t) + size);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->next = qrk->arena;
+		block->used = 0;
+		block->size = size;
+		qrk->arena = block;
+	}
+
+	dst = (char*)(block + 1) + block->used;
+	memcpy(dst, str, length);
+	dst[length] = 0;
+	block->used += length + 1;
+	return dst;
+}
+
+static int table_resize(hquark_t* qrk, uint32_t size)
+{
+	int i;
+	uint32_t k;
+	slot_t *table = (slot_t*)malloc(sizeof(slot_t) * size);
+	if (table == NULL) {
+		return -1;
+	}
+	for (k = 0; k < size; ++k) {
+		table[k].qid = -1;
+	}
+
+	/* Reinsert the strings in the order of their identifiers. */
+	for (i = 0; i < qrk->num; ++i) {
+		uint32_t hv = hquark_hash(qrk->id_to_string[i], qrk->lengths[i]);
+		for (k = hv & (size - 1); 0 <= table[k].qid; k = (k + 1) & (size - 1));
+		table[k].hash = hv;
+		table[k].qid = i;
+	}
+
+	free(qrk->table);
+	qrk->table = table;
+	qrk->mask = size - 1;
+	return 0;
+}
+
+/* Find the slot for the string: the slot holding it or an empty one. */
+static slot_t *find_slot(hquark_t* qrk, const char *str, size_t length, uint32_t hv)
+{
+	uint32_t k = hv & qrk->mask;
+	slot_t *slot = NULL;
+
+	while (slot = &qrk->table[k], 0 <= slot->qid) {
+		if (slot->hash == hv && qrk->lengths[slot->qid] == length &&
+			memcmp(qrk->id_to_string[slot->qid], str, length) == 0) {
+			break;
+		}
+		k = (k + 1) & qrk->mask;
+	}
+	return slot;
+}
+
+hquark_t* hquark_new()
+{
+	hquark_t* qrk = (hquark_t*)calloc(1, sizeof(hquark_t));
+	if (qrk != NULL) {
+		if (table_resize(qrk, 1024) != 0) {
+			free(qrk);
+			return NULL;
+		}
+	}
+	return qrk;
+}
+
+void hquark_delete(hquark_t* qrk)
+{
+	if (qrk != NULL) {
+		arena_block_t *block = qrk->arena;
+		while (block != NULL) {
+			arena_block_t *next = block->next;
+			free(block);
+			block = next;
+		}
+		free(qrk->table);
+		free(qrk->lengths);
+		free(qrk->id_to_string);
+		free(qrk);
+	}
+}
+
+int hquark_get(hquark_t* qrk, const char *str)
+{
+	return hquark_get_n(qrk, str, strlen(str));
+}
+
+int hquark_get_n(hquark_t* qrk, const char *str, size_t length)
+{
+	char *newstr = NULL;
+	uint32_t hv = hquark_hash(str, length);
+	slot_t *slot = find_slot(qrk, str, length, hv);
+
+	if (0 <= slot->qid) {
+		return slot->qid;
+	}
+
+	/* Keep the load factor of the hash table at most 1/2. */
+	if (qrk->mask < (uint32_t)(qrk->num + 1) * 2) {
+		if (table_resize(qrk, (qrk->mask + 1) * 2) != 0) {
+			return -1;
+		}
+		slot = find_slot(qrk, str, length, hv);
+	}
+
+	if (qrk->max <= qrk->num) {
+		int max = (qrk->max + 1) * 2;
+		char **id_to_string = (char **)realloc(qrk->id_to_string, sizeof(char *) * max);
+		size_t *lengths = NULL;
+		if (id_to_string == NULL) {
+			return -1;
+		}
+		qrk->id_to_string = id_to_string;
+		lengths = (size_t*)realloc(qrk->lengths, sizeof(size_t) * max);
+		if (lengths == NULL) {
+			return -1;
+		}
+		qrk->lengths = lengths;
+		qrk->max = max;
+	}
+
+	newstr = arena_store(qrk, str, length);
+	if (newstr == NULL) {
+		return -1;
+	}
+
+	qrk->id_to_string[qrk->num] = newstr;
+	qrk->lengths[qrk->num] = length;
+	slot->hash = hv;
+	slot->qid = qrk->num;
+	return qrk->num++;
+}
+
+int hquark_to_id(hquark_t* qrk, const char *str)
+{
+	return hquark_to_id_n(qrk, str, strlen(str));
+}
+
+int hquark_to_id_n(hquark_t* qrk, const char *str, size_t length)
+{
+	const slot_t *slot = find_slot(qrk, str, length, hquark_hash(str, length));
+	return slot->qid;
+}
+
+int hquark_renumber(hquark_t* qrk, const int *map)
+{
+	int i, ret = -1;
+	char **id_to_string = (char **)malloc(sizeof(char *) * (qrk->num + 1));
+	size_t *lengths = (size_t*)malloc(sizeof(size_t) * (qrk->num + 1));
+
+	if (id_to_string == NULL || lengths == NULL) {
+		goto exit;
+	}
+
+	/* Make sure that the map is a permutation of the identifiers. */
+	for (i = 0; i < qrk->num; ++i) {
+		id_to_string[i] = NULL;
+	}
+	for (i = 0; i < qrk->num; ++i) {
+		if (map[i] < 0 || qrk->num <= map[i] || id_to_string[map[i]] != NULL) {
+			goto exit;
+		}
+		id_to_string[map[i]] = qrk->id_to_string[i];
+		lengths[map[i]] = qrk->lengths[i];
+	}
+
+	/* Replace the arrays and rebuild the hash table. */
+	free(qrk->id_to_string);
+	free(qrk->lengths);
+	qrk->id_to_string = id_to_string;
+	qrk->lengths = lengths;
+	qrk->max = qrk->num + 1;
+	id_to_string = NULL;
+	lengths = NULL;
+	ret = table_resize(qrk, qrk->mask + 1);
+
+exit:
+	free(lengths);
+	free(id_to_string);
+	return ret;
+}
+
+const char *hquark_to_string(hquark_t* qrk, int qid)
+{
+	return (0 <= qid && qid < qrk->num) ? qrk->id_to_string[qid] : NULL;
+}
+
+int hquark_num(hquark_t* qrk)
+{
+	return qrk->num;
+}
@@ -0,0 +1,55 @@
+/*
+ *      Quark object with an open-addressing hash table and a string arena.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+ /* $Id$ */
+
+#ifndef    __HQUARK_H__
+#define    __HQUARK_H__
+
+/*
+	The hashed quark has the same semantics as quark_t: identifiers are
+	assigned to strings from zero in the order of their first insertion.
+ */
+struct tag_hquark;
+typedef struct tag_hquark hquark_t;
+
+hquark_t* hquark_new();
+void hquark_delete(hquark_t* qrk);
+int hquark_get(hquark_t* qrk, const char *str);
+int hquark_get_n(hquark_t* qrk, const char *str, size_t length);
+int hquark_to_id(hquark_t* qrk, const char *str);
+int hquark_to_id_n(hquark_t* qrk, const char *str, size_t length);
+int hquark_renumber(hquark_t* qrk, const int *map);
+const char *hquark_to_string(hquark_t* qrk, int qid);
+int hquark_num(hquark_t* qrk);
+uint32_t hquark_hash(const char *str, size_t length);
+
+#endif/*__HQUARK_H__*/
@@ -31,14 +31,16 @@
  /* $Id$ */
 
 #include "os.h"
-#include "quark.h"
-#include "rumavl.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#include "quark.h"
+#include "rumavl.h"
+
 typedef struct {
 	char *str;
+	size_t len;
 	int qid;
 } record_t;
 
@@ -53,7 +55,11 @@ static int keycmp(const void *_x, const void *_y, size_t n, void *udata)
 {
 	const record_t* x = (const record_t*)_x;
 	const record_t* y = (const record_t*)_y;
-	return strcmp(x->str, y->str);
+	int ret = memcmp(x->str, y->str, (x->len < y->len) ? x->len : y->len);
+	if (ret == 0) {
+		ret = (x->len < y->len) ? -1 : (y->len < x->len);
+	}
+	return ret;
 }
 
 static int owcb(RUMAVL *tree, RUMAVL_NODE *n, void *_x, const void *_y, void *udata)
@@ -96,15 +102,22 @@ void quark_delete(quark_t* qrk)
 }
 
 int quark_get(quark_t* qrk, const char *str)
+{
+	return quark_get_n(qrk, str, strlen(str));
+}
+
+int quark_get_n(quark_t* qrk, const char *str, size_t length)
 {
 	record_t key, *record = NULL;
 
 	key.str = (char *)str;
+	key.len = length;
 	record = (record_t*)rumavl_find(qrk->string_to_id, &key);
 	if (record == NULL) {
-		char *newstr = (char*)malloc(strlen(str) + 1);
+		char *newstr = (char*)malloc(key.len + 1);
 		if (newstr != NULL) {
-			strcpy(newstr, str);
+			memcpy(newstr, str, key.len);
+			newstr[key.len] = 0;
 		}
 
 		if (qrk->max <= qrk->num) {
@@ -126,10 +139,16 @@ int quark_get(quark_t* qrk, const char *str)
 }
 
 int quark_to_id(quark_t* qrk, const char *str)
+{
+	return quark_to_id_n(qrk, str, strlen(str));
+}
+
+int quark_to_id_n(quark_t* qrk, const char *str, size_t length)
 {
 	record_t key, *record = NULL;
 
 	key.str = (char *)str;
+	key.len = length;
 	record = (record_t*)rumavl_find(qrk->string_to_id, &key);
 	return (record != NULL) ? record->qid : -1;
 }
@@ -39,7 +39,9 @@ typedef struct tag_quark quark_t;
 quark_t* quark_new();
 void quark_delete(quark_t* qrk);
 int quark_get(quark_t* qrk, const char *str);
+int quark_get_n(quark_t* qrk, const char *str, size_t length);
 int quark_to_id(quark_t* qrk, const char *str);
+int quark_to_id_n(quark_t* qrk, const char *str, size_t length);
 const char *quark_to_string(quark_t* qrk, int qid);
 int quark_num(quark_t* qrk);
 
@@ -48,6 +48,7 @@
 #include "logging.h"
 #include "params.h"
 #include "vecmath.h"
+#include "allreduce.h"
 #include <lbfgs.h>
 
 /**
@@ -63,6 +64,9 @@ typedef struct {
 	int         max_iterations;
 	char*       linesearch;
 	int         linesearch_max_iterations;
+	int         dist_size;
+	int         dist_rank;
+	char*       dist_address;
 } training_option_t;
 
 /**
@@ -76,6 +80,9 @@ typedef struct {
 	floatval_t c2;
 	floatval_t* best_w;
 	clock_t begin;
+	allreduce_t *ar;        /**< Allreduce channel (distributed training). */
+	floatval_t* obs;        /**< Observation expectations (ranks other than #0). */
+	int error;
 } lbfgs_internal_t;
 
 static lbfgsfloatval_t lbfgs_evaluate(void *instance,
@@ -93,6 +100,20 @@ static lbfgsfloatval_t lbfgs_evaluate(void *instance,
 	/* Compute the objective value and gradients. */
 	gm->objective_and_gradients_batch(gm, trainset, x, &f, g);
 
+	/* Sum up the objective and gradients computed for the shards. */
+	if (lbfgsi->ar != NULL && !lbfgsi->error) {
+		/* The observation expectations are counted only once (by rank #0). */
+		if (lbfgsi->obs != NULL) {
+			for (i = 0; i < n; ++i) {
+				g[i] -= lbfgsi->obs[i];
+			}
+		}
+		if (allreduce_sum(lbfgsi->ar, g, n) != 0 || \
+			allreduce_sum(lbfgsi->ar, &f, 1) != 0) {
+			lbfgsi->error = CRFSUITEERR_UNKNOWN;
+		}
+	}
+
 	/* L2 regularization. */
 	const floatval_t c22 = lbfgsi->c2 * 2.;
 	if (0 < lbfgsi->c2) {
@@ -151,10 +172,84 @@ static int lbfgs_progress(
 
 	logging(lg, "\n");
 
+	/* Cancel the optimization if the allreduce channel is broken. */
+	if (lbfgsi->error) {
+		logging(lg, "ERROR: Failed to exchange the gradients between processes\n");
+		return lbfgsi->error;
+	}
+
 	/* Continue. */
 	return 0;
 }
 
+/**
+ * Connect to the other processes of a distributed training job and shard
+ * the training data by the rank of this process. Every process generates
+ * features from the whole training set, which must be identical among the
+ * processes; the feature set is checked against the one of rank #0.
+ */
+static int lbfgs_distribute(
+	lbfgs_internal_t *lbfgsi,
+	const training_option_t *opt,
+	encoder_t *gm,
+	dataset_t *trainset,
+	dataset_t *shard,
+	floatval_t *w,
+	const int K
+)
+{
+	int i, ret = 0;
+	dataset_t empty;
+	floatval_t f, local[2], root[2];
+	logging_t *lg = lbfgsi->lg;
+
+	logging(lg, "Distributed training: rank %d of %d (%s)\n", \
+		opt->dist_rank, opt->dist_size, opt->dist_address);
+
+	if ((ret = allreduce_open(&lbfgsi->ar, opt->dist_address, \
+		opt->dist_rank, opt->dist_size))) {
+		logging(lg, "ERROR: Failed to connect the processes\n");
+		return ret;
+	}
+
+	/* Obtain the observation expectations with an empty data set. */
+	lbfgsi->obs = (floatval_t*)calloc(sizeof(floatval_t), K);
+	if (lbfgsi->obs == NULL) {
+		return CRFSUITEERR_OUTOFMEMORY;
+	}
+	memset(&empty, 0, sizeof(empty));
+	empty.data = trainset->data;
+	gm->objective_and_gradients_batch(gm, &empty, w, &f, lbfgsi->obs);
+
+	/* Check that all the ranks have generated the same features. */
+	local[0] = K;
+	local[1] = 0.;
+	for (i = 0; i < K; ++i) {
+		local[1] += (i % 1021 + 1) * lbfgsi->obs[i];
+	}
+	root[0] = local[0];
+	root[1] = local[1];
+	if ((ret = allreduce_broadcast(lbfgsi->ar, root, 2))) {
+		logging(lg, "ERROR: Failed to exchange the feature set\n");
+		return ret;
+	}
+	if (root[0] != local[0] || root[1] != local[1]) {
+		logging(lg, "ERROR: The features differ from those of rank 0\n");
+		return CRFSUITEERR_INCOMPATIBLE;
+	}
+
+	/* Rank #0 keeps the observation expectations in its gradients. */
+	if (opt->dist_rank == 0) {
+		free(lbfgsi->obs);
+		lbfgsi->obs = NULL;
+	}
+
+	dataset_init_shard(shard, trainset, opt->dist_rank, opt->dist_size);
+	logging(lg, "Number of instances in the shard: %d\n", shard->num_instances);
+	logging(lg, "\n");
+	return 0;
+}
+
 static int exchange_options(crfsuite_params_t* params, training_option_t* opt, int mode)
 {
 	BEGIN_PARAM_MAP(params, mode)
@@ -200,6 +295,23 @@ static int exchange_options(crfsuite_params_t* params, training_option_t* opt, i
 			"max_linesearch", opt->linesearch_max_iterations, 20,
 			"The maximum number of trials for the line search algorithm."
 		)
+		DDX_PARAM_INT(
+			"distributed.size", opt->dist_size, 1,
+			"The number of processes that train the model together; every process\n"
+			"reads the same training data, and computes the gradients for its share."
+		)
+		DDX_PARAM_INT(
+			"distributed.rank", opt->dist_rank, 0,
+			"The rank of this process (0 ... ${distributed.size}-1); rank 0 reduces\n"
+			"the gradients and writes the model."
+		)
+		DDX_PARAM_STRING(
+			"distributed.address", opt->dist_address, "unix:crfsuite.sock",
+			"The address at which rank 0 waits for the other processes:\n"
+			"{   'unix:PATH': Unix domain socket (processes on a single machine),\n"
+			"    'tcp:HOST:PORT': TCP connection\n"
+			"}\n"
+		)
 	END_PARAM_MAP()
 
 	return __ret;
@@ -227,9 +339,11 @@ int crfsuite_train_lbfgs(
 	lbfgs_internal_t lbfgsi;
 	lbfgs_parameter_t lbfgsparam;
 	training_option_t opt;
+	dataset_t shard;
 
 	/* Initialize the variables. */
 	memset(&lbfgsi, 0, sizeof(lbfgsi));
+	memset(&shard, 0, sizeof(shard));
 	memset(&opt, 0, sizeof(opt));
 	lbfgs_parameter_init(&lbfgsparam);
 
@@ -262,6 +376,22 @@ int crfsuite_train_lbfgs(
 	logging(lg, "linesearch.max_iterations: %d\n", opt.linesearch_max_iterations);
 	logging(lg, "\n");
 
+	/* Set other callback data. */
+	lbfgsi.gm = gm;
+	lbfgsi.trainset = trainset;
+	lbfgsi.testset = testset;
+	lbfgsi.c2 = opt.c2;
+	lbfgsi.lg = lg;
+
+	/* Split the training data among the processes. */
+	if (1 < opt.dist_size) {
+		if ((ret = lbfgs_distribute(&lbfgsi, &opt, gm, trainset, &shard, w, K)))
+			goto error_exit;
+		lbfgsi.trainset = &shard;
+		if (opt.dist_rank != 0)
+			lbfgsi.testset = NULL;
+	}
+
 	/* Set parameters for L-BFGS. */
 	lbfgsparam.m = opt.memory;
 	lbfgsparam.epsilon = opt.epsilon;
@@ -288,13 +418,6 @@ int crfsuite_train_lbfgs(
 		lbfgsparam.orthantwise_c = 0;
 	}
 
-	/* Set other callback data. */
-	lbfgsi.gm = gm;
-	lbfgsi.trainset = trainset;
-	lbfgsi.testset = testset;
-	lbfgsi.c2 = opt.c2;
-	lbfgsi.lg = lg;
-
 	/* Call the L-BFGS solver. */
 	lbfgsi.begin = clock();
 	lbret = lbfgs(
@@ -315,6 +438,12 @@ int crfsuite_train_lbfgs(
 	else
 		logging(lg, "L-BFGS terminated with error code (%d)\n", lbret);
 
+	/* Do not return the weights of an optimization canceled by an error. */
+	if (lbfgsi.error) {
+		ret = lbfgsi.error;
+		goto error_exit;
+	}
+
 	/* Restore the feature weights of the last call of lbfgs_progress(). */
 	veccopy(w, lbfgsi.best_w, K);
 
@@ -323,11 +452,17 @@ int crfsuite_train_lbfgs(
 	logging(lg, "\n");
 
 	/* Exit with success. */
+	allreduce_close(lbfgsi.ar);
+	dataset_finish(&shard);
+	free(lbfgsi.obs);
 	free(lbfgsi.best_w);
 	*ptr_w = w;
 	return 0;
 
 error_exit:
+	allreduce_close(lbfgsi.ar);
+	dataset_finish(&shard);
+	free(lbfgsi.obs);
 	free(lbfgsi.best_w);
 	free(w);
 	*ptr_w = NULL;
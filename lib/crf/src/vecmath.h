@@ -192,6 +192,101 @@ inline static floatval_t logsumexp(floatval_t a, floatval_t b) {
 		return b + log(1 + exp(a - b));
 }
 
+/*
+ * Single-precision variants used by the contexts of the float32 build
+ * (--enable-float32). Sums and dot products are accumulated in double.
+ */
+inline static void veczerof(float *x, const int n)
+{
+	if (n) {
+		memset(x, 0, sizeof(float) * n);
+	}
+}
+
+inline static void vecsetf(float *x, const float a, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i) {
+		x[i] = a;
+	}
+}
+
+inline static void veccopyf(float *y, const float *x, const int n)
+{
+	if (n) {
+		memcpy(y, x, sizeof(float) * n);
+	}
+}
+
+inline static void vecaddf(float *y, const float *x, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i) {
+		y[i] += x[i];
+	}
+}
+
+inline static void vecaaddf(float *y, const float a, const float *x, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+inline static void vecmulf(float *y, const float *x, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i) {
+		y[i] *= x[i];
+	}
+}
+
+inline static void vecinvf(float *y, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i) {
+		y[i] = 1.f / y[i];
+	}
+}
+
+inline static void vecscalef(float *y, const float a, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i)
+		y[i] *= a;
+}
+
+inline static floatval_t vecdotf(const float *x, const float *y, const int n)
+{
+	int i;
+	floatval_t s = 0.;
+	for (i = 0; i < n; ++i) {
+		s += x[i] * y[i];
+	}
+	return s;
+}
+
+inline static floatval_t vecsumf(float* x, const int n)
+{
+	int i;
+	floatval_t s = 0.;
+
+	for (i = 0; i < n; ++i)
+		s += x[i];
+
+	return s;
+}
+
+inline static floatval_t vecsumlogf(float* x, const int n)
+{
+	int i;
+	floatval_t s = 0.;
+	for (i = 0; i < n; ++i) {
+		s += log(x[i]);
+	}
+	return s;
+}
+
 #ifdef  USE_SSE
 
 inline static void vecexp(double *values, const int n)
@@ -347,6 +442,68 @@ inline static void vecexp(double *values, const int n)
 	}
 }
 
+#define CONST_128S(var, val) \
+    MIE_ALIGN(16) static const float var[4] = {(val), (val), (val), (val)}
+
+inline static void vecexpf(float *values, const int n)
+{
+	int i;
+	CONST_128S(one, 1.f);
+	CONST_128S(half, 0.5f);
+	CONST_128S(log2e, 1.44269504088896341f);
+	CONST_128S(maxlog, 88.0296919311f);     // log(2**127)
+	CONST_128S(minlog, -87.3365447506f);    // log(2**-126)
+	CONST_128S(c1, 0.693359375f);
+	CONST_128S(c2, -2.12194440e-4f);
+	CONST_128S(p0, 1.9875691500E-4f);
+	CONST_128S(p1, 1.3981999507E-3f);
+	CONST_128S(p2, 8.3334519073E-3f);
+	CONST_128S(p3, 4.1665795894E-2f);
+	CONST_128S(p4, 1.6666665459E-1f);
+	CONST_128S(p5, 5.0000001201E-1f);
+	const __m128i offset = _mm_set1_epi32(127);
+
+	for (i = 0; i < n; i += 4) {
+		__m128i k;
+		__m128 x, a, p, y;
+
+		/* Load four float values. */
+		x = _mm_load_ps(values + i);
+		x = _mm_min_ps(x, _mm_load_ps(maxlog));
+		x = _mm_max_ps(x, _mm_load_ps(minlog));
+
+		/* k = (int)floor(x / log2 + 0.5); p = (float)k; */
+		a = _mm_add_ps(_mm_mul_ps(x, _mm_load_ps(log2e)), _mm_load_ps(half));
+		k = _mm_cvttps_epi32(a);
+		p = _mm_cvtepi32_ps(k);
+		y = _mm_and_ps(_mm_cmpgt_ps(p, a), _mm_load_ps(one));
+		p = _mm_sub_ps(p, y);
+		k = _mm_cvttps_epi32(p);
+
+		/* x -= p * log2; */
+		x = _mm_sub_ps(x, _mm_mul_ps(p, _mm_load_ps(c1)));
+		x = _mm_sub_ps(x, _mm_mul_ps(p, _mm_load_ps(c2)));
+
+		/* a = 1 + x + x^2 * P(x); */
+		a = _mm_load_ps(p0);
+		a = _mm_add_ps(_mm_mul_ps(a, x), _mm_load_ps(p1));
+		a = _mm_add_ps(_mm_mul_ps(a, x), _mm_load_ps(p2));
+		a = _mm_add_ps(_mm_mul_ps(a, x), _mm_load_ps(p3));
+		a = _mm_add_ps(_mm_mul_ps(a, x), _mm_load_ps(p4));
+		a = _mm_add_ps(_mm_mul_ps(a, x), _mm_load_ps(p5));
+		a = _mm_mul_ps(a, _mm_mul_ps(x, x));
+		a = _mm_add_ps(a, x);
+		a = _mm_add_ps(a, _mm_load_ps(one));
+
+		/* a *= 2^k. */
+		k = _mm_slli_epi32(_mm_add_epi32(k, offset), 23);
+		a = _mm_mul_ps(a, _mm_castsi128_ps(k));
+
+		/* Store the results. */
+		_mm_store_ps(values + i, a);
+	}
+}
+
 #else
 
 inline static void vecexp(double *values, const int n)
@@ -357,6 +514,14 @@ inline static void vecexp(double *values, const int n)
 	}
 }
 
+inline static void vecexpf(float *values, const int n)
+{
+	int i;
+	for (i = 0; i < n; ++i) {
+		values[i] = expf(values[i]);
+	}
+}
+
 #endif /*USE_SSE*/
 
 #endif/*__VECMATH_H__*/
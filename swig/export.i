@@ -1,4 +1,4 @@
-%module(directors="1") crfsuite
+%module(directors="1", threads="1") crfsuite
 
 %include <std_string.i>
 %include <std_vector.i>
@@ -8,6 +8,23 @@
 #include "crfsuite_api.hpp"
 %}
 
+/*
+ * The GIL is released only by the calls that do not touch Python objects;
+ * a tagger (or a trainer) must not be shared by Python threads.
+ */
+%nothread;
+%thread CRFSuite::Tagger::tag;
+%thread CRFSuite::Tagger::viterbi;
+%thread CRFSuite::Trainer::train;
+
+/* The interfaces with raw pointers are covered by Tagger.tag_arrays(). */
+%ignore CRFSuite::Tagger::set(const int *, const double *, const int *, int);
+%ignore CRFSuite::Tagger::viterbi(int *, double *);
+%ignore CRFSuite::Tagger::viterbi(const char **, double *);
+%ignore CRFSuite::Tagger::tag(const int *, const double *, const int *, const int *, int, int *, double *);
+%ignore CRFSuite::Tagger::attribute_id(const char *, std::size_t);
+%ignore CRFSuite::Tagger::attribute_id(const char *);
+
 %include "crfsuite_api.hpp"
 
 namespace CRFSuite {
@@ -32,3 +49,372 @@ typedef CRFSuite::StringList StringList;
         SWIG_exception(SWIG_RuntimeError,"Unknown exception");
     }
 }
+
+%{
+/*
+ * Conversions for the batch interface. The functions return false with a
+ * Python exception set when an argument is malformed.
+ */
+
+/* A contiguous buffer of an object supporting the buffer protocol. */
+class PyBatchBuffer
+{
+public:
+    Py_buffer view;
+    Py_ssize_t size;
+    bool held;
+
+    PyBatchBuffer() : size(0), held(false) {}
+    ~PyBatchBuffer() { if (held) PyBuffer_Release(&view); }
+
+    bool get(PyObject *obj, const char *name, char type, bool writable)
+    {
+        int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+        if (PyObject_GetBuffer(obj, &view, flags) != 0) {
+            return false;
+        }
+        held = true;
+
+        /* Accept the native (or little-endian) int and double. */
+        const char *fmt = view.format != NULL ? view.format : "B";
+        if (*fmt == '@' || *fmt == '=' || *fmt == '<') {
+            ++fmt;
+        }
+        bool ok = (type == 'd') ?
+            (*fmt == 'd' && view.itemsize == sizeof(double)) :
+            ((*fmt == 'i' || *fmt == 'l') && view.itemsize == sizeof(int));
+        if (!ok || fmt[1] != '\0') {
+            PyErr_Format(PyExc_TypeError, "%s must be an array of %s", name,
+                type == 'd' ? "doubles" : "32-bit integers");
+            return false;
+        }
+        size = view.len / view.itemsize;
+        return true;
+    }
+};
+
+/* Validate the layout of a batch before it is read without the GIL. */
+static bool crfsuite_check_batch(
+    Py_ssize_t num_aids, Py_ssize_t num_values, const int *offsets,
+    Py_ssize_t num_offsets, const int *lengths, Py_ssize_t N,
+    Py_ssize_t num_labels, Py_ssize_t num_marginals)
+{
+    Py_ssize_t I = 0;
+    for (Py_ssize_t n = 0; n < N; ++n) {
+        if (lengths[n] < 0) {
+            PyErr_SetString(PyExc_ValueError, "lengths must not be negative");
+            return false;
+        }
+        I += lengths[n];
+    }
+    if (num_offsets < I + 1) {
+        PyErr_SetString(PyExc_ValueError, "offsets must have sum(lengths) + 1 elements");
+        return false;
+    }
+    if (offsets[0] < 0 || num_aids < offsets[I]) {
+        PyErr_SetString(PyExc_ValueError, "offsets are out of range of aids");
+        return false;
+    }
+    for (Py_ssize_t i = 0; i < I; ++i) {
+        if (offsets[i + 1] < offsets[i]) {
+            PyErr_SetString(PyExc_ValueError, "offsets must not decrease");
+            return false;
+        }
+    }
+    if (0 <= num_values && num_values < num_aids) {
+        PyErr_SetString(PyExc_ValueError, "values must be as long as aids");
+        return false;
+    }
+    if (num_labels < I || (0 <= num_marginals && num_marginals < I)) {
+        PyErr_SetString(PyExc_ValueError, "the output arrays are too short");
+        return false;
+    }
+    return true;
+}
+
+/* A sequence converted by PySequence_Fast(). */
+class PyBatchSequence
+{
+public:
+    PyObject *seq;
+    Py_ssize_t size;
+
+    PyBatchSequence() : seq(NULL), size(0) {}
+    ~PyBatchSequence() { Py_XDECREF(seq); }
+
+    bool get(PyObject *obj, const char *message)
+    {
+        Py_XDECREF(seq);
+        seq = PySequence_Fast(obj, message);
+        size = (seq != NULL) ? PySequence_Fast_GET_SIZE(seq) : 0;
+        return seq != NULL;
+    }
+
+    PyObject *operator[](Py_ssize_t i) { return PySequence_Fast_GET_ITEM(seq, i); }
+};
+
+/* Obtain the UTF-8 string of a str (or bytes) object. */
+static bool crfsuite_get_string(PyObject *obj, const char **str, Py_ssize_t *len)
+{
+#if PY_VERSION_HEX >= 0x03000000
+    if (PyUnicode_Check(obj)) {
+        *str = PyUnicode_AsUTF8AndSize(obj, len);
+        return *str != NULL;
+    }
+    if (PyBytes_Check(obj)) {
+        return PyBytes_AsStringAndSize(obj, (char**)str, len) == 0;
+    }
+#else
+    if (PyString_Check(obj)) {
+        return PyString_AsStringAndSize(obj, (char**)str, len) == 0;
+    }
+#endif
+    PyErr_SetString(PyExc_TypeError, "attribute names and labels must be strings");
+    return false;
+}
+
+/* Obtain an attribute given by a name or a (name, value) pair. */
+static bool crfsuite_get_attribute(
+    PyObject *obj, const char **str, Py_ssize_t *len, double *value)
+{
+    *value = 1.;
+    if (PyTuple_Check(obj) || PyList_Check(obj)) {
+        if (PySequence_Fast_GET_SIZE(obj) != 2) {
+            PyErr_SetString(PyExc_ValueError, "an attribute must be a name or a (name, value) pair");
+            return false;
+        }
+        *value = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(obj, 1));
+        if (*value == -1. && PyErr_Occurred()) {
+            return false;
+        }
+        obj = PySequence_Fast_GET_ITEM(obj, 0);
+    }
+    return crfsuite_get_string(obj, str, len);
+}
+
+/* Encode item sequences into attribute identifiers in one pass. */
+static bool crfsuite_encode_batch(
+    CRFSuite::Tagger *tagger, PyObject *xseqs, std::vector<int>& aids,
+    std::vector<double>& values, std::vector<int>& offsets,
+    std::vector<int>& lengths)
+{
+    PyBatchSequence seqs, items, attrs;
+    if (!seqs.get(xseqs, "xseqs must be a sequence")) {
+        return false;
+    }
+    offsets.push_back(0);
+    for (Py_ssize_t n = 0; n < seqs.size; ++n) {
+        if (!items.get(seqs[n], "an item sequence must be a sequence of items")) {
+            return false;
+        }
+        for (Py_ssize_t t = 0; t < items.size; ++t) {
+            if (!attrs.get(items[t], "an item must be a sequence of attributes")) {
+                return false;
+            }
+            for (Py_ssize_t a = 0; a < attrs.size; ++a) {
+                const char *str = NULL;
+                Py_ssize_t len = 0;
+                double value;
+                if (!crfsuite_get_attribute(attrs[a], &str, &len, &value)) {
+                    return false;
+                }
+                int aid = tagger->attribute_id(str, (std::size_t)len);
+                if (0 <= aid) {
+                    aids.push_back(aid);
+                    values.push_back(value);
+                }
+            }
+            offsets.push_back((int)aids.size());
+        }
+        lengths.push_back((int)items.size);
+    }
+    return true;
+}
+
+/* Convert an item sequence and a label sequence for Trainer::append(). */
+static bool crfsuite_convert_instance(
+    PyObject *xseq, PyObject *yseq, CRFSuite::ItemSequence& items,
+    CRFSuite::StringList& labels)
+{
+    PyBatchSequence seq, attrs;
+    if (!seq.get(xseq, "an item sequence must be a sequence of items")) {
+        return false;
+    }
+    items.resize(seq.size);
+    for (Py_ssize_t t = 0; t < seq.size; ++t) {
+        if (!attrs.get(seq[t], "an item must be a sequence of attributes")) {
+            return false;
+        }
+        items[t].clear();
+        items[t].reserve(attrs.size);
+        for (Py_ssize_t a = 0; a < attrs.size; ++a) {
+            const char *str = NULL;
+            Py_ssize_t len = 0;
+            double value;
+            if (!crfsuite_get_attribute(attrs[a], &str, &len, &value)) {
+                return false;
+            }
+            items[t].push_back(CRFSuite::Attribute(std::string(str, len), value));
+        }
+    }
+
+    if (!seq.get(yseq, "a label sequence must be a sequence of strings")) {
+        return false;
+    }
+    labels.resize(seq.size);
+    for (Py_ssize_t t = 0; t < seq.size; ++t) {
+        const char *str = NULL;
+        Py_ssize_t len = 0;
+        if (!crfsuite_get_string(seq[t], &str, &len)) {
+            return false;
+        }
+        labels[t].assign(str, len);
+    }
+    return true;
+}
+%}
+
+%pythoncode %{
+try:
+    import numpy as _numpy
+except ImportError:
+    _numpy = None
+
+def _batch_input(obj, typecode):
+    """Convert an array-like object into a buffer of int or double."""
+    if obj is None:
+        return obj
+    if _numpy is not None:
+        return _numpy.ascontiguousarray(obj, dtype=(_numpy.intc if typecode == 'i' else _numpy.double))
+    import array
+    return obj if isinstance(obj, array.array) else array.array(typecode, obj)
+
+def _batch_output(typecode, size):
+    """Allocate a numpy array (or array.array without numpy)."""
+    if _numpy is not None:
+        return _numpy.zeros(size, dtype=(_numpy.intc if typecode == 'i' else _numpy.double))
+    import array
+    return array.array(typecode, [0]) * size
+%}
+
+%extend CRFSuite::Tagger {
+    PyObject *_tag_arrays(PyObject *aids, PyObject *values, PyObject *offsets,
+        PyObject *lengths, PyObject *labels, PyObject *marginals)
+    {
+        PyBatchBuffer a, v, o, n, l, m;
+        if (!a.get(aids, "aids", 'i', false) ||
+            (values != Py_None && !v.get(values, "values", 'd', false)) ||
+            !o.get(offsets, "offsets", 'i', false) ||
+            !n.get(lengths, "lengths", 'i', false) ||
+            !l.get(labels, "labels", 'i', true) ||
+            (marginals != Py_None && !m.get(marginals, "marginals", 'd', true))) {
+            return NULL;
+        }
+        if (!crfsuite_check_batch(
+                a.size, v.held ? v.size : -1, (const int*)o.view.buf, o.size,
+                (const int*)n.view.buf, n.size, l.size, m.held ? m.size : -1)) {
+            return NULL;
+        }
+
+        SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+        $self->tag(
+            (const int*)a.view.buf, v.held ? (const double*)v.view.buf : NULL,
+            (const int*)o.view.buf, (const int*)n.view.buf, (int)n.size,
+            (int*)l.view.buf, m.held ? (double*)m.view.buf : NULL);
+        SWIG_PYTHON_THREAD_END_ALLOW;
+        Py_RETURN_NONE;
+    }
+
+    PyObject *_tag_batch(PyObject *xseqs, PyObject *labels, PyObject *marginals)
+    {
+        std::vector<int> aids, offsets, lengths;
+        std::vector<double> values;
+        PyBatchBuffer l, m;
+        if (!crfsuite_encode_batch($self, xseqs, aids, values, offsets, lengths) ||
+            !l.get(labels, "labels", 'i', true) ||
+            (marginals != Py_None && !m.get(marginals, "marginals", 'd', true))) {
+            return NULL;
+        }
+        if (l.size < (Py_ssize_t)offsets.size() - 1 ||
+            (m.held && m.size < (Py_ssize_t)offsets.size() - 1)) {
+            PyErr_SetString(PyExc_ValueError, "the output arrays are too short");
+            return NULL;
+        }
+        aids.push_back(-1);
+        values.push_back(0.);
+
+        SWIG_PYTHON_THREAD_BEGIN_ALLOW;
+        $self->tag(
+            &aids[0], &values[0], &offsets[0],
+            lengths.empty() ? NULL : &lengths[0], (int)lengths.size(),
+            (int*)l.view.buf, m.held ? (double*)m.view.buf : NULL);
+        SWIG_PYTHON_THREAD_END_ALLOW;
+        Py_RETURN_NONE;
+    }
+
+%pythoncode %{
+    def tag_batch(self, xseqs, marginals=False):
+        """Tag a batch of item sequences.
+
+        Each item sequence is a list of items, and each item is a list of
+        attributes given by names or (name, value) pairs. The sequences
+        are encoded in one pass and tagged without holding the GIL.
+
+        Returns the label identifiers of all the items concatenated into
+        one array (indices of labels()), or a pair of the identifiers and
+        the marginal probabilities when marginals is True. The arrays are
+        numpy arrays if numpy is available.
+        """
+        xseqs = list(xseqs)
+        size = sum([len(xseq) for xseq in xseqs])
+        labels = _batch_output('i', size)
+        probs = _batch_output('d', size) if marginals else None
+        self._tag_batch(xseqs, labels, probs)
+        return (labels, probs) if marginals else labels
+
+    def tag_arrays(self, aids, offsets, lengths, values=None, marginals=False):
+        """Tag a batch of item sequences encoded into arrays.
+
+        The attributes of the item #i in the batch are
+        aids[offsets[i]:offsets[i+1]] (identifiers obtained by
+        attribute_id(); negative ones are ignored) with the optional
+        values, and the sequence #n consists of lengths[n] items. The
+        return value is the same as that of tag_batch().
+        """
+        aids = _batch_input(aids, 'i')
+        offsets = _batch_input(offsets, 'i')
+        lengths = _batch_input(lengths, 'i')
+        values = _batch_input(values, 'd')
+        size = sum(lengths)
+        labels = _batch_output('i', size)
+        probs = _batch_output('d', size) if marginals else None
+        self._tag_arrays(aids, values, offsets, lengths, labels, probs)
+        return (labels, probs) if marginals else labels
+%}
+}
+
+%feature("compactdefaultargs") CRFSuite::Trainer::append_batch;
+
+%extend CRFSuite::Trainer {
+    PyObject *append_batch(PyObject *xseqs, PyObject *yseqs, int group = 0)
+    {
+        PyBatchSequence xs, ys;
+        CRFSuite::ItemSequence items;
+        CRFSuite::StringList labels;
+        if (!xs.get(xseqs, "xseqs must be a sequence") ||
+            !ys.get(yseqs, "yseqs must be a sequence")) {
+            return NULL;
+        }
+        if (xs.size != ys.size) {
+            PyErr_SetString(PyExc_ValueError, "xseqs and yseqs must have the same length");
+            return NULL;
+        }
+        for (Py_ssize_t n = 0; n < xs.size; ++n) {
+            if (!crfsuite_convert_instance(xs[n], ys[n], items, labels)) {
+                return NULL;
+            }
+            $self->append(items, labels, group);
+        }
+        Py_RETURN_NONE;
+    }
+}
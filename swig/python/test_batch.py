@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+# -*- mode: python; coding: utf-8; -*-
+
+"""Compare the batch interface of the tagger with Tagger.tag().
+
+Usage: python test_batch.py MODEL DATA
+
+MODEL is a linear-chain model trained by "crfsuite learn", and DATA is a
+data file in the format of "crfsuite tag". The item sequences in DATA are
+tagged by Tagger.tag(), Tagger.tag_batch(), and Tagger.tag_arrays(), and
+the results are reported in the TAP format.
+"""
+
+##################################################################
+# Imports
+from __future__ import print_function
+
+import sys
+
+try:
+    from crfsuite import Attribute, Item, ItemSequence, Tagger
+except ImportError as e:
+    print('Bail out! the crfsuite module is not built (%s)' % e)
+    sys.exit(1)
+
+##################################################################
+# Constants
+# An attribute that no model has; every interface ignores it.
+UNKNOWN = 'unknown attribute'
+# Tolerance of the marginal probabilities.
+EPSILON = 1e-6
+
+
+##################################################################
+# Methods
+def instances(fi):
+    """Read item sequences of (name, value) pairs from a data file."""
+    xseq = []
+    for line in fi:
+        line = line.strip('\n')
+        if not line:
+            # An empty line presents an end of a sequence.
+            if xseq:
+                yield xseq
+            xseq = []
+            continue
+
+        # Split the line on TAB characters; the first field is a label.
+        item = []
+        for field in line.split('\t')[1:]:
+            p = field.rfind(':')
+            if p == -1:
+                item.append((field, 1.0))
+            else:
+                item.append((field[:p], float(field[p+1:])))
+        item.append((UNKNOWN, 1.0))
+        xseq.append(item)
+    if xseq:
+        yield xseq
+
+
+def item_sequence(xseq):
+    """Convert an item sequence into an ItemSequence object."""
+    items = ItemSequence()
+    for attrs in xseq:
+        item = Item()
+        for name, value in attrs:
+            item.append(Attribute(name, value))
+        items.append(item)
+    return items
+
+
+def encode(tagger, xseqs):
+    """Encode item sequences into arrays of attribute identifiers."""
+    aids, values, offsets, lengths = [], [], [0], []
+    for xseq in xseqs:
+        for attrs in xseq:
+            for name, value in attrs:
+                aids.append(tagger.attribute_id(name))
+                values.append(value)
+            offsets.append(len(aids))
+        lengths.append(len(xseq))
+    return aids, values, offsets, lengths
+
+
+def report(test, ok, message):
+    print('%s %d # %s' % ('ok' if ok else 'not ok', test, message))
+
+
+##################################################################
+# Main
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print('Bail out! usage: %s MODEL DATA' % sys.argv[0])
+        sys.exit(1)
+
+    tagger = Tagger()
+    if not tagger.open(sys.argv[1]):
+        print('Bail out! failed to open the model')
+        sys.exit(1)
+    with open(sys.argv[2]) as fi:
+        xseqs = list(instances(fi))
+    labels = list(tagger.labels())
+
+    # The reference labels and marginal probabilities of Tagger.tag().
+    expected, probs = [], []
+    for xseq in xseqs:
+        yseq = tagger.tag(item_sequence(xseq))
+        for t, y in enumerate(yseq):
+            expected.append(y)
+            probs.append(tagger.marginal(y, t))
+
+    print('1..4')
+
+    # Item sequences given by names and (name, value) pairs.
+    ids, marginals = tagger.tag_batch(xseqs, marginals=True)
+    report(1, [labels[i] for i in ids] == expected,
+           'tag_batch() agrees with tag() on %d items' % len(expected))
+    report(2, all(abs(p - q) < EPSILON for p, q in zip(marginals, probs)),
+           'marginals of tag_batch() agree with marginal()')
+
+    # Item sequences given by attribute identifiers.
+    aids, values, offsets, lengths = encode(tagger, xseqs)
+    ids, marginals = tagger.tag_arrays(
+        aids, offsets, lengths, values=values, marginals=True)
+    report(3, [labels[i] for i in ids] == expected,
+           'tag_arrays() agrees with tag() on %d items' % len(expected))
+    report(4, all(abs(p - q) < EPSILON for p, q in zip(marginals, probs)),
+           'marginals of tag_arrays() agree with marginal()')
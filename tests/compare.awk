@@ -0,0 +1,50 @@
+# $Id$
+#
+# Compare two outputs of crfsuite, allowing a difference up to `tolerance'
+# between the numbers at the same positions; the other tokens and the
+# number of lines must be identical. The exit status is zero if the
+# outputs agree.
+#
+#   awk -v tolerance=0.001 -f compare.awk FILE1 FILE2
+
+function numeric(s)
+{
+    return s ~ /^[-+]?[0-9]*\.?[0-9]+([eE][-+]?[0-9]+)?$/
+}
+
+FILENAME == ARGV[1] {
+    line[FNR] = $0
+    n = FNR
+    next
+}
+
+{
+    m = FNR
+    if (!(FNR in line)) {
+	differ = 1
+	exit
+    }
+    na = split(line[FNR], a, /[ \t:]+/)
+    nb = split($0, b, /[ \t:]+/)
+    if (na != nb) {
+	differ = 1
+	exit
+    }
+    for (i = 1; i <= na; ++i) {
+	if (numeric(a[i]) && numeric(b[i])) {
+	    d = a[i] - b[i]
+	    if (d < -tolerance || tolerance < d) {
+		differ = 1
+		exit
+	    }
+	}
+	else if (a[i] != b[i]) {
+	    differ = 1
+	    exit
+	}
+    }
+}
+
+END {
+    exit (differ || m != n) ? 1 : 0
+}
@@ -0,0 +1,162 @@
+/*
+ *        Look-ups of the CQDB formats with length-delimited keys.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cqdb.h>
+
+/*
+	This program writes a database in each format, and looks up every key
+	as a slice of a longer string (not terminated by a NULL character).
+	The results are reported in the TAP format.
+ */
+
+#define    NUM_KEYS    1000
+#define    LONG_KEY    300
+
+static char *make_key(int i)
+{
+	char *key = NULL;
+
+	/* Every tenth key is longer than the buffer for the first format. */
+	if (i % 10 == 0) {
+		key = (char*)malloc(LONG_KEY + 1);
+		memset(key, 'a' + i % 26, LONG_KEY);
+		sprintf(key + LONG_KEY - 8, "%08d", i);
+	}
+	else {
+		key = (char*)malloc(32);
+		sprintf(key, "w[0]=%d", i);
+	}
+	return key;
+}
+
+static char *write_database(int flag, char **keys, size_t *ptr_size)
+{
+	int i;
+	long size;
+	char *buffer = NULL;
+	cqdb_writer_t *dbw = NULL;
+	FILE *fp = tmpfile();
+
+	if (fp == NULL || (dbw = cqdb_writer(fp, flag)) == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < NUM_KEYS; ++i) {
+		if (cqdb_writer_put(dbw, keys[i], i) != 0) {
+			return NULL;
+		}
+	}
+	if (cqdb_writer_close(dbw) != 0) {
+		return NULL;
+	}
+
+	/* Read the database into memory. */
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	buffer = (char*)malloc(size);
+	fseek(fp, 0, SEEK_SET);
+	if (buffer == NULL || fread(buffer, 1, size, fp) != (size_t)size) {
+		free(buffer);
+		buffer = NULL;
+	}
+	fclose(fp);
+	*ptr_size = (size_t)size;
+	return buffer;
+}
+
+static int test_format(int flag, const char *name, char **keys, int test)
+{
+	int i, found = 0, sliced = 0, others = 0;
+	size_t size = 0;
+	cqdb_t *db = NULL;
+	char *buffer = write_database(flag, keys, &size);
+
+	if (buffer == NULL || (db = cqdb_reader(buffer, size)) == NULL) {
+		printf("Bail out! failed to write or read the database (%s)\n", name);
+		exit(1);
+	}
+
+	for (i = 0; i < NUM_KEYS; ++i) {
+		size_t length = strlen(keys[i]);
+		char *slice = (char*)malloc(length + 3);
+
+		/* The key between other characters. */
+		slice[0] = 'x';
+		memcpy(slice + 1, keys[i], length);
+		slice[length + 1] = 'y';
+		slice[length + 2] = 'z';
+
+		if (cqdb_to_id(db, keys[i]) == i) {
+			++found;
+		}
+		if (cqdb_to_id_n(db, slice + 1, length) == i) {
+			++sliced;
+		}
+		if (cqdb_to_id_n(db, slice + 1, length - 1) != i &&
+			cqdb_to_id_n(db, slice + 1, length + 1) < 0) {
+			++others;
+		}
+		free(slice);
+	}
+
+	printf("%s %d # %s: %d of %d keys found\n",
+		found == NUM_KEYS ? "ok" : "not ok", test, name, found, NUM_KEYS);
+	printf("%s %d # %s: %d of %d slices found\n",
+		sliced == NUM_KEYS ? "ok" : "not ok", test + 1, name, sliced, NUM_KEYS);
+	printf("%s %d # %s: %d of %d shorter and longer slices not matched\n",
+		others == NUM_KEYS ? "ok" : "not ok", test + 2, name, others, NUM_KEYS);
+
+	cqdb_delete(db);
+	free(buffer);
+	return test + 3;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, test = 1;
+	char *keys[NUM_KEYS];
+
+	for (i = 0; i < NUM_KEYS; ++i) {
+		keys[i] = make_key(i);
+	}
+
+	printf("1..6\n");
+	test = test_format(0, "first format", keys, test);
+	test = test_format(CQDB_FASTHASH, "second format", keys, test);
+
+	for (i = 0; i < NUM_KEYS; ++i) {
+		free(keys[i]);
+	}
+	return 0;
+}
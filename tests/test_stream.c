@@ -0,0 +1,196 @@
+/*
+ *        Streaming Viterbi decoding compared with Viterbi decoding.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* $Id$ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <crfsuite.h>
+
+/*
+	This program tags random sequences of the attributes of a model with
+	Viterbi decoding and with push() and pop() of a stream, and compares
+	the labels. The results are reported in the TAP format.
+ */
+
+#define    NUM_SEQUENCES    300
+#define    MAX_LENGTH       200
+#define    LONG_LENGTH      100000
+#define    NUM_ATTRIBUTES   3
+
+static unsigned int seed = 2463534242U;
+
+static int random_int(int n)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (int)(seed % (unsigned int)n);
+}
+
+static void random_instance(crfsuite_instance_t *inst, int T, int A)
+{
+	int i, t;
+	crfsuite_item_t item;
+	crfsuite_attribute_t cont;
+
+	crfsuite_instance_init(inst);
+	for (t = 0; t < T; ++t) {
+		crfsuite_item_init(&item);
+		for (i = 0; i < NUM_ATTRIBUTES; ++i) {
+			crfsuite_attribute_set(&cont, random_int(A), 1.0);
+			crfsuite_item_append_attribute(&item, &cont);
+		}
+		crfsuite_instance_append(inst, &item, 0);
+		crfsuite_item_finish(&item);
+	}
+}
+
+/* Tag an instance by a stream; returns the number of popped labels. */
+static int stream_instance(crfsuite_tagger_t *tagger, crfsuite_instance_t *inst, \
+	int lookahead, int *labels)
+{
+	int t, n = 0, num = 0;
+
+	if (tagger->stream(tagger, lookahead) != 0) {
+		return -1;
+	}
+	for (t = 0; t < inst->num_items; ++t) {
+		if (tagger->push(tagger, &inst->items[t]) != 0) {
+			return -1;
+		}
+		tagger->pop(tagger, labels + n, inst->num_items - n, 0, &num);
+		n += num;
+	}
+	tagger->pop(tagger, labels + n, inst->num_items - n, 1, &num);
+	return n + num;
+}
+
+/* Count the items whose labels agree between Viterbi and a stream. */
+static int compare(crfsuite_tagger_t *tagger, crfsuite_instance_t *inst, \
+	int lookahead, int *viterbi, int *streamed, int *ptr_popped)
+{
+	int t, agree = 0;
+	floatval_t score;
+
+	tagger->set(tagger, inst);
+	tagger->viterbi(tagger, viterbi, &score, NULL);
+	*ptr_popped = stream_instance(tagger, inst, lookahead, streamed);
+	for (t = 0; t < inst->num_items; ++t) {
+		if (viterbi[t] == streamed[t]) {
+			++agree;
+		}
+	}
+	return agree;
+}
+
+static int test_sequences(crfsuite_tagger_t *tagger, int A, int lookahead, \
+	int min_ratio, int test)
+{
+	int i, T, popped, agree = 0, items = 0, complete = 1;
+	int *viterbi = (int*)calloc(MAX_LENGTH, sizeof(int));
+	int *streamed = (int*)calloc(MAX_LENGTH, sizeof(int));
+	crfsuite_instance_t inst;
+
+	for (i = 0; i < NUM_SEQUENCES; ++i) {
+		T = 1 + random_int(MAX_LENGTH);
+		random_instance(&inst, T, A);
+		agree += compare(tagger, &inst, lookahead, viterbi, streamed, &popped);
+		items += T;
+		if (popped != T) {
+			complete = 0;
+		}
+		crfsuite_instance_finish(&inst);
+	}
+
+	printf("%s %d # lookahead %d: every label has been popped\n",
+		complete ? "ok" : "not ok", test, lookahead);
+	printf("%s %d # lookahead %d: %d of %d labels agree with Viterbi\n",
+		(double)agree * 100 >= (double)items * min_ratio ? "ok" : "not ok",
+		test + 1, lookahead, agree, items);
+
+	free(streamed);
+	free(viterbi);
+	return test + 2;
+}
+
+static int test_long_sequence(crfsuite_tagger_t *tagger, int A, int test)
+{
+	int popped, agree;
+	int *viterbi = (int*)calloc(LONG_LENGTH, sizeof(int));
+	int *streamed = (int*)calloc(LONG_LENGTH, sizeof(int));
+	crfsuite_instance_t inst;
+
+	random_instance(&inst, LONG_LENGTH, A);
+	agree = compare(tagger, &inst, LONG_LENGTH, viterbi, streamed, &popped);
+	printf("%s %d # long sequence: %d of %d labels agree with Viterbi\n",
+		(popped == LONG_LENGTH && agree == LONG_LENGTH) ? "ok" : "not ok",
+		test, agree, LONG_LENGTH);
+
+	crfsuite_instance_finish(&inst);
+	free(streamed);
+	free(viterbi);
+	return test + 1;
+}
+
+int main(int argc, char *argv[])
+{
+	int A, test = 1;
+	crfsuite_model_t *model = NULL;
+	crfsuite_tagger_t *tagger = NULL;
+	crfsuite_dictionary_t *attrs = NULL;
+
+	if (argc < 2 ||
+		crfsuite_create_instance_from_file(argv[1], (void**)&model, FTYPE_CRF1D) != 0 ||
+		model->get_tagger(model, &tagger) != 0 ||
+		model->get_attrs(model, &attrs) != 0) {
+		printf("Bail out! failed to open the model\n");
+		return 1;
+	}
+	A = attrs->num(attrs);
+
+	printf("1..5\n");
+
+	/* The stream decides every label on the best path of the sequence
+	   when the lookahead is not shorter than the sequence. */
+	test = test_sequences(tagger, A, MAX_LENGTH, 100, test);
+
+	/* A short lookahead commits some labels before the paths converge. */
+	test = test_sequences(tagger, A, 8, 99, test);
+
+	/* A long sequence in a single stream, whose scores are normalized
+	   at every item unlike those of Viterbi decoding. */
+	test = test_long_sequence(tagger, A, test);
+
+	attrs->release(attrs);
+	tagger->release(tagger);
+	model->release(model);
+	return 0;
+}
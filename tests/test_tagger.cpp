@@ -0,0 +1,280 @@
+/*
+ *        Tagger API with attribute identifiers, the attribute cache, and
+ *        the Viterbi-only mode.
+ *
+ * Copyright (c) 2007-2010, Naoaki Okazaki
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the names of the authors nor the names of its contributors
+ *       may be used to endorse or promote products derived from this
+ *       software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* $Id$ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <crfsuite.hpp>
+
+/*
+	This program tags random sequences of the attributes of a model with
+	the identifier-based functions of CRFSuite::Tagger and compares the
+	labels with those of the item sequences, checks the counts of the
+	attribute cache, and checks that a Viterbi-only tagger refuses to
+	compute marginal probabilities. The results are reported in the TAP
+	format.
+ */
+
+#define    NUM_SEQUENCES    100
+#define    MAX_LENGTH       32
+#define    NUM_ATTRIBUTES   3
+#define    CACHE_SIZE       64
+
+static unsigned int seed = 2463534242U;
+
+static int random_int(int n)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (int)(seed % (unsigned int)n);
+}
+
+/* A random sequence given both by attribute names and by identifiers. */
+struct sequence {
+	CRFSuite::ItemSequence xseq;
+	std::vector<int> aids;
+	std::vector<double> values;
+	std::vector<int> offsets;
+};
+
+static void random_sequence(sequence& seq, const std::vector<std::string>& names)
+{
+	int i, t, a;
+	const int T = 1 + random_int(MAX_LENGTH);
+
+	seq.xseq.clear();
+	seq.aids.clear();
+	seq.values.clear();
+	seq.offsets.assign(1, 0);
+	for (t = 0; t < T; ++t) {
+		CRFSuite::Item item;
+		for (i = 0; i < NUM_ATTRIBUTES; ++i) {
+			a = random_int((int)names.size());
+			double value = (1 + random_int(4)) * 0.5;
+			item.push_back(CRFSuite::Attribute(names[a], value));
+			seq.aids.push_back(a);
+			seq.values.push_back(value);
+		}
+		/* An attribute unknown to the model is ignored by both. */
+		item.push_back(CRFSuite::Attribute("unknown attribute"));
+		seq.aids.push_back(-1);
+		seq.values.push_back(1.);
+		seq.xseq.push_back(item);
+		seq.offsets.push_back((int)seq.aids.size());
+	}
+}
+
+static int test_identifiers(CRFSuite::Tagger& tagger,
+	const std::vector<std::string>& names, int test)
+{
+	int i, t, T, agree_ids = 1, agree_strs = 1;
+	sequence seq;
+	std::vector<int> labels(MAX_LENGTH);
+	std::vector<const char*> strs(MAX_LENGTH);
+
+	for (i = 0; i < NUM_SEQUENCES; ++i) {
+		random_sequence(seq, names);
+		tagger.set(seq.xseq);
+		CRFSuite::StringList yseq = tagger.viterbi();
+
+		tagger.set(&seq.aids[0], &seq.values[0], &seq.offsets[0], (int)seq.xseq.size());
+		T = tagger.viterbi(&labels[0]);
+		if (T != (int)yseq.size()) {
+			agree_ids = 0;
+		}
+		for (t = 0; t < T && t < (int)yseq.size(); ++t) {
+			if (yseq[t] != tagger.label(labels[t])) {
+				agree_ids = 0;
+			}
+		}
+
+		T = tagger.viterbi(&strs[0]);
+		if (T != (int)yseq.size()) {
+			agree_strs = 0;
+		}
+		for (t = 0; t < T && t < (int)yseq.size(); ++t) {
+			if (yseq[t] != strs[t]) {
+				agree_strs = 0;
+			}
+		}
+	}
+
+	printf("%s %d # viterbi(int*) after set() with identifiers agrees with viterbi()\n",
+		agree_ids ? "ok" : "not ok", test);
+	printf("%s %d # viterbi(const char**) after set() with identifiers agrees with viterbi()\n",
+		agree_strs ? "ok" : "not ok", test + 1);
+	return test + 2;
+}
+
+static int test_cache(CRFSuite::Tagger& tagger,
+	const std::vector<std::string>& names, int test)
+{
+	size_t i, hits;
+	int found = 1;
+	crfsuite_cache_stats_t stats;
+
+	tagger.cache_attributes(CACHE_SIZE);
+	stats = tagger.cache_stats();
+	printf("%s %d # an empty cache of %d entries for %d requested\n",
+		(CACHE_SIZE <= stats.size && stats.lookups == 0 && stats.hits == 0) ? "ok" : "not ok",
+		test, stats.size, CACHE_SIZE);
+
+	/* Every lookup is counted, and the cached identifiers are correct. */
+	for (i = 0; i < names.size(); ++i) {
+		if (tagger.attribute_id(names[i]) != (int)i) {
+			found = 0;
+		}
+	}
+	stats = tagger.cache_stats();
+	printf("%s %d # %d of %d lookups found the identifiers with %d hits\n",
+		(found && stats.lookups == names.size() && stats.hits <= stats.lookups) ? "ok" : "not ok",
+		test + 1, (int)stats.lookups, (int)names.size(), (int)stats.hits);
+
+	/* The second of two successive lookups of a name always hits. */
+	hits = stats.hits;
+	tagger.attribute_id(names[0]);
+	tagger.attribute_id(names[0]);
+	stats = tagger.cache_stats();
+	printf("%s %d # a repeated lookup hits the cache\n",
+		(stats.lookups == names.size() + 2 && hits < stats.hits) ? "ok" : "not ok",
+		test + 2);
+
+	tagger.cache_attributes(0);
+	stats = tagger.cache_stats();
+	printf("%s %d # the cache is disabled\n",
+		(stats.size == 0 && stats.lookups == 0 && stats.hits == 0) ? "ok" : "not ok",
+		test + 3);
+	return test + 4;
+}
+
+static int test_viterbi_only(const char *filename, CRFSuite::Tagger& reference,
+	const std::vector<std::string>& names, int test)
+{
+	int i, t, ret, agree = 1;
+	floatval_t score, prob;
+	sequence seq;
+	crfsuite_model_t *model = NULL;
+	crfsuite_tagger_t *tagger = NULL;
+	crfsuite_instance_t inst;
+	crfsuite_item_t item;
+	crfsuite_attribute_t cont;
+
+	random_sequence(seq, names);
+	reference.set(seq.xseq);
+	CRFSuite::StringList yseq = reference.viterbi();
+
+	if (crfsuite_create_instance_from_file_ex(
+			filename, (void**)&model, FTYPE_CRF1D, CRFSUITE_TAGGER_VITERBI) != 0 ||
+		model->get_tagger(model, &tagger) != 0) {
+		printf("Bail out! failed to open the model for Viterbi decoding\n");
+		exit(1);
+	}
+
+	crfsuite_instance_init(&inst);
+	for (t = 0; t < (int)seq.xseq.size(); ++t) {
+		crfsuite_item_init(&item);
+		for (i = seq.offsets[t]; i < seq.offsets[t+1]; ++i) {
+			if (0 <= seq.aids[i]) {
+				crfsuite_attribute_set(&cont, seq.aids[i], seq.values[i]);
+				crfsuite_item_append_attribute(&item, &cont);
+			}
+		}
+		crfsuite_instance_append(&inst, &item, 0);
+		crfsuite_item_finish(&item);
+	}
+
+	std::vector<int> labels(inst.num_items);
+	tagger->set(tagger, &inst);
+	ret = tagger->viterbi(tagger, &labels[0], &score, NULL);
+	for (t = 0; t < inst.num_items; ++t) {
+		if (yseq[t] != reference.label(labels[t])) {
+			agree = 0;
+		}
+	}
+	printf("%s %d # a Viterbi-only tagger finds the Viterbi labels\n",
+		(ret == 0 && agree) ? "ok" : "not ok", test);
+
+	ret = tagger->marginal_point(tagger, labels[0], 0, &prob, NULL);
+	printf("%s %d # marginal_point() of a Viterbi-only tagger is not supported (%d)\n",
+		ret == CRFSUITEERR_NOTSUPPORTED ? "ok" : "not ok", test + 1, ret);
+
+	crfsuite_instance_finish(&inst);
+	tagger->release(tagger);
+	model->release(model);
+	return test + 2;
+}
+
+int main(int argc, char *argv[])
+{
+	int a, A, test = 1;
+	const char *str = NULL;
+	CRFSuite::Tagger tagger;
+	crfsuite_model_t *model = NULL;
+	crfsuite_dictionary_t *attrs = NULL;
+	std::vector<std::string> names;
+
+	if (argc < 2 ||
+		crfsuite_create_instance_from_file(argv[1], (void**)&model, FTYPE_CRF1D) != 0 ||
+		model->get_attrs(model, &attrs) != 0 ||
+		!tagger.open(argv[1])) {
+		printf("Bail out! failed to open the model\n");
+		return 1;
+	}
+
+	/* The attribute names in the order of their identifiers. */
+	A = attrs->num(attrs);
+	for (a = 0; a < A; ++a) {
+		attrs->to_string(attrs, a, &str);
+		names.push_back(str);
+		attrs->free(attrs, str);
+	}
+	attrs->release(attrs);
+	model->release(model);
+
+	printf("1..8\n");
+
+	try {
+		test = test_identifiers(tagger, names, test);
+		test = test_cache(tagger, names, test);
+		test = test_viterbi_only(argv[1], tagger, names, test);
+	} catch (const std::exception& e) {
+		printf("Bail out! %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}